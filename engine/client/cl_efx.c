@@ -32,6 +32,37 @@ particle_t	*cl_particles = NULL;	// particle pool
 static vec3_t	cl_avelocities[NUMVERTEXNORMALS];
 static float	cl_lasttimewarn = 0.0f;
 
+// particles are thinked grouped by kind
+typedef enum
+{
+	PART_STATIC = 0,
+	PART_FIRE,
+	PART_EXPLODE,
+	PART_EXPLODE2,
+	PART_BLOB,
+	PART_BLOB2,
+	PART_GRAV,
+	PART_SLOWGRAV,
+	PART_VOX_GRAV,
+	PART_VOX_SLOWGRAV,
+	PART_CUSTOM,	// client callbacks and sparks
+	PART_KINDS
+} partkind_t;
+
+typedef struct
+{
+	particle_t	*pool;		// particles are indexed in this pool
+	particle_t	*head;		// sorted list
+	byte		*kind;		// kind + 1 for each listed particle
+	int		capacity;
+} partbatch_t;
+
+static partbatch_t	cl_partbatch;
+static qboolean	cl_partbatched;	// renderer shouldn't think particles
+
+static void CL_AllocParticleBatch( partbatch_t *pb, particle_t *pool, int capacity );
+static void CL_FreeParticleBatch( partbatch_t *pb );
+
 /*
 ================
 R_LookupColor
@@ -90,6 +121,7 @@ void CL_InitParticles( void )
 	int	i;
 
 	cl_particles = Mem_Calloc( cls.mempool, sizeof( particle_t ) * GI->max_particles );
+	CL_AllocParticleBatch( &cl_partbatch, cl_particles, GI->max_particles );
 	CL_ClearParticles ();
 
 	// this is used for EF_BRIGHTFIELD
@@ -138,6 +170,8 @@ void CL_FreeParticles( void )
 	if( cl_particles )
 		Mem_Free( cl_particles );
 	cl_particles = NULL;
+
+	CL_FreeParticleBatch( &cl_partbatch );
 }
 
 /*
@@ -2096,16 +2130,34 @@ void CL_DrawEFX( float time, qboolean fTrans )
 
 	if( fTrans )
 	{
-		R_FreeDeadParticles( &cl_active_particles );
 		if( CVAR_TO_BOOL( cl_draw_particles ))
+		{
+			// free dead particles and group the rest by type
+			CL_SortParticles( &cl_active_particles );
+
+			// renderer shouldn't think them one by one
+			cl_partbatched = true;
 			ref.dllFuncs.CL_DrawParticles( time, cl_active_particles, PART_SIZE );
+			cl_partbatched = false;
+
+			CL_SimulateParticles( time );
+		}
+		else R_FreeDeadParticles( &cl_active_particles );
+
 		R_FreeDeadParticles( &cl_active_tracers );
 		if( CVAR_TO_BOOL( cl_draw_tracers ))
 			ref.dllFuncs.CL_DrawTracers( time, cl_active_tracers );
 	}
 }
 
-void CL_ThinkParticle( double frametime, particle_t *p )
+/*
+==============
+CL_UpdateParticle
+
+think a single particle
+==============
+*/
+static void CL_UpdateParticle( double frametime, particle_t *p )
 {
 	float		time3 = 15.0f * frametime;
 	float		time2 = 10.0f * frametime;
@@ -2190,3 +2242,320 @@ void CL_ThinkParticle( double frametime, particle_t *p )
 	}
 }
 
+/*
+==============
+CL_ThinkParticle
+
+called by renderer for each drawn particle
+==============
+*/
+void CL_ThinkParticle( double frametime, particle_t *p )
+{
+	// already simulated by CL_SimulateParticles
+	if( cl_partbatched )
+		return;
+
+	CL_UpdateParticle( frametime, p );
+}
+
+/*
+==============================================================
+
+PARTICLES SIMULATION
+
+==============================================================
+*/
+/*
+==============
+CL_ParticleKind
+==============
+*/
+static int CL_ParticleKind( const particle_t *p )
+{
+	switch( p->type )
+	{
+	case pt_static: return PART_STATIC;
+	case pt_fire: return PART_FIRE;
+	case pt_explode: return PART_EXPLODE;
+	case pt_explode2: return PART_EXPLODE2;
+	case pt_blob: return ( p->packedColor == 255 ) ? PART_BLOB : PART_CUSTOM;
+	case pt_blob2: return ( p->packedColor == 255 ) ? PART_BLOB2 : PART_CUSTOM;
+	case pt_grav: return PART_GRAV;
+	case pt_slowgrav: return PART_SLOWGRAV;
+	case pt_vox_grav: return PART_VOX_GRAV;
+	case pt_vox_slowgrav: return PART_VOX_SLOWGRAV;
+	default: return PART_CUSTOM;
+	}
+}
+
+/*
+==============
+CL_AllocParticleBatch
+==============
+*/
+static void CL_AllocParticleBatch( partbatch_t *pb, particle_t *pool, int capacity )
+{
+	memset( pb, 0, sizeof( *pb ));
+	pb->kind = Mem_Calloc( cls.mempool, capacity );
+	pb->capacity = capacity;
+	pb->pool = pool;
+}
+
+/*
+==============
+CL_FreeParticleBatch
+==============
+*/
+static void CL_FreeParticleBatch( partbatch_t *pb )
+{
+	if( pb->kind )
+		Mem_Free( pb->kind );
+	memset( pb, 0, sizeof( *pb ));
+}
+
+/*
+==============
+CL_SortParticleBatch
+
+free dead particles, relink the rest grouped
+by kind and in the pool order inside the group
+==============
+*/
+static void CL_SortParticleBatch( partbatch_t *pb, particle_t **list, double killtime )
+{
+	particle_t	*head[PART_KINDS], **tail[PART_KINDS];
+	particle_t	*p, *next, **link;
+	particle_t	*dead, **deadtail;
+	particle_t	*other, **othertail;
+	int		i, index, kind;
+	int		first, last;
+
+	first = pb->capacity;
+	last = -1;
+
+	dead = NULL;
+	deadtail = &dead;
+	other = NULL;
+	othertail = &other;
+
+	for( p = *list; p; p = next )
+	{
+		next = p->next;
+		index = p - pb->pool;
+
+		if( p->die < killtime )
+		{
+			// deathfuncs are called when list is consistent again
+			*deadtail = p;
+			deadtail = &p->next;
+			continue;
+		}
+
+		// particle doesn't belong to the pool, keep it unsorted
+		if( index < 0 || index >= pb->capacity )
+		{
+			*othertail = p;
+			othertail = &p->next;
+			continue;
+		}
+
+		pb->kind[index] = CL_ParticleKind( p ) + 1;
+		first = Q_min( first, index );
+		last = Q_max( last, index );
+	}
+
+	*deadtail = NULL;
+
+	for( kind = 0; kind < PART_KINDS; kind++ )
+	{
+		head[kind] = NULL;
+		tail[kind] = &head[kind];
+	}
+
+	// counting sort by pool index
+	for( i = first; i <= last; i++ )
+	{
+		if( !pb->kind[i] ) continue;
+
+		kind = pb->kind[i] - 1;
+		p = &pb->pool[i];
+		*tail[kind] = p;
+		tail[kind] = &p->next;
+		pb->kind[i] = 0;
+	}
+
+	link = list;
+	for( kind = 0; kind < PART_KINDS; kind++ )
+	{
+		if( !head[kind] ) continue;
+		*link = head[kind];
+		link = tail[kind];
+	}
+	*link = other;
+	*othertail = NULL;
+
+	pb->head = *list;
+
+	// particles allocated by deathfuncs are linked before the head
+	for( p = dead; p; p = next )
+	{
+		next = p->next;
+
+		if( p->deathfunc )
+			p->deathfunc( p );
+
+		// move to freelist
+		p->deathfunc = NULL;
+		p->next = cl_free_particles;
+		cl_free_particles = p;
+	}
+}
+
+/*
+==============
+CL_ThinkParticleBatch
+
+particles of the same kind are going in a row and in memory
+order, so type switch in CL_UpdateParticle is well predicted
+==============
+*/
+static void CL_ThinkParticleBatch( partbatch_t *pb, double frametime )
+{
+	particle_t	*p;
+
+	// particles allocated by callbacks are going before the head
+	for( p = pb->head; p; p = p->next )
+		CL_UpdateParticle( frametime, p );
+}
+
+/*
+==============
+CL_SortParticles
+
+free dead particles and group the rest by kind
+==============
+*/
+void CL_SortParticles( particle_t **list )
+{
+	CL_SortParticleBatch( &cl_partbatch, list, cl.time );
+}
+
+/*
+==============
+CL_SimulateParticles
+
+think all the particles sorted by CL_SortParticles
+==============
+*/
+void CL_SimulateParticles( double frametime )
+{
+	CL_ThinkParticleBatch( &cl_partbatch, frametime );
+	cl_partbatch.head = NULL;
+}
+
+/*
+==============
+CL_ParticleBench_f
+
+think synthetic explosion particles one by one
+and in batches, compare the results
+==============
+*/
+void CL_ParticleBench_f( void )
+{
+	static const ptype_t types[] = { pt_explode, pt_explode2, pt_blob, pt_blob2, pt_grav, pt_slowgrav, pt_fire, pt_static };
+	double		start, elapsed[2];
+	particle_t	*pool, *list[2], *p;
+	partbatch_t	batch;
+	int		i, j, k, count, frames;
+	int		mismatch = 0, *order;
+	particle_t	*oldfree;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "partbench <particles> [frames]\n" );
+		return;
+	}
+
+	count = bound( 1, Q_atoi( Cmd_Argv( 1 )), 65536 );
+	frames = ( Cmd_Argc() > 2 ) ? bound( 1, Q_atoi( Cmd_Argv( 2 )), 100000 ) : 100;
+
+	pool = Mem_Calloc( cls.mempool, sizeof( particle_t ) * count * 2 );
+	CL_AllocParticleBatch( &batch, &pool[count], count );
+
+	for( i = 0; i < count; i++ )
+	{
+		p = &pool[i];
+		p->type = types[i % ARRAYSIZE( types )];
+		p->packedColor = 255;
+		p->ramp = COM_RandomFloat( 0.0f, 4.0f );
+		p->die = 99999.0f;
+		for( j = 0; j < 3; j++ )
+		{
+			p->org[j] = COM_RandomFloat( -4096.0f, 4096.0f );
+			p->vel[j] = COM_RandomFloat( -256.0f, 256.0f );
+		}
+		pool[count + i] = *p;
+	}
+
+	// freelist is shuffled after a while in the game
+	order = Mem_Malloc( cls.mempool, sizeof( int ) * count );
+	for( i = 0; i < count; i++ )
+		order[i] = i;
+
+	for( i = count - 1; i > 0; i-- )
+	{
+		j = COM_RandomLong( 0, i );
+		k = order[i];
+		order[i] = order[j];
+		order[j] = k;
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		k = order[i];
+		pool[k].next = ( i < count - 1 ) ? &pool[order[i+1]] : NULL;
+		pool[count + k].next = ( i < count - 1 ) ? &pool[count + order[i+1]] : NULL;
+	}
+	list[0] = &pool[order[0]];
+	list[1] = &pool[count + order[0]];
+	Mem_Free( order );
+
+	start = Sys_DoubleTime();
+	for( i = 0; i < frames; i++ )
+	{
+		for( p = list[0]; p; p = p->next )
+			CL_UpdateParticle( 0.01, p );
+	}
+	elapsed[0] = Sys_DoubleTime() - start;
+
+	// nothing should die here, but keep the freelist safe
+	oldfree = cl_free_particles;
+
+	start = Sys_DoubleTime();
+	for( i = 0; i < frames; i++ )
+	{
+		CL_SortParticleBatch( &batch, &list[1], -99999.0f );
+		CL_ThinkParticleBatch( &batch, 0.01 );
+	}
+	elapsed[1] = Sys_DoubleTime() - start;
+
+	cl_free_particles = oldfree;
+
+	for( i = 0; i < count; i++ )
+	{
+		particle_t	*a = &pool[i], *b = &pool[count + i];
+
+		if( memcmp( a->org, b->org, sizeof( a->org )) || memcmp( a->vel, b->vel, sizeof( a->vel ))
+		 || a->ramp != b->ramp || a->color != b->color || a->die != b->die )
+			mismatch++;
+	}
+
+	Con_Printf( "thinked %i particles, %i frames\n", count, frames );
+	Con_Printf( "single: %.3f msec per frame\n", elapsed[0] * 1000.0 / frames );
+	Con_Printf( "batched: %.3f msec per frame, %.2fx\n", elapsed[1] * 1000.0 / frames, elapsed[0] / Q_max( elapsed[1], 0.000001 ));
+	if( mismatch ) Con_Printf( S_WARN "%i particles are mismatched\n", mismatch );
+
+	CL_FreeParticleBatch( &batch );
+	Mem_Free( pool );
+}
@@ -23,6 +23,9 @@ GNU General Public License for more details.
 #include "dlight.h"
 #include "sound.h"
 #include "input.h"
+#if XASH_SSE2
+#include <emmintrin.h>
+#endif
 
 #define STUDIO_INTERPOLATION_FIX
 
@@ -426,15 +429,19 @@ void CL_PureOrigin( cl_entity_t *ent, float t, vec3_t outorigin, vec3_t outangle
 
 /*
 ==================
-CL_InterpolateModel
+CL_SetupInterpolation
 
-non-players interpolation
+pick history updates and lerp fraction
+for non-players interpolation
 ==================
 */
-int CL_InterpolateModel( cl_entity_t *e )
+#define INTERP_SKIP		0	// entity is not ready to draw
+#define INTERP_DONE		1	// origin and angles are final
+#define INTERP_LERP		2	// lerp between ph1 and ph0 by frac
+
+static int CL_SetupInterpolation( cl_entity_t *e, position_history_t **pph0, position_history_t **pph1, float *pfrac )
 {
 	position_history_t  *ph0 = NULL, *ph1 = NULL;
-	vec3_t		origin, angles, delta;
 	float		t, t1, t2, frac;
 	vec4_t		q, q1, q2;
 
@@ -442,7 +449,7 @@ int CL_InterpolateModel( cl_entity_t *e )
 	VectorCopy( e->curstate.angles, e->angles );
 
 	if( cls.timedemo || !e->model )
-		return 1;
+		return INTERP_DONE;
 
 	if( cls.demoplayback == DEMO_QUAKE1 )
 	{
@@ -452,54 +459,71 @@ int CL_InterpolateModel( cl_entity_t *e )
 		AngleQuaternion( e->curstate.angles, q2, false );
 		QuaternionSlerp( q1, q2, cl.lerpFrac, q );
 		QuaternionAngle( q, e->angles );
-		return 1;
+		return INTERP_DONE;
 	}
 
 	if( cl.maxclients <= 1 )
-		return 1;
+		return INTERP_DONE;
 
 	if( e->model->type == mod_brush && !cl_bmodelinterp->value )
-		return 1;
+		return INTERP_DONE;
 
 	if( cl.local.moving && cl.local.onground == e->index )
-		return 1;
+		return INTERP_DONE;
 
 	t = cl.time - cl_interp->value;
 	CL_FindInterpolationUpdates( e, t, &ph0, &ph1 );
 
 	if( ph0 == NULL || ph1 == NULL )
-		return 0;
+		return INTERP_SKIP;
 
 	t1 = ph1->animtime;
 	t2 = ph0->animtime;
 
 	if( t - t1 < 0.0f )
-		return 0;
+		return INTERP_SKIP;
 
 	if( t1 == 0.0f )
 	{
 		VectorCopy( ph0->origin, e->origin );
 		VectorCopy( ph0->angles, e->angles );
-		return 0;
+		return INTERP_SKIP;
 	}
 
 	if( t2 == t1 )
 	{
 		VectorCopy( ph0->origin, e->origin );
 		VectorCopy( ph0->angles, e->angles );
-		return 1;
+		return INTERP_DONE;
 	}
 
-	VectorSubtract( ph0->origin, ph1->origin, delta );
 	frac = (t - t1) / (t2 - t1);
 
 	if( frac < 0.0f )
-		return 0;
+		return INTERP_SKIP;
 
 	if( frac > 1.0f )
 		frac = 1.0f;
 
-	VectorMA( ph1->origin, frac, delta, origin );
+	*pph0 = ph0;
+	*pph1 = ph1;
+	*pfrac = frac;
+
+	return INTERP_LERP;
+}
+
+/*
+==================
+CL_SlerpInterpolation
+
+finish the lerp: slerp angles and apply
+already lerped origin
+==================
+*/
+static void CL_SlerpInterpolation( cl_entity_t *e, const position_history_t *ph0, const position_history_t *ph1, float frac, const vec3_t origin )
+{
+	vec4_t	q, q1, q2;
+	vec3_t	angles;
 
 	AngleQuaternion( ph0->angles, q1, false );
 	AngleQuaternion( ph1->angles, q2, false );
@@ -508,10 +532,294 @@ int CL_InterpolateModel( cl_entity_t *e )
 
 	VectorCopy( origin, e->origin );
 	VectorCopy( angles, e->angles );
+}
+
+/*
+==================
+CL_InterpolateModel
+
+non-players interpolation
+==================
+*/
+int CL_InterpolateModel( cl_entity_t *e )
+{
+	position_history_t  *ph0, *ph1;
+	vec3_t		origin, delta;
+	float		frac;
+	int		result;
+
+	result = CL_SetupInterpolation( e, &ph0, &ph1, &frac );
+
+	if( result != INTERP_LERP )
+		return result;
+
+	VectorSubtract( ph0->origin, ph1->origin, delta );
+	VectorMA( ph1->origin, frac, delta, origin );
+	CL_SlerpInterpolation( e, ph0, ph1, frac, origin );
 
 	return 1;
 }
 
+/*
+=========================================================================
+
+BATCHED INTERPOLATION
+
+packet entities are linked in chunks: the first pass prepares each
+entity and gathers origins to lerp into per-axis arrays, the second
+lerps them four at a time, the third slerps angles (the endpoint
+quaternions are cached per entity) and links entities in the original
+order. Results are identical to CL_InterpolateModel
+
+=========================================================================
+*/
+#define LINK_BATCH		256	// packet entities per chunk
+
+typedef struct
+{
+	cl_entity_t	*ent;
+	entity_state_t	*state;
+	int		result;		// same as CL_InterpolateModel
+	qboolean		studiolerp;	// call R_StudioLerpMovement
+} linkent_t;
+
+typedef struct
+{
+	linkent_t		ents[LINK_BATCH];
+	int		numents;
+
+	// lerp inputs, lerped origins replace 'from'
+	float		from[3][LINK_BATCH];
+	float		to[3][LINK_BATCH];
+	float		frac[LINK_BATCH];
+	position_history_t	*ph0[LINK_BATCH];
+	position_history_t	*ph1[LINK_BATCH];
+	int		slot[LINK_BATCH];	// owner in ents
+	int		numlerps;
+} linkbatch_t;
+
+// history updates arrive much slower than frames are drawn, so the
+// quaternions of the lerp endpoints are kept between frames
+#define QUAT_CACHE_SIZE	1024	// must be power of two
+
+typedef struct
+{
+	int		entnum;		// entity index + 1, 0 is unused slot
+	vec3_t		angles[2];	// ph0 and ph1 angles
+	vec4_t		quat[2];
+} interpquat_t;
+
+static linkbatch_t	cl_linkbatch;
+static interpquat_t	cl_interpquat[QUAT_CACHE_SIZE];
+
+/*
+==================
+CL_QueueInterpolation
+
+find history updates for entity
+and gather the origins to lerp
+==================
+*/
+static void CL_QueueInterpolation( linkbatch_t *b, linkent_t *le )
+{
+	position_history_t	*ph0, *ph1;
+	float		frac;
+	int		i, n;
+
+	le->result = CL_SetupInterpolation( le->ent, &ph0, &ph1, &frac );
+
+	if( le->result != INTERP_LERP )
+		return;
+
+	n = b->numlerps++;
+
+	for( i = 0; i < 3; i++ )
+	{
+		b->from[i][n] = ph1->origin[i];
+		b->to[i][n] = ph0->origin[i];
+	}
+
+	b->frac[n] = frac;
+	b->ph0[n] = ph0;
+	b->ph1[n] = ph1;
+	b->slot[n] = le - b->ents;
+}
+
+/*
+==================
+CL_FlushInterpolation
+
+lerp all the gathered origins, slerp angles
+==================
+*/
+static void CL_FlushInterpolation( linkbatch_t *b )
+{
+	int	i = 0, j;
+
+#if XASH_SSE2
+	// same operations as VectorMA( from, frac, to - from ),
+	// so the results are bit exact
+	for( ; i + 4 <= b->numlerps; i += 4 )
+	{
+		__m128	frac = _mm_loadu_ps( &b->frac[i] );
+
+		for( j = 0; j < 3; j++ )
+		{
+			__m128	from = _mm_loadu_ps( &b->from[j][i] );
+			__m128	delta = _mm_sub_ps( _mm_loadu_ps( &b->to[j][i] ), from );
+
+			_mm_storeu_ps( &b->from[j][i], _mm_add_ps( from, _mm_mul_ps( frac, delta )));
+		}
+	}
+#endif
+	for( ; i < b->numlerps; i++ )
+	{
+		for( j = 0; j < 3; j++ )
+			b->from[j][i] = b->from[j][i] + b->frac[i] * ( b->to[j][i] - b->from[j][i] );
+	}
+
+	for( i = 0; i < b->numlerps; i++ )
+	{
+		linkent_t		*le = &b->ents[b->slot[i]];
+		interpquat_t	*iq = &cl_interpquat[le->ent->index & ( QUAT_CACHE_SIZE - 1 )];
+		vec4_t		q;
+
+		// compare bits, same angles give same quaternions
+		if( iq->entnum != le->ent->index + 1
+		 || memcmp( iq->angles[0], b->ph0[i]->angles, sizeof( vec3_t ))
+		 || memcmp( iq->angles[1], b->ph1[i]->angles, sizeof( vec3_t )))
+		{
+			iq->entnum = le->ent->index + 1;
+			VectorCopy( b->ph0[i]->angles, iq->angles[0] );
+			VectorCopy( b->ph1[i]->angles, iq->angles[1] );
+			AngleQuaternion( iq->angles[0], iq->quat[0], false );
+			AngleQuaternion( iq->angles[1], iq->quat[1], false );
+		}
+
+		le->ent->origin[0] = b->from[0][i];
+		le->ent->origin[1] = b->from[1][i];
+		le->ent->origin[2] = b->from[2][i];
+
+		QuaternionSlerp( iq->quat[1], iq->quat[0], b->frac[i], q );
+		QuaternionAngle( q, le->ent->angles );
+		le->result = 1;
+	}
+
+	b->numlerps = 0;
+}
+
+/*
+==================
+CL_InterpolationBench_f
+
+interpolate current packet entities one by one
+and in batches, compare the results
+==================
+*/
+void CL_InterpolationBench_f( void )
+{
+	linkbatch_t	*b = &cl_linkbatch;
+	frame_t		*frame;
+	entity_state_t	*state;
+	cl_entity_t	**ents, *ent;
+	vec3_t		*saved, *result;
+	int		i, j, count, frames;
+	int		lerps = 0, mismatch = 0;
+	double		start, elapsed[2];
+
+	if( cls.state != ca_active || !cl.validsequence || !cl.frames[cl.parsecountmod].valid )
+	{
+		Con_Printf( "interpbench: play a demo or connect to server first\n" );
+		return;
+	}
+
+	if( cls.timedemo || cl.maxclients <= 1 )
+	{
+		Con_Printf( "interpbench: interpolation is disabled in timedemo and singleplayer\n" );
+		return;
+	}
+
+	frames = ( Cmd_Argc() > 1 ) ? bound( 1, Q_atoi( Cmd_Argv( 1 )), 100000 ) : 1000;
+	frame = &cl.frames[cl.parsecountmod];
+
+	ents = Mem_Malloc( cls.mempool, sizeof( *ents ) * Q_max( frame->num_entities, 1 ));
+
+	for( i = count = 0; i < frame->num_entities; i++ )
+	{
+		state = &cls.packet_entities[(frame->first_entity + i) % cls.num_client_entities];
+
+		if( CL_IsPlayerIndex( state->number ) || !state->modelindex || FBitSet( state->effects, EF_NODRAW ))
+			continue;
+
+		ent = CL_GetEntityByIndex( state->number );
+		if( ent && ent->model ) ents[count++] = ent;
+	}
+
+	// keep the frame untouched
+	saved = Mem_Malloc( cls.mempool, sizeof( vec3_t ) * 6 * Q_max( count, 1 ));
+	result = saved + count * 2;
+
+	for( i = 0; i < count; i++ )
+	{
+		VectorCopy( ents[i]->origin, saved[i*2+0] );
+		VectorCopy( ents[i]->angles, saved[i*2+1] );
+	}
+
+	start = Sys_DoubleTime();
+	for( j = 0; j < frames; j++ )
+	{
+		for( i = 0; i < count; i++ )
+			CL_InterpolateModel( ents[i] );
+	}
+	elapsed[0] = Sys_DoubleTime() - start;
+
+	for( i = 0; i < count; i++ )
+	{
+		VectorCopy( ents[i]->origin, result[i*2+0] );
+		VectorCopy( ents[i]->angles, result[i*2+1] );
+	}
+
+	start = Sys_DoubleTime();
+	for( j = 0; j < frames; j++ )
+	{
+		for( i = 0; i < count; i++ )
+		{
+			if( b->numents == LINK_BATCH )
+			{
+				CL_FlushInterpolation( b );
+				b->numents = 0;
+			}
+
+			b->ents[b->numents].ent = ents[i];
+			CL_QueueInterpolation( b, &b->ents[b->numents] );
+			if( b->ents[b->numents].result == INTERP_LERP && j == 0 )
+				lerps++;
+			b->numents++;
+		}
+
+		CL_FlushInterpolation( b );
+		b->numents = 0;
+	}
+	elapsed[1] = Sys_DoubleTime() - start;
+
+	for( i = 0; i < count; i++ )
+	{
+		if( !VectorCompare( ents[i]->origin, result[i*2+0] ) || !VectorCompare( ents[i]->angles, result[i*2+1] ))
+			mismatch++;
+
+		VectorCopy( saved[i*2+0], ents[i]->origin );
+		VectorCopy( saved[i*2+1], ents[i]->angles );
+	}
+
+	Con_Printf( "interpolated %i entities (%i lerped), %i frames\n", count, lerps, frames );
+	Con_Printf( "single: %.3f msec per frame\n", elapsed[0] * 1000.0 / frames );
+	Con_Printf( "batched: %.3f msec per frame, %.2fx\n", elapsed[1] * 1000.0 / frames, elapsed[0] / Q_max( elapsed[1], 0.000001 ));
+	if( mismatch ) Con_Printf( S_WARN "%i entities are mismatched\n", mismatch );
+
+	Mem_Free( saved );
+	Mem_Free( ents );
+}
+
 /*
 =============
 CL_ComputePlayerOrigin
@@ -1104,6 +1412,76 @@ void CL_LinkPlayers( frame_t *frame )
 	if( cl.local.apply_effects ) CL_AddEntityEffects( CL_GetLocalPlayer( ));
 }
 
+/*
+===============
+CL_LinkEntityBatch
+
+finish interpolation and link the batched entities
+===============
+*/
+static void CL_LinkEntityBatch( linkbatch_t *b )
+{
+	cl_entity_t	*ent;
+	entity_state_t	*state;
+	linkent_t		*le;
+	int		i;
+
+	CL_FlushInterpolation( b );
+
+	for( i = 0; i < b->numents; i++ )
+	{
+		le = &b->ents[i];
+		ent = le->ent;
+		state = le->state;
+
+		// brushes are linked even without interpolation
+		if( !le->result && ent->model->type != mod_brush )
+			continue;
+
+		if( le->studiolerp )
+			ref.dllFuncs.R_StudioLerpMovement( ent, cl.time, ent->origin, ent->angles );
+
+		if( !FBitSet( state->entityType, ENTITY_NORMAL ))
+		{
+			CL_LinkCustomEntity( ent, state );
+			continue;
+		}
+
+		if( ent->model->type != mod_brush )
+		{
+			// NOTE: never pass sprites with rendercolor '0 0 0' it's a stupid Valve Hammer Editor bug
+			if( !ent->curstate.rendercolor.r && !ent->curstate.rendercolor.g && !ent->curstate.rendercolor.b )
+				ent->curstate.rendercolor.r = ent->curstate.rendercolor.g = ent->curstate.rendercolor.b = 255;
+		}
+
+		// XASH SPECIFIC
+		if( ent->curstate.rendermode == kRenderNormal && ent->curstate.renderfx == kRenderFxNone )
+			ent->curstate.renderamt = 255.0f;
+
+		if( ent->curstate.aiment != 0 && ent->curstate.movetype != MOVETYPE_COMPOUND )
+			ent->curstate.movetype = MOVETYPE_FOLLOW;
+
+		if( FBitSet( ent->curstate.effects, EF_NOINTERP ))
+			CL_ResetLatchedVars( ent, false );
+
+		if( CL_EntityTeleported( ent ))
+		{
+			VectorCopy( ent->curstate.origin, ent->latched.prevorigin );
+			VectorCopy( ent->curstate.angles, ent->latched.prevangles );
+			CL_ResetPositions( ent );
+		}
+
+		VectorCopy( ent->origin, ent->attachment[0] );
+		VectorCopy( ent->origin, ent->attachment[1] );
+		VectorCopy( ent->origin, ent->attachment[2] );
+		VectorCopy( ent->origin, ent->attachment[3] );
+
+		CL_AddVisibleEntity( ent, ET_NORMAL );
+	}
+
+	b->numents = 0;
+}
+
 /*
 ===============
 CL_LinkPacketEntities
@@ -1112,8 +1490,10 @@ CL_LinkPacketEntities
 */
 void CL_LinkPacketEntities( frame_t *frame )
 {
+	linkbatch_t	*b = &cl_linkbatch;
 	cl_entity_t	*ent;
 	entity_state_t	*state;
+	linkent_t		*le;
 	qboolean		parametric;
 	qboolean		interpolate;
 	int		i;
@@ -1192,9 +1572,18 @@ void CL_LinkPacketEntities( frame_t *frame )
 			}
 		}
 
+		if( b->numents == LINK_BATCH )
+			CL_LinkEntityBatch( b );
+
+		le = &b->ents[b->numents++];
+		le->ent = ent;
+		le->state = state;
+		le->result = 1;
+		le->studiolerp = false;
+
 		if( ent->model->type == mod_brush )
 		{
-			CL_InterpolateModel( ent );
+			CL_QueueInterpolation( b, le );
 		}
 		else
 		{
@@ -1207,13 +1596,11 @@ void CL_LinkPacketEntities( frame_t *frame )
 			}
 			else if( CL_EntityCustomLerp( ent ))
 			{
-				if ( !CL_InterpolateModel( ent ))
-					continue;
+				CL_QueueInterpolation( b, le );
 			}
 			else if( ent->curstate.movetype == MOVETYPE_STEP && !NET_IsLocalAddress( cls.netchan.remote_address ))
 			{
-				if( !CL_InterpolateModel( ent ))
-					continue;
+				CL_QueueInterpolation( b, le );
 			}
 			else
 			{
@@ -1225,47 +1612,12 @@ void CL_LinkPacketEntities( frame_t *frame )
 			if( ent->model->type == mod_studio )
 			{
 				if( interpolate && FBitSet( host.features, ENGINE_COMPUTE_STUDIO_LERP ))
-					ref.dllFuncs.R_StudioLerpMovement( ent, cl.time, ent->origin, ent->angles );
+					le->studiolerp = true;
 			}
 		}
-
-		if( !FBitSet( state->entityType, ENTITY_NORMAL ))
-		{
-			CL_LinkCustomEntity( ent, state );
-			continue;
-		}
-
-		if( ent->model->type != mod_brush )
-		{
-			// NOTE: never pass sprites with rendercolor '0 0 0' it's a stupid Valve Hammer Editor bug
-			if( !ent->curstate.rendercolor.r && !ent->curstate.rendercolor.g && !ent->curstate.rendercolor.b )
-				ent->curstate.rendercolor.r = ent->curstate.rendercolor.g = ent->curstate.rendercolor.b = 255;
-		}
-
-		// XASH SPECIFIC
-		if( ent->curstate.rendermode == kRenderNormal && ent->curstate.renderfx == kRenderFxNone )
-			ent->curstate.renderamt = 255.0f;
-
-		if( ent->curstate.aiment != 0 && ent->curstate.movetype != MOVETYPE_COMPOUND )
-			ent->curstate.movetype = MOVETYPE_FOLLOW;
-
-		if( FBitSet( ent->curstate.effects, EF_NOINTERP ))
-			CL_ResetLatchedVars( ent, false );
-
-		if( CL_EntityTeleported( ent ))
-		{
-			VectorCopy( ent->curstate.origin, ent->latched.prevorigin );
-			VectorCopy( ent->curstate.angles, ent->latched.prevangles );
-			CL_ResetPositions( ent );
-		}
-
-		VectorCopy( ent->origin, ent->attachment[0] );
-		VectorCopy( ent->origin, ent->attachment[1] );
-		VectorCopy( ent->origin, ent->attachment[2] );
-		VectorCopy( ent->origin, ent->attachment[3] );
-
-		CL_AddVisibleEntity( ent, ET_NORMAL );
 	}
+
+	CL_LinkEntityBatch( b );
 }
 
 /*
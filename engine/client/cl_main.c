@@ -43,6 +43,7 @@ convar_t	*rcon_client_password;
 convar_t	*rcon_address;
 convar_t	*cl_timeout;
 convar_t	*cl_nopred;
+convar_t	*cl_predcache;
 convar_t	*cl_showfps;
 convar_t	*cl_nodelta;
 convar_t	*cl_crosshair;
@@ -2826,6 +2827,7 @@ void CL_InitLocal( void )
 
 	// userinfo
 	cl_nopred = Cvar_Get( "cl_nopred", "0", FCVAR_ARCHIVE|FCVAR_USERINFO, "disable client movement prediction" );
+	cl_predcache = Cvar_Get( "cl_predcache", "1", FCVAR_ARCHIVE, "reuse prediction of the sent commands while server ack and physents are the same" );
 	name = Cvar_Get( "name", Sys_GetCurrentUser(), FCVAR_USERINFO|FCVAR_ARCHIVE|FCVAR_PRINTABLEONLY, "player name" );
 	model = Cvar_Get( "model", "", FCVAR_USERINFO|FCVAR_ARCHIVE, "player model ('player' is a singleplayer model)" );
 	cl_updaterate = Cvar_Get( "cl_updaterate", "20", FCVAR_USERINFO|FCVAR_ARCHIVE, "refresh rate of server messages" );
@@ -2899,6 +2901,9 @@ void CL_InitLocal( void )
 	Cmd_AddCommand ("togglemenu", CL_Escape_f, "toggle between game and menu" );
 	Cmd_AddCommand ("pointfile", CL_ReadPointFile_f, "show leaks on a map (if present of course)" );
 	Cmd_AddCommand ("linefile", CL_ReadLineFile_f, "show leaks on a map (if present of course)" );
+	Cmd_AddCommand ("partbench", CL_ParticleBench_f, "benchmark single and batched particle think" );
+	Cmd_AddCommand ("predstats", CL_PredictionStats_f, "show prediction checkpoint statistics" );
+	Cmd_AddCommand ("interpbench", CL_InterpolationBench_f, "benchmark single and batched entity interpolation on the current frame" );
 	Cmd_AddCommand ("fullserverinfo", CL_FullServerinfo_f, "sent by server when serverinfo changes" );
 	Cmd_AddCommand ("upload", CL_BeginUpload_f, "uploading file to the server" );
 
@@ -26,6 +26,37 @@ GNU General Public License for more details.
 #define MIN_PREDICTION_EPSILON	0.5f	// complain if error is > this and we have cl_showerror set
 #define MAX_PREDICTION_ERROR		64.0f	// above this is assumed to be a teleport, don't smooth, etc.
 
+// checkpoint of the acknowledged but already sent commands.
+// while the server ack and the pmove inputs stay the same only
+// the newest command has to be simulated every frame
+typedef struct
+{
+	int		numcmds;		// commands simulated to the checkpoint, 0 is invalid
+	int		parsecount;	// server frame the prediction starts from
+	int		acknowledged;	// netchan.incoming_acknowledged
+	double		time;		// time after the last command
+	local_state_t	state;		// state after the last command
+	usercmd_t		cmds[MULTIPLAYER_BACKUP];
+
+	// pmove inputs
+	physent_t		*ents;		// physents, moveents, visents
+	size_t		entsize;
+	int		numphysent;
+	int		nummoveent;
+	int		numvisent;
+	movevars_t	movevars;
+	char		physinfo[MAX_INFO_STRING];
+	int		flags;		// PRED_* flags
+	int		hits;		// statistics
+	int		misses;
+} predcache_t;
+
+#define PRED_PREDICTED	BIT( 0 )
+#define PRED_DEAD		BIT( 1 )
+#define PRED_SPECTATOR	BIT( 2 )
+
+static predcache_t	pred_checkpoint;
+
 /*
 =============
 CL_ClearPhysEnts
@@ -38,6 +69,7 @@ void CL_ClearPhysEnts( void )
 	clgame.pmove->numvisent = 0;
 	clgame.pmove->nummoveent = 0;
 	clgame.pmove->numphysent = 0;
+	pred_checkpoint.numcmds = 0;
 }
 
 /*
@@ -1104,7 +1136,10 @@ void CL_RunUsercmd( local_state_t *from, local_state_t *to, usercmd_t *u, qboole
 		CL_SetupPMove( clgame.pmove, from, &cmd, runfuncs, *time );
 
 		// motor!
+		// physents are frozen during the move, see SV_RunCmd
+		PM_BuildBroadPhase( clgame.pmove );
 		clgame.dllFuncs.pfnPlayerMove( clgame.pmove, false );
+		PM_ClearBroadPhase( clgame.pmove );
 
 		// copy results back to client
 		CL_FinishPMove( clgame.pmove, to );
@@ -1120,6 +1155,193 @@ void CL_RunUsercmd( local_state_t *from, local_state_t *to, usercmd_t *u, qboole
 }
 
 
+/*
+=================
+CL_PredictionInputsChanged
+
+compare pmove inputs with the checkpoint ones
+and keep the new inputs if they are differ
+=================
+*/
+static qboolean CL_PredictionInputsChanged( void )
+{
+	predcache_t	*pc = &pred_checkpoint;
+	playermove_t	*pm = clgame.pmove;
+	physent_t		*ents;
+	size_t		size;
+	int		flags = 0;
+
+	if( CL_IsPredicted( )) SetBits( flags, PRED_PREDICTED );
+	if( cl.local.health <= 0 ) SetBits( flags, PRED_DEAD );
+	if( cls.spectator ) SetBits( flags, PRED_SPECTATOR );
+
+	size = sizeof( physent_t ) * ( pm->numphysent + pm->nummoveent + pm->numvisent );
+
+	if( pc->numphysent == pm->numphysent && pc->nummoveent == pm->nummoveent && pc->numvisent == pm->numvisent && pc->flags == flags )
+	{
+		ents = pc->ents;
+
+		if( !memcmp( ents, pm->physents, sizeof( physent_t ) * pm->numphysent )
+		 && !memcmp( ents + pm->numphysent, pm->moveents, sizeof( physent_t ) * pm->nummoveent )
+		 && !memcmp( ents + pm->numphysent + pm->nummoveent, pm->visents, sizeof( physent_t ) * pm->numvisent )
+		 && !memcmp( &pc->movevars, &clgame.movevars, sizeof( movevars_t ))
+		 && !Q_strcmp( pc->physinfo, cls.physinfo ))
+			return false;
+	}
+
+	if( size > pc->entsize )
+	{
+		pc->ents = Z_Realloc( pc->ents, size );
+		pc->entsize = size;
+	}
+
+	ents = pc->ents;
+	memcpy( ents, pm->physents, sizeof( physent_t ) * pm->numphysent );
+	memcpy( ents + pm->numphysent, pm->moveents, sizeof( physent_t ) * pm->nummoveent );
+	memcpy( ents + pm->numphysent + pm->nummoveent, pm->visents, sizeof( physent_t ) * pm->numvisent );
+	pc->numphysent = pm->numphysent;
+	pc->nummoveent = pm->nummoveent;
+	pc->numvisent = pm->numvisent;
+	pc->movevars = clgame.movevars;
+	Q_strncpy( pc->physinfo, cls.physinfo, sizeof( pc->physinfo ));
+	pc->flags = flags;
+
+	return true;
+}
+
+/*
+=================
+CL_RestorePrediction
+
+returns the first command that must be simulated,
+commands before it are taken from the checkpoint
+=================
+*/
+static int CL_RestorePrediction( qboolean repredicting, double *time )
+{
+	predcache_t	*pc = &pred_checkpoint;
+	runcmd_t		*pcmd;
+	int		i;
+
+	// inputs must be compared every frame to keep them actual
+	if( CL_PredictionInputsChanged( ) || !CVAR_TO_BOOL( cl_predcache ))
+		pc->numcmds = 0;
+
+	if( repredicting )
+		return 1; // new server state, replay everything
+
+	if( pc->numcmds <= 0 || pc->parsecount != cl.parsecount || pc->acknowledged != cls.netchan.incoming_acknowledged )
+	{
+		pc->misses++;
+		return 1;
+	}
+
+	// there is must be a newest command to run
+	if( cls.netchan.incoming_acknowledged + pc->numcmds + 1 > cls.netchan.outgoing_sequence )
+	{
+		pc->misses++;
+		return 1;
+	}
+
+	for( i = 1; i <= pc->numcmds; i++ )
+	{
+		pcmd = &cl.commands[(cls.netchan.incoming_acknowledged + i) & CL_UPDATE_MASK];
+
+		if( pcmd->senttime >= host.realtime || !pcmd->processedfuncs )
+			break;
+
+		if( memcmp( &pcmd->cmd, &pc->cmds[i - 1], sizeof( usercmd_t )))
+			break;
+	}
+
+	if( i <= pc->numcmds )
+	{
+		pc->numcmds = 0;
+		pc->misses++;
+		return 1;
+	}
+
+	cl.predicted_frames[(cl.parsecountmod + pc->numcmds) & CL_UPDATE_MASK] = pc->state;
+	*time = pc->time;
+	pc->hits++;
+
+	return pc->numcmds + 1;
+}
+
+/*
+=================
+CL_SavePrediction
+
+store the checkpoint after last sent command
+=================
+*/
+static void CL_SavePrediction( const local_state_t *state, int numcmds, double time )
+{
+	predcache_t	*pc = &pred_checkpoint;
+	int		i;
+
+	for( i = 1; i <= numcmds; i++ )
+		pc->cmds[i - 1] = cl.commands[(cls.netchan.incoming_acknowledged + i) & CL_UPDATE_MASK].cmd;
+
+	pc->state = *state;
+	pc->time = time;
+	pc->numcmds = numcmds;
+	pc->parsecount = cl.parsecount;
+	pc->acknowledged = cls.netchan.incoming_acknowledged;
+}
+
+#ifdef _DEBUG
+/*
+=================
+CL_VerifyPrediction
+
+replay all the commands from the server state
+and compare with the incremental prediction
+=================
+*/
+static void CL_VerifyPrediction( int numcmds, const local_state_t *result, double resulttime )
+{
+	static local_state_t	states[2];
+	int			i, lastground;
+	double			time;
+
+	time = cl.frames[cl.parsecountmod].time;
+	states[0] = cl.predicted_frames[cl.parsecountmod];
+	lastground = cl.local.lastground;
+
+	for( i = 1; i <= numcmds; i++ )
+	{
+		int	cmdnum = cls.netchan.incoming_acknowledged + i;
+		CL_RunUsercmd( &states[(i - 1) & 1], &states[i & 1], &cl.commands[cmdnum & CL_UPDATE_MASK].cmd, false, &time, cmdnum );
+	}
+
+	cl.local.lastground = lastground;
+
+	if( time != resulttime || memcmp( &states[numcmds & 1].playerstate, &result->playerstate, sizeof( entity_state_t ))
+	 || memcmp( &states[numcmds & 1].client, &result->client, sizeof( clientdata_t )))
+	{
+		Con_Printf( S_WARN "CL_PredictMovement: incremental prediction differs from full replay (%i commands)\n", numcmds );
+		pred_checkpoint.numcmds = 0;
+	}
+}
+#endif
+
+/*
+=================
+CL_PredictionStats_f
+
+=================
+*/
+void CL_PredictionStats_f( void )
+{
+	predcache_t	*pc = &pred_checkpoint;
+	int		total = pc->hits + pc->misses;
+
+	Con_Printf( "prediction checkpoint: %i commands, %i frames reused, %i replayed", pc->numcmds, pc->hits, pc->misses );
+	if( total ) Con_Printf( " (%.1f%% reused)", pc->hits * 100.0f / total );
+	Con_Printf( "\n" );
+}
+
 /*
 =================
 CL_MoveSpectatorCamera
@@ -1159,10 +1381,14 @@ void CL_PredictMovement( qboolean repredicting )
 	int		current_command_mod;
 	frame_t		*frame = NULL;
 	int		i, stoppoint;
+	int		first, settled;
 	qboolean		runfuncs;
 	double		f = 1.0;
 	cl_entity_t	*ent;
 	double		time;
+#ifdef _DEBUG
+	int		last = 0;	// last predicted command, to verify the checkpoint
+#endif
 
 	if( cls.state != ca_active || cls.spectator )
 		return;
@@ -1211,7 +1437,17 @@ void CL_PredictMovement( qboolean repredicting )
 	CL_PushPMStates();
 	CL_SetSolidPlayers( cl.playernum );
 
-	for( i = 1; i < CL_UPDATE_MASK && cls.netchan.incoming_acknowledged + i < cls.netchan.outgoing_sequence + stoppoint; i++ )
+	// skip the sent commands that were simulated in previous frames
+	first = CL_RestorePrediction( repredicting, &time );
+	settled = cls.netchan.outgoing_sequence - 1 - cls.netchan.incoming_acknowledged;
+
+	if( first > 1 )
+	{
+		from = &cl.predicted_frames[(cl.parsecountmod + first - 1) & CL_UPDATE_MASK];
+		from_cmd = &cl.commands[(cls.netchan.incoming_acknowledged + first - 1) & CL_UPDATE_MASK];
+	}
+
+	for( i = first; i < CL_UPDATE_MASK && cls.netchan.incoming_acknowledged + i < cls.netchan.outgoing_sequence + stoppoint; i++ )
 	{
 		current_command = cls.netchan.incoming_acknowledged + i;
 		current_command_mod = current_command & CL_UPDATE_MASK;
@@ -1223,6 +1459,12 @@ void CL_PredictMovement( qboolean repredicting )
 		CL_RunUsercmd( from, to, &to_cmd->cmd, runfuncs, &time, current_command );
 		VectorCopy( to->playerstate.origin, cl.local.predicted_origins[current_command_mod] );
 		to_cmd->processedfuncs = true;
+#ifdef _DEBUG
+		last = i;
+#endif
+
+		if( i == settled )
+			CL_SavePrediction( to, i, time );
 
 		if( to_cmd->senttime >= host.realtime )
 			break;
@@ -1235,6 +1477,10 @@ void CL_PredictMovement( qboolean repredicting )
 		from_cmd = to_cmd;
 	}
 
+#ifdef _DEBUG
+	if( first > 1 && last >= first )
+		CL_VerifyPrediction( last, to, time );
+#endif
 	CL_PopPMStates();
 
 	if(( i == CL_UPDATE_MASK ) || ( !to && !repredicting ))
@@ -35,9 +35,32 @@ TEMPENTS MANAGEMENT
 #define SHARD_VOLUME		12.0f	// on shard ever n^3 units
 #define MAX_MUZZLEFLASH		3
 
+// tempents that will never be culled by PVS before update
+#define FTENT_NOCULL		(FTENT_NOMODEL|FTENT_PERSIST|FTENT_CLIENTCUSTOM|FTENT_PLYRATTACHMENT|FTENT_SINEWAVE|FTENT_SPIRAL)
+
+typedef struct
+{
+	int		*serial;		// bumped on each allocation
+	int		*lowring;		// low priority allocations, oldest first
+	int		*lowserial;
+	int		lowhead;
+	int		lowcount;
+
+	// per-frame counters
+	int		active;
+	int		culled;
+	int		visible;
+	int		sounds;
+	int		evicted;
+	int		overflows;
+} tentpool_t;
+
 TEMPENTITY	*cl_active_tents;
 TEMPENTITY	*cl_free_tents;
 TEMPENTITY	*cl_tempents = NULL;		// entities pool
+static tentpool_t	cl_tentpool;
+static convar_t	*cl_tent_cull;
+static convar_t	*cl_showtents;
 
 model_t		*cl_sprite_muzzleflash[MAX_MUZZLEFLASH];	// muzzle flashes
 model_t		*cl_sprite_dot = NULL;
@@ -206,8 +229,14 @@ CL_InitTempents
 void CL_InitTempEnts( void )
 {
 	cl_tempents = Mem_Calloc( cls.mempool, sizeof( TEMPENTITY ) * GI->max_tents );
+	cl_tentpool.serial = Mem_Calloc( cls.mempool, sizeof( int ) * GI->max_tents * 3 );
+	cl_tentpool.lowring = cl_tentpool.serial + GI->max_tents;
+	cl_tentpool.lowserial = cl_tentpool.lowring + GI->max_tents;
 	CL_ClearTempEnts();
 
+	cl_tent_cull = Cvar_Get( "cl_tent_cull", "1", FCVAR_ARCHIVE, "kill tempents outside of PVS before they are updated" );
+	cl_showtents = Cvar_Get( "cl_showtents", "0", 0, "show tempents counters" );
+
 	// load tempent sprites (glowshell, muzzleflashes etc)
 	CL_LoadClientSprites ();
 }
@@ -233,6 +262,9 @@ void CL_ClearTempEnts( void )
 	cl_tempents[GI->max_tents-1].next = NULL;
 	cl_free_tents = cl_tempents;
 	cl_active_tents = NULL;
+
+	// serials are kept
+	cl_tentpool.lowhead = cl_tentpool.lowcount = 0;
 }
 
 /*
@@ -246,6 +278,70 @@ void CL_FreeTempEnts( void )
 	if( cl_tempents )
 		Mem_Free( cl_tempents );
 	cl_tempents = NULL;
+
+	if( cl_tentpool.serial )
+		Mem_Free( cl_tentpool.serial );
+	memset( &cl_tentpool, 0, sizeof( cl_tentpool ));
+}
+
+/*
+==============
+CL_TempEntRegister
+
+remember the allocation, low priority
+tempents are queued for eviction
+==============
+*/
+static void CL_TempEntRegister( TEMPENTITY *pTemp )
+{
+	int	index = pTemp - cl_tempents;
+	int	slot;
+
+	cl_tentpool.serial[index]++;
+
+	if( pTemp->priority != TENTPRIORITY_LOW )
+		return;
+
+	// the oldest allocation is overwritten when ring is full
+	slot = cl_tentpool.lowhead;
+	cl_tentpool.lowring[slot] = index;
+	cl_tentpool.lowserial[slot] = cl_tentpool.serial[index];
+	cl_tentpool.lowhead = ( slot + 1 ) % GI->max_tents;
+	cl_tentpool.lowcount = Q_min( cl_tentpool.lowcount + 1, GI->max_tents );
+}
+
+/*
+==============
+CL_EvictLowPriorityTempEnt
+
+returns the oldest low priority tempent, it's
+still in the active list. Freelist must be empty
+==============
+*/
+static TEMPENTITY *CL_EvictLowPriorityTempEnt( void )
+{
+	TEMPENTITY	*pTemp;
+	int		slot, index;
+
+	while( cl_tentpool.lowcount > 0 )
+	{
+		slot = ( cl_tentpool.lowhead - cl_tentpool.lowcount + GI->max_tents ) % GI->max_tents;
+		index = cl_tentpool.lowring[slot];
+		cl_tentpool.lowcount--;
+
+		pTemp = &cl_tempents[index];
+
+		// reallocated since then
+		if( cl_tentpool.serial[index] != cl_tentpool.lowserial[slot] )
+			continue;
+
+		if( pTemp->priority != TENTPRIORITY_LOW )
+			continue;
+
+		return pTemp;
+	}
+
+	return NULL;
 }
 
 /*
@@ -370,6 +466,7 @@ void CL_TempEntPlaySound( TEMPENTITY *pTemp, float damp )
 
 		handle = S_RegisterSound( soundname );
 		S_StartSound( pTemp->entity.origin, -(pTemp - cl_tempents), CHAN_BODY, handle, fvol, ATTN_NORM, pitch, SND_STOP_LOOPING );
+		cl_tentpool.sounds++;
 	}
 }
 
@@ -402,6 +499,7 @@ int CL_TempEntAddEntity( cl_entity_t *pEntity )
 
 		// add to list
 		CL_AddVisibleEntity( pEntity, ET_TEMPENTITY );
+		cl_tentpool.visible++;
 
 		return 1;
 	}
@@ -409,6 +507,50 @@ int CL_TempEntAddEntity( cl_entity_t *pEntity )
 	return 0;
 }
 
+/*
+==============
+CL_CullTempEnts
+
+client.dll kills the tempents it can't add to the PVS
+after the movement. Kill them before, so their physics,
+collision and sounds are skipped
+==============
+*/
+static void CL_CullTempEnts( double ft )
+{
+	TEMPENTITY	*pTemp;
+	vec3_t		mins, maxs;
+	const byte	*visbits;
+	float		move;
+	int		i;
+
+	visbits = ref.dllFuncs.Mod_GetCurrentVis();
+
+	for( pTemp = cl_active_tents; pTemp; pTemp = pTemp->next )
+	{
+		cl_tentpool.active++;
+
+		if( !visbits || !pTemp->entity.model || FBitSet( pTemp->flags, FTENT_NOCULL ))
+			continue;
+
+		// check the box swept by this frame movement, velocity is kept in baseline
+		for( i = 0; i < 3; i++ )
+		{
+			move = pTemp->entity.baseline.origin[i] * ft;
+			mins[i] = pTemp->entity.origin[i] + Q_min( move, 0.0f ) + pTemp->entity.model->mins[i];
+			maxs[i] = pTemp->entity.origin[i] + Q_max( move, 0.0f ) + pTemp->entity.model->maxs[i];
+		}
+
+		if( Mod_BoxVisible( mins, maxs, visbits ))
+			continue;
+
+		// same as client.dll does for invisible tempents
+		pTemp->die = cl.time - 1.0f;
+		ClearBits( pTemp->flags, FTENT_FADEOUT );
+		cl_tentpool.culled++;
+	}
+}
+
 /*
 ==============
 CL_AddTempEnts
@@ -422,7 +564,21 @@ void CL_TempEntUpdate( void )
 	double	ft = cl.time - cl.oldtime;
 	float	gravity = clgame.movevars.gravity;
 
+	cl_tentpool.active = cl_tentpool.culled = 0;
+	cl_tentpool.visible = cl_tentpool.sounds = 0;
+
+	if( CVAR_TO_BOOL( cl_tent_cull ))
+		CL_CullTempEnts( ft );
+
 	clgame.dllFuncs.pfnTempEntUpdate( ft, cl.time, gravity, &cl_free_tents, &cl_active_tents, CL_TempEntAddEntity, CL_TempEntPlaySound );
+
+	if( CVAR_TO_BOOL( cl_showtents ))
+	{
+		Con_NPrintf( 4, "tempents: %i active, %i culled, %i visible, %i sounds\n",
+			cl_tentpool.active, cl_tentpool.culled, cl_tentpool.visible, cl_tentpool.sounds );
+		Con_NPrintf( 5, "tempents pool: %i evicted, %i overflows\n", cl_tentpool.evicted, cl_tentpool.overflows );
+		cl_tentpool.evicted = cl_tentpool.overflows = 0;
+	}
 }
 
 /*
@@ -473,6 +629,7 @@ TEMPENTITY *CL_TempEntAlloc( const vec3_t org, model_t *pmodel )
 	if( !cl_free_tents )
 	{
 		Con_DPrintf( "Overflow %d temporary ents!\n", GI->max_tents );
+		cl_tentpool.overflows++;
 		return NULL;
 	}
 
@@ -486,6 +643,7 @@ TEMPENTITY *CL_TempEntAlloc( const vec3_t org, model_t *pmodel )
 
 	pTemp->next = cl_active_tents;
 	cl_active_tents = pTemp;
+	CL_TempEntRegister( pTemp );
 
 	return pTemp;
 }
@@ -499,12 +657,27 @@ alloc high priority tempentity
 */
 TEMPENTITY *CL_TempEntAllocHigh( const vec3_t org, model_t *pmodel )
 {
-	TEMPENTITY	*pTemp;
+	TEMPENTITY	*pTemp, *pNext;
 
 	if( !cl_free_tents )
 	{
-		// no temporary ents free, so find the first active low-priority temp ent
-		// and overwrite it.
+		// no temporary ents free, so take the oldest low-priority
+		// temp ent and overwrite it right in the active list
+		if(( pTemp = CL_EvictLowPriorityTempEnt( )) != NULL )
+		{
+			pNext = pTemp->next;
+			CL_PrepareTEnt( pTemp, pmodel );
+			pTemp->next = pNext;
+
+			pTemp->priority = TENTPRIORITY_HIGH;
+			if( org ) VectorCopy( org, pTemp->entity.origin );
+			CL_TempEntRegister( pTemp );
+			cl_tentpool.evicted++;
+
+			return pTemp;
+		}
+
+		// eviction queue has lost track of them, search the list
 		CL_FreeLowPriorityTempEnt();
 	}
 
@@ -513,6 +686,7 @@ TEMPENTITY *CL_TempEntAllocHigh( const vec3_t org, model_t *pmodel )
 		// didn't find anything? The tent list is either full of high-priority tents
 		// or all tents in the list are still due to live for > 10 seconds.
 		Con_DPrintf( "Couldn't alloc a high priority TENT!\n" );
+		cl_tentpool.overflows++;
 		return NULL;
 	}
 
@@ -527,6 +701,7 @@ TEMPENTITY *CL_TempEntAllocHigh( const vec3_t org, model_t *pmodel )
 
 	pTemp->next = cl_active_tents;
 	cl_active_tents = pTemp;
+	CL_TempEntRegister( pTemp );
 
 	return pTemp;
 }
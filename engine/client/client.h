@@ -655,6 +655,7 @@ extern convar_t	cl_allow_download;
 extern convar_t	cl_allow_upload;
 extern convar_t	cl_download_ingame;
 extern convar_t	*cl_nopred;
+extern convar_t	*cl_predcache;
 extern convar_t	*cl_showfps;
 extern convar_t	*cl_envshot_size;
 extern convar_t	*cl_timeout;
@@ -905,6 +906,7 @@ void V_RenderView( void );
 void CL_SetSolidEntities( void );
 void CL_SetSolidPlayers( int playernum );
 void CL_InitClientMove( void );
+void CL_PredictionStats_f( void );
 void CL_PredictMovement( qboolean repredicting );
 void CL_CheckPredictionError( void );
 qboolean CL_IsPredicted( void );
@@ -948,6 +950,7 @@ void CL_MoveThirdpersonCamera( void );
 qboolean CL_IsPlayerIndex( int idx );
 void CL_SetIdealPitch( void );
 void CL_EmitEntities( void );
+void CL_InterpolationBench_f( void );
 
 //
 // cl_remap.c
@@ -1005,6 +1008,9 @@ void CL_LoadClientSprites( void );
 void CL_ReadPointFile_f( void );
 void CL_DrawEFX( float time, qboolean fTrans );
 void CL_ThinkParticle( double frametime, particle_t *p );
+void CL_SortParticles( particle_t **list );
+void CL_SimulateParticles( double frametime );
+void CL_ParticleBench_f( void );
 void CL_ReadLineFile_f( void );
 void CL_RunLightStyles( void );
 
@@ -777,7 +777,7 @@ void DSP_Process( int idsp, portable_samplepair_t *pbfront, int sampleCount )
 		return;
 
 	// don't process DSP while in menu
-	if( cls.key_dest == key_menu || !sampleCount )
+	if( s_mixparams.menu || !sampleCount )
 		return;
 
 	// preset is already installed by CheckNewDspPresets
@@ -814,7 +814,7 @@ void CheckNewDspPresets( void )
 	if( dsp_off->value != 0.0f )
 		return;
 
-	if( s_listener.waterlevel > 2 )
+	if( s_mixparams.waterlevel > 2 )
 		idsp_room = roomwater_type->value;
 	else idsp_room = room_type->value;
 
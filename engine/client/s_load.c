@@ -30,6 +30,15 @@ static string	s_sentenceImmediateName;	// keep dummy sentence name
 qboolean		s_registering = false;
 int		s_registration_sequence = 0;
 
+static struct
+{
+	size_t	resident;		// bytes of loaded sound data
+	uint	hits;		// sound was used while it's in memory
+	uint	loads;
+	uint	reloads;		// loaded again after eviction
+	uint	evictions;
+} s_cache;
+
 /*
 =================
 S_SoundList_f
@@ -41,12 +50,16 @@ void S_SoundList_f( void )
 	wavdata_t		*sc;
 	int		i, totalSfx = 0;
 	int		totalSize = 0;
+	int		totalEvicted = 0;
 
 	for( i = 0, sfx = s_knownSfx; i < s_numSfx; i++, sfx++ )
 	{
 		if( !sfx->name[0] )
 			continue;
 
+		if( sfx->evicted )
+			totalEvicted++;
+
 		sc = sfx->cache;
 		if( sc )
 		{
@@ -64,6 +77,12 @@ void S_SoundList_f( void )
 	Con_Printf( "-------------------------------------------\n" );
 	Con_Printf( "%i total sounds\n", totalSfx );
 	Con_Printf( "%s total memory\n", Q_memprint( totalSize ));
+
+	if( s_cachesize->value > 0.0f )
+		Con_Printf( "%s resident of %s budget\n", Q_memprint( s_cache.resident ), Q_memprint( s_cachesize->value * 1024 * 1024 ));
+	else Con_Printf( "%s resident, no budget\n", Q_memprint( s_cache.resident ));
+	Con_Printf( "%u hits, %u loads, %u reloads, %u evictions, %i sounds evicted\n",
+		s_cache.hits, s_cache.loads, s_cache.reloads, s_cache.evictions, totalEvicted );
 	Con_Printf( "\n" );
 }
 
@@ -119,6 +138,94 @@ static wavdata_t *S_CreateDefaultSound( void )
 	return sc;
 }
 
+/*
+=================
+S_SoundInUse
+=================
+*/
+static qboolean S_SoundInUse( sfx_t *sfx )
+{
+	int	i, j;
+
+	for( i = 0; i < total_channels; i++ )
+	{
+		if( channels[i].sfx == sfx )
+			return true;
+
+		if( !channels[i].isSentence )
+			continue;
+
+		// next words are played by mixer
+		for( j = 0; j < CVOXWORDMAX && channels[i].words[j].sfx; j++ )
+		{
+			if( channels[i].words[j].sfx == sfx )
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+=================
+S_CacheBudget
+
+returns zero if budget is not set
+=================
+*/
+static size_t S_CacheBudget( void )
+{
+	if( s_cachesize->value <= 0.0f )
+		return 0;
+	return (size_t)( s_cachesize->value * 1024 * 1024 );
+}
+
+/*
+=================
+S_CheckCacheBudget
+
+release least recently used sounds
+until we fit into budget
+=================
+*/
+static void S_CheckCacheBudget( sfx_t *keep )
+{
+	size_t	budget = S_CacheBudget();
+	sfx_t	*sfx, *oldest;
+	int	i;
+
+	if( !budget ) return;
+
+	while( s_cache.resident > budget )
+	{
+		oldest = NULL;
+
+		// default sound at index 0 is never evicted
+		for( i = 1, sfx = s_knownSfx + 1; i < s_numSfx; i++, sfx++ )
+		{
+			if( !sfx->cache || sfx == keep )
+				continue;
+
+			if( !oldest || (int)( sfx->lastused - oldest->lastused ) < 0 )
+				oldest = sfx;
+		}
+
+		if( !oldest || oldest->lastused == host.framecount )
+			break; // everything else is in use right now
+
+		if( S_SoundInUse( oldest ))
+		{
+			// paused channels don't touch their sounds, do it here
+			oldest->lastused = host.framecount;
+			continue;
+		}
+
+		S_UnloadSound( oldest );
+		oldest->evicted = true;
+		s_cache.evictions++;
+	}
+}
+
 /*
 =================
 S_LoadSound
@@ -132,7 +239,14 @@ wavdata_t *S_LoadSound( sfx_t *sfx )
 
 	// see if still in memory
 	if( sfx->cache )
+	{
+		if( sfx->lastused != host.framecount )
+		{
+			sfx->lastused = host.framecount;
+			s_cache.hits++;
+		}
 		return sfx->cache;
+	}
 
 	if( !COM_CheckString( sfx->name ))
 		return NULL;
@@ -156,10 +270,44 @@ wavdata_t *S_LoadSound( sfx_t *sfx )
 		Sound_Process( &sc, SOUND_44k, sc->width, SOUND_RESAMPLE );
 
 	sfx->cache = sc;
+	sfx->lastused = host.framecount;
+	s_cache.resident += sc->size;
+
+	if( sfx->evicted )
+	{
+		sfx->evicted = false;
+		s_cache.reloads++;
+	}
+	else s_cache.loads++;
+
+	S_CheckCacheBudget( sfx );
 
 	return sfx->cache;
 }
 
+/*
+=================
+S_UnloadSound
+
+release sound data but keep the sfx
+=================
+*/
+void S_UnloadSound( sfx_t *sfx )
+{
+	if( !sfx || !sfx->cache )
+		return;
+
+	// mixing thread may still use this data
+	S_LockMixer();
+	S_MixerReleaseSound( sfx );
+
+	s_cache.resident -= sfx->cache->size;
+	FS_FreeSound( sfx->cache );
+	sfx->cache = NULL;
+
+	S_UnlockMixer();
+}
+
 // =======================================================================
 // Load a sound
 // =======================================================================
@@ -255,8 +403,7 @@ void S_FreeSound( sfx_t *sfx )
 		prev = &hashSfx->hashNext;
 	}
 
-	if( sfx->cache )
-		FS_FreeSound( sfx->cache );
+	S_UnloadSound( sfx );
 	memset( sfx, 0, sizeof( *sfx ));
 }
 
@@ -310,11 +457,16 @@ void S_EndRegistration( void )
 			S_FreeSound( sfx ); // don't need this sound
 	}
 
-	// load everything in
+	// load everything in, sounds that don't fit
+	// into the cache budget will be loaded on demand
 	for( i = 0, sfx = s_knownSfx; i < s_numSfx; i++, sfx++ )
 	{
 		if( !sfx->name[0] )
 			continue;
+
+		if( S_CacheBudget() && s_cache.resident >= S_CacheBudget( ))
+			break;
+
 		S_LoadSound( sfx );
 	}
 	s_registering = false;
@@ -381,6 +533,9 @@ void S_InitSounds( void )
 	s_sfxHashList[s_knownSfx->hashValue] = s_knownSfx;
 	s_knownSfx->cache = S_CreateDefaultSound();
 	s_numSfx = 1;
+
+	memset( &s_cache, 0, sizeof( s_cache ));
+	s_cache.resident = s_knownSfx->cache->size;
 }
 
 /*
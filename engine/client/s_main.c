@@ -46,6 +46,7 @@ convar_t		*s_combine_sounds;
 convar_t		*snd_mute_losefocus;
 convar_t		*s_test;		// cvar for testing new effects
 convar_t		*s_samplecount;
+convar_t		*s_cachesize;
 
 /*
 =============================================================================
@@ -107,6 +108,8 @@ S_FreeChannel
 */
 void S_FreeChannel( channel_t *ch )
 {
+	S_MixerStopChannel( ch );
+
 	ch->sfx = NULL;
 	ch->name[0] = '\0';
 	ch->use_loop = false;
@@ -597,15 +600,18 @@ void S_StartSound( const vec3_t pos, int ent, int chan, sound_t handle, float fv
 	{
 		if( check == target_chan ) continue;
 
-		if( check->sfx == sfx && !check->pMixer.sample )
+		if( check->sfx == sfx && !check->pMixer.sample && S_MixerChannelFresh( check ))
 		{
 			// skip up to 0.1 seconds of audio
 			int skip = COM_RandomLong( 0, (long)( 0.1f * check->sfx->cache->rate ));
 
 			S_SetSampleStart( check, sfx->cache, skip );
+			S_MixerSkipChannel( check );
 			break;
 		}
 	}
+
+	S_MixerStartChannel( target_chan );
 }
 
 /*
@@ -712,6 +718,8 @@ void S_RestoreSound( const vec3_t pos, int ent, int chan, sound_t handle, float
 
 	// Init client entity mouth movement vars
 	SND_InitMouth( ent, chan );
+
+	S_MixerStartChannel( target_chan );
 }
 
 /*
@@ -832,6 +840,9 @@ int S_GetCurrentStaticSounds( soundlist_t *pout, int size )
 	if( !dma.initialized )
 		return 0;
 
+	// pick up actual playback positions
+	S_MixerSyncPositions();
+
 	for( i = MAX_DYNAMIC_CHANNELS; i < total_channels && sounds_left; i++ )
 	{
 		if( channels[i].entchannel == CHAN_STATIC && channels[i].sfx && channels[i].sfx->name[0] )
@@ -873,6 +884,9 @@ int S_GetCurrentDynamicSounds( soundlist_t *pout, int size )
 	if( !dma.initialized )
 		return 0;
 
+	// pick up actual playback positions
+	S_MixerSyncPositions();
+
 	for( i = 0; i < MAX_CHANNELS && sounds_left; i++ )
 	{
 		if( !channels[i].sfx || !channels[i].sfx->name[0] || !Q_stricmp( channels[i].sfx->name, "*default" ))
@@ -1039,6 +1053,8 @@ rawchan_t *S_FindRawChannel( int entnum, qboolean create )
 	if( free >= 0 ) best = free;
 	if( best < 0 ) return NULL; // no free slots
 
+	S_LockMixer();
+
 	if( !raw_channels[best] )
 	{
 		raw_samples = MAX_RAW_SAMPLES;
@@ -1050,6 +1066,8 @@ rawchan_t *S_FindRawChannel( int entnum, qboolean create )
 	ch->entnum = entnum;
 	ch->s_rawend = 0;
 
+	S_UnlockMixer();
+
 	return ch;
 }
 
@@ -1393,6 +1411,8 @@ S_ClearBuffer
 */
 void S_ClearBuffer( void )
 {
+	S_LockMixer();
+
 	S_ClearRawChannels();
 
 	SNDDMA_BeginPainting ();
@@ -1400,6 +1420,8 @@ void S_ClearBuffer( void )
 	SNDDMA_Submit ();
 
 	MIX_ClearAllPaintBuffers( PAINTBUFFER_SIZE, true );
+
+	S_UnlockMixer();
 }
 
 /*
@@ -1428,6 +1450,16 @@ void S_StopAllSounds( qboolean ambient )
 	int	i;
 
 	if( !dma.initialized ) return;
+
+	// painting has been reset in the mixing thread,
+	// channels will be released by main thread
+	if( S_MixerThreadSelf( ))
+	{
+		S_MixerStopAll();
+		return;
+	}
+
+	S_LockMixer();
 	total_channels = MAX_DYNAMIC_CHANNELS;	// no statics
 
 	for( i = 0; i < MAX_CHANNELS; i++ )
@@ -1436,6 +1468,7 @@ void S_StopAllSounds( qboolean ambient )
 		S_FreeChannel( &channels[i] );
 	}
 
+	S_MixerClearChannels();
 	DSP_ClearState();
 
 	// clear all the channels
@@ -1448,10 +1481,20 @@ void S_StopAllSounds( qboolean ambient )
 
 	// clear any remaining soundfade
 	memset( &soundfade, 0, sizeof( soundfade ));
+
+	S_UnlockMixer();
 }
 
 //=============================================================================
-void S_UpdateChannels( void )
+/*
+==================
+S_UpdateDMA
+
+paint the mixahead part of dma buffer,
+called by mixing thread if it's running
+==================
+*/
+void S_UpdateDMA( void )
 {
 	uint	endtime;
 	int	samps;
@@ -1484,6 +1527,41 @@ void S_UpdateChannels( void )
 	SNDDMA_Submit();
 }
 
+/*
+==================
+S_UpdateChannels
+==================
+*/
+void S_UpdateChannels( void )
+{
+	// mixing thread is painting by itself
+	if( S_MixerThreadActive( ))
+		return;
+
+	S_MixerDrainCommands();
+	S_UpdateDMA();
+}
+
+/*
+==================
+S_UpdateMixParams
+
+copy the client state the mixer depends on
+==================
+*/
+static void S_UpdateMixParams( void )
+{
+	s_mixparams.background = cl.background;
+	s_mixparams.console = ( cls.key_dest == key_console );
+	s_mixparams.menu = ( cls.key_dest == key_menu );
+	s_mixparams.inmenu = s_listener.inmenu;
+	s_mixparams.paused = s_listener.paused;
+	s_mixparams.active = s_listener.active;
+	s_mixparams.waterlevel = s_listener.waterlevel;
+	s_mixparams.mastervol = S_GetMasterVolume();
+	s_mixparams.musicvol = S_GetMusicVolume();
+}
+
 /*
 =================
 S_ExtraUpdate
@@ -1529,15 +1607,15 @@ void SND_UpdateSound( void )
 
 	if( !dma.initialized ) return;
 
+	// release the channels which are finished by mixer
+	S_MixerBeginFrame();
+
 	// if the loading plaque is up, clear everything
 	// out to make sure we aren't looping a dirty
 	// dma buffer while loading
 	// update any client side sound fade
 	S_UpdateSoundFade();
 
-	// release raw-channels that no longer used more than 10 secs
-	S_FreeIdleRawChannels();
-
 	VectorCopy( cl.simvel, s_listener.velocity );
 	s_listener.frametime = (cl.time - cl.oldtime);
 	s_listener.waterlevel = cl.local.waterlevel;
@@ -1599,7 +1677,18 @@ void SND_UpdateSound( void )
 		}
 	}
 
+	// send changes to the mixer
+	S_MixerSpatialize();
+
+	S_LockMixer();
+
+	// release raw-channels that no longer used more than 10 secs
+	S_FreeIdleRawChannels();
 	S_SpatializeRawChannels();
+	S_UpdateMixParams();
+	CheckNewDspPresets();
+
+	S_UnlockMixer();
 
 	// debugging output
 	if( CVAR_TO_BOOL( s_show ))
@@ -1826,6 +1915,7 @@ qboolean S_Init( void )
 	snd_mute_losefocus = Cvar_Get( "snd_mute_losefocus", "1", FCVAR_ARCHIVE, "silence the audio when game window loses focus" );
 	s_test = Cvar_Get( "s_test", "0", 0, "engine developer cvar for quick testing new features" );
 	s_samplecount = Cvar_Get( "s_samplecount", "0", FCVAR_ARCHIVE, "sample count (0 for default value)" );
+	s_cachesize = Cvar_Get( "s_cachesize", "0", FCVAR_ARCHIVE, "memory budget for loaded sounds in megabytes (0 is unlimited)" );
 
 	Cmd_AddCommand( "play", S_Play_f, "playing a specified sound file" );
 	Cmd_AddCommand( "play2", S_Play2_f, "playing a group of specified sound files" ); // nehahra stuff
@@ -1833,6 +1923,7 @@ qboolean S_Init( void )
 	Cmd_AddCommand( "stopsound", S_StopSound_f, "stop all sounds" );
 	Cmd_AddCommand( "music", S_Music_f, "starting a background track" );
 	Cmd_AddCommand( "soundlist", S_SoundList_f, "display loaded sounds" );
+	Cmd_AddCommand( "s_mixbench", S_MixBench_f, "benchmark scalar and SIMD channel mixing" );
 	Cmd_AddCommand( "s_info", S_SoundInfo_f, "print sound system information" );
 	Cmd_AddCommand( "s_fade", S_SoundFade_f, "fade all sounds then stop all" );
 	Cmd_AddCommand( "+voicerecord", Cmd_Null_f, "start voice recording (non-implemented)" );
@@ -1856,6 +1947,7 @@ qboolean S_Init( void )
 	MIX_InitAllPaintbuffers ();
 	SX_Init ();
 	S_InitScaletable ();
+	S_InitMixer ();
 	S_StopAllSounds ( true );
 	S_InitSounds ();
 	VOX_Init ();
@@ -1870,11 +1962,15 @@ void S_Shutdown( void )
 {
 	if( !dma.initialized ) return;
 
+	// stop painting before anything is freed
+	S_ShutdownMixer ();
+
 	Cmd_RemoveCommand( "play" );
 	Cmd_RemoveCommand( "playvol" );
 	Cmd_RemoveCommand( "stopsound" );
 	Cmd_RemoveCommand( "music" );
 	Cmd_RemoveCommand( "soundlist" );
+	Cmd_RemoveCommand( "s_mixbench" );
 	Cmd_RemoveCommand( "s_info" );
 	Cmd_RemoveCommand( "s_fade" );
 	Cmd_RemoveCommand( "+voicerecord" );
@@ -16,6 +16,11 @@ GNU General Public License for more details.
 #include "common.h"
 #include "sound.h"
 #include "client.h"
+#if XASH_SSE2
+#include <emmintrin.h>
+#elif XASH_NEON
+#include <arm_neon.h>
+#endif
 
 #define IPAINTBUFFER	0
 #define IROOMBUFFER		1
@@ -210,6 +215,275 @@ void MIX_InitAllPaintbuffers( void )
 /*
 ===============================================================================
 
+SIMD KERNELS
+
+each kernel processes as many samples as it can and returns the count,
+the rest is handled by the scalar code. Results are bit-exact with it:
+8-bit scale table is just ((signed char)data * (volume >> SND_SCALE_SHIFT << SND_SCALE_SHIFT))
+===============================================================================
+*/
+#define MIX_RESAMPLE_CHUNK	256	// temp buffer for gathered pitch shifted samples
+
+static qboolean mix_simd = true;	// for s_mixbench comparison
+
+_inline int MIX_ScaleFromVolume( int volume )
+{
+	return ( volume >> SND_SCALE_SHIFT ) << SND_SCALE_SHIFT;
+}
+
+#if XASH_SSE2
+// add four L/R pairs which come as eight interleaved 16-bit samples
+_inline void MIX_PaintPairs_SSE2( portable_samplepair_t *pbuf, __m128i data, __m128i vol, __m128i shift )
+{
+	__m128i	lo = _mm_mullo_epi16( data, vol );
+	__m128i	hi = _mm_mulhi_epi16( data, vol );
+	__m128i	*p = (__m128i *)pbuf;
+
+	_mm_storeu_si128( p + 0, _mm_add_epi32( _mm_loadu_si128( p + 0 ), _mm_sra_epi32( _mm_unpacklo_epi16( lo, hi ), shift )));
+	_mm_storeu_si128( p + 1, _mm_add_epi32( _mm_loadu_si128( p + 1 ), _mm_sra_epi32( _mm_unpackhi_epi16( lo, hi ), shift )));
+}
+
+_inline __m128i MIX_LoadInt_SSE2( const void *p )
+{
+	int	x;
+
+	memcpy( &x, p, sizeof( x ));
+	return _mm_cvtsi32_si128( x );
+}
+
+// SSE2 have no 32-bit mullo, low halves of unsigned products are the same
+_inline __m128i MIX_MulLo32_SSE2( __m128i a, __m128i b )
+{
+	__m128i	even = _mm_mul_epu32( a, b );
+	__m128i	odd = _mm_mul_epu32( _mm_srli_si128( a, 4 ), _mm_srli_si128( b, 4 ));
+
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 )), _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 )));
+}
+
+static int MIX_PaintMono8_SIMD( portable_samplepair_t *pbuf, int lscale, int rscale, const byte *pData, int outCount )
+{
+	__m128i	vol = _mm_set_epi16( rscale, lscale, rscale, lscale, rscale, lscale, rscale, lscale );
+	__m128i	shift = _mm_cvtsi32_si128( 0 );
+	int	i;
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		__m128i	data = MIX_LoadInt_SSE2( pData + i );
+
+		// duplicate and sign extend: d0 d0 d1 d1 d2 d2 d3 d3
+		data = _mm_unpacklo_epi8( data, data );
+		data = _mm_srai_epi16( _mm_unpacklo_epi16( data, data ), 8 );
+		MIX_PaintPairs_SSE2( pbuf + i, data, vol, shift );
+	}
+
+	return i;
+}
+
+static int MIX_PaintStereo8_SIMD( portable_samplepair_t *pbuf, int lscale, int rscale, const byte *pData, int outCount )
+{
+	__m128i	vol = _mm_set_epi16( rscale, lscale, rscale, lscale, rscale, lscale, rscale, lscale );
+	__m128i	shift = _mm_cvtsi32_si128( 0 );
+	int	i;
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		__m128i	data = _mm_loadl_epi64( (const __m128i *)( pData + i * 2 ));
+
+		// sign extend: l0 r0 l1 r1 l2 r2 l3 r3
+		data = _mm_srai_epi16( _mm_unpacklo_epi8( data, data ), 8 );
+		MIX_PaintPairs_SSE2( pbuf + i, data, vol, shift );
+	}
+
+	return i;
+}
+
+static int MIX_PaintMono16_SIMD( portable_samplepair_t *pbuf, int lvol, int rvol, const short *pData, int outCount )
+{
+	__m128i	vol = _mm_set_epi16( rvol, lvol, rvol, lvol, rvol, lvol, rvol, lvol );
+	__m128i	shift = _mm_cvtsi32_si128( 8 );
+	int	i;
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		__m128i	data = _mm_loadl_epi64( (const __m128i *)( pData + i ));
+
+		MIX_PaintPairs_SSE2( pbuf + i, _mm_unpacklo_epi16( data, data ), vol, shift );
+	}
+
+	return i;
+}
+
+static int MIX_PaintStereo16_SIMD( portable_samplepair_t *pbuf, int lvol, int rvol, const short *pData, int outCount )
+{
+	__m128i	vol = _mm_set_epi16( rvol, lvol, rvol, lvol, rvol, lvol, rvol, lvol );
+	__m128i	shift = _mm_cvtsi32_si128( 8 );
+	int	i;
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+		MIX_PaintPairs_SSE2( pbuf + i, _mm_loadu_si128( (const __m128i *)( pData + i * 2 )), vol, shift );
+
+	return i;
+}
+
+static int MIX_MixPaintbuffers_SIMD( const int *in1, const int *in2, int *out, int count, int gain )
+{
+	__m128i	vgain = _mm_set1_epi32( gain );
+	int	i;
+
+	// count is in samples, not in pairs
+	for( i = 0; i + 4 <= count; i += 4 )
+	{
+		__m128i	a = _mm_loadu_si128( (const __m128i *)( in1 + i ));
+		__m128i	b = _mm_loadu_si128( (const __m128i *)( in2 + i ));
+
+		b = _mm_srai_epi32( MIX_MulLo32_SSE2( b, vgain ), 8 );
+		_mm_storeu_si128( (__m128i *)( out + i ), _mm_add_epi32( a, b ));
+	}
+
+	return i;
+}
+
+static int MIX_CompressPaintbuffer_SIMD( int *pbuf, int count )
+{
+	__m128i	vmax = _mm_set1_epi32( 32760 );
+	__m128i	vmin = _mm_set1_epi32( -32760 );
+	int	i;
+
+	for( i = 0; i + 4 <= count; i += 4 )
+	{
+		__m128i	x = _mm_loadu_si128( (const __m128i *)( pbuf + i ));
+		__m128i	mask;
+
+		mask = _mm_cmpgt_epi32( x, vmax );
+		x = _mm_or_si128( _mm_and_si128( mask, vmax ), _mm_andnot_si128( mask, x ));
+		mask = _mm_cmplt_epi32( x, vmin );
+		x = _mm_or_si128( _mm_and_si128( mask, vmin ), _mm_andnot_si128( mask, x ));
+		_mm_storeu_si128( (__m128i *)( pbuf + i ), x );
+	}
+
+	return i;
+}
+#elif XASH_NEON
+// add four L/R pairs
+_inline void MIX_PaintPairs_NEON( portable_samplepair_t *pbuf, int16x4_t left, int16x4_t right, int16_t lvol, int16_t rvol, int32x4_t shift )
+{
+	int32x4x2_t	acc = vld2q_s32( (int32_t *)pbuf );
+
+	// negative shift means arithmetic shift right
+	acc.val[0] = vaddq_s32( acc.val[0], vshlq_s32( vmull_n_s16( left, lvol ), shift ));
+	acc.val[1] = vaddq_s32( acc.val[1], vshlq_s32( vmull_n_s16( right, rvol ), shift ));
+	vst2q_s32( (int32_t *)pbuf, acc );
+}
+
+static int MIX_PaintMono8_SIMD( portable_samplepair_t *pbuf, int lscale, int rscale, const byte *pData, int outCount )
+{
+	int32x4_t	shift = vdupq_n_s32( 0 );
+	int	i;
+
+	for( i = 0; i + 8 <= outCount; i += 8 )
+	{
+		int16x8_t	data = vmovl_s8( vld1_s8( (const int8_t *)( pData + i )));
+
+		MIX_PaintPairs_NEON( pbuf + i + 0, vget_low_s16( data ), vget_low_s16( data ), lscale, rscale, shift );
+		MIX_PaintPairs_NEON( pbuf + i + 4, vget_high_s16( data ), vget_high_s16( data ), lscale, rscale, shift );
+	}
+
+	return i;
+}
+
+static int MIX_PaintStereo8_SIMD( portable_samplepair_t *pbuf, int lscale, int rscale, const byte *pData, int outCount )
+{
+	int32x4_t	shift = vdupq_n_s32( 0 );
+	int	i;
+
+	for( i = 0; i + 8 <= outCount; i += 8 )
+	{
+		int8x8x2_t	data = vld2_s8( (const int8_t *)( pData + i * 2 ));
+		int16x8_t		left = vmovl_s8( data.val[0] );
+		int16x8_t		right = vmovl_s8( data.val[1] );
+
+		MIX_PaintPairs_NEON( pbuf + i + 0, vget_low_s16( left ), vget_low_s16( right ), lscale, rscale, shift );
+		MIX_PaintPairs_NEON( pbuf + i + 4, vget_high_s16( left ), vget_high_s16( right ), lscale, rscale, shift );
+	}
+
+	return i;
+}
+
+static int MIX_PaintMono16_SIMD( portable_samplepair_t *pbuf, int lvol, int rvol, const short *pData, int outCount )
+{
+	int32x4_t	shift = vdupq_n_s32( -8 );
+	int	i;
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		int16x4_t	data = vld1_s16( pData + i );
+
+		MIX_PaintPairs_NEON( pbuf + i, data, data, lvol, rvol, shift );
+	}
+
+	return i;
+}
+
+static int MIX_PaintStereo16_SIMD( portable_samplepair_t *pbuf, int lvol, int rvol, const short *pData, int outCount )
+{
+	int32x4_t	shift = vdupq_n_s32( -8 );
+	int	i;
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		int16x4x2_t	data = vld2_s16( pData + i * 2 );
+
+		MIX_PaintPairs_NEON( pbuf + i, data.val[0], data.val[1], lvol, rvol, shift );
+	}
+
+	return i;
+}
+
+static int MIX_MixPaintbuffers_SIMD( const int *in1, const int *in2, int *out, int count, int gain )
+{
+	int	i;
+
+	// count is in samples, not in pairs
+	for( i = 0; i + 4 <= count; i += 4 )
+	{
+		int32x4_t	b = vshrq_n_s32( vmulq_n_s32( vld1q_s32( in2 + i ), gain ), 8 );
+
+		vst1q_s32( out + i, vaddq_s32( vld1q_s32( in1 + i ), b ));
+	}
+
+	return i;
+}
+
+static int MIX_CompressPaintbuffer_SIMD( int *pbuf, int count )
+{
+	int32x4_t	vmax = vdupq_n_s32( 32760 );
+	int32x4_t	vmin = vdupq_n_s32( -32760 );
+	int	i;
+
+	for( i = 0; i + 4 <= count; i += 4 )
+		vst1q_s32( pbuf + i, vmaxq_s32( vminq_s32( vld1q_s32( pbuf + i ), vmax ), vmin ));
+
+	return i;
+}
+#else
+// scalar code only
+#define MIX_PaintMono8_SIMD( pbuf, lscale, rscale, pData, outCount )	0
+#define MIX_PaintStereo8_SIMD( pbuf, lscale, rscale, pData, outCount )	0
+#define MIX_PaintMono16_SIMD( pbuf, lvol, rvol, pData, outCount )	0
+#define MIX_PaintStereo16_SIMD( pbuf, lvol, rvol, pData, outCount )	0
+#define MIX_MixPaintbuffers_SIMD( in1, in2, out, count, gain )	0
+#define MIX_CompressPaintbuffer_SIMD( pbuf, count )	0
+#endif
+
+#if XASH_SSE2 || XASH_NEON
+#define MIX_HAVE_SIMD	1
+#else
+#define MIX_HAVE_SIMD	0
+#endif
+
+/*
+===============================================================================
+
 CHANNEL MIXING
 
 ===============================================================================
@@ -217,12 +491,15 @@ CHANNEL MIXING
 void S_PaintMonoFrom8( portable_samplepair_t *pbuf, int *volume, byte *pData, int outCount )
 {
 	int	*lscale, *rscale;
-	int 	i, data;
+	int 	i = 0, data;
+
+	if( mix_simd )
+		i = MIX_PaintMono8_SIMD( pbuf, MIX_ScaleFromVolume( volume[0] ), MIX_ScaleFromVolume( volume[1] ), pData, outCount );
 
 	lscale = snd_scaletable[volume[0] >> SND_SCALE_SHIFT];
 	rscale = snd_scaletable[volume[1] >> SND_SCALE_SHIFT];
 
-	for( i = 0; i < outCount; i++ )
+	for( ; i < outCount; i++ )
 	{
 		data = pData[i];
 		pbuf[i].left += lscale[data];
@@ -235,13 +512,16 @@ void S_PaintStereoFrom8( portable_samplepair_t *pbuf, int *volume, byte *pData,
 	int	*lscale, *rscale;
 	uint	left, right;
 	word	*data;
-	int	i;
+	int	i = 0;
+
+	if( mix_simd )
+		i = MIX_PaintStereo8_SIMD( pbuf, MIX_ScaleFromVolume( volume[0] ), MIX_ScaleFromVolume( volume[1] ), pData, outCount );
 
 	lscale = snd_scaletable[volume[0] >> SND_SCALE_SHIFT];
 	rscale = snd_scaletable[volume[1] >> SND_SCALE_SHIFT];
-	data = (word *)pData;
+	data = (word *)pData + i;
 
-	for( i = 0; i < outCount; i++, data++ )
+	for( ; i < outCount; i++, data++ )
 	{
 		left = (byte)((*data & 0x00FF));
 		right = (byte)((*data & 0xFF00) >> 8);
@@ -253,9 +533,12 @@ void S_PaintStereoFrom8( portable_samplepair_t *pbuf, int *volume, byte *pData,
 void S_PaintMonoFrom16( portable_samplepair_t *pbuf, int *volume, short *pData, int outCount )
 {
 	int	left, right;
-	int	i, data;
+	int	i = 0, data;
 
-	for( i = 0; i < outCount; i++ )
+	if( mix_simd )
+		i = MIX_PaintMono16_SIMD( pbuf, volume[0], volume[1], pData, outCount );
+
+	for( ; i < outCount; i++ )
 	{
 		data = pData[i];
 		left = ( data * volume[0]) >> 8;
@@ -269,11 +552,14 @@ void S_PaintStereoFrom16( portable_samplepair_t *pbuf, int *volume, short *pData
 {
 	uint	*data;
 	int	left, right;
-	int	i;
+	int	i = 0;
+
+	if( mix_simd )
+		i = MIX_PaintStereo16_SIMD( pbuf, volume[0], volume[1], pData, outCount );
 
-	data = (uint *)pData;
+	data = (uint *)pData + i;
 
-	for( i = 0; i < outCount; i++, data++ )
+	for( ; i < outCount; i++, data++ )
 	{
 		left = (signed short)((*data & 0x0000FFFF));
 		right = (signed short)((*data & 0xFFFF0000) >> 16);
@@ -309,6 +595,29 @@ void S_Mix8Mono( portable_samplepair_t *pbuf, int *volume, byte *pData, int inpu
 		return;
 	}
 
+	if( MIX_HAVE_SIMD && mix_simd )
+	{
+		byte	temp[MIX_RESAMPLE_CHUNK];
+		int	j, count;
+
+		// gather pitch shifted samples and paint them at once
+		for( i = 0; i < outCount; i += count )
+		{
+			count = Q_min( outCount - i, MIX_RESAMPLE_CHUNK );
+
+			for( j = 0; j < count; j++ )
+			{
+				temp[j] = pData[sampleIndex];
+				sampleFrac += rateScale;
+				sampleIndex += FIX_INTPART( sampleFrac );
+				sampleFrac = FIX_FRACPART( sampleFrac );
+			}
+
+			S_PaintMonoFrom8( pbuf + i, volume, temp, count );
+		}
+		return;
+	}
+
 	lscale = snd_scaletable[volume[0] >> SND_SCALE_SHIFT];
 	rscale = snd_scaletable[volume[1] >> SND_SCALE_SHIFT];
 
@@ -335,6 +644,30 @@ void S_Mix8Stereo( portable_samplepair_t *pbuf, int *volume, byte *pData, int in
 		return;
 	}
 
+	if( MIX_HAVE_SIMD && mix_simd )
+	{
+		byte	temp[MIX_RESAMPLE_CHUNK * 2];
+		int	j, count;
+
+		// gather pitch shifted samples and paint them at once
+		for( i = 0; i < outCount; i += count )
+		{
+			count = Q_min( outCount - i, MIX_RESAMPLE_CHUNK );
+
+			for( j = 0; j < count; j++ )
+			{
+				temp[j*2+0] = pData[sampleIndex+0];
+				temp[j*2+1] = pData[sampleIndex+1];
+				sampleFrac += rateScale;
+				sampleIndex += FIX_INTPART( sampleFrac )<<1;
+				sampleFrac = FIX_FRACPART( sampleFrac );
+			}
+
+			S_PaintStereoFrom8( pbuf + i, volume, temp, count );
+		}
+		return;
+	}
+
 	lscale = snd_scaletable[volume[0] >> SND_SCALE_SHIFT];
 	rscale = snd_scaletable[volume[1] >> SND_SCALE_SHIFT];
 
@@ -360,6 +693,29 @@ void S_Mix16Mono( portable_samplepair_t *pbuf, int *volume, short *pData, int in
 		return;
 	}
 
+	if( MIX_HAVE_SIMD && mix_simd )
+	{
+		short	temp[MIX_RESAMPLE_CHUNK];
+		int	j, count;
+
+		// gather pitch shifted samples and paint them at once
+		for( i = 0; i < outCount; i += count )
+		{
+			count = Q_min( outCount - i, MIX_RESAMPLE_CHUNK );
+
+			for( j = 0; j < count; j++ )
+			{
+				temp[j] = pData[sampleIndex];
+				sampleFrac += rateScale;
+				sampleIndex += FIX_INTPART( sampleFrac );
+				sampleFrac = FIX_FRACPART( sampleFrac );
+			}
+
+			S_PaintMonoFrom16( pbuf + i, volume, temp, count );
+		}
+		return;
+	}
+
 	for( i = 0; i < outCount; i++ )
 	{
 		pbuf[i].left += (volume[0] * (int)( pData[sampleIndex] ))>>8;
@@ -382,6 +738,30 @@ void S_Mix16Stereo( portable_samplepair_t *pbuf, int *volume, short *pData, int
 		return;
 	}
 
+	if( MIX_HAVE_SIMD && mix_simd )
+	{
+		short	temp[MIX_RESAMPLE_CHUNK * 2];
+		int	j, count;
+
+		// gather pitch shifted samples and paint them at once
+		for( i = 0; i < outCount; i += count )
+		{
+			count = Q_min( outCount - i, MIX_RESAMPLE_CHUNK );
+
+			for( j = 0; j < count; j++ )
+			{
+				temp[j*2+0] = pData[sampleIndex+0];
+				temp[j*2+1] = pData[sampleIndex+1];
+				sampleFrac += rateScale;
+				sampleIndex += FIX_INTPART( sampleFrac )<<1;
+				sampleFrac = FIX_FRACPART( sampleFrac );
+			}
+
+			S_PaintStereoFrom16( pbuf + i, volume, temp, count );
+		}
+		return;
+	}
+
 	for( i = 0; i < outCount; i++ )
 	{
 		pbuf[i].left += (volume[0] * (int)( pData[sampleIndex+0] ))>>8;
@@ -538,7 +918,7 @@ void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
 	qboolean	bZeroVolume;
 
 	// mix each channel into paintbuffer
-	ch = channels;
+	ch = mix_channels;
 
 	// validate parameters
 	Assert( outputRate <= SOUND_DMA_SPEED );
@@ -551,32 +931,32 @@ void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
 
 	if( sampleCount <= 0 ) return;
 
-	for( i = 0; i < total_channels; i++, ch++ )
+	for( i = 0; i < mix_total_channels; i++, ch++ )
 	{
 		if( !ch->sfx ) continue;
 
 		// NOTE: background map is allow both type sounds: menu and game
-		if( !cl.background )
+		if( !s_mixparams.background )
 		{
-			if( cls.key_dest == key_console && ch->localsound )
+			if( s_mixparams.console && ch->localsound )
 			{
 				// play, playvol
 			}
-			else if(( s_listener.inmenu || s_listener.paused ) && !ch->localsound )
+			else if(( s_mixparams.inmenu || s_mixparams.paused ) && !ch->localsound )
 			{
 				// play only local sounds, keep pause for other
 				continue;
 			}
-			else if( !s_listener.inmenu && !s_listener.active && !ch->staticsound )
+			else if( !s_mixparams.inmenu && !s_mixparams.active && !ch->staticsound )
 			{
 				// play only ambient sounds, keep pause for other
 				continue;
 			}
 		}
-		else if( cls.key_dest == key_console )
+		else if( s_mixparams.console )
 			continue;	// silent mode in console
 
-		pSource = S_LoadSound( ch->sfx );
+		pSource = S_MixerLoadSound( ch->sfx );
 
 		// Don't mix sound data for sounds with zero volume. If it's a non-looping sound,
 		// just remove the sound when its volume goes to zero.
@@ -593,7 +973,7 @@ void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
 		{
 			if( !pSource )
 			{
-				S_FreeChannel( ch );
+				S_MixerFreeChannel( ch );
 				continue;
 			}
 		}
@@ -619,7 +999,8 @@ void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
 			ch->pitch = VOX_ModifyPitch( ch, ch->basePitch * 0.01f );
 		else ch->pitch = ch->basePitch * 0.01f;
 
-		if( CL_GetEntityByIndex( ch->entnum ) && ( ch->entchannel == CHAN_VOICE ))
+		// mixer only publishes the mouth, main thread moves it
+		if( ch->entchannel == CHAN_VOICE )
 		{
 			if( pSource->width == 1 )
 				SND_MoveMouth8( ch, pSource, sampleCount );
@@ -634,7 +1015,7 @@ void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
 
 		if( !S_ShouldContinueMixing( ch ))
 		{
-			S_FreeChannel( ch );
+			S_MixerFreeChannel( ch );
 		}
 	}
 }
@@ -857,7 +1238,11 @@ void MIX_MixPaintbuffers( int ibuf1, int ibuf2, int ibuf3, int count, float fgai
 	// pb1 (4ch->2ch) + pb2 (4ch->2ch)	-> pb3 2ch
 
 	// mix front channels
-	for( i = 0; i < count; i++ )
+	i = 0;
+	if( mix_simd )
+		i = MIX_MixPaintbuffers_SIMD( (int *)pbuf1, (int *)pbuf2, (int *)pbuf3, count * 2, gain ) >> 1;
+
+	for( ; i < count; i++ )
 	{
 		pbuf3[i].left = pbuf1[i].left;
 		pbuf3[i].right = pbuf1[i].right;
@@ -870,12 +1255,16 @@ void MIX_CompressPaintbuffer( int ipaint, int count )
 {
 	portable_samplepair_t	*pbuf;
 	paintbuffer_t		*ppaint;
-	int			i;
+	int			i = 0;
 
 	ppaint = MIX_GetPPaintFromIPaint( ipaint );
 	pbuf = ppaint->pbuf;
 
-	for( i = 0; i < count; i++, pbuf++ )
+	if( mix_simd )
+		i = MIX_CompressPaintbuffer_SIMD( (int *)pbuf, count * 2 ) >> 1;
+	pbuf += i;
+
+	for( ; i < count; i++, pbuf++ )
 	{
 		pbuf->left = CLIP( pbuf->left );
 		pbuf->right = CLIP( pbuf->right );
@@ -904,7 +1293,7 @@ void MIX_MixStreamBuffer( int end )
 	ch = S_FindRawChannel( S_RAW_SOUND_BACKGROUNDTRACK, false );
 
 	// clear the paint buffer
-	if( s_listener.paused || !ch || ch->s_rawend < paintedtime )
+	if( s_mixparams.paused || !ch || ch->s_rawend < paintedtime )
 	{
 		memset( pbuf, 0, (end - paintedtime) * sizeof( portable_samplepair_t ));
 	}
@@ -933,7 +1322,7 @@ void MIX_MixRawSamplesBuffer( int end )
 
 	pbuf = MIX_GetCurrentPaintbufferPtr()->pbuf;
 
-	if( s_listener.paused ) return;
+	if( s_mixparams.paused ) return;
 
 	// paint in the raw channels
 	for( i = 0; i < MAX_RAW_CHANNELS; i++ )
@@ -1016,8 +1405,7 @@ void MIX_PaintChannels( int endtime )
 {
 	int	end, count;
 
-	CheckNewDspPresets();
-
+	// NOTE: dsp presets are checked by SND_UpdateSound
 	while( paintedtime < endtime )
 	{
 		// if paintbuffer is smaller than DMA buffer
@@ -1037,10 +1425,10 @@ void MIX_PaintChannels( int endtime )
 		DSP_Process( idsp_room, MIX_GetPFrontFromIPaint( IROOMBUFFER ), count );
 
 		// add music or soundtrack from movie (no dsp)
-		MIX_MixPaintbuffers( IPAINTBUFFER, IROOMBUFFER, IPAINTBUFFER, count, S_GetMasterVolume() );
+		MIX_MixPaintbuffers( IPAINTBUFFER, IROOMBUFFER, IPAINTBUFFER, count, s_mixparams.mastervol );
 
 		// add music or soundtrack from movie (no dsp)
-		MIX_MixPaintbuffers( IPAINTBUFFER, ISTREAMBUFFER, IPAINTBUFFER, count, S_GetMusicVolume() );
+		MIX_MixPaintbuffers( IPAINTBUFFER, ISTREAMBUFFER, IPAINTBUFFER, count, s_mixparams.musicvol );
 
 		// clip all values > 16 bit down to 16 bit
 		MIX_CompressPaintbuffer( IPAINTBUFFER, count );
@@ -1053,3 +1441,109 @@ void MIX_PaintChannels( int endtime )
 		paintedtime = end;
 	}
 }
+
+/*
+=================
+S_MixBench_f
+
+mix synthetic channels with scalar and SIMD code,
+check they are bit-exact and print mixing throughput.
+mix_simd is shared with the mixing thread, so it's
+kept stopped while the bench runs
+=================
+*/
+void S_MixBench_f( void )
+{
+	portable_samplepair_t	*pbuf;
+	double			start, elapsed[2];
+	CRC32_t			crc[2];
+	qboolean			oldsimd = mix_simd;
+	int			numchannels, seconds, blocks;
+	int			i, j, k, pass;
+	int			srclen, pvol[CCHANVOLUMES];
+	byte			*data;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "s_mixbench <channels> [seconds]\n" );
+		return;
+	}
+
+	numchannels = bound( 1, Q_atoi( Cmd_Argv( 1 )), MAX_CHANNELS );
+	seconds = Cmd_Argc() > 2 ? bound( 1, Q_atoi( Cmd_Argv( 2 )), 60 ) : 10;
+	blocks = seconds * SOUND_44k / PAINTBUFFER_SIZE;
+
+	// enough for stereo 16-bit source with pitch up to 2.0
+	srclen = ( PAINTBUFFER_SIZE * 2 + 4 ) * 2 * sizeof( short );
+	data = Z_Malloc( srclen );
+	pbuf = Z_Malloc( PAINTBUFFER_SIZE * sizeof( *pbuf ));
+
+	for( i = 0; i < srclen; i++ )
+		data[i] = (byte)(((uint)i * 2654435761U ) >> 24 );
+
+	S_LockMixer();
+
+	for( pass = 0; pass < 2; pass++ )
+	{
+		mix_simd = ( pass != 0 );
+		CRC32_Init( &crc[pass] );
+		start = Sys_DoubleTime();
+
+		for( i = 0; i < blocks; i++ )
+		{
+			memset( pbuf, 0, PAINTBUFFER_SIZE * sizeof( *pbuf ));
+
+			for( j = 0; j < numchannels; j++ )
+			{
+				// every channel gets own format, pitch and volume
+				uint	rate = ( j & 4 ) ? FIX_FLOAT( 0.75 + ( j & 3 ) * 0.25 ) : FIX( 1 );
+				int	offset = ( j * 7 ) & FIX_MASK;
+
+				pvol[0] = ( j * 37 + i ) & 255;
+				pvol[1] = ( j * 91 + i ) & 255;
+
+				switch( j & 3 )
+				{
+				case 0: S_Mix8Mono( pbuf, pvol, data, offset, rate, PAINTBUFFER_SIZE, 0 ); break;
+				case 1: S_Mix8Stereo( pbuf, pvol, data, offset, rate, PAINTBUFFER_SIZE ); break;
+				case 2: S_Mix16Mono( pbuf, pvol, (short *)data, offset, rate, PAINTBUFFER_SIZE ); break;
+				case 3: S_Mix16Stereo( pbuf, pvol, (short *)data, offset, rate, PAINTBUFFER_SIZE ); break;
+				}
+			}
+
+			k = mix_simd ? MIX_CompressPaintbuffer_SIMD( (int *)pbuf, PAINTBUFFER_SIZE * 2 ) >> 1 : 0;
+
+			for( ; k < PAINTBUFFER_SIZE; k++ )
+			{
+				pbuf[k].left = CLIP( pbuf[k].left );
+				pbuf[k].right = CLIP( pbuf[k].right );
+			}
+
+			CRC32_ProcessBuffer( &crc[pass], pbuf, PAINTBUFFER_SIZE * sizeof( *pbuf ));
+		}
+
+		elapsed[pass] = Sys_DoubleTime() - start;
+		crc[pass] = CRC32_Final( crc[pass] );
+	}
+
+	mix_simd = oldsimd;
+	S_UnlockMixer();
+
+	Z_Free( data );
+	Z_Free( pbuf );
+
+	Con_Printf( "mixed %i channels, %i seconds of 44k audio\n", numchannels, seconds );
+	Con_Printf( "scalar: %.3f sec, %.1f channels per core\n", elapsed[0], numchannels * seconds / Q_max( elapsed[0], 0.001 ));
+
+	if( !MIX_HAVE_SIMD )
+	{
+		Con_Printf( "SIMD: not available in this build\n" );
+		return;
+	}
+
+	Con_Printf( "SIMD: %.3f sec, %.1f channels per core, %.2fx\n", elapsed[1], numchannels * seconds / Q_max( elapsed[1], 0.001 ), elapsed[0] / Q_max( elapsed[1], 0.001 ));
+
+	if( crc[0] != crc[1] )
+		Con_Printf( S_ERROR "SIMD output mismatch (%08x != %08x)\n", crc[0], crc[1] );
+	else Con_Printf( "SIMD output is bit-exact\n" );
+}
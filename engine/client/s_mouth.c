@@ -20,6 +20,8 @@ GNU General Public License for more details.
 
 #define CAVGSAMPLES		10
 
+static mouth_t	mix_mouth[MAX_CHANNELS];	// running averages of the mixing channels, mixer only
+
 void SND_InitMouth( int entnum, int entchannel )
 {
 	if(( entchannel == CHAN_VOICE || entchannel == CHAN_STREAM ) && entnum > 0 )
@@ -54,19 +56,44 @@ void SND_CloseMouth( channel_t *ch )
 	}
 }
 
-void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count )
+/*
+=================
+SND_SetMouth
+
+main thread applies the mouth state published by the mixer
+=================
+*/
+void SND_SetMouth( int entnum, int mouthopen )
 {
 	cl_entity_t	*clientEntity;
+
+	clientEntity = CL_GetEntityByIndex( entnum );
+
+	if( clientEntity )
+		clientEntity->mouth.mouthopen = mouthopen;
+}
+
+/*
+=================
+SND_InitMixerMouth
+
+channel was (re)started in the mixer
+=================
+*/
+void SND_InitMixerMouth( channel_t *ch )
+{
+	memset( &mix_mouth[ch - mix_channels], 0, sizeof( mouth_t ));
+}
+
+void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count )
+{
 	signed char		*pdata = NULL;
 	mouth_t		*pMouth = NULL;
 	int		scount, pos = 0;
 	int		savg, data;
 	uint 		i;
 
-	clientEntity = CL_GetEntityByIndex( ch->entnum );
-	if( !clientEntity ) return;
-
-	pMouth = &clientEntity->mouth;
+	pMouth = &mix_mouth[ch - mix_channels];
 
 	if( ch->isSentence )
 	{
@@ -99,22 +126,19 @@ void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count )
 		pMouth->mouthopen = pMouth->sndavg / CAVGSAMPLES;
 		pMouth->sndavg = 0;
 		pMouth->sndcount = 0;
+		S_MixerSetMouth( ch, pMouth->mouthopen );
 	}
 }
 
 void SND_MoveMouth16( channel_t *ch, wavdata_t *pSource, int count )
 {
-	cl_entity_t	*clientEntity;
 	short		*pdata = NULL;
 	mouth_t		*pMouth = NULL;
 	int		savg, data;
 	int		scount, pos = 0;
 	uint 		i;
 
-	clientEntity = CL_GetEntityByIndex( ch->entnum );
-	if( !clientEntity ) return;
-
-	pMouth = &clientEntity->mouth;
+	pMouth = &mix_mouth[ch - mix_channels];
 
 	if( ch->isSentence )
 	{
@@ -148,5 +172,6 @@ void SND_MoveMouth16( channel_t *ch, wavdata_t *pSource, int count )
 		pMouth->mouthopen = pMouth->sndavg / CAVGSAMPLES;
 		pMouth->sndavg = 0;
 		pMouth->sndcount = 0;
+		S_MixerSetMouth( ch, pMouth->mouthopen );
 	}
 }
@@ -0,0 +1,833 @@
+/*
+s_thread.c - sound mixing thread
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "sound.h"
+#include "client.h"
+#include "platform/platform.h"
+
+/*
+===============================================================================
+
+the mixer owns its own copy of channels (mix_channels), the main thread
+never touches it directly. Channel starts, stops and spatialization are
+sent through the single producer/single consumer command queue, finished
+channels are reported back through mix_done serials.
+
+Rare structural changes (stop all sounds, unloading sound data, raw
+channels allocation) are done under S_LockMixer, the mixer holds
+the same lock while it paints.
+
+without the thread the queue is drained right before painting
+so both modes are running exactly the same code.
+
+===============================================================================
+*/
+#if !XASH_EMSCRIPTEN && !XASH_DOS4GW
+#define HAVE_MIX_THREAD
+#endif
+
+#ifdef HAVE_MIX_THREAD
+#if XASH_WIN32
+#define mutex_init( x )	InitializeCriticalSection( x )
+#define mutex_free( x )	DeleteCriticalSection( x )
+#define mutex_lock( x )	EnterCriticalSection( x )
+#define mutex_unlock( x )	LeaveCriticalSection( x )
+#define mutex_t		CRITICAL_SECTION
+#define thread_t		HANDLE
+#else // !XASH_WIN32
+#include <pthread.h>
+#define mutex_init( x )	pthread_mutex_init( x, NULL )
+#define mutex_free( x )	pthread_mutex_destroy( x )
+#define mutex_lock( x )	pthread_mutex_lock( x )
+#define mutex_unlock( x )	pthread_mutex_unlock( x )
+#define mutex_t		pthread_mutex_t
+#define thread_t		pthread_t
+#endif // !XASH_WIN32
+#endif // HAVE_MIX_THREAD
+
+#if defined( __GNUC__ )
+#define MIX_LoadAcquire( p )		__atomic_load_n( p, __ATOMIC_ACQUIRE )
+#define MIX_StoreRelease( p, v )	__atomic_store_n( p, v, __ATOMIC_RELEASE )
+#else
+// msvc volatile accesses have acquire/release semantics
+#define MIX_LoadAcquire( p )		(*(p))
+#define MIX_StoreRelease( p, v )	(*(p) = (v))
+#endif
+
+#define MIX_QUEUE_SIZE	1024	// must be power of two
+#define MIX_QUEUE_MASK	( MIX_QUEUE_SIZE - 1 )
+#define MIX_STARTS_SIZE	64	// pending channel starts, must be power of two
+#define MIX_STARTS_MASK	( MIX_STARTS_SIZE - 1 )
+#define MIX_THREAD_SLEEP	4	// msec between mixing passes
+
+// mouthopen tagged with the channel serial, so the main thread
+// never applies the mouth of the previous sound on this channel
+#define MIX_MOUTH( serial, open )	((( serial ) & 0x7FFFFF ) << 8 | (( open ) & 0xFF ))
+
+typedef enum
+{
+	MIXCMD_START = 0,	// channel copy is in starts ring
+	MIXCMD_STOP,
+	MIXCMD_SPATIALIZE,
+	MIXCMD_SKIP
+} mixcmdtype_t;
+
+typedef struct
+{
+	int		type;
+	int		index;		// channel number
+	int		serial;		// drop commands for already restarted channels
+	int		leftvol;
+	int		rightvol;
+	int		value;		// base pitch or sample position to skip
+} mixcmd_t;
+
+// what mixer is knows about the channel, main thread only
+typedef struct
+{
+	int		serial;		// bumped on every start
+	qboolean		active;		// mixer is playing it
+	qboolean		fresh;		// started in this frame
+	sfx_t		*sfx;
+	int		leftvol;
+	int		rightvol;
+	int		pitch;
+	int		mouth;		// last applied mix_mouthopen value
+} mixsent_t;
+
+static struct
+{
+	// written by main thread
+	mixcmd_t		cmds[MIX_QUEUE_SIZE];
+	channel_t		starts[MIX_STARTS_SIZE];
+	volatile uint	cmd_head;
+	uint		start_head;
+
+	// written by mixer
+	volatile uint	cmd_tail;
+	volatile uint	start_tail;
+} mix_queue;
+
+static struct
+{
+#ifdef HAVE_MIX_THREAD
+	thread_t		thread;
+	mutex_t		mutex;
+#if XASH_WIN32
+	DWORD		threadid;
+#endif
+#endif
+	qboolean		created;		// changed by main thread when mixer is not running
+	volatile int	running;
+	volatile int	stopall;		// mixer asks main thread to stop all sounds
+	int		lockcount;	// main thread only
+} mix_thread;
+
+channel_t		mix_channels[MAX_CHANNELS];
+int		mix_total_channels;
+mixparams_t	s_mixparams;
+
+static int	mix_serial[MAX_CHANNELS];	// serial of the mixed sound, mixer only
+static volatile int	mix_done[MAX_CHANNELS];	// serial of the last finished sound
+static volatile int	mix_mouthopen[MAX_CHANNELS];	// mouth published by the mixer, see MIX_MOUTH
+static mixsent_t	mix_sent[MAX_CHANNELS];
+#ifdef HAVE_MIX_THREAD
+static convar_t	*s_mixthread;
+#endif
+
+/*
+=================
+S_MixerThreadSelf
+
+mixer should never load or free sounds by itself
+=================
+*/
+qboolean S_MixerThreadSelf( void )
+{
+#ifdef HAVE_MIX_THREAD
+	if( !mix_thread.created )
+		return false;
+#if XASH_WIN32
+	return GetCurrentThreadId() == mix_thread.threadid;
+#else
+	return pthread_equal( pthread_self(), mix_thread.thread ) ? true : false;
+#endif
+#else
+	return false;
+#endif
+}
+
+/*
+=================
+S_MixerThreadActive
+
+mixing thread is painting by itself
+=================
+*/
+qboolean S_MixerThreadActive( void )
+{
+	return mix_thread.created;
+}
+
+/*
+=================
+S_LockMixer
+
+wait for current mixing pass and keep the mixer stopped,
+can be nested. Does nothing if there is no mixing thread
+=================
+*/
+void S_LockMixer( void )
+{
+#ifdef HAVE_MIX_THREAD
+	if( !mix_thread.created || S_MixerThreadSelf( ))
+		return;
+
+	if( mix_thread.lockcount++ == 0 )
+		mutex_lock( &mix_thread.mutex );
+#endif
+}
+
+/*
+=================
+S_UnlockMixer
+=================
+*/
+void S_UnlockMixer( void )
+{
+#ifdef HAVE_MIX_THREAD
+	if( !mix_thread.created || S_MixerThreadSelf( ))
+		return;
+
+	Assert( mix_thread.lockcount > 0 );
+
+	if( --mix_thread.lockcount == 0 )
+		mutex_unlock( &mix_thread.mutex );
+#endif
+}
+
+/*
+=================
+S_MixerLoadSound
+
+returns sound data for mixing, the mixing thread
+have to be satisfied with already loaded sounds
+=================
+*/
+wavdata_t *S_MixerLoadSound( sfx_t *sfx )
+{
+	if( !S_MixerThreadSelf( ))
+		return S_LoadSound( sfx );
+
+	return sfx ? sfx->cache : NULL;
+}
+
+/*
+===============================================================================
+
+MIXER SIDE
+
+===============================================================================
+*/
+/*
+=================
+S_MixerFreeChannel
+
+mixing is finished, let the main thread know about it
+=================
+*/
+void S_MixerFreeChannel( channel_t *ch )
+{
+	int	index = ch - mix_channels;
+
+	Assert( index >= 0 && index < MAX_CHANNELS );
+
+	ch->sfx = NULL;
+	ch->isSentence = false;
+	ch->currentWord = NULL;
+	memset( &ch->pMixer, 0, sizeof( ch->pMixer ));
+
+	MIX_StoreRelease( &mix_done[index], mix_serial[index] );
+}
+
+/*
+=================
+S_MixerSetMouth
+
+called by mixer, main thread will move
+the entity mouth on the next frame
+=================
+*/
+void S_MixerSetMouth( channel_t *ch, int mouthopen )
+{
+	int	index = ch - mix_channels;
+
+	MIX_StoreRelease( &mix_mouthopen[index], MIX_MOUTH( mix_serial[index], mouthopen ));
+}
+
+/*
+=================
+S_MixerStopAll
+
+called by mixer when dma time is wrapped,
+main thread will do the rest
+=================
+*/
+void S_MixerStopAll( void )
+{
+	int	i;
+
+	for( i = 0; i < mix_total_channels; i++ )
+	{
+		if( mix_channels[i].sfx )
+			S_MixerFreeChannel( &mix_channels[i] );
+	}
+
+	MIX_StoreRelease( &mix_thread.stopall, true );
+}
+
+/*
+=================
+S_MixerApply
+=================
+*/
+static void S_MixerApply( const mixcmd_t *cmd, const channel_t *start )
+{
+	channel_t	*ch = &mix_channels[cmd->index];
+
+	switch( cmd->type )
+	{
+	case MIXCMD_START:
+		*ch = *start;
+		// sentence word mixer is pointed to the channel itself
+		if( ch->currentWord ) ch->currentWord = &ch->pMixer;
+		mix_serial[cmd->index] = cmd->serial;
+		SND_InitMixerMouth( ch );
+		mix_total_channels = Q_max( mix_total_channels, cmd->index + 1 );
+		break;
+	case MIXCMD_STOP:
+		if( mix_serial[cmd->index] == cmd->serial && ch->sfx )
+			S_MixerFreeChannel( ch );
+		break;
+	case MIXCMD_SPATIALIZE:
+		if( mix_serial[cmd->index] != cmd->serial )
+			break;
+		ch->leftvol = cmd->leftvol;
+		ch->rightvol = cmd->rightvol;
+		ch->basePitch = cmd->value;
+		break;
+	case MIXCMD_SKIP:
+		if( mix_serial[cmd->index] == cmd->serial && ch->sfx )
+			ch->pMixer.sample = cmd->value;
+		break;
+	}
+}
+
+/*
+=================
+S_MixerDrainCommands
+
+apply all pending commands, called by the mixer
+or by main thread while mixer is locked
+=================
+*/
+void S_MixerDrainCommands( void )
+{
+	uint	head = MIX_LoadAcquire( &mix_queue.cmd_head );
+	uint	tail = mix_queue.cmd_tail;
+
+	while( tail != head )
+	{
+		const mixcmd_t	*cmd = &mix_queue.cmds[tail & MIX_QUEUE_MASK];
+
+		if( cmd->type == MIXCMD_START )
+		{
+			S_MixerApply( cmd, &mix_queue.starts[mix_queue.start_tail & MIX_STARTS_MASK] );
+			MIX_StoreRelease( &mix_queue.start_tail, mix_queue.start_tail + 1 );
+		}
+		else S_MixerApply( cmd, NULL );
+
+		tail++;
+	}
+
+	MIX_StoreRelease( &mix_queue.cmd_tail, tail );
+}
+
+/*
+=================
+S_MixerReleaseSound
+
+sound data is going to be freed, stop the channels
+which are still mixing it. Mixer must be locked
+=================
+*/
+void S_MixerReleaseSound( sfx_t *sfx )
+{
+	int	i;
+
+	// mixing on the main thread will reload it
+	if( !mix_thread.created )
+		return;
+
+	S_MixerDrainCommands();
+
+	for( i = 0; i < mix_total_channels; i++ )
+	{
+		if( mix_channels[i].sfx == sfx )
+			S_MixerFreeChannel( &mix_channels[i] );
+	}
+}
+
+/*
+===============================================================================
+
+MAIN THREAD SIDE
+
+===============================================================================
+*/
+/*
+=================
+S_MixerPush
+=================
+*/
+static void S_MixerPush( const mixcmd_t *cmd, const channel_t *start )
+{
+	qboolean	full;
+
+	full = ( mix_queue.cmd_head - MIX_LoadAcquire( &mix_queue.cmd_tail )) >= MIX_QUEUE_SIZE;
+
+	if( start && ( mix_queue.start_head - MIX_LoadAcquire( &mix_queue.start_tail )) >= MIX_STARTS_SIZE )
+		full = true;
+
+	if( full )
+	{
+		// mixer is too far behind, apply all the commands right now
+		S_LockMixer();
+		S_MixerDrainCommands();
+		S_MixerApply( cmd, start );
+		S_UnlockMixer();
+		return;
+	}
+
+	if( start )
+	{
+		mix_queue.starts[mix_queue.start_head & MIX_STARTS_MASK] = *start;
+		mix_queue.start_head++;
+	}
+
+	mix_queue.cmds[mix_queue.cmd_head & MIX_QUEUE_MASK] = *cmd;
+	MIX_StoreRelease( &mix_queue.cmd_head, mix_queue.cmd_head + 1 );
+}
+
+/*
+=================
+S_MixerStartChannel
+
+(re)start the channel from the scratch
+=================
+*/
+void S_MixerStartChannel( channel_t *ch )
+{
+	int	index = ch - channels;
+	mixsent_t	*sent = &mix_sent[index];
+	mixcmd_t	cmd;
+
+	Assert( index >= 0 && index < MAX_CHANNELS );
+
+	// make sure mixer will find the sound data
+	S_LoadSound( ch->sfx );
+
+	sent->serial++;
+	sent->active = true;
+	sent->fresh = true;
+	sent->sfx = ch->sfx;
+	sent->leftvol = ch->leftvol;
+	sent->rightvol = ch->rightvol;
+	sent->pitch = ch->basePitch;
+	sent->mouth = MIX_MOUTH( sent->serial, 0 );
+
+	memset( &cmd, 0, sizeof( cmd ));
+	cmd.type = MIXCMD_START;
+	cmd.index = index;
+	cmd.serial = sent->serial;
+
+	S_MixerPush( &cmd, ch );
+}
+
+/*
+=================
+S_MixerStopChannel
+=================
+*/
+void S_MixerStopChannel( channel_t *ch )
+{
+	int	index = ch - channels;
+	mixsent_t	*sent;
+	mixcmd_t	cmd;
+
+	if( index < 0 || index >= MAX_CHANNELS )
+		return;
+
+	sent = &mix_sent[index];
+
+	if( !sent->active )
+		return;
+
+	sent->active = false;
+	sent->fresh = false;
+
+	memset( &cmd, 0, sizeof( cmd ));
+	cmd.type = MIXCMD_STOP;
+	cmd.index = index;
+	cmd.serial = sent->serial;
+
+	S_MixerPush( &cmd, NULL );
+}
+
+/*
+=================
+S_MixerSkipChannel
+
+send new start position of the channel
+=================
+*/
+void S_MixerSkipChannel( channel_t *ch )
+{
+	int	index = ch - channels;
+	mixsent_t	*sent = &mix_sent[index];
+	mixcmd_t	cmd;
+
+	if( !sent->active )
+		return;
+
+	memset( &cmd, 0, sizeof( cmd ));
+	cmd.type = MIXCMD_SKIP;
+	cmd.index = index;
+	cmd.serial = sent->serial;
+	cmd.value = (int)ch->pMixer.sample;
+
+	S_MixerPush( &cmd, NULL );
+}
+
+/*
+=================
+S_MixerChannelFresh
+
+channel was started in this frame and mixer didn't
+get spatialization for it yet
+=================
+*/
+qboolean S_MixerChannelFresh( channel_t *ch )
+{
+	return mix_sent[ch - channels].fresh;
+}
+
+/*
+=================
+S_MixerSpatialize
+
+send changed volumes and pitches to the mixer,
+start and stop channels that was changed directly
+=================
+*/
+void S_MixerSpatialize( void )
+{
+	mixsent_t	*sent;
+	channel_t	*ch;
+	mixcmd_t	cmd;
+	int	i;
+
+	memset( &cmd, 0, sizeof( cmd ));
+	cmd.type = MIXCMD_SPATIALIZE;
+
+	for( i = 0, ch = channels, sent = mix_sent; i < total_channels; i++, ch++, sent++ )
+	{
+		sent->fresh = false;
+
+		if( !ch->sfx )
+		{
+			// ambient sounds are switched off without S_FreeChannel
+			if( sent->active )
+				S_MixerStopChannel( ch );
+			continue;
+		}
+
+		// ambient and static sounds are set up in place
+		if( !sent->active || sent->sfx != ch->sfx )
+		{
+			S_MixerStartChannel( ch );
+			sent->fresh = false;
+			continue;
+		}
+
+		if( sent->leftvol == ch->leftvol && sent->rightvol == ch->rightvol && sent->pitch == ch->basePitch )
+			continue;
+
+		sent->leftvol = ch->leftvol;
+		sent->rightvol = ch->rightvol;
+		sent->pitch = ch->basePitch;
+
+		cmd.index = i;
+		cmd.serial = sent->serial;
+		cmd.leftvol = ch->leftvol;
+		cmd.rightvol = ch->rightvol;
+		cmd.value = ch->basePitch;
+
+		S_MixerPush( &cmd, NULL );
+	}
+}
+
+/*
+=================
+S_MixerClearChannels
+
+forget about all channels and pending commands
+=================
+*/
+void S_MixerClearChannels( void )
+{
+	int	i;
+
+	S_LockMixer();
+
+	// main thread is consumer now
+	mix_queue.cmd_tail = mix_queue.cmd_head;
+	mix_queue.start_tail = mix_queue.start_head;
+
+	memset( mix_channels, 0, sizeof( mix_channels ));
+	mix_total_channels = 0;
+
+	// serials are kept to ignore old mix_done values
+	for( i = 0; i < MAX_CHANNELS; i++ )
+	{
+		mix_sent[i].active = false;
+		mix_sent[i].fresh = false;
+		mix_sent[i].sfx = NULL;
+	}
+
+	S_UnlockMixer();
+}
+
+/*
+=================
+S_MixerSyncPositions
+
+copy actual playback positions from the mixer,
+used when sounds are saved
+=================
+*/
+void S_MixerSyncPositions( void )
+{
+	channel_t	*ch, *mix;
+	int	i;
+
+	S_LockMixer();
+	S_MixerDrainCommands();
+
+	for( i = 0, ch = channels, mix = mix_channels; i < total_channels; i++, ch++, mix++ )
+	{
+		if( !mix_sent[i].active || mix_serial[i] != mix_sent[i].serial || !mix->sfx )
+			continue;
+
+		ch->pMixer = mix->pMixer;
+		ch->wordIndex = mix->wordIndex;
+		ch->currentWord = mix->currentWord ? &ch->pMixer : NULL;
+	}
+
+	S_UnlockMixer();
+}
+
+/*
+=================
+S_MixerThreadLoop
+=================
+*/
+#ifdef HAVE_MIX_THREAD
+static void S_MixerThreadLoop( void )
+{
+	while( MIX_LoadAcquire( &mix_thread.running ))
+	{
+		mutex_lock( &mix_thread.mutex );
+		S_MixerDrainCommands();
+		S_UpdateDMA();
+		mutex_unlock( &mix_thread.mutex );
+
+		Platform_Sleep( MIX_THREAD_SLEEP );
+	}
+}
+
+#if XASH_WIN32
+static DWORD WINAPI S_MixerThreadStart( LPVOID unused )
+{
+	S_MixerThreadLoop();
+	return 0;
+}
+#else
+static void *S_MixerThreadStart( void *unused )
+{
+	S_MixerThreadLoop();
+	return NULL;
+}
+#endif
+
+/*
+=================
+S_StartMixerThread
+=================
+*/
+static void S_StartMixerThread( void )
+{
+	qboolean	failed;
+
+	if( mix_thread.created )
+		return;
+
+	mutex_init( &mix_thread.mutex );
+
+	// don't let the thread run until it's handle is stored
+	mutex_lock( &mix_thread.mutex );
+	mix_thread.running = true;
+#if XASH_WIN32
+	mix_thread.thread = CreateThread( NULL, 0, S_MixerThreadStart, NULL, 0, &mix_thread.threadid );
+	failed = ( mix_thread.thread == NULL );
+#else
+	failed = ( pthread_create( &mix_thread.thread, NULL, S_MixerThreadStart, NULL ) != 0 );
+#endif
+
+	if( failed )
+	{
+		mix_thread.running = false;
+		mutex_unlock( &mix_thread.mutex );
+		mutex_free( &mix_thread.mutex );
+		Con_Printf( S_ERROR "Audio: couldn't create mixing thread\n" );
+		Cvar_SetValue( "s_mixthread", 0.0f );
+		return;
+	}
+
+	mix_thread.created = true;
+	mutex_unlock( &mix_thread.mutex );
+
+	Con_Reportf( "Audio: mixing thread started\n" );
+}
+#endif // HAVE_MIX_THREAD
+
+/*
+=================
+S_StopMixerThread
+=================
+*/
+static void S_StopMixerThread( void )
+{
+#ifdef HAVE_MIX_THREAD
+	if( !mix_thread.created )
+		return;
+
+	Assert( mix_thread.lockcount == 0 );
+
+	MIX_StoreRelease( &mix_thread.running, false );
+#if XASH_WIN32
+	WaitForSingleObject( mix_thread.thread, INFINITE );
+	CloseHandle( mix_thread.thread );
+#else
+	pthread_join( mix_thread.thread, NULL );
+#endif
+	mutex_free( &mix_thread.mutex );
+	mix_thread.created = false;
+
+	Con_Reportf( "Audio: mixing thread stopped\n" );
+#endif
+}
+
+/*
+=================
+S_MixerBeginFrame
+
+follow s_mixthread changes and release
+the channels which are finished by mixer
+=================
+*/
+void S_MixerBeginFrame( void )
+{
+	mixsent_t	*sent;
+	int	i, mouth;
+
+#ifdef HAVE_MIX_THREAD
+	if( CVAR_TO_BOOL( s_mixthread ) != mix_thread.created )
+	{
+		if( CVAR_TO_BOOL( s_mixthread ))
+			S_StartMixerThread();
+		else S_StopMixerThread();
+	}
+#endif
+
+	if( MIX_LoadAcquire( &mix_thread.stopall ))
+	{
+		MIX_StoreRelease( &mix_thread.stopall, false );
+		S_StopAllSounds( true );
+		return;
+	}
+
+	for( i = 0, sent = mix_sent; i < total_channels; i++, sent++ )
+	{
+		if( !sent->active )
+			continue;
+
+		mouth = MIX_LoadAcquire( &mix_mouthopen[i] );
+
+		// ignore mouth of the previous sound
+		if( mouth != sent->mouth && ( mouth >> 8 ) == ( sent->mouth >> 8 ))
+		{
+			sent->mouth = mouth;
+			SND_SetMouth( channels[i].entnum, mouth & 0xFF );
+		}
+
+		if( MIX_LoadAcquire( &mix_done[i] ) != sent->serial )
+			continue;
+
+		sent->active = false;
+		S_FreeChannel( &channels[i] );
+	}
+}
+
+/*
+=================
+S_InitMixer
+=================
+*/
+void S_InitMixer( void )
+{
+	memset( &mix_queue, 0, sizeof( mix_queue ));
+	memset( mix_sent, 0, sizeof( mix_sent ));
+	memset( (void *)mix_done, 0, sizeof( mix_done ));
+	memset( mix_serial, 0, sizeof( mix_serial ));
+	memset( mix_channels, 0, sizeof( mix_channels ));
+	memset( &s_mixparams, 0, sizeof( s_mixparams ));
+	mix_total_channels = 0;
+
+#ifdef HAVE_MIX_THREAD
+	s_mixthread = Cvar_Get( "s_mixthread", "1", FCVAR_ARCHIVE, "mix sound in a separate thread" );
+#endif
+}
+
+/*
+=================
+S_ShutdownMixer
+=================
+*/
+void S_ShutdownMixer( void )
+{
+	S_StopMixerThread();
+}
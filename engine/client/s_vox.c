@@ -350,7 +350,7 @@ void VOX_LoadWord( channel_t *pchan )
 {
 	if( pchan->words[pchan->wordIndex].sfx )
 	{
-		wavdata_t	*pSource = S_LoadSound( pchan->words[pchan->wordIndex].sfx );
+		wavdata_t	*pSource = S_MixerLoadSound( pchan->words[pchan->wordIndex].sfx );
 
 		if( pSource )
 		{
@@ -387,14 +387,17 @@ void VOX_FreeWord( channel_t *pchan )
 	pchan->currentWord = NULL; // sentence is finished
 	memset( &pchan->pMixer, 0, sizeof( pchan->pMixer ));
 
+	// mixing thread leaves it for the sound cache budget
+	if( S_MixerThreadSelf( ))
+		return;
+
 	// release unused sounds
 	if( pchan->words[pchan->wordIndex].sfx )
 	{
 		// If this wave wasn't precached by the game code
 		if( !pchan->words[pchan->wordIndex].fKeepCached )
 		{
-			FS_FreeSound( pchan->words[pchan->wordIndex].sfx->cache );
-			pchan->words[pchan->wordIndex].sfx->cache = NULL;
+			S_UnloadSound( pchan->words[pchan->wordIndex].sfx );
 			pchan->words[pchan->wordIndex].sfx = NULL;
 		}
 	}
@@ -516,6 +519,13 @@ void VOX_LoadSound( channel_t *pchan, const char *pszin )
 		i++;
 	}
 
+	// mixer can't load the next words by itself
+	for( i = 0; i < cword; i++ )
+	{
+		if( rgvoxword[i].sfx )
+			S_LoadSound( rgvoxword[i].sfx );
+	}
+
 	VOX_LoadFirstWord( pchan, rgvoxword );
 
 	pchan->isSentence = true;
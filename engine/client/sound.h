@@ -79,6 +79,9 @@ typedef struct sfx_s
 	int		servercount;
 	uint		hashValue;
 	struct sfx_s	*hashNext;
+
+	uint		lastused;		// host.framecount of last use, for cache eviction
+	qboolean		evicted;		// data was released by cache budget
 } sfx_t;
 
 extern portable_samplepair_t	paintbuffer[];
@@ -191,6 +194,20 @@ typedef struct
 	qboolean		stream_paused;	// pause only background track
 } listener_t;
 
+// main thread state used by the mixer, copied once per frame
+typedef struct
+{
+	qboolean		background;	// background map is allow both menu and game sounds
+	qboolean		console;		// console is opened
+	qboolean		menu;		// menu is opened
+	qboolean		inmenu;		// listener in-menu ?
+	qboolean		paused;
+	qboolean		active;
+	int		waterlevel;
+	float		mastervol;
+	float		musicvol;
+} mixparams_t;
+
 typedef struct
 {
 	string		current;		// a currently playing track
@@ -214,6 +231,9 @@ extern int	total_channels;
 extern int	paintedtime;
 extern int	soundtime;
 extern listener_t	s_listener;
+extern mixparams_t	s_mixparams;
+extern channel_t	mix_channels[MAX_CHANNELS];
+extern int	mix_total_channels;
 extern int	idsp_room;
 extern dma_t	dma;
 
@@ -226,6 +246,7 @@ extern convar_t	*dsp_off;
 extern convar_t	*s_test;		// cvar to testify new effects
 extern convar_t *s_samplecount;
 extern convar_t *snd_mute_losefocus;
+extern convar_t	*s_cachesize;
 
 void S_InitScaletable( void );
 wavdata_t *S_LoadSound( sfx_t *sfx );
@@ -236,6 +257,7 @@ float S_GetMusicVolume( void );
 // s_main.c
 //
 void S_FreeChannel( channel_t *ch );
+void S_UpdateDMA( void );
 
 //
 // s_mix.c
@@ -245,6 +267,7 @@ void MIX_ClearAllPaintBuffers( int SampleCount, qboolean clearFilters );
 void MIX_InitAllPaintbuffers( void );
 void MIX_FreeAllPaintbuffers( void );
 void MIX_PaintChannels( int endtime );
+void S_MixBench_f( void );
 
 // s_load.c
 qboolean S_TestSoundChar( const char *pch, char c );
@@ -252,6 +275,7 @@ char *S_SkipSoundChar( const char *pch );
 sfx_t *S_FindName( const char *name, int *pfInCache );
 sound_t S_RegisterSound( const char *name );
 void S_FreeSound( sfx_t *sfx );
+void S_UnloadSound( sfx_t *sfx );
 void S_InitSounds( void );
 
 // s_dsp.c
@@ -282,6 +306,30 @@ void S_ClearRawChannel( int entnum );
 void S_StopAllSounds( qboolean ambient );
 void S_FreeSounds( void );
 
+//
+// s_thread.c
+//
+void S_InitMixer( void );
+void S_ShutdownMixer( void );
+void S_LockMixer( void );
+void S_UnlockMixer( void );
+qboolean S_MixerThreadSelf( void );
+qboolean S_MixerThreadActive( void );
+void S_MixerBeginFrame( void );
+void S_MixerSpatialize( void );
+void S_MixerDrainCommands( void );
+void S_MixerStartChannel( channel_t *ch );
+void S_MixerStopChannel( channel_t *ch );
+void S_MixerSkipChannel( channel_t *ch );
+qboolean S_MixerChannelFresh( channel_t *ch );
+void S_MixerClearChannels( void );
+void S_MixerSyncPositions( void );
+void S_MixerReleaseSound( sfx_t *sfx );
+void S_MixerFreeChannel( channel_t *ch );
+void S_MixerStopAll( void );
+void S_MixerSetMouth( channel_t *ch, int mouthopen );
+wavdata_t *S_MixerLoadSound( sfx_t *sfx );
+
 //
 // s_mouth.c
 //
@@ -289,6 +337,8 @@ void SND_InitMouth( int entnum, int entchannel );
 void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count );
 void SND_MoveMouth16( channel_t *ch, wavdata_t *pSource, int count );
 void SND_CloseMouth( channel_t *ch );
+void SND_SetMouth( int entnum, int mouthopen );
+void SND_InitMixerMouth( channel_t *ch );
 
 //
 // s_stream.c
@@ -99,12 +99,18 @@ struct file_s
 struct wfile_s
 {
 	string		filename;
+	string		shortname;		// wad name without path, e.g. "halflife.wad"
 	int		infotableofs;
 	byte		*mempool;			// W_ReadLump temp buffers
 	int		numlumps;
 	file_t		*handle;
 	dlumpinfo_t	*lumps;
 	time_t		filetime;
+
+	// lump name hash index
+	uint		hashsize;
+	int		*hashtable;		// first lump in bucket or -1
+	int		*hashnext;		// next lump in bucket or -1
 };
 
 typedef struct pack_s
@@ -2415,6 +2421,10 @@ and the file index in the package if relevant
 */
 static searchpath_t *FS_FindFile( const char *name, int *index, qboolean gamedironly )
 {
+	qboolean		wadparsed = false;
+	qboolean		anywadname = true;
+	signed char	wadtype = TYP_NONE;
+	string		wadname, lumpname;
 	searchpath_t	*search;
 	char		*pEnvPath;
 
@@ -2458,37 +2468,34 @@ static searchpath_t *FS_FindFile( const char *name, int *index, qboolean gamedir
 		else if( search->wad )
 		{
 			dlumpinfo_t	*lump;
-			signed char		type = W_TypeFromExt( name );
-			qboolean		anywadname = true;
-			string		wadname, wadfolder;
-			string		shortname;
-
-			// quick reject by filetype
-			if( type == TYP_NONE ) continue;
-			COM_ExtractFilePath( name, wadname );
-			wadfolder[0] = '\0';
 
-			if( COM_CheckStringEmpty( wadname ) )
+			// parse the name only once for all the wads
+			if( !wadparsed )
 			{
-				COM_FileBase( wadname, wadname );
-				Q_strncpy( wadfolder, wadname, sizeof( wadfolder ));
-				COM_DefaultExtension( wadname, ".wad" );
-				anywadname = false;
+				wadtype = W_TypeFromExt( name );
+				COM_ExtractFilePath( name, wadname );
+
+				if( COM_CheckStringEmpty( wadname ) )
+				{
+					COM_FileBase( wadname, wadname );
+					COM_DefaultExtension( wadname, ".wad" );
+					anywadname = false;
+				}
+
+				// NOTE: we can't using long names for wad,
+				// because we using original wad names[16];
+				COM_FileBase( name, lumpname );
+				wadparsed = true;
 			}
 
-			// make wadname from wad fullpath
-			COM_FileBase( search->wad->filename, shortname );
-			COM_DefaultExtension( shortname, ".wad" );
+			// quick reject by filetype
+			if( wadtype == TYP_NONE ) continue;
 
 			// quick reject by wadname
-			if( !anywadname && Q_stricmp( wadname, shortname ))
+			if( !anywadname && Q_stricmp( wadname, search->wad->shortname ))
 				continue;
 
-			// NOTE: we can't using long names for wad,
-			// because we using original wad names[16];
-			COM_FileBase( name, shortname );
-
-			lump = W_FindLump( search->wad, shortname, type );
+			lump = W_FindLump( search->wad, lumpname, wadtype );
 
 			if( lump )
 			{
@@ -3566,12 +3573,8 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 				anywadname = false;
 			}
 
-			// make wadname from wad fullpath
-			COM_FileBase( searchpath->wad->filename, temp2 );
-			COM_DefaultExtension( temp2, ".wad" );
-
 			// quick reject by wadname
-			if( !anywadname && Q_stricmp( wadname, temp2 ))
+			if( !anywadname && Q_stricmp( wadname, searchpath->wad->shortname ))
 				continue;
 
 			// look through all the wad file elements
@@ -3763,39 +3766,49 @@ Serach for already existed lump
 */
 static dlumpinfo_t *W_FindLump( wfile_t *wad, const char *name, const signed char matchtype )
 {
-	int	left, right;
+	int	i;
 
-	if( !wad || !wad->lumps || matchtype == TYP_NONE )
+	if( !wad || !wad->lumps || !wad->hashtable || matchtype == TYP_NONE )
 		return NULL;
 
-	// look for the file (binary search)
-	left = 0;
-	right = wad->numlumps - 1;
-
-	while( left <= right )
+	for( i = wad->hashtable[COM_HashKey( name, wad->hashsize )]; i != -1; i = wad->hashnext[i] )
 	{
-		int	middle = (left + right) / 2;
-		int	diff = Q_stricmp( wad->lumps[middle].name, name );
-
-		if( !diff )
-		{
-			if(( matchtype == TYP_ANY ) || ( matchtype == wad->lumps[middle].type ))
-				return &wad->lumps[middle]; // found
-			else if( wad->lumps[middle].type < matchtype )
-				diff = 1;
-			else if( wad->lumps[middle].type > matchtype )
-				diff = -1;
-			else break; // not found
-		}
+		if(( matchtype != TYP_ANY ) && ( matchtype != wad->lumps[i].type ))
+			continue;
 
-		// if we're too far in the list
-		if( diff > 0 ) right = middle - 1;
-		else left = middle + 1;
+		if( !Q_stricmp( wad->lumps[i].name, name ))
+			return &wad->lumps[i]; // found
 	}
 
 	return NULL;
 }
 
+/*
+===========
+W_BuildHashTable
+
+index the sorted lumps by name
+===========
+*/
+static void W_BuildHashTable( wfile_t *wad )
+{
+	int	i;
+
+	wad->hashsize = wad->numlumps * 2 + 1;
+	wad->hashtable = (int *)Mem_Malloc( wad->mempool, wad->hashsize * sizeof( int ));
+	wad->hashnext = (int *)Mem_Malloc( wad->mempool, wad->numlumps * sizeof( int ));
+	memset( wad->hashtable, 0xFF, wad->hashsize * sizeof( int ));
+
+	// go backwards so chains keep the sorted order
+	for( i = wad->numlumps - 1; i >= 0; i-- )
+	{
+		uint	hash = COM_HashKey( wad->lumps[i].name, wad->hashsize );
+
+		wad->hashnext[i] = wad->hashtable[hash];
+		wad->hashtable[hash] = i;
+	}
+}
+
 /*
 ====================
 W_AddFileToWad
@@ -3930,6 +3943,8 @@ wfile_t *W_Open( const char *filename, int *error )
 
 	// copy wad name
 	Q_strncpy( wad->filename, filename, sizeof( wad->filename ));
+	COM_FileBase( filename, wad->shortname );
+	COM_DefaultExtension( wad->shortname, ".wad" );
 	wad->filetime = FS_SysFileTime( filename );
 	wad->mempool = Mem_AllocPool( filename );
 
@@ -4016,6 +4031,8 @@ wfile_t *W_Open( const char *filename, int *error )
 	// release source lumps
 	Mem_Free( srclumps );
 
+	W_BuildHashTable( wad );
+
 	// and leave the file open
 	return wad;
 }
@@ -24,6 +24,9 @@ GNU General Public License for more details.
 #include "client.h"
 #include "server.h"			// LUMP_ error codes
 #include "ref_common.h"
+#if XASH_SSE2
+#include <emmintrin.h>
+#endif
 typedef struct wadlist_s
 {
 	char			wadnames[MAX_MAP_WADS][32];
@@ -41,6 +44,52 @@ typedef struct leaflist_s
 	int			topnode;		// for overflows where each leaf can't be stored individually
 } leaflist_t;
 
+#define IDBSPCACHEHEADER	(('C'<<24)+('P'<<16)+('S'<<8)+'B') // little-endian "BSPC"
+#define BSPCACHE_VERSION	1
+#define BSPCACHE_ALIGN	16
+
+// preprocessed surface data, stored in the cache file
+typedef struct
+{
+	short			texturemins[2];
+	short			extents[2];
+	short			lightmapmins[2];
+	short			lightextents[2];
+	float			lmvecs[2][4];
+	vec3_t			mins, maxs;
+	vec3_t			origin;
+
+	// face bevel
+	vec3_t			bevelorigin;
+	float			bevelradius;
+	int			bevelcontents;
+	int			firstbevel;	// index into bevel planes
+	int			numbevels;
+} dcachesurf_t;
+
+typedef struct
+{
+	int			fileofs;		// remapped mclipnode_t array
+	int			count;		// -1 if hull wasn't built
+} dcachehull_t;
+
+// all the data is addressed by offsets from the start of file
+// so it can be used in-place right after the reading
+typedef struct
+{
+	int			ident;
+	int			version;
+	dword			checksum;		// source lumps and hull sizes
+	int			planesize;	// sizeof( mplane_t )
+	int			clipnodesize;	// sizeof( mclipnode_t )
+	int			numsurfaces;
+	int			numsubmodels;
+	dlump_t			surfaces;		// dcachesurf_t
+	dlump_t			bevels;		// mplane_t
+	dlump_t			hulls;		// dcachehull_t[numsubmodels][MAX_MAP_HULLS]
+	dlump_t			clipnodes;	// mclipnode_t
+} dcacheheader_t;
+
 typedef struct
 {
 	// generic lumps
@@ -129,6 +178,15 @@ typedef struct
 	byte			*shadowdata_out;	// occlusion data pointer
 	dclipnode32_t		*clipnodes_out;	// temporary 32-bit array to hold clipnodes
 
+	// preprocessed data cache
+	dcachesurf_t		*cachesurfs;	// NULL if cache is missed
+	mplane_t			*cachebevels;
+	dcachehull_t		*cachehulls;
+	byte			*cachebase;	// cache file contents
+	mfacebevel_t		*cachebevels_out;	// bevels that linked with cached planes
+	hull_t			*hulls_out;	// submodel hulls to write into the cache
+	dword			cachecrc;
+
 	// misc stuff
 	wadlist_t			wadlist;
 	int			lightmap_samples;	// samples per lightmap (1 or 3)
@@ -173,11 +231,30 @@ typedef struct
 	size_t		*count;
 } mlumpinfo_t;
 
+// decompressed pvs rows of the world clusters. the whole matrix
+// when it fits into mod_pvscache megabytes, rows recycled by clock
+// algorithm otherwise
+typedef struct
+{
+	byte		*rows;
+	int		*rowcluster;	// cluster held by the row, -1 if unused
+	int		*clusterrow;	// row of the cluster, -1 if not decompressed
+	byte		*referenced;	// second chance for the clock hand
+	int		numclusters;
+	int		numrows;
+	int		hand;
+	size_t		rowbytes;
+	size_t		hits;
+	size_t		misses;
+	size_t		evictions;
+} mpvscache_t;
+
 world_static_t		world;
 static dbspmodel_t		srcmodel;
 static loadstat_t		loadstat;
 static model_t		*worldmodel;
 static byte		g_visdata[(MAX_MAP_LEAFS+7)/8];	// intermediate buffer
+static mpvscache_t		pvscache;
 static mlumpstat_t		worldstats[HEADER_LUMPS+EXTRA_LUMPS];
 static mlumpinfo_t		srclumps[HEADER_LUMPS] =
 {
@@ -448,28 +525,24 @@ void Mod_PrintWorldStats_f( void )
 */
 /*
 ===================
-Mod_DecompressPVS
+Mod_DecompressVis
+
+never writes beyond visbytes, even if the data is broken
 ===================
 */
-byte *Mod_DecompressPVS( const byte *in, int visbytes )
+static void Mod_DecompressVis( const byte *in, byte *out, int visbytes )
 {
-	byte	*out;
+	byte	*end = out + visbytes;
 	int	c;
 
-	out = g_visdata;
-
 	if( !in )
 	{
 		// no vis info, so make all visible
-		while( visbytes )
-		{
-			*out++ = 0xff;
-			visbytes--;
-		}
-		return g_visdata;
+		memset( out, 0xFF, visbytes );
+		return;
 	}
 
-	do
+	while( out < end )
 	{
 		if( *in )
 		{
@@ -477,19 +550,162 @@ byte *Mod_DecompressPVS( const byte *in, int visbytes )
 			continue;
 		}
 
-		c = in[1];
+		c = Q_min( in[1], end - out );
 		in += 2;
 
-		while( c )
-		{
-			*out++ = 0;
-			c--;
-		}
-	} while( out - g_visdata < visbytes );
+		memset( out, 0, c );
+		out += c;
+	}
+}
+
+/*
+===================
+Mod_DecompressPVS
+===================
+*/
+byte *Mod_DecompressPVS( const byte *in, int visbytes )
+{
+	Mod_DecompressVis( in, g_visdata, visbytes );
 
 	return g_visdata;
 }
 
+/*
+===================
+Mod_InitPVSCache
+===================
+*/
+static void Mod_InitPVSCache( model_t *mod, int numclusters )
+{
+	size_t	limit, rowbytes;
+	int	i, numrows;
+
+	memset( &pvscache, 0, sizeof( pvscache ));
+
+	if( !mod->visdata || numclusters <= 0 || mod_pvscache->value <= 0.0f )
+		return;
+
+	// padded for the wide loads in Mod_OrVisRow
+	rowbytes = ( world.visbytes + 15 ) & ~15;
+	limit = (size_t)( mod_pvscache->value * 1024.0f * 1024.0f );
+	numrows = (int)Q_min( (size_t)numclusters, Q_max( limit / rowbytes, 64 ));
+
+	pvscache.rowbytes = rowbytes;
+	pvscache.numrows = numrows;
+	pvscache.numclusters = numclusters;
+	pvscache.rows = Mem_Calloc( mod->mempool, numrows * rowbytes );
+	pvscache.rowcluster = Mem_Malloc( mod->mempool, numrows * sizeof( int ));
+	pvscache.clusterrow = Mem_Malloc( mod->mempool, numclusters * sizeof( int ));
+	pvscache.referenced = Mem_Calloc( mod->mempool, numrows );
+
+	for( i = 0; i < numrows; i++ )
+		pvscache.rowcluster[i] = -1;
+
+	for( i = 0; i < numclusters; i++ )
+		pvscache.clusterrow[i] = -1;
+}
+
+/*
+===================
+Mod_LeafPVS
+
+decompressed pvs of the world leaf, valid until the
+next call, like the one from Mod_DecompressPVS
+===================
+*/
+static byte *Mod_LeafPVS( mleaf_t *leaf )
+{
+	mpvscache_t	*pc = &pvscache;
+	int		row;
+
+	if( !pc->rows || leaf->cluster < 0 || leaf->cluster >= pc->numclusters )
+		return Mod_DecompressPVS( leaf->compressed_vis, world.visbytes );
+
+	row = pc->clusterrow[leaf->cluster];
+
+	if( row >= 0 )
+	{
+		pc->referenced[row] = true;
+		pc->hits++;
+		return pc->rows + row * pc->rowbytes;
+	}
+
+	// advance the clock hand up to the row without a second chance
+	while( pc->referenced[pc->hand] )
+	{
+		pc->referenced[pc->hand] = false;
+		pc->hand = ( pc->hand + 1 ) % pc->numrows;
+	}
+
+	row = pc->hand;
+	pc->hand = ( pc->hand + 1 ) % pc->numrows;
+
+	if( pc->rowcluster[row] >= 0 )
+	{
+		pc->clusterrow[pc->rowcluster[row]] = -1;
+		pc->evictions++;
+	}
+
+	pc->rowcluster[row] = leaf->cluster;
+	pc->clusterrow[leaf->cluster] = row;
+	pc->referenced[row] = true;
+	pc->misses++;
+
+	Mod_DecompressVis( leaf->compressed_vis, pc->rows + row * pc->rowbytes, world.visbytes );
+
+	return pc->rows + row * pc->rowbytes;
+}
+
+/*
+===================
+Mod_OrVisRow
+===================
+*/
+static void Mod_OrVisRow( byte *out, const byte *in, int bytes )
+{
+	int	i = 0;
+
+#if XASH_SSE2
+	for( ; i + 16 <= bytes; i += 16 )
+	{
+		__m128i	a = _mm_loadu_si128( (const __m128i *)( out + i ));
+		__m128i	b = _mm_loadu_si128( (const __m128i *)( in + i ));
+		_mm_storeu_si128( (__m128i *)( out + i ), _mm_or_si128( a, b ));
+	}
+#endif
+	for( ; i < bytes; i++ )
+		out[i] |= in[i];
+}
+
+/*
+===================
+Mod_PrintPVSCacheStats_f
+===================
+*/
+void Mod_PrintPVSCacheStats_f( void )
+{
+	mpvscache_t	*pc = &pvscache;
+	size_t		lookups = pc->hits + pc->misses;
+	size_t		memory;
+
+	if( !pc->rows )
+	{
+		Con_Printf( "pvs cache is not in use\n" );
+		return;
+	}
+
+	memory = pc->numrows * ( pc->rowbytes + sizeof( int ) + 1 ) + pc->numclusters * sizeof( int );
+
+	Con_Printf( "pvs cache: %i of %i clusters, %s, %s\n", pc->numrows, pc->numclusters,
+		pc->numrows == pc->numclusters ? "whole matrix" : "clock eviction", Q_memprint( memory ));
+	Con_Printf( "%lu lookups, %lu hits, %lu misses, %lu evictions\n", lookups, pc->hits, pc->misses, pc->evictions );
+
+	if( lookups )
+		Con_Printf( "hit rate %.1f%%\n", pc->hits * 100.0 / lookups );
+
+	pc->hits = pc->misses = pc->evictions = 0;
+}
+
 /*
 ==================
 Mod_PointInLeaf
@@ -539,7 +755,7 @@ byte *Mod_GetPVSForPoint( const vec3_t p )
 	}
 
 	if( leaf && leaf->cluster >= 0 )
-		return Mod_DecompressPVS( leaf->compressed_vis, world.visbytes );
+		return Mod_LeafPVS( leaf );
 	return NULL;
 }
 
@@ -551,8 +767,6 @@ Mod_FatPVS_RecursiveBSPNode
 */
 static void Mod_FatPVS_RecursiveBSPNode( const vec3_t org, float radius, byte *visbuffer, int visbytes, mnode_t *node )
 {
-	int	i;
-
 	while( node->contents >= 0 )
 	{
 		float d = PlaneDiff( org, node->plane );
@@ -571,12 +785,7 @@ static void Mod_FatPVS_RecursiveBSPNode( const vec3_t org, float radius, byte *v
 
 	// if this leaf is in a cluster, accumulate the vis bits
 	if(((mleaf_t *)node)->cluster >= 0 )
-	{
-		byte	*vis = Mod_DecompressPVS( ((mleaf_t *)node)->compressed_vis, world.visbytes );
-
-		for( i = 0; i < visbytes; i++ )
-			visbuffer[i] |= vis[i];
-	}
+		Mod_OrVisRow( visbuffer, Mod_LeafPVS( (mleaf_t *)node ), visbytes );
 }
 
 /*
@@ -1305,7 +1514,7 @@ static void Mod_MakeHull0( void )
 Mod_SetupHull
 =================
 */
-static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, byte *mempool, int headnode, int hullnum )
+static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, byte *mempool, int submodel, int headnode, int hullnum )
 {
 	hull_t	*hull = &mod->hulls[hullnum];
 	int	count;
@@ -1342,6 +1551,20 @@ static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, byte *mempool, int h
 	if( VectorIsNull( hull->clip_mins ) && VectorIsNull( hull->clip_maxs ))
 		return;	// no hull specified
 
+	if( bmod->cachehulls != NULL )
+	{
+		dcachehull_t	*in = &bmod->cachehulls[submodel * MAX_MAP_HULLS + hullnum];
+
+		if( in->count >= 0 )
+		{
+			// use already remapped clipnodes
+			hull->clipnodes = (mclipnode_t *)(bmod->cachebase + in->fileofs);
+			hull->lastclipnode = in->count;
+			hull->planes = mod->planes; // share planes
+			return;
+		}
+	}
+
 	CountClipNodes32_r( bmod->clipnodes_out, hull, headnode );
 	count = hull->lastclipnode;
 
@@ -1497,7 +1720,11 @@ static void Mod_SetupSubmodels( dbspmodel_t *bmod )
 
 		// but hulls1-3 is build individually for a each given submodel
 		for( j = 1; j < MAX_MAP_HULLS; j++ )
-			Mod_SetupHull( bmod, mod, mempool, bm->headnode[j], j );
+			Mod_SetupHull( bmod, mod, mempool, i, bm->headnode[j], j );
+
+		// keep the hulls to store them into the cache
+		if( bmod->hulls_out != NULL )
+			memcpy( &bmod->hulls_out[i * MAX_MAP_HULLS], mod->hulls, sizeof( mod->hulls ));
 
 		mod->firstmodelsurface = bm->firstface;
 		mod->nummodelsurfaces = bm->numfaces;
@@ -1559,6 +1786,357 @@ static void Mod_SetupSubmodels( dbspmodel_t *bmod )
 		Mem_Free( bmod->clipnodes_out );
 }
 
+/*
+===============================================================================
+
+			BSP CACHE
+
+===============================================================================
+*/
+/*
+=================
+Mod_BspCachePath
+=================
+*/
+static void Mod_BspCachePath( char *path, size_t size )
+{
+	char	modelname[64];
+
+	COM_FileBase( loadmodel->name, modelname );
+	Q_snprintf( path, size, "maps/cache/%s.bspc", modelname );
+}
+
+/*
+=================
+Mod_BspCacheChecksum
+
+checksum all the source data
+that preprocessing depends on
+=================
+*/
+static dword Mod_BspCacheChecksum( dbspmodel_t *bmod, const byte *mod_base )
+{
+	const int	lumps[] = { LUMP_PLANES, LUMP_VERTEXES, LUMP_TEXINFO, LUMP_FACES, LUMP_CLIPNODES, LUMP_EDGES, LUMP_SURFEDGES, LUMP_MODELS };
+	dheader_t	*header = (dheader_t *)mod_base;
+	dword	crc;
+	int	i;
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, &header->version, sizeof( header->version ));
+
+	for( i = 0; i < ARRAYSIZE( lumps ); i++ )
+	{
+		dlump_t	*l = &header->lumps[lumps[i]];
+
+		if( l->filelen > 0 )
+			CRC32_ProcessBuffer( &crc, mod_base + l->fileofs, l->filelen );
+	}
+
+	if( bmod->numfaceinfo > 0 )
+		CRC32_ProcessBuffer( &crc, bmod->faceinfo, bmod->numfaceinfo * sizeof( dfaceinfo_t ));
+
+	// face contents are determined by texture names
+	for( i = 0; i < loadmodel->numtextures; i++ )
+	{
+		if( loadmodel->textures[i] != NULL )
+			CRC32_ProcessBuffer( &crc, loadmodel->textures[i]->name, sizeof( loadmodel->textures[i]->name ));
+	}
+
+	// clipping hulls are not built when sizes are missed
+	CRC32_ProcessBuffer( &crc, host.player_mins, sizeof( host.player_mins ));
+	CRC32_ProcessBuffer( &crc, host.player_maxs, sizeof( host.player_maxs ));
+
+	return CRC32_Final( crc );
+}
+
+/*
+=================
+Mod_CheckCacheLump
+=================
+*/
+static qboolean Mod_CheckCacheLump( const dlump_t *l, fs_offset_t filesize, size_t entrysize, size_t count )
+{
+	if( l->fileofs < (int)sizeof( dcacheheader_t ) || ( l->fileofs % BSPCACHE_ALIGN ))
+		return false;
+
+	if( l->filelen < 0 || l->fileofs + (fs_offset_t)l->filelen > filesize )
+		return false;
+
+	if( count != -1 && l->filelen != count * entrysize )
+		return false;
+
+	return ( l->filelen % entrysize ) == 0;
+}
+
+/*
+=================
+Mod_LoadBspCache
+
+read preprocessed data if it's actual
+=================
+*/
+static qboolean Mod_LoadBspCache( dbspmodel_t *bmod, const byte *mod_base )
+{
+	dcacheheader_t	*header;
+	fs_offset_t	filesize;
+	char		path[MAX_QPATH];
+	dcachesurf_t	*surf;
+	dcachehull_t	*hull;
+	file_t		*f;
+	byte		*in;
+	int		i, numclipnodes;
+
+	if( !bmod->isworld || !CVAR_TO_BOOL( mod_bspcache ))
+		return false;
+
+	bmod->cachecrc = Mod_BspCacheChecksum( bmod, mod_base );
+	Mod_BspCachePath( path, sizeof( path ));
+
+	if( !( f = FS_Open( path, "rb", true )))
+		return false;
+
+	filesize = FS_FileLength( f );
+
+	if( filesize < sizeof( dcacheheader_t ))
+	{
+		FS_Close( f );
+		return false;
+	}
+
+	// cache data is kept in the model pool and used in-place
+	in = Mem_Malloc( loadmodel->mempool, filesize );
+
+	if( FS_Read( f, in, filesize ) != filesize )
+	{
+		FS_Close( f );
+		Mem_Free( in );
+		return false;
+	}
+
+	FS_Close( f );
+	header = (dcacheheader_t *)in;
+
+	if( header->ident != IDBSPCACHEHEADER || header->version != BSPCACHE_VERSION || header->checksum != bmod->cachecrc )
+		goto outdated;
+
+	if( header->planesize != sizeof( mplane_t ) || header->clipnodesize != sizeof( mclipnode_t ))
+		goto outdated;
+
+	if( header->numsurfaces != bmod->numsurfaces || header->numsubmodels != bmod->numsubmodels )
+		goto outdated;
+
+	if( !Mod_CheckCacheLump( &header->surfaces, filesize, sizeof( dcachesurf_t ), bmod->numsurfaces )
+		|| !Mod_CheckCacheLump( &header->bevels, filesize, sizeof( mplane_t ), -1 )
+		|| !Mod_CheckCacheLump( &header->hulls, filesize, sizeof( dcachehull_t ), bmod->numsubmodels * MAX_MAP_HULLS )
+		|| !Mod_CheckCacheLump( &header->clipnodes, filesize, sizeof( mclipnode_t ), -1 ))
+		goto outdated;
+
+	// validate clipnode ranges
+	hull = (dcachehull_t *)(in + header->hulls.fileofs);
+	numclipnodes = header->clipnodes.filelen / sizeof( mclipnode_t );
+
+	for( i = 0; i < bmod->numsubmodels * MAX_MAP_HULLS; i++, hull++ )
+	{
+		if( hull->count < 0 )
+			continue;
+
+		if( hull->fileofs < header->clipnodes.fileofs || hull->count > numclipnodes
+			|| (( hull->fileofs - header->clipnodes.fileofs ) % sizeof( mclipnode_t ))
+			|| hull->fileofs + hull->count * sizeof( mclipnode_t ) > header->clipnodes.fileofs + header->clipnodes.filelen )
+			goto outdated;
+	}
+
+	// validate bevel ranges
+	surf = (dcachesurf_t *)(in + header->surfaces.fileofs);
+
+	for( i = 0; i < bmod->numsurfaces; i++, surf++ )
+	{
+		if( surf->firstbevel < 0 || surf->numbevels < 0
+			|| ( surf->firstbevel + surf->numbevels ) * sizeof( mplane_t ) > header->bevels.filelen )
+			goto outdated;
+	}
+
+	bmod->cachebase = in;
+	bmod->cachesurfs = (dcachesurf_t *)(in + header->surfaces.fileofs);
+	bmod->cachebevels = (mplane_t *)(in + header->bevels.fileofs);
+	bmod->cachehulls = (dcachehull_t *)(in + header->hulls.fileofs);
+	bmod->cachebevels_out = Mem_Calloc( loadmodel->mempool, bmod->numsurfaces * sizeof( mfacebevel_t ));
+
+	Con_Reportf( "%s: using preprocessed data from %s\n", loadmodel->name, path );
+
+	return true;
+
+outdated:
+	Con_Reportf( "%s: %s is outdated\n", loadmodel->name, path );
+	Mem_Free( in );
+
+	return false;
+}
+
+/*
+=================
+Mod_LoadCachedSurface
+
+replaces Mod_CalcSurfaceBounds,
+Mod_CalcSurfaceExtents and Mod_CreateFaceBevels
+=================
+*/
+static void Mod_LoadCachedSurface( dbspmodel_t *bmod, msurface_t *surf )
+{
+	int		surfnum = surf - loadmodel->surfaces;
+	dcachesurf_t	*in = &bmod->cachesurfs[surfnum];
+	mfacebevel_t	*fb = &bmod->cachebevels_out[surfnum];
+	mextrasurf_t	*info = surf->info;
+	int		i;
+
+	for( i = 0; i < 2; i++ )
+	{
+		surf->texturemins[i] = in->texturemins[i];
+		surf->extents[i] = in->extents[i];
+		info->lightmapmins[i] = in->lightmapmins[i];
+		info->lightextents[i] = in->lightextents[i];
+	}
+
+	memcpy( info->lmvecs, in->lmvecs, sizeof( info->lmvecs ));
+	VectorCopy( in->mins, info->mins );
+	VectorCopy( in->maxs, info->maxs );
+	VectorCopy( in->origin, info->origin );
+
+	// bevel planes are shared with cache
+	fb->edges = bmod->cachebevels + in->firstbevel;
+	fb->numedges = in->numbevels;
+	VectorCopy( in->bevelorigin, fb->origin );
+	fb->radius = in->bevelradius;
+	fb->contents = in->bevelcontents;
+	info->bevel = fb;
+}
+
+/*
+=================
+Mod_SaveBspCache
+
+write preprocessed data for the next loading
+=================
+*/
+static void Mod_SaveBspCache( dbspmodel_t *bmod )
+{
+	size_t		filesize, numbevels = 0, numclipnodes = 0;
+	dcacheheader_t	*header;
+	char		path[MAX_QPATH];
+	dcachesurf_t	*outsurf;
+	dcachehull_t	*outhull;
+	mplane_t		*outbevel;
+	mclipnode_t	*outclip;
+	msurface_t	*surf;
+	hull_t		*hull;
+	byte		*out;
+	int		i;
+
+	if( !bmod->hulls_out )
+		return;
+
+	surf = loadmodel->surfaces;
+
+	for( i = 0; i < loadmodel->numsurfaces; i++, surf++ )
+	{
+		if( surf->info->bevel )
+			numbevels += surf->info->bevel->numedges;
+	}
+
+	hull = bmod->hulls_out;
+
+	for( i = 0; i < bmod->numsubmodels * MAX_MAP_HULLS; i++, hull++ )
+	{
+		if( i % MAX_MAP_HULLS && hull->planes != NULL )
+			numclipnodes += hull->lastclipnode;
+	}
+
+	filesize = ALIGN( sizeof( dcacheheader_t ), BSPCACHE_ALIGN );
+	filesize += ALIGN( loadmodel->numsurfaces * sizeof( dcachesurf_t ), BSPCACHE_ALIGN );
+	filesize += ALIGN( numbevels * sizeof( mplane_t ), BSPCACHE_ALIGN );
+	filesize += ALIGN( bmod->numsubmodels * MAX_MAP_HULLS * sizeof( dcachehull_t ), BSPCACHE_ALIGN );
+	filesize += numclipnodes * sizeof( mclipnode_t );
+
+	out = Z_Calloc( filesize );
+	header = (dcacheheader_t *)out;
+	header->ident = IDBSPCACHEHEADER;
+	header->version = BSPCACHE_VERSION;
+	header->checksum = bmod->cachecrc;
+	header->planesize = sizeof( mplane_t );
+	header->clipnodesize = sizeof( mclipnode_t );
+	header->numsurfaces = loadmodel->numsurfaces;
+	header->numsubmodels = bmod->numsubmodels;
+
+	header->surfaces.fileofs = ALIGN( sizeof( dcacheheader_t ), BSPCACHE_ALIGN );
+	header->surfaces.filelen = loadmodel->numsurfaces * sizeof( dcachesurf_t );
+	header->bevels.fileofs = ALIGN( header->surfaces.fileofs + header->surfaces.filelen, BSPCACHE_ALIGN );
+	header->bevels.filelen = numbevels * sizeof( mplane_t );
+	header->hulls.fileofs = ALIGN( header->bevels.fileofs + header->bevels.filelen, BSPCACHE_ALIGN );
+	header->hulls.filelen = bmod->numsubmodels * MAX_MAP_HULLS * sizeof( dcachehull_t );
+	header->clipnodes.fileofs = ALIGN( header->hulls.fileofs + header->hulls.filelen, BSPCACHE_ALIGN );
+	header->clipnodes.filelen = numclipnodes * sizeof( mclipnode_t );
+
+	outsurf = (dcachesurf_t *)(out + header->surfaces.fileofs);
+	outbevel = (mplane_t *)(out + header->bevels.fileofs);
+	surf = loadmodel->surfaces;
+	numbevels = 0;
+
+	for( i = 0; i < loadmodel->numsurfaces; i++, surf++, outsurf++ )
+	{
+		mextrasurf_t	*info = surf->info;
+		mfacebevel_t	*fb = info->bevel;
+		int		j;
+
+		for( j = 0; j < 2; j++ )
+		{
+			outsurf->texturemins[j] = surf->texturemins[j];
+			outsurf->extents[j] = surf->extents[j];
+			outsurf->lightmapmins[j] = info->lightmapmins[j];
+			outsurf->lightextents[j] = info->lightextents[j];
+		}
+
+		memcpy( outsurf->lmvecs, info->lmvecs, sizeof( outsurf->lmvecs ));
+		VectorCopy( info->mins, outsurf->mins );
+		VectorCopy( info->maxs, outsurf->maxs );
+		VectorCopy( info->origin, outsurf->origin );
+		outsurf->firstbevel = numbevels;
+
+		if( !fb ) continue; // bad surface
+
+		VectorCopy( fb->origin, outsurf->bevelorigin );
+		outsurf->bevelradius = fb->radius;
+		outsurf->bevelcontents = fb->contents;
+		outsurf->numbevels = fb->numedges;
+		memcpy( outbevel + numbevels, fb->edges, fb->numedges * sizeof( mplane_t ));
+		numbevels += fb->numedges;
+	}
+
+	outhull = (dcachehull_t *)(out + header->hulls.fileofs);
+	outclip = (mclipnode_t *)(out + header->clipnodes.fileofs);
+	hull = bmod->hulls_out;
+
+	for( i = 0; i < bmod->numsubmodels * MAX_MAP_HULLS; i++, hull++, outhull++ )
+	{
+		// hull 0 is shared and built from nodes
+		if( !( i % MAX_MAP_HULLS ) || hull->planes == NULL )
+		{
+			outhull->count = -1;
+			continue;
+		}
+
+		outhull->fileofs = (byte *)outclip - out;
+		outhull->count = hull->lastclipnode;
+		memcpy( outclip, hull->clipnodes, hull->lastclipnode * sizeof( mclipnode_t ));
+		outclip += hull->lastclipnode;
+	}
+
+	Mod_BspCachePath( path, sizeof( path ));
+
+	if( FS_WriteFile( path, out, filesize ))
+		Con_Reportf( "%s: preprocessed data saved to %s\n", loadmodel->name, path );
+	Mem_Free( out );
+}
+
 /*
 ===============================================================================
 
@@ -2341,9 +2919,16 @@ static void Mod_LoadSurfaces( dbspmodel_t *bmod )
 		if( FBitSet( out->texinfo->flags, TEX_SPECIAL ))
 			SetBits( out->flags, SURF_DRAWTILED );
 
-		Mod_CalcSurfaceBounds( out );
-		Mod_CalcSurfaceExtents( out );
-		Mod_CreateFaceBevels( out );
+		if( bmod->cachesurfs != NULL )
+		{
+			Mod_LoadCachedSurface( bmod, out );
+		}
+		else
+		{
+			Mod_CalcSurfaceBounds( out );
+			Mod_CalcSurfaceExtents( out );
+			Mod_CreateFaceBevels( out );
+		}
 
 		// grab the second sample to detect colored lighting
 		if( test_lightsize > 0 && lightofs != -1 )
@@ -2815,6 +3400,11 @@ qboolean Mod_LoadBmodelLumps( const byte *mod_base, qboolean isworld )
 	Mod_LoadTextures( bmod );
 	Mod_LoadVisibility( bmod );
 	Mod_LoadTexInfo( bmod );
+
+	// trying to skip the preprocessing
+	if( !Mod_LoadBspCache( bmod, mod_base ) && isworld && CVAR_TO_BOOL( mod_bspcache ))
+		bmod->hulls_out = Mem_Calloc( loadmodel->mempool, bmod->numsubmodels * MAX_MAP_HULLS * sizeof( hull_t ));
+
 	Mod_LoadSurfaces( bmod );
 	Mod_LoadLighting( bmod );
 	Mod_LoadMarkSurfaces( bmod );
@@ -2836,6 +3426,12 @@ qboolean Mod_LoadBmodelLumps( const byte *mod_base, qboolean isworld )
 #endif // XASH_DEDICATED
 	}
 
+	if( bmod->hulls_out != NULL )
+	{
+		Mod_SaveBspCache( bmod );
+		Mem_Free( bmod->hulls_out );
+	}
+
 	for( i = 0; i < bmod->wadlist.count; i++ )
 	{
 		if( !bmod->wadlist.wadusage[i] )
@@ -2937,11 +3533,18 @@ void Mod_LoadBrushModel( model_t *mod, const void *buffer, qboolean *loaded )
 	loadmodel->mempool = Mem_AllocPool( va( "^2%s^7", loadmodel->name ));
 	loadmodel->type = mod_brush;
 
+	// rows of the previous world are gone with its mempool
+	if( world.loading ) memset( &pvscache, 0, sizeof( pvscache ));
+
 	// loading all the lumps into heap
 	if( !Mod_LoadBmodelLumps( buffer, world.loading ))
 		return; // there were errors
 
-	if( world.loading ) worldmodel = mod;
+	if( world.loading )
+	{
+		worldmodel = mod;
+		Mod_InitPVSCache( mod, mod->submodels[0].visleafs );
+	}
 
 	if( loaded ) *loaded = true;	// all done
 }
@@ -120,8 +120,10 @@ extern world_static_t	world;
 extern byte		*com_studiocache;
 extern model_t		*loadmodel;
 extern convar_t		*mod_studiocache;
+extern convar_t		*mod_pvscache;
 extern convar_t		*r_wadtextures;
 extern convar_t		*r_showhull;
+extern convar_t		*mod_bspcache;
 
 //
 // model.c
@@ -160,6 +162,7 @@ mleaf_t *Mod_PointInLeaf( const vec3_t p, mnode_t *node );
 void Mod_AmbientLevels( const vec3_t p, byte *pvolumes );
 int Mod_SampleSizeForFace( msurface_t *surf );
 byte *Mod_GetPVSForPoint( const vec3_t p );
+void Mod_PrintPVSCacheStats_f( void );
 void Mod_UnloadBrushModel( model_t *mod );
 void Mod_PrintWorldStats_f( void );
 
@@ -190,6 +193,9 @@ void *R_StudioGetAnim( studiohdr_t *m_pStudioHeader, model_t *m_pSubModel, mstud
 void Mod_StudioComputeBounds( void *buffer, vec3_t mins, vec3_t maxs, qboolean ignore_sequences );
 int Mod_HitgroupForStudioHull( int index );
 void Mod_ClearStudioCache( void );
+void Mod_InitStudioCache( void );
+void Mod_StudioCacheNewFrame( void );
+void Mod_HitboxBench_f( void );
 
 //
 // mod_sprite.c
@@ -22,6 +22,11 @@ GNU General Public License for more details.
 
 typedef int (*STUDIOAPI)( int, sv_blending_interface_t**, server_studio_api_t*,  float (*transform)[3][4], float (*bones)[MAXSTUDIOBONES][3][4] );
 
+static void SV_StudioSetupBones( model_t *pModel, float frame, int sequence, const vec3_t angles, const vec3_t origin,
+	const byte *pcontroller, const byte *pblending, int iBone, const edict_t *pEdict );
+static void Mod_StudioSetupBoneList( model_t *pModel, float frame, int sequence, const vec3_t angles, const vec3_t origin,
+	const byte *pcontroller, const byte *pblending, const int *boneused, int numbones );
+
 typedef struct mstudiocache_s
 {
 	float	frame;
@@ -35,29 +40,47 @@ typedef struct mstudiocache_s
 	uint	current_hull;
 	uint	current_plane;
 	uint	numhitboxes;
+	uint	hash;
+	uint	generation;	// entries of the older generations are free
 } mstudiocache_t;
 
-#define STUDIO_CACHESIZE		16
-#define STUDIO_CACHEMASK		(STUDIO_CACHESIZE - 1)
+typedef struct
+{
+	size_t	lookups;
+	size_t	hits;
+	size_t	probes;
+	size_t	overflows;	// generations started before the frame end
+	size_t	frames;
+} mstudiocachestats_t;
+
+#define STUDIO_CACHESIZE		256	// default capacity
+#define STUDIO_CACHE_HITBOXES		32	// hitboxes reserved per entry
 
 // trace global variables
 static sv_blending_interface_t	*pBlendAPI = NULL;
 static studiohdr_t			*mod_studiohdr;
 static matrix3x4			studio_transform;
-static hull_t			cache_hull[MAXSTUDIOBONES];
 static hull_t			studio_hull[MAXSTUDIOBONES];
 static matrix3x4			studio_bones[MAXSTUDIOBONES];
 static uint			studio_hull_hitgroup[MAXSTUDIOBONES];
-static uint			cache_hull_hitgroup[MAXSTUDIOBONES];
-static mstudiocache_t		cache_studio[STUDIO_CACHESIZE];
 static mclipnode_t			studio_clipnodes[6];
 static mplane_t			studio_planes[768];
-static mplane_t			cache_planes[768];
+static convar_t			*mod_studiocache_size;
+
+// hashed cache of hitbox hulls, open addressing, emptied every server frame
+static mstudiocache_t		*cache_studio;
+static mplane_t			*cache_planes;
+static uint			*cache_hull_hitgroup;
+static uint			cache_size;	// power of two, twice the capacity
+static uint			cache_capacity;
+static uint			cache_maxhulls;
+static uint			cache_generation;
+static mstudiocachestats_t	cache_stats;
 
 // current cache state
-static int			cache_current;
-static int			cache_current_hull;
-static int			cache_current_plane;
+static uint			cache_current;	// entries in this generation
+static uint			cache_current_hull;
+static uint			cache_current_plane;
 
 /*
 ====================
@@ -98,6 +121,58 @@ void Mod_InitStudioHull( void )
 
 ===============================================================================
 */
+/*
+====================
+StudioCacheNewGeneration
+====================
+*/
+static void Mod_StudioCacheNewGeneration( void )
+{
+	cache_generation++;
+
+	// very unlikely, wipe out the ancient entries
+	if( cache_generation == 0 )
+	{
+		if( cache_studio ) memset( cache_studio, 0, cache_size * sizeof( *cache_studio ));
+		cache_generation = 1;
+	}
+
+	cache_current = cache_current_hull = cache_current_plane = 0;
+}
+
+/*
+====================
+StudioCacheResize
+
+applies r_studiocache_size
+====================
+*/
+static void Mod_StudioCacheResize( void )
+{
+	uint	capacity, size;
+
+	capacity = bound( 16, mod_studiocache_size->value, 4096 );
+
+	if( cache_studio && capacity == cache_capacity )
+		return;
+
+	for( size = 1; size < capacity * 2; size <<= 1 );
+
+	if( cache_studio ) Mem_Free( cache_studio );
+	if( cache_planes ) Mem_Free( cache_planes );
+	if( cache_hull_hitgroup ) Mem_Free( cache_hull_hitgroup );
+
+	cache_capacity = capacity;
+	cache_size = size;
+	cache_maxhulls = Q_max( capacity * STUDIO_CACHE_HITBOXES, MAXSTUDIOBONES );
+	cache_studio = Mem_Calloc( host.mempool, cache_size * sizeof( *cache_studio ));
+	cache_planes = Mem_Malloc( host.mempool, cache_maxhulls * 6 * sizeof( *cache_planes ));
+	cache_hull_hitgroup = Mem_Malloc( host.mempool, cache_maxhulls * sizeof( *cache_hull_hitgroup ));
+
+	cache_generation = 0;
+	Mod_StudioCacheNewGeneration();
+}
+
 /*
 ====================
 ClearStudioCache
@@ -105,10 +180,61 @@ ClearStudioCache
 */
 void Mod_ClearStudioCache( void )
 {
-	memset( cache_studio, 0, sizeof( cache_studio ));
-	cache_current_hull = cache_current_plane = 0;
+	if( !mod_studiocache_size )
+		return; // not initialized yet
 
-	cache_current = 0;
+	Mod_StudioCacheResize();
+	Mod_StudioCacheNewGeneration();
+}
+
+/*
+====================
+StudioCacheNewFrame
+
+the server frame is over, bone setups of the next one are unlikely to repeat
+====================
+*/
+void Mod_StudioCacheNewFrame( void )
+{
+	if( !mod_studiocache_size || !mod_studiocache->value )
+		return;
+
+	Mod_StudioCacheResize();
+
+	if( cache_current )
+	{
+		Mod_StudioCacheNewGeneration();
+		cache_stats.frames++;
+	}
+}
+
+/*
+====================
+StudioCacheHash
+====================
+*/
+static uint Mod_StudioCacheHash( model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *controller, byte *blending )
+{
+	uint	hash = 2166136261U;
+	uint	key[13];
+	int	i;
+
+	memcpy( &key[0], &frame, sizeof( float ));
+	key[1] = (uint)sequence;
+	memcpy( &key[2], angles, sizeof( vec3_t ));
+	memcpy( &key[5], origin, sizeof( vec3_t ));
+	memcpy( &key[8], size, sizeof( vec3_t ));
+	key[11] = controller[0] | controller[1] << 8 | controller[2] << 16 | (uint)controller[3] << 24;
+	key[12] = blending[0] | blending[1] << 8 | (uint)((size_t)model >> 4) << 16;
+
+	for( i = 0; i < 13; i++ )
+	{
+		hash ^= key[i];
+		hash *= 16777619U;
+		hash ^= hash >> 15;
+	}
+
+	return hash;
 }
 
 /*
@@ -118,13 +244,23 @@ AddToStudioCache
 */
 void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *pcontroller, byte *pblending, model_t *model, hull_t *hull, int numhitboxes )
 {
-	mstudiocache_t *pCache;
+	mstudiocache_t	*pCache;
+	uint		hash, i;
 
-	if( numhitboxes + cache_current_hull >= MAXSTUDIOBONES )
-		Mod_ClearStudioCache();
+	if( numhitboxes <= 0 || numhitboxes > MAXSTUDIOBONES )
+		return;
 
-	cache_current++;
-	pCache = &cache_studio[cache_current & STUDIO_CACHEMASK];
+	if( cache_current >= cache_capacity || cache_current_hull + numhitboxes > cache_maxhulls )
+	{
+		Mod_StudioCacheNewGeneration();
+		cache_stats.overflows++;
+	}
+
+	hash = Mod_StudioCacheHash( model, frame, sequence, angles, origin, size, pcontroller, pblending );
+
+	// the table is never more than half full
+	for( i = hash & ( cache_size - 1 ); cache_studio[i].generation == cache_generation; i = ( i + 1 ) & ( cache_size - 1 ));
+	pCache = &cache_studio[i];
 
 	pCache->frame = frame;
 	pCache->sequence = sequence;
@@ -138,11 +274,13 @@ void Mod_AddToStudioCache( float frame, int sequence, vec3_t angles, vec3_t orig
 	pCache->model = model;
 	pCache->current_hull = cache_current_hull;
 	pCache->current_plane = cache_current_plane;
+	pCache->hash = hash;
+	pCache->generation = cache_generation;
 
-	memcpy( &cache_hull[cache_current_hull], hull, numhitboxes * sizeof( hull_t ));
 	memcpy( &cache_planes[cache_current_plane], studio_planes, numhitboxes * sizeof( mplane_t ) * 6 );
 	memcpy( &cache_hull_hitgroup[cache_current_hull], studio_hull_hitgroup, numhitboxes * sizeof( uint ));
 
+	cache_current++;
 	cache_current_hull += numhitboxes;
 	cache_current_plane += numhitboxes * 6;
 	pCache->numhitboxes = numhitboxes;
@@ -156,11 +294,18 @@ CheckStudioCache
 mstudiocache_t *Mod_CheckStudioCache( model_t *model, float frame, int sequence, vec3_t angles, vec3_t origin, vec3_t size, byte *controller, byte *blending )
 {
 	mstudiocache_t	*pCached;
-	int		i;
+	uint		hash, i;
+
+	cache_stats.lookups++;
+	hash = Mod_StudioCacheHash( model, frame, sequence, angles, origin, size, controller, blending );
 
-	for( i = 0; i < STUDIO_CACHESIZE; i++ )
+	for( i = hash & ( cache_size - 1 ); cache_studio[i].generation == cache_generation; i = ( i + 1 ) & ( cache_size - 1 ))
 	{
-		pCached = &cache_studio[(cache_current - i) & STUDIO_CACHEMASK];
+		pCached = &cache_studio[i];
+		cache_stats.probes++;
+
+		if( pCached->hash != hash )
+			continue;
 
 		if( pCached->model != model )
 			continue;
@@ -186,12 +331,48 @@ mstudiocache_t *Mod_CheckStudioCache( model_t *model, float frame, int sequence,
 		if( memcmp( pCached->blending, blending, 2 ) != 0 )
 			continue;
 
+		cache_stats.hits++;
 		return pCached;
 	}
 
 	return NULL;
 }
 
+/*
+====================
+Mod_StudioCacheStats_f
+====================
+*/
+static void Mod_StudioCacheStats_f( void )
+{
+	mstudiocachestats_t	*st = &cache_stats;
+
+	Con_Printf( "studio cache: %u entries, %u of them and %u of %u hitboxes used now\n",
+		cache_capacity, cache_current, cache_current_hull, cache_maxhulls );
+	Con_Printf( "%lu lookups, %lu hits, %lu frames, %lu overflows\n",
+		st->lookups, st->hits, st->frames, st->overflows );
+
+	if( st->lookups )
+	{
+		Con_Printf( "hit rate %.1f%%, %.2f probes per lookup\n",
+			st->hits * 100.0 / st->lookups, (double)st->probes / st->lookups );
+	}
+
+	memset( st, 0, sizeof( *st ));
+}
+
+/*
+====================
+InitStudioCache
+====================
+*/
+void Mod_InitStudioCache( void )
+{
+	mod_studiocache_size = Cvar_Get( "r_studiocache_size", va( "%i", STUDIO_CACHESIZE ), FCVAR_ARCHIVE, "studio cache capacity, in hitbox setups" );
+	Cmd_AddCommand( "studiocachestats", Mod_StudioCacheStats_f, "show studio cache hit rate" );
+	Mod_StudioCacheResize();
+}
+
 /*
 ===============================================================================
 
@@ -221,6 +402,44 @@ void Mod_SetStudioHullPlane( int planenum, int bone, int axis, float offset, con
 
 }
 
+/*
+====================
+StudioHitboxBones
+
+bones that carry hitboxes and their parents, children go first
+====================
+*/
+static int Mod_StudioHitboxBones( int *boneused )
+{
+	byte		used[MAXSTUDIOBONES];
+	mstudiobbox_t	*phitbox;
+	mstudiobone_t	*pbones;
+	int		i, numbones = 0;
+
+	phitbox = (mstudiobbox_t *)((byte *)mod_studiohdr + mod_studiohdr->hitboxindex);
+	pbones = (mstudiobone_t *)((byte *)mod_studiohdr + mod_studiohdr->boneindex);
+	memset( used, 0, sizeof( used ));
+
+	for( i = 0; i < mod_studiohdr->numhitboxes; i++ )
+	{
+		int	bone = phitbox[i].bone;
+
+		// parents are walked until the already marked one
+		while( bone >= 0 && bone < MAXSTUDIOBONES && !used[bone] )
+		{
+			used[bone] = true;
+			bone = pbones[bone].parent;
+		}
+	}
+
+	for( i = Q_min( mod_studiohdr->numbones, MAXSTUDIOBONES ) - 1; i >= 0; i-- )
+	{
+		if( used[i] ) boneused[numbones++] = i;
+	}
+
+	return numbones;
+}
+
 /*
 ====================
 HullForStudio
@@ -234,20 +453,21 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 	mstudiocache_t	*bonecache;
 	mstudiobbox_t	*phitbox;
 	qboolean		bSkipShield;
-	int		i, j;
+	int		boneused[MAXSTUDIOBONES];
+	int		i, j, numbones;
 
 	bSkipShield = false;
 	*numhitboxes = 0; // assume error
 
-	if( mod_studiocache->value )
+	if( mod_studiocache->value && cache_studio )
 	{
 		bonecache = Mod_CheckStudioCache( model, frame, sequence, angles, origin, size, pcontroller, pblending );
 
+		// studio_hull itself never changes, its planes do
 		if( bonecache != NULL )
 		{
 			memcpy( studio_planes, &cache_planes[bonecache->current_plane], bonecache->numhitboxes * sizeof( mplane_t ) * 6 );
 			memcpy( studio_hull_hitgroup, &cache_hull_hitgroup[bonecache->current_hull], bonecache->numhitboxes * sizeof( uint ));
-			memcpy( studio_hull, &cache_hull[bonecache->current_hull], bonecache->numhitboxes * sizeof( hull_t ));
 
 			*numhitboxes = bonecache->numhitboxes;
 			return studio_hull;
@@ -262,7 +482,15 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 	if( !FBitSet( host.features, ENGINE_COMPENSATE_QUAKE_BUG ))
 		angles2[PITCH] = -angles2[PITCH]; // stupid quake bug
 
-	pBlendAPI->SV_StudioSetupBones( model, frame, sequence, angles2, origin, pcontroller, pblending, -1, pEdict );
+	// builtin blending only needs the bones that hold hitboxes,
+	// the custom one is free to use all bones, give them all
+	if( pBlendAPI->SV_StudioSetupBones == SV_StudioSetupBones )
+	{
+		numbones = Mod_StudioHitboxBones( boneused );
+		Mod_StudioSetupBoneList( model, frame, sequence, angles2, origin, pcontroller, pblending, boneused, numbones );
+	}
+	else pBlendAPI->SV_StudioSetupBones( model, frame, sequence, angles2, origin, pcontroller, pblending, -1, pEdict );
+
 	phitbox = (mstudiobbox_t *)((byte *)mod_studiohdr + mod_studiohdr->hitboxindex);
 
 	if( SV_IsValidEdict( pEdict ) && pEdict->v.gamestate == 1 )
@@ -286,7 +514,7 @@ hull_t *Mod_HullForStudio( model_t *model, float frame, int sequence, vec3_t ang
 	// tell trace code about hitbox count
 	*numhitboxes = (bSkipShield) ? (mod_studiohdr->numhitboxes - 1) : (mod_studiohdr->numhitboxes);
 
-	if( mod_studiocache->value )
+	if( mod_studiocache->value && cache_studio )
 		Mod_AddToStudioCache( frame, sequence, angles, origin, size, pcontroller, pblending, model, studio_hull, *numhitboxes );
 
 	return studio_hull;
@@ -640,16 +868,37 @@ void *R_StudioGetAnim( studiohdr_t *m_pStudioHeader, model_t *m_pSubModel, mstud
 
 /*
 ====================
-StudioSetupBones
+StudioSlerpBoneList
 
-NOTE: pEdict is unused
+R_StudioSlerpBones for the listed bones only
 ====================
 */
-static void SV_StudioSetupBones( model_t *pModel,	float frame, int sequence, const vec3_t angles, const vec3_t origin,
-	const byte *pcontroller, const byte *pblending, int iBone, const edict_t *pEdict )
+static void Mod_StudioSlerpBoneList( const int *boneused, int numbones, vec4_t q1[], float pos1[][3], vec4_t q2[], float pos2[][3], float s )
 {
-	int		i, j, numbones = 0;
-	int		boneused[MAXSTUDIOBONES];
+	int	i, j;
+
+	s = bound( 0.0f, s, 1.0f );
+
+	for( j = 0; j < numbones; j++ )
+	{
+		i = boneused[j];
+		QuaternionSlerp( q1[i], q2[i], s, q1[i] );
+		VectorLerp( pos1[i], s, pos2[i], pos1[i] );
+	}
+}
+
+/*
+====================
+StudioSetupBoneList
+
+builds studio_bones for the listed bones, parents
+must be listed after their children
+====================
+*/
+static void Mod_StudioSetupBoneList( model_t *pModel, float frame, int sequence, const vec3_t angles, const vec3_t origin,
+	const byte *pcontroller, const byte *pblending, const int *boneused, int numbones )
+{
+	int		i, j;
 	float		f = 0.0;
 
 	mstudiobone_t	*pbones;
@@ -679,51 +928,35 @@ static void SV_StudioSetupBones( model_t *pModel,	float frame, int sequence, con
 	pbones = (mstudiobone_t *)((byte *)mod_studiohdr + mod_studiohdr->boneindex);
 	panim = R_StudioGetAnim( mod_studiohdr, pModel, pseqdesc );
 
-	if( iBone < -1 || iBone >= mod_studiohdr->numbones )
-		iBone = 0;
-
-	if( iBone == -1 )
-	{
-		numbones = mod_studiohdr->numbones;
-		for( i = 0; i < mod_studiohdr->numbones; i++ )
-			boneused[(numbones - i) - 1] = i;
-	}
-	else
-	{
-		// only the parent bones
-		for( i = iBone; i != -1; i = pbones[i].parent )
-			boneused[numbones++] = i;
-	}
-
 	if( pseqdesc->numframes > 1 )
 		f = ( frame * ( pseqdesc->numframes - 1 )) / 256.0f;
 
-	Mod_StudioCalcRotations( boneused, numbones, pcontroller, pos, q, pseqdesc, panim, f );
+	Mod_StudioCalcRotations( (int *)boneused, numbones, pcontroller, pos, q, pseqdesc, panim, f );
 
 	if( pseqdesc->numblends > 1 )
 	{
 		float	s;
 
 		panim += mod_studiohdr->numbones;
-		Mod_StudioCalcRotations( boneused, numbones, pcontroller, pos2, q2, pseqdesc, panim, f );
+		Mod_StudioCalcRotations( (int *)boneused, numbones, pcontroller, pos2, q2, pseqdesc, panim, f );
 
 		s = (float)pblending[0] / 255.0f;
 
-		R_StudioSlerpBones( mod_studiohdr->numbones, q, pos, q2, pos2, s );
+		Mod_StudioSlerpBoneList( boneused, numbones, q, pos, q2, pos2, s );
 
 		if( pseqdesc->numblends == 4 )
 		{
 			panim += mod_studiohdr->numbones;
-			Mod_StudioCalcRotations( boneused, numbones, pcontroller, pos3, q3, pseqdesc, panim, f );
+			Mod_StudioCalcRotations( (int *)boneused, numbones, pcontroller, pos3, q3, pseqdesc, panim, f );
 
 			panim += mod_studiohdr->numbones;
-			Mod_StudioCalcRotations( boneused, numbones, pcontroller, pos4, q4, pseqdesc, panim, f );
+			Mod_StudioCalcRotations( (int *)boneused, numbones, pcontroller, pos4, q4, pseqdesc, panim, f );
 
 			s = (float)pblending[0] / 255.0f;
-			R_StudioSlerpBones( mod_studiohdr->numbones, q3, pos3, q4, pos4, s );
+			Mod_StudioSlerpBoneList( boneused, numbones, q3, pos3, q4, pos4, s );
 
 			s = (float)pblending[1] / 255.0f;
-			R_StudioSlerpBones( mod_studiohdr->numbones, q, pos, q3, pos3, s );
+			Mod_StudioSlerpBoneList( boneused, numbones, q, pos, q3, pos3, s );
 		}
 	}
 
@@ -740,6 +973,140 @@ static void SV_StudioSetupBones( model_t *pModel,	float frame, int sequence, con
 	}
 }
 
+/*
+====================
+StudioSetupBones
+
+NOTE: pEdict is unused
+====================
+*/
+static void SV_StudioSetupBones( model_t *pModel,	float frame, int sequence, const vec3_t angles, const vec3_t origin,
+	const byte *pcontroller, const byte *pblending, int iBone, const edict_t *pEdict )
+{
+	int		i, numbones = 0;
+	int		boneused[MAXSTUDIOBONES];
+	mstudiobone_t	*pbones;
+
+	pbones = (mstudiobone_t *)((byte *)mod_studiohdr + mod_studiohdr->boneindex);
+
+	if( iBone < -1 || iBone >= mod_studiohdr->numbones )
+		iBone = 0;
+
+	if( iBone == -1 )
+	{
+		numbones = mod_studiohdr->numbones;
+		for( i = 0; i < mod_studiohdr->numbones; i++ )
+			boneused[(numbones - i) - 1] = i;
+	}
+	else
+	{
+		// only the parent bones
+		for( i = iBone; i != -1; i = pbones[i].parent )
+			boneused[numbones++] = i;
+	}
+
+	Mod_StudioSetupBoneList( pModel, frame, sequence, angles, origin, pcontroller, pblending, boneused, numbones );
+}
+
+/*
+====================
+Mod_HitboxBench_f
+
+time the bone setup of studio entities for hitbox
+traces, all bones against the hitbox bones only
+====================
+*/
+void Mod_HitboxBench_f( void )
+{
+	static matrix3x4	full[MAXSTUDIOBONES];
+	int		boneused[MAXSTUDIOBONES];
+	int		i, j, e, pass, count = 100;
+	int		numents = 0, mismatches = 0;
+	size_t		bones[2] = { 0, 0 };
+	double		time[2];
+	edict_t		*ent;
+	model_t		*mod;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "sv_hitboxbench: server is not active\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 )
+		count = Q_max( 1, Q_atoi( Cmd_Argv( 1 )));
+
+	for( pass = 0; pass < 2; pass++ )
+	{
+		time[pass] = Sys_DoubleTime();
+
+		for( i = 0; i < count; i++ )
+		{
+			for( e = 1; e < svgame.numEntities; e++ )
+			{
+				ent = EDICT_NUM( e );
+
+				if( !SV_IsValidEdict( ent ) || !( mod = SV_ModelHandle( ent->v.modelindex )) || mod->type != mod_studio )
+					continue;
+
+				mod_studiohdr = Mod_StudioExtradata( mod );
+				if( !mod_studiohdr || mod_studiohdr->numhitboxes <= 0 )
+					continue;
+
+				if( pass == 0 )
+				{
+					SV_StudioSetupBones( mod, ent->v.frame, ent->v.sequence, ent->v.angles, ent->v.origin, ent->v.controller, ent->v.blending, -1, ent );
+					bones[0] += mod_studiohdr->numbones;
+					continue;
+				}
+
+				j = Mod_StudioHitboxBones( boneused );
+				Mod_StudioSetupBoneList( mod, ent->v.frame, ent->v.sequence, ent->v.angles, ent->v.origin, ent->v.controller, ent->v.blending, boneused, j );
+				bones[1] += j;
+			}
+		}
+
+		time[pass] = Sys_DoubleTime() - time[pass];
+	}
+
+	// bones that hold hitboxes must come out the same
+	for( e = 1; e < svgame.numEntities; e++ )
+	{
+		ent = EDICT_NUM( e );
+
+		if( !SV_IsValidEdict( ent ) || !( mod = SV_ModelHandle( ent->v.modelindex )) || mod->type != mod_studio )
+			continue;
+
+		mod_studiohdr = Mod_StudioExtradata( mod );
+		if( !mod_studiohdr || mod_studiohdr->numhitboxes <= 0 )
+			continue;
+
+		SV_StudioSetupBones( mod, ent->v.frame, ent->v.sequence, ent->v.angles, ent->v.origin, ent->v.controller, ent->v.blending, -1, ent );
+		memcpy( full, studio_bones, sizeof( full ));
+
+		j = Mod_StudioHitboxBones( boneused );
+		Mod_StudioSetupBoneList( mod, ent->v.frame, ent->v.sequence, ent->v.angles, ent->v.origin, ent->v.controller, ent->v.blending, boneused, j );
+
+		for( i = 0; i < j; i++ )
+		{
+			if( memcmp( full[boneused[i]], studio_bones[boneused[i]], sizeof( matrix3x4 )))
+				mismatches++;
+		}
+		numents++;
+	}
+
+	if( !numents )
+	{
+		Con_Printf( "sv_hitboxbench: no studio entities with hitboxes\n" );
+		return;
+	}
+
+	Con_Printf( "%i entities, %.1f bones per setup, %.1f of them hold hitboxes\n", numents,
+		(double)bones[0] / ( numents * count ), (double)bones[1] / ( numents * count ));
+	Con_Printf( "all bones: %.2f usec, hitbox bones: %.2f usec per setup, %i mismatches\n",
+		time[0] * 1e6 / ( numents * count ), time[1] * 1e6 / ( numents * count ), mismatches );
+}
+
 /*
 ====================
 StudioGetAttachment
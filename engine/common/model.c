@@ -23,14 +23,17 @@ GNU General Public License for more details.
 #include "enginefeatures.h"
 #include "client.h"
 #include "server.h"
+#include "pm_local.h"
 
 static model_info_t	mod_crcinfo[MAX_MODELS];
 static model_t	mod_known[MAX_MODELS];
 static int	mod_numknown = 0;
 byte		*com_studiocache;		// cache for submodels
 convar_t		*mod_studiocache;
+convar_t		*mod_pvscache;
 convar_t		*r_wadtextures;
 convar_t		*r_showhull;
+convar_t		*mod_bspcache;
 model_t		*loadmodel;
 
 /*
@@ -116,6 +119,10 @@ void Mod_FreeModel( model_t *mod )
 		world.deluxedata = NULL;
 	}
 
+	// cached point contents refer to the hulls
+	if( mod->type == mod_brush )
+		PM_ClearContentsCache();
+
 	memset( mod, 0, sizeof( *mod ));
 }
 
@@ -137,12 +144,16 @@ void Mod_Init( void )
 	mod_studiocache = Cvar_Get( "r_studiocache", "1", FCVAR_ARCHIVE, "enables studio cache for speedup tracing hitboxes" );
 	r_wadtextures = Cvar_Get( "r_wadtextures", "0", 0, "completely ignore textures in the bsp-file if enabled" );
 	r_showhull = Cvar_Get( "r_showhull", "0", 0, "draw collision hulls 1-3" );
+	mod_bspcache = Cvar_Get( "mod_bspcache", "1", FCVAR_ARCHIVE, "store preprocessed map data in cache files to speedup loading" );
+	mod_pvscache = Cvar_Get( "mod_pvscache", "8", FCVAR_ARCHIVE, "megabytes of decompressed world pvs kept in memory, applied on map load" );
 
 	Cmd_AddCommand( "mapstats", Mod_PrintWorldStats_f, "show stats for currently loaded map" );
 	Cmd_AddCommand( "modellist", Mod_Modellist_f, "display loaded models list" );
+	Cmd_AddCommand( "pvscachestats", Mod_PrintPVSCacheStats_f, "show decompressed pvs cache hit rate and memory" );
 
 	Mod_ResetStudioAPI ();
 	Mod_InitStudioHull ();
+	Mod_InitStudioCache ();
 }
 
 /*
@@ -31,11 +31,16 @@ void PM_DrawBBox( const vec3_t mins, const vec3_t maxs, const vec3_t origin, int
 //
 void Pmove_Init( void );
 void PM_InitBoxHull( void );
+void PM_BuildBroadPhase( playermove_t *pmove );
+void PM_ClearBroadPhase( playermove_t *pmove );
 hull_t *PM_HullForBsp( physent_t *pe, playermove_t *pmove, float *offset );
 qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace );
 pmtrace_t PM_PlayerTraceExt( playermove_t *pm, vec3_t p1, vec3_t p2, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter );
 int PM_TestPlayerPosition( playermove_t *pmove, vec3_t pos, pmtrace_t *ptrace, pfnIgnore pmFilter );
 int PM_HullPointContents( hull_t *hull, int num, const vec3_t p );
+int PM_HullPointContentsCached( hull_t *hull, int num, const vec3_t p );
+void PM_ClearContentsCache( void );
+void PM_PrintContentsCacheStats( qboolean reset );
 int PM_TruePointContents( playermove_t *pmove, const vec3_t p );
 int PM_PointContents( playermove_t *pmove, const vec3_t p );
 void PM_ConvertTrace( trace_t *out, pmtrace_t *in, edict_t *ent );
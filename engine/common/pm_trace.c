@@ -28,6 +28,61 @@ static mplane_t	pm_boxplanes[6];
 static mclipnode_t	pm_boxclipnodes[6];
 static hull_t	pm_boxhull;
 
+// broad-phase over pmove physents, it's valid while
+// the game dll runs the player move and physents are frozen
+#define PM_BITWORDS		(( MAX_PHYSENTS + 31 ) >> 5 )
+
+typedef struct
+{
+	float		key;
+	int		ent;
+} pmsortent_t;
+
+typedef struct
+{
+	const physent_t	*ents;		// pmove->physents
+	int		numents;		// 0 is inactive
+	vec3_t		absmin[MAX_PHYSENTS];	// already expanded by any hull size
+	vec3_t		absmax[MAX_PHYSENTS];
+	vec3_t		origin[MAX_PHYSENTS];	// checked by pm_broadphase 2
+	pmsortent_t	sorted[MAX_PHYSENTS];	// boxed physents sorted by absmin[0]
+	int		numsorted;
+	uint		always[PM_BITWORDS];	// world, custom and hitbox physents
+} pmbroadphase_t;
+
+static pmbroadphase_t	pm_broadphase[2];	// client and server pmove
+
+// point contents of the static bsp hulls, memoized per cell of the grid.
+// cell that lies on one side of every plane down to a leaf keeps the
+// contents, otherwise it keeps the node where the planes begin to cut it
+#define PM_CONTENTS_CACHE	4096		// must be power of two
+#define PM_CONTENTS_CELL	16.0f
+#define PM_CONTENTS_RANGE	1048576.0f	// don't quantize points beyond this
+#define PM_CONTENTS_EPSILON	0.125f		// rounding slack for the non-axial planes
+
+typedef struct
+{
+	const hull_t	*hull;
+	int		num;		// start node of the query
+	int		cell[3];
+	int		result;		// contents if < 0, node to descend from otherwise
+	uint		generation;
+} pmcontents_t;
+
+typedef struct
+{
+	size_t		lookups;
+	size_t		leafhits;		// answered without planes
+	size_t		nodehits;		// descent started below the head node
+	size_t		misses;
+	size_t		uncached;
+} pmcontentsstats_t;
+
+static pmcontents_t		pm_contents[PM_CONTENTS_CACHE];
+static pmcontentsstats_t	pm_contentsstats;
+static uint		pm_contentsgen = 1;
+static convar_t		*pm_broadphase_mode;
+
 // default hullmins
 static const vec3_t pm_hullmins[MAX_MAP_HULLS] =
 {
@@ -50,6 +105,8 @@ void Pmove_Init( void )
 {
 	PM_InitBoxHull ();
 
+	pm_broadphase_mode = Cvar_Get( "pm_broadphase", "1", 0, "cull player traces by physent bounds, 2 also compares with the linear traces" );
+
 	// init default hull sizes
 	memcpy( host.player_mins, pm_hullmins, sizeof( pm_hullmins ));
 	memcpy( host.player_maxs, pm_hullmaxs, sizeof( pm_hullmaxs ));
@@ -137,6 +194,161 @@ int PM_HullPointContents( hull_t *hull, int num, const vec3_t p )
 	return num;
 }
 
+/*
+==================
+PM_ClearContentsCache
+
+hulls of the freed models may come back on the same address
+==================
+*/
+void PM_ClearContentsCache( void )
+{
+	pm_contentsgen++;
+
+	if( pm_contentsgen == 0 )
+	{
+		memset( pm_contents, 0, sizeof( pm_contents ));
+		pm_contentsgen = 1;
+	}
+}
+
+/*
+==================
+PM_CellHint
+
+descends with the whole cell while it stays on one side of the planes
+==================
+*/
+static int PM_CellHint( hull_t *hull, int num, const vec3_t mins, const vec3_t maxs )
+{
+	mplane_t	*plane;
+	float	dmin, dmax;
+	int	i;
+
+	while( num >= 0 )
+	{
+		plane = &hull->planes[hull->clipnodes[num].planenum];
+
+		if( plane->type < 3 )
+		{
+			// exact, the cell is half-open and PlaneDiff is a single subtraction
+			if( mins[plane->type] >= plane->dist )
+				num = hull->clipnodes[num].children[0];
+			else if( maxs[plane->type] <= plane->dist )
+				num = hull->clipnodes[num].children[1];
+			else break;
+			continue;
+		}
+
+		dmin = dmax = -plane->dist;
+
+		for( i = 0; i < 3; i++ )
+		{
+			if( plane->normal[i] >= 0.0f )
+			{
+				dmin += plane->normal[i] * mins[i];
+				dmax += plane->normal[i] * maxs[i];
+			}
+			else
+			{
+				dmin += plane->normal[i] * maxs[i];
+				dmax += plane->normal[i] * mins[i];
+			}
+		}
+
+		if( dmin >= PM_CONTENTS_EPSILON )
+			num = hull->clipnodes[num].children[0];
+		else if( dmax <= -PM_CONTENTS_EPSILON )
+			num = hull->clipnodes[num].children[1];
+		else break;
+	}
+
+	return num;
+}
+
+/*
+==================
+PM_HullPointContentsCached
+
+same as PM_HullPointContents, only for the hulls
+that stay unchanged until their model is freed
+==================
+*/
+int PM_HullPointContentsCached( hull_t *hull, int num, const vec3_t p )
+{
+	vec3_t		mins, maxs;
+	pmcontents_t	*pc;
+	int		cell[3];
+	uint		hash;
+	int		i;
+
+	if( !hull || !hull->planes )	// fantom bmodels?
+		return CONTENTS_NONE;
+
+	pm_contentsstats.lookups++;
+
+	// also catches NaN
+	if( !( fabs( p[0] ) < PM_CONTENTS_RANGE && fabs( p[1] ) < PM_CONTENTS_RANGE && fabs( p[2] ) < PM_CONTENTS_RANGE ))
+	{
+		pm_contentsstats.uncached++;
+		return PM_HullPointContents( hull, num, p );
+	}
+
+	for( i = 0; i < 3; i++ )
+		cell[i] = (int)floor( p[i] * ( 1.0f / PM_CONTENTS_CELL ));
+
+	hash = (uint)cell[0] * 73856093U ^ (uint)cell[1] * 19349663U ^ (uint)cell[2] * 83492791U;
+	hash ^= (uint)((size_t)hull >> 4) * 2654435761U ^ (uint)num;
+	pc = &pm_contents[( hash ^ ( hash >> 15 )) & ( PM_CONTENTS_CACHE - 1 )];
+
+	if( pc->generation != pm_contentsgen || pc->hull != hull || pc->num != num
+		|| pc->cell[0] != cell[0] || pc->cell[1] != cell[1] || pc->cell[2] != cell[2] )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			mins[i] = cell[i] * PM_CONTENTS_CELL;
+			maxs[i] = mins[i] + PM_CONTENTS_CELL;
+		}
+
+		pc->hull = hull;
+		pc->num = num;
+		VectorCopy( cell, pc->cell );
+		pc->result = PM_CellHint( hull, num, mins, maxs );
+		pc->generation = pm_contentsgen;
+		pm_contentsstats.misses++;
+	}
+	else if( pc->result < 0 )
+		pm_contentsstats.leafhits++;
+	else if( pc->result != num )
+		pm_contentsstats.nodehits++;
+
+	if( pc->result < 0 )
+		return pc->result;
+
+	return PM_HullPointContents( hull, pc->result, p );
+}
+
+/*
+==================
+PM_PrintContentsCacheStats
+==================
+*/
+void PM_PrintContentsCacheStats( qboolean reset )
+{
+	pmcontentsstats_t	*st = &pm_contentsstats;
+
+	Con_Printf( "contents cache: %lu lookups, %lu leaf hits, %lu node hits, %lu misses, %lu uncached\n",
+		st->lookups, st->leafhits, st->nodehits, st->misses, st->uncached );
+
+	if( st->lookups )
+	{
+		Con_Printf( "hit rate %.1f%% (%.1f%% without planes)\n",
+			( st->leafhits + st->nodehits ) * 100.0 / st->lookups, st->leafhits * 100.0 / st->lookups );
+	}
+
+	if( reset ) memset( st, 0, sizeof( *st ));
+}
+
 /*
 ==================
 PM_HullForBsp
@@ -313,84 +525,300 @@ loc0:
 	return false;
 }
 
-pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
+/*
+==================
+PM_SortBroadPhase
+
+qsort comparator, by the lower x bound
+==================
+*/
+static int PM_SortBroadPhase( const void *a, const void *b )
 {
-	physent_t	*pe;
-	matrix4x4	matrix;
-	pmtrace_t	trace_bbox;
-	pmtrace_t	trace_hitbox;
-	pmtrace_t	trace_total;
-	vec3_t	offset, start_l, end_l;
-	vec3_t	temp, mins, maxs;
-	int	i, j, hullcount;
-	qboolean	rotated, transform_bbox;
-	hull_t	*hull = NULL;
+	const pmsortent_t	*sa = a, *sb = b;
 
-	memset( &trace_total, 0, sizeof( trace_total ));
-	VectorCopy( end, trace_total.endpos );
-	trace_total.fraction = 1.0f;
-	trace_total.ent = -1;
+	if( sa->key < sb->key ) return -1;
+	if( sa->key > sb->key ) return 1;
+	return 0;
+}
 
-	for( i = 0; i < numents; i++ )
+/*
+==================
+PM_BuildBroadPhase
+
+collect world bounds of the pmove physents,
+they are stay the same during the player move
+==================
+*/
+void PM_BuildBroadPhase( playermove_t *pmove )
+{
+	pmbroadphase_t	*bp = &pm_broadphase[pmove->server ? 1 : 0];
+	float		ext = 0.0f, clip, reach, radius;
+	physent_t		*pe;
+	int		i, j;
+
+	bp->numents = 0;
+
+	if( !pm_broadphase_mode || !pm_broadphase_mode->value )
+		return;
+
+	// player hull can shift the bmodel hull as well as expand the boxes
+	for( i = 0; i < MAX_MAP_HULLS; i++ )
 	{
-		pe = &ents[i];
+		for( j = 0; j < 3; j++ )
+		{
+			ext = Q_max( ext, fabs( pmove->player_mins[i][j] ));
+			ext = Q_max( ext, fabs( pmove->player_maxs[i][j] ));
+		}
+	}
 
-		if( i != 0 && ( flags & PM_WORLD_ONLY ))
-			break;
+	memset( bp->always, 0, sizeof( bp->always ));
+	bp->numsorted = 0;
 
-		// run custom user filter
-		if( pmFilter != NULL )
+	for( i = 0; i < pmove->numphysent; i++ )
+	{
+		pe = &pmove->physents[i];
+		reach = ext * 2.0f + 1.0f;
+		VectorCopy( pe->origin, bp->origin[i] );
+
+		if( i == 0 || pe->solid == SOLID_CUSTOM )
 		{
-			if( pmFilter( pe ))
+			SetBits( bp->always[i >> 5], BIT( i & 31 ));
+			continue;
+		}
+
+		if( pe->model )
+		{
+			if( pe->model->type != mod_brush )
+			{
+				SetBits( bp->always[i >> 5], BIT( i & 31 ));
 				continue;
+			}
+
+			// compiled hulls are larger than the brushes
+			for( clip = 0.0f, j = 0; j < MAX_MAP_HULLS; j++ )
+			{
+				hull_t	*hull = &pe->model->hulls[j];
+
+				clip = Q_max( clip, hull->clip_maxs[0] - hull->clip_mins[0] );
+				clip = Q_max( clip, hull->clip_maxs[1] - hull->clip_mins[1] );
+				clip = Q_max( clip, hull->clip_maxs[2] - hull->clip_mins[2] );
+			}
+			reach += clip;
+
+			if( !VectorIsNull( pe->angles ))
+			{
+				radius = RadiusFromBounds( pe->model->mins, pe->model->maxs ) + reach * 2.0f;
+
+				for( j = 0; j < 3; j++ )
+				{
+					bp->absmin[i][j] = pe->origin[j] - radius;
+					bp->absmax[i][j] = pe->origin[j] + radius;
+				}
+			}
+			else
+			{
+				for( j = 0; j < 3; j++ )
+				{
+					bp->absmin[i][j] = pe->origin[j] + pe->model->mins[j] - reach;
+					bp->absmax[i][j] = pe->origin[j] + pe->model->maxs[j] + reach;
+				}
+			}
 		}
-		else if( ignore_pe != -1 )
+		else
 		{
-			if( i == ignore_pe )
+			// hitboxes may stick out of the bbox, same test as the traces does.
+			// point hull is traced against hitboxes too, but it never uses the
+			// broad-phase, so usehull changed during the move is also safe
+			if( PM_AllowHitBoxTrace( pe->studiomodel, pmove->usehull ))
+			{
+				SetBits( bp->always[i >> 5], BIT( i & 31 ));
 				continue;
+			}
+
+			for( j = 0; j < 3; j++ )
+			{
+				bp->absmin[i][j] = pe->origin[j] + pe->mins[j] - reach;
+				bp->absmax[i][j] = pe->origin[j] + pe->maxs[j] + reach;
+			}
 		}
 
-		if( pe->model != NULL && pe->solid == SOLID_NOT && pe->skin != CONTENTS_NONE )
+		bp->sorted[bp->numsorted].key = bp->absmin[i][0];
+		bp->sorted[bp->numsorted].ent = i;
+		bp->numsorted++;
+	}
+
+	qsort( bp->sorted, bp->numsorted, sizeof( pmsortent_t ), PM_SortBroadPhase );
+
+	bp->ents = pmove->physents;
+	bp->numents = pmove->numphysent;
+}
+
+/*
+==================
+PM_ClearBroadPhase
+
+physents may be changed after the player move,
+but not during it
+==================
+*/
+void PM_ClearBroadPhase( playermove_t *pmove )
+{
+	pmbroadphase_t	*bp = &pm_broadphase[pmove->server ? 1 : 0];
+	int		i;
+
+	if( bp->numents && pm_broadphase_mode->value == 2.0f )
+	{
+		for( i = 0; i < bp->numents; i++ )
+		{
+			if( !VectorCompare( bp->ents[i].origin, bp->origin[i] ))
+				Con_Printf( S_ERROR "PM_ClearBroadPhase: physent %i was moved during the player move\n", i );
+		}
+	}
+
+	bp->numents = 0;
+}
+
+/*
+==================
+PM_BroadPhaseCandidates
+
+mark physents which bounds are touched by the trace,
+returns false if broad-phase can't be used
+==================
+*/
+static qboolean PM_BroadPhaseCandidates( playermove_t *pmove, const physent_t *ents, int numents, const vec3_t start, const vec3_t end, uint *bits )
+{
+	pmbroadphase_t	*bp = &pm_broadphase[pmove->server ? 1 : 0];
+	vec3_t		mins, maxs;
+	int		i, j, lo, hi, mid;
+
+	// point hull always traces the hitboxes, see PM_AllowHitBoxTrace
+	if( !bp->numents || ents != bp->ents || numents != bp->numents || pmove->usehull == 2 )
+		return false;
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( IS_NAN( start[i] ) || IS_NAN( end[i] ))
+			return false;
+
+		mins[i] = Q_min( start[i], end[i] );
+		maxs[i] = Q_max( start[i], end[i] );
+	}
+
+	memcpy( bits, bp->always, sizeof( bp->always ));
+
+	// skip physents that are starts past the trace
+	for( lo = 0, hi = bp->numsorted; lo < hi; )
+	{
+		mid = ( lo + hi ) >> 1;
+
+		if( bp->sorted[mid].key <= maxs[0] )
+			lo = mid + 1;
+		else hi = mid;
+	}
+
+	for( i = 0; i < lo; i++ )
+	{
+		j = bp->sorted[i].ent;
+
+		if( bp->absmax[j][0] < mins[0] )
 			continue;
 
-		if(( flags & PM_GLASS_IGNORE ) && pe->rendermode != kRenderNormal )
+		if( bp->absmin[j][1] > maxs[1] || bp->absmax[j][1] < mins[1] )
 			continue;
 
-		if(( flags & PM_CUSTOM_IGNORE ) && pe->solid == SOLID_CUSTOM )
+		if( bp->absmin[j][2] > maxs[2] || bp->absmax[j][2] < mins[2] )
 			continue;
 
-		hullcount = 1;
+		SetBits( bits[j >> 5], BIT( j & 31 ));
+	}
 
-		if( pe->solid == SOLID_CUSTOM )
-		{
-			VectorCopy( pmove->player_mins[pmove->usehull], mins );
-			VectorCopy( pmove->player_maxs[pmove->usehull], maxs );
-			VectorClear( offset );
-		}
-		else if( pe->model )
-		{
-			hull = PM_HullForBsp( pe, pmove, offset );
-		}
-		else
-		{
-			if( pe->studiomodel )
-			{
-				if( FBitSet( flags, PM_STUDIO_IGNORE ))
-					continue;
+	return true;
+}
 
-				if( PM_AllowHitBoxTrace( pe->studiomodel, pmove->usehull ) && !FBitSet( flags, PM_STUDIO_BOX ))
-				{
-					hull = PM_HullForStudio( pe, pmove, &hullcount );
-					VectorClear( offset );
-				}
-				else
-				{
-					VectorSubtract( pe->mins, pmove->player_maxs[pmove->usehull], mins );
-					VectorSubtract( pe->maxs, pmove->player_mins[pmove->usehull], maxs );
+/*
+==================
+PM_CompareTraces
 
-					hull = PM_HullForBox( mins, maxs );
-					VectorCopy( pe->origin, offset );
-				}
+==================
+*/
+static qboolean PM_CompareTraces( const pmtrace_t *a, const pmtrace_t *b )
+{
+	if( a->allsolid != b->allsolid || a->startsolid != b->startsolid || a->inopen != b->inopen || a->inwater != b->inwater )
+		return false;
+
+	if( a->fraction != b->fraction || !VectorCompare( a->endpos, b->endpos ))
+		return false;
+
+	if( a->ent != b->ent || a->hitgroup != b->hitgroup )
+		return false;
+
+	return VectorCompare( a->plane.normal, b->plane.normal ) && a->plane.dist == b->plane.dist;
+}
+
+/*
+==================
+PM_ClipToPhysEnt
+
+clip the player trace to the single physent
+==================
+*/
+static void PM_ClipToPhysEnt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, physent_t *ents, int i, int ignore_pe, pfnIgnore pmFilter, pmtrace_t *trace_total )
+{
+	physent_t	*pe = &ents[i];
+	matrix4x4	matrix;
+	pmtrace_t	trace_bbox;
+	pmtrace_t	trace_hitbox;
+	vec3_t	offset, start_l, end_l;
+	vec3_t	temp, mins, maxs;
+	int	j, hullcount;
+	qboolean	rotated, transform_bbox;
+	hull_t	*hull = NULL;
+
+	// run custom user filter
+	if( pmFilter != NULL )
+	{
+		if( pmFilter( pe ))
+			return;
+	}
+	else if( ignore_pe != -1 )
+	{
+		if( i == ignore_pe )
+			return;
+	}
+
+	if( pe->model != NULL && pe->solid == SOLID_NOT && pe->skin != CONTENTS_NONE )
+		return;
+
+	if(( flags & PM_GLASS_IGNORE ) && pe->rendermode != kRenderNormal )
+		return;
+
+	if(( flags & PM_CUSTOM_IGNORE ) && pe->solid == SOLID_CUSTOM )
+		return;
+
+	hullcount = 1;
+
+	if( pe->solid == SOLID_CUSTOM )
+	{
+		VectorCopy( pmove->player_mins[pmove->usehull], mins );
+		VectorCopy( pmove->player_maxs[pmove->usehull], maxs );
+		VectorClear( offset );
+	}
+	else if( pe->model )
+	{
+		hull = PM_HullForBsp( pe, pmove, offset );
+	}
+	else
+	{
+		if( pe->studiomodel )
+		{
+			if( FBitSet( flags, PM_STUDIO_IGNORE ))
+				return;
+
+			if( PM_AllowHitBoxTrace( pe->studiomodel, pmove->usehull ) && !FBitSet( flags, PM_STUDIO_BOX ))
+			{
+				hull = PM_HullForStudio( pe, pmove, &hullcount );
+				VectorClear( offset );
 			}
 			else
 			{
@@ -400,149 +828,228 @@ pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int
 				hull = PM_HullForBox( mins, maxs );
 				VectorCopy( pe->origin, offset );
 			}
+		}
+		else
+		{
+			VectorSubtract( pe->mins, pmove->player_maxs[pmove->usehull], mins );
+			VectorSubtract( pe->maxs, pmove->player_mins[pmove->usehull], maxs );
 
+			hull = PM_HullForBox( mins, maxs );
+			VectorCopy( pe->origin, offset );
 		}
 
-		if( pe->solid == SOLID_BSP && !VectorIsNull( pe->angles ))
-			rotated = true;
-		else rotated = false;
+	}
 
-		if( FBitSet( host.features, ENGINE_PHYSICS_PUSHER_EXT ))
+	if( pe->solid == SOLID_BSP && !VectorIsNull( pe->angles ))
+		rotated = true;
+	else rotated = false;
+
+	if( FBitSet( host.features, ENGINE_PHYSICS_PUSHER_EXT ))
+	{
+		if(( check_angles( pe->angles[0] ) || check_angles( pe->angles[2] )) && pmove->usehull != 2 )
+			transform_bbox = true;
+		else transform_bbox = false;
+	}
+	else transform_bbox = false;
+
+	if( rotated )
+	{
+		if( transform_bbox )
+			Matrix4x4_CreateFromEntity( matrix, pe->angles, pe->origin, 1.0f );
+		else Matrix4x4_CreateFromEntity( matrix, pe->angles, offset, 1.0f );
+
+		Matrix4x4_VectorITransform( matrix, start, start_l );
+		Matrix4x4_VectorITransform( matrix, end, end_l );
+
+		if( transform_bbox )
 		{
-			if(( check_angles( pe->angles[0] ) || check_angles( pe->angles[2] )) && pmove->usehull != 2 )
-				transform_bbox = true;
-			else transform_bbox = false;
+			World_TransformAABB( matrix, pmove->player_mins[pmove->usehull], pmove->player_maxs[pmove->usehull], mins, maxs );
+			VectorSubtract( hull->clip_mins, mins, offset );	// calc new local offset
+
+			for( j = 0; j < 3; j++ )
+			{
+				if( start_l[j] >= 0.0f )
+					start_l[j] -= offset[j];
+				else start_l[j] += offset[j];
+				if( end_l[j] >= 0.0f )
+					end_l[j] -= offset[j];
+				else end_l[j] += offset[j];
+			}
 		}
-		else transform_bbox = false;
+	}
+	else
+	{
+		VectorSubtract( start, offset, start_l );
+		VectorSubtract( end, offset, end_l );
+	}
 
-		if( rotated )
+	memset( &trace_bbox, 0, sizeof( trace_bbox ));
+	VectorCopy( end, trace_bbox.endpos );
+	trace_bbox.allsolid = true;
+	trace_bbox.fraction = 1.0f;
+
+	if( hullcount < 1 )
+	{
+		// g-cont. probably this never happens
+		trace_bbox.allsolid = false;
+	}
+	else if( pe->solid == SOLID_CUSTOM )
+	{
+		// run custom sweep callback
+		if( pmove->server || Host_IsLocalClient( ))
+			SV_ClipPMoveToEntity( pe, start, mins, maxs, end, &trace_bbox );
+#if !XASH_DEDICATED
+		else CL_ClipPMoveToEntity( pe, start, mins, maxs, end, &trace_bbox );
+#endif
+	}
+	else if( hullcount == 1 )
+	{
+		PM_RecursiveHullCheck( hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace_bbox );
+	}
+	else
+	{
+		int	last_hitgroup;
+
+		for( last_hitgroup = 0, j = 0; j < hullcount; j++ )
 		{
-			if( transform_bbox )
-				Matrix4x4_CreateFromEntity( matrix, pe->angles, pe->origin, 1.0f );
-			else Matrix4x4_CreateFromEntity( matrix, pe->angles, offset, 1.0f );
+			memset( &trace_hitbox, 0, sizeof( trace_hitbox ));
+			VectorCopy( end, trace_hitbox.endpos );
+			trace_hitbox.allsolid = true;
+			trace_hitbox.fraction = 1.0f;
 
-			Matrix4x4_VectorITransform( matrix, start, start_l );
-			Matrix4x4_VectorITransform( matrix, end, end_l );
+			PM_RecursiveHullCheck( &hull[j], hull[j].firstclipnode, 0, 1, start_l, end_l, &trace_hitbox );
 
-			if( transform_bbox )
+			if( j == 0 || trace_hitbox.allsolid || trace_hitbox.startsolid || trace_hitbox.fraction < trace_bbox.fraction )
 			{
-				World_TransformAABB( matrix, pmove->player_mins[pmove->usehull], pmove->player_maxs[pmove->usehull], mins, maxs );
-				VectorSubtract( hull->clip_mins, mins, offset );	// calc new local offset
-
-				for( j = 0; j < 3; j++ )
+				if( trace_bbox.startsolid )
 				{
-					if( start_l[j] >= 0.0f )
-						start_l[j] -= offset[j];
-					else start_l[j] += offset[j];
-					if( end_l[j] >= 0.0f )
-						end_l[j] -= offset[j];
-					else end_l[j] += offset[j];
+					trace_bbox = trace_hitbox;
+					trace_bbox.startsolid = true;
 				}
+				else trace_bbox = trace_hitbox;
+
+				last_hitgroup = j;
 			}
 		}
-		else
-		{
-			VectorSubtract( start, offset, start_l );
-			VectorSubtract( end, offset, end_l );
-		}
 
-		memset( &trace_bbox, 0, sizeof( trace_bbox ));
-		VectorCopy( end, trace_bbox.endpos );
-		trace_bbox.allsolid = true;
-		trace_bbox.fraction = 1.0f;
+		trace_bbox.hitgroup = Mod_HitgroupForStudioHull( last_hitgroup );
+	}
+
+	if( trace_bbox.allsolid )
+		trace_bbox.startsolid = true;
 
-		if( hullcount < 1 )
-		{
-			// g-cont. probably this never happens
-			trace_bbox.allsolid = false;
-		}
-		else if( pe->solid == SOLID_CUSTOM )
+	if( trace_bbox.startsolid )
+		trace_bbox.fraction = 0.0f;
+
+	if( !trace_bbox.startsolid )
+	{
+		VectorLerp( start, trace_bbox.fraction, end, trace_bbox.endpos );
+
+		if( rotated )
 		{
-			// run custom sweep callback
-			if( pmove->server || Host_IsLocalClient( ))
-				SV_ClipPMoveToEntity( pe, start, mins, maxs, end, &trace_bbox );
-#if !XASH_DEDICATED
-			else CL_ClipPMoveToEntity( pe, start, mins, maxs, end, &trace_bbox );
-#endif
+			VectorCopy( trace_bbox.plane.normal, temp );
+			Matrix4x4_TransformPositivePlane( matrix, temp, trace_bbox.plane.dist, trace_bbox.plane.normal, &trace_bbox.plane.dist );
 		}
-		else if( hullcount == 1 )
+		else
 		{
-			PM_RecursiveHullCheck( hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace_bbox );
+			trace_bbox.plane.dist = DotProduct( trace_bbox.endpos, trace_bbox.plane.normal );
 		}
-		else
+	}
+
+	if( trace_bbox.fraction < trace_total->fraction )
+	{
+		*trace_total = trace_bbox;
+		trace_total->ent = i;
+	}
+}
+
+
+pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
+{
+	uint	bits[PM_BITWORDS];
+	pmtrace_t	trace_total;
+	pmtrace_t	trace_linear;
+	int	i;
+
+	memset( &trace_total, 0, sizeof( trace_total ));
+	VectorCopy( end, trace_total.endpos );
+	trace_total.fraction = 1.0f;
+	trace_total.ent = -1;
+
+	if( !PM_BroadPhaseCandidates( pmove, ents, numents, start, end, bits ))
+	{
+		for( i = 0; i < numents; i++ )
 		{
-			int	last_hitgroup;
+			if( i != 0 && ( flags & PM_WORLD_ONLY ))
+				break;
 
-			for( last_hitgroup = 0, j = 0; j < hullcount; j++ )
-			{
-				memset( &trace_hitbox, 0, sizeof( trace_hitbox ));
-				VectorCopy( end, trace_hitbox.endpos );
-				trace_hitbox.allsolid = true;
-				trace_hitbox.fraction = 1.0f;
+			PM_ClipToPhysEnt( pmove, start, end, flags, ents, i, ignore_pe, pmFilter, &trace_total );
+		}
 
-				PM_RecursiveHullCheck( &hull[j], hull[j].firstclipnode, 0, 1, start_l, end_l, &trace_hitbox );
+		return trace_total;
+	}
 
-				if( j == 0 || trace_hitbox.allsolid || trace_hitbox.startsolid || trace_hitbox.fraction < trace_bbox.fraction )
-				{
-					if( trace_bbox.startsolid )
-					{
-						trace_bbox = trace_hitbox;
-						trace_bbox.startsolid = true;
-					}
-					else trace_bbox = trace_hitbox;
-
-					last_hitgroup = j;
-				}
-			}
+	trace_linear = trace_total;
 
-			trace_bbox.hitgroup = Mod_HitgroupForStudioHull( last_hitgroup );
+	for( i = 0; i < numents; i++ )
+	{
+		if( !FBitSet( bits[i >> 5], BIT( i & 31 )))
+		{
+			if( !bits[i >> 5] ) i |= 31; // skip empty word
+			continue;
 		}
 
-		if( trace_bbox.allsolid )
-			trace_bbox.startsolid = true;
+		if( i != 0 && ( flags & PM_WORLD_ONLY ))
+			break;
 
-		if( trace_bbox.startsolid )
-			trace_bbox.fraction = 0.0f;
+		PM_ClipToPhysEnt( pmove, start, end, flags, ents, i, ignore_pe, pmFilter, &trace_total );
+	}
 
-		if( !trace_bbox.startsolid )
+	if( pm_broadphase_mode->value == 2.0f )
+	{
+		for( i = 0; i < numents; i++ )
 		{
-			VectorLerp( start, trace_bbox.fraction, end, trace_bbox.endpos );
+			if( i != 0 && ( flags & PM_WORLD_ONLY ))
+				break;
 
-			if( rotated )
-			{
-				VectorCopy( trace_bbox.plane.normal, temp );
-				Matrix4x4_TransformPositivePlane( matrix, temp, trace_bbox.plane.dist, trace_bbox.plane.normal, &trace_bbox.plane.dist );
-			}
-			else
-			{
-				trace_bbox.plane.dist = DotProduct( trace_bbox.endpos, trace_bbox.plane.normal );
-			}
+			PM_ClipToPhysEnt( pmove, start, end, flags, ents, i, ignore_pe, pmFilter, &trace_linear );
 		}
 
-		if( trace_bbox.fraction < trace_total.fraction )
+		if( !PM_CompareTraces( &trace_total, &trace_linear ))
 		{
-			trace_total = trace_bbox;
-			trace_total.ent = i;
+			Con_Printf( S_ERROR "PM_PlayerTraceExt: broad-phase trace mismatch (ent %i, linear %i, fraction %g, linear %g)\n",
+				trace_total.ent, trace_linear.ent, trace_total.fraction, trace_linear.fraction );
+			return trace_linear;
 		}
 	}
 
 	return trace_total;
 }
 
-int PM_TestPlayerPosition( playermove_t *pmove, vec3_t pos, pmtrace_t *ptrace, pfnIgnore pmFilter )
+/*
+==================
+PM_TestPhysEnts
+
+returns first physent that contains the player,
+only marked physents are tested if bits is not NULL
+==================
+*/
+static int PM_TestPhysEnts( playermove_t *pmove, vec3_t pos, pfnIgnore pmFilter, const uint *bits )
 {
 	int	i, j, hullcount;
 	vec3_t	pos_l, offset;
 	hull_t	*hull = NULL;
 	vec3_t	mins, maxs;
-	pmtrace_t trace;
 	physent_t *pe;
 
-	trace = PM_PlayerTraceExt( pmove, pmove->origin, pmove->origin, 0, pmove->numphysent, pmove->physents, -1, pmFilter );
-	if( ptrace ) *ptrace = trace;
-
 	for( i = 0; i < pmove->numphysent; i++ )
 	{
+		if( bits && !FBitSet( bits[i >> 5], BIT( i & 31 )))
+		{
+			if( !bits[i >> 5] ) i |= 31; // skip empty word
+			continue;
+		}
+
 		pe = &pmove->physents[i];
 
 		// run custom user filter
@@ -656,6 +1163,34 @@ int PM_TestPlayerPosition( playermove_t *pmove, vec3_t pos, pmtrace_t *ptrace, p
 	return -1; // didn't hit anything
 }
 
+int PM_TestPlayerPosition( playermove_t *pmove, vec3_t pos, pmtrace_t *ptrace, pfnIgnore pmFilter )
+{
+	uint	bits[PM_BITWORDS];
+	pmtrace_t	trace;
+	int	hit, linear;
+
+	trace = PM_PlayerTraceExt( pmove, pmove->origin, pmove->origin, 0, pmove->numphysent, pmove->physents, -1, pmFilter );
+	if( ptrace ) *ptrace = trace;
+
+	if( !PM_BroadPhaseCandidates( pmove, pmove->physents, pmove->numphysent, pos, pos, bits ))
+		return PM_TestPhysEnts( pmove, pos, pmFilter, NULL );
+
+	hit = PM_TestPhysEnts( pmove, pos, pmFilter, bits );
+
+	if( pm_broadphase_mode->value == 2.0f )
+	{
+		linear = PM_TestPhysEnts( pmove, pos, pmFilter, NULL );
+
+		if( hit != linear )
+		{
+			Con_Printf( S_ERROR "PM_TestPlayerPosition: broad-phase mismatch (ent %i, linear %i)\n", hit, linear );
+			return linear;
+		}
+	}
+
+	return hit;
+}
+
 /*
 =============
 PM_TruePointContents
@@ -668,7 +1203,7 @@ int PM_TruePointContents( playermove_t *pmove, const vec3_t p )
 
 	if( hull )
 	{
-		return PM_HullPointContents( hull, hull->firstclipnode, p );
+		return PM_HullPointContentsCached( hull, hull->firstclipnode, p );
 	}
 	else
 	{
@@ -694,7 +1229,7 @@ int PM_PointContents( playermove_t *pmove, const vec3_t p )
 		return CONTENTS_NONE;
 
 	// get base contents from world
-	contents = PM_HullPointContents( &pmove->physents[0].model->hulls[0], 0, p );
+	contents = PM_HullPointContentsCached( &pmove->physents[0].model->hulls[0], 0, p );
 
 	for( i = 1; i < pmove->numphysent; i++ )
 	{
@@ -723,7 +1258,7 @@ int PM_PointContents( playermove_t *pmove, const vec3_t p )
 		}
 
 		// test hull for intersection with this model
-		if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
+		if( PM_HullPointContentsCached( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
 			continue;
 
 		// compare contents ranking
@@ -30,8 +30,12 @@ ENTITY AREA CHECKING
 ===============================================================================
 */
 #define MAX_TOTAL_ENT_LEAFS		128
-#define AREA_NODES			32
-#define AREA_DEPTH			4
+#define AREA_NODES			2048	// enough for AREA_MAX_DEPTH
+#define AREA_DEPTH			4	// fixed depth of the uniform tree
+#define AREA_MAX_DEPTH		10
+#define AREA_LEAF_SIZE		1024.0f	// empty regions are split down to this size
+#define AREA_MIN_SIZE		128.0f	// crowded regions are split down to this size
+#define AREA_MIN_LINKS		8	// region with more edicts counts as crowded
 
 #include "lightstyle.h"
 
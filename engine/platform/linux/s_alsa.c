@@ -34,6 +34,7 @@ static struct s_alsa_t
 
 void SND_Pause_f( void )
 {
+	S_LockMixer();
 	s_alsa.paused = Q_atoi( Cmd_Argv( 1 ) ) ;
 
 	if( !s_alsa.paused )
@@ -46,6 +47,7 @@ void SND_Pause_f( void )
 		snd_pcm_drain( s_alsa.pcm_handle );
 		snd_pcm_drop( s_alsa.pcm_handle );
 	}
+	S_UnlockMixer();
 }
 
 
@@ -376,6 +378,8 @@ between a deactivate and an activate.
 */
 void SNDDMA_Activate( qboolean active )
 {
+	// don't let the mixing thread write into stopped device
+	S_LockMixer();
 	s_alsa.paused = !active;
 
 	if( !s_alsa.paused )
@@ -388,6 +392,7 @@ void SNDDMA_Activate( qboolean active )
 		snd_pcm_drain( s_alsa.pcm_handle );
 		snd_pcm_drop( s_alsa.pcm_handle );
 	}
+	S_UnlockMixer();
 }
 
 #endif
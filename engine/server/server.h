@@ -163,6 +163,11 @@ typedef struct server_s
 	sizebuf_t		datagram;
 	byte		datagram_buf[MAX_DATAGRAM];
 
+	// unreliable messages for every spawned client, written once
+	sizebuf_t		broadcast;	// each client takes its unread part, see SV_SyncBroadcast
+	byte		broadcast_buf[MAX_DATAGRAM];
+	qboolean		broadcast_full;	// rest of the frame goes to the clients one by one
+
 	// reliable data to send to clients.
 	sizebuf_t		reliable_datagram;	// copied to all clients at end of frame
 	byte		reliable_datagram_buf[MAX_DATAGRAM];
@@ -250,6 +255,7 @@ typedef struct sv_client_s
 	// it can be harmlessly overflowed.
 	sizebuf_t		datagram;
 	byte		datagram_buf[MAX_DATAGRAM];
+	int		broadcast_bit;		// sv.broadcast before this bit is already in datagram
 
 	client_frame_t	*frames;			// updates can be delta'd from here
 	event_state_t	events;			// delta-updated events cycle
@@ -387,6 +393,8 @@ extern	areanode_t	sv_areanodes[];		// AABB dynamic tree
 extern convar_t		mp_logecho;
 extern convar_t		mp_logfile;
 extern convar_t		sv_unlag;
+extern convar_t		sv_idleskip;
+extern convar_t		sv_broadcastarena;
 extern convar_t		sv_maxunlag;
 extern convar_t		sv_unlagpush;
 extern convar_t		sv_unlagsamples;
@@ -677,6 +685,17 @@ msurface_t *SV_TraceSurface( edict_t *ent, const vec3_t start, const vec3_t end
 trace_t SV_MoveToss( edict_t *tossent, edict_t *ignore );
 void SV_LinkEdict( edict_t *ent, qboolean touch_triggers );
 void SV_TouchLinks( edict_t *ent, areanode_t *node );
+int SV_AreaEntityInSphere( int start, const vec3_t org, float radius );
+void SV_BuildAreaNodes( qboolean uniform );
+void SV_AreaStats_f( void );
+void SV_TraceBench_f( void );
+void SV_ContentsTest_f( void );
+void SV_PhysStats_f( void );
+void SV_MulticastStats_f( void );
+void SV_ClearViewLeafs( void );
+void SV_SyncBroadcast( sv_client_t *cl, sizebuf_t *msg );
+void SV_SkipBroadcast( sv_client_t *cl );
+void SV_EndBroadcast( void );
 int SV_TruePointContents( const vec3_t p );
 int SV_PointContents( const vec3_t p );
 void SV_RunLightStyles( void );
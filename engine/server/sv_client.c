@@ -2043,8 +2043,9 @@ static qboolean SV_Begin_f( sv_client_t *cl )
 	if( cl->state != cs_connected )
 		return false;
 
-	// now client is spawned
+	// now client is spawned, it gets only the broadcasts written after
 	cl->state = cs_spawned;
+	SV_SkipBroadcast( cl );
 	return true;
 }
 
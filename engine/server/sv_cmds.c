@@ -978,6 +978,15 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "shutdownserver", SV_KillServer_f, "shutdown current server" );
 	Cmd_AddCommand( "changelevel", SV_ChangeLevel_f, "change level" );
 	Cmd_AddCommand( "changelevel2", SV_ChangeLevel2_f, "smooth change level" );
+	Cmd_AddCommand( "sv_areastats", SV_AreaStats_f, "show area tree and link lists visited by traces and touches" );
+	Cmd_AddCommand( "sv_tracebench", SV_TraceBench_f, "trace between entities with uniform and adaptive area trees" );
+	Cmd_AddCommand( "sv_contentstest", SV_ContentsTest_f, "check and time cached point contents of the world hulls" );
+	Cmd_AddCommand( "sv_hitboxbench", Mod_HitboxBench_f, "time the bone setup for hitbox traces, all bones against hitbox bones" );
+	Cmd_AddCommand( "sv_physstats", SV_PhysStats_f, "show entities, idle skips, thinks and time of the physics loop" );
+	Cmd_AddCommand( "sv_multicaststats", SV_MulticastStats_f, "show multicasts, recipients and view leaf lookups per frame" );
+#ifdef XASH_64BIT
+	Cmd_AddCommand( "str64stats", SV_PrintStr64Stats_f, "show 64 bit string pool statistics" );
+#endif
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -1012,6 +1021,15 @@ void SV_KillOperatorCommands( void )
 	Cmd_RemoveCommand( "shutdownserver" );
 	Cmd_RemoveCommand( "changelevel" );
 	Cmd_RemoveCommand( "changelevel2" );
+	Cmd_RemoveCommand( "sv_areastats" );
+	Cmd_RemoveCommand( "sv_tracebench" );
+	Cmd_RemoveCommand( "sv_contentstest" );
+	Cmd_RemoveCommand( "sv_hitboxbench" );
+	Cmd_RemoveCommand( "sv_physstats" );
+	Cmd_RemoveCommand( "sv_multicaststats" );
+#ifdef XASH_64BIT
+	Cmd_RemoveCommand( "str64stats" );
+#endif
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -710,6 +710,7 @@ void SV_SendClientDatagram( sv_client_t *cl )
 {
 	byte	msg_buf[MAX_DATAGRAM];
 	sizebuf_t	msg;
+	int	pending;
 
 	MSG_Init( &msg, "Datagram", msg_buf, sizeof( msg_buf ));
 
@@ -721,18 +722,25 @@ void SV_SendClientDatagram( sv_client_t *cl )
 	SV_WriteEntitiesToClient( cl, &msg );
 
 	// copy the accumulated multicast datagram
-	// for this client out to the message
-	if( MSG_CheckOverflow( &cl->datagram ))
+	// for this client out to the message,
+	// broadcasts it didn't get yet are going after
+	pending = Q_max( 0, MSG_GetNumBitsWritten( &sv.broadcast ) - cl->broadcast_bit );
+
+	if( MSG_CheckOverflow( &cl->datagram ) || pending > MSG_GetNumBitsLeft( &cl->datagram ))
 	{
 		Con_Printf( S_WARN "%s overflowed for %s\n", MSG_GetName( &cl->datagram ), cl->name );
 	}
 	else
 	{
-		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( &msg ))
+		if((( MSG_GetNumBitsWritten( &cl->datagram ) + pending + 7 ) >> 3 ) < MSG_GetNumBytesLeft( &msg ))
+		{
 			MSG_WriteBits( &msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
+			SV_SyncBroadcast( cl, &msg );
+		}
 		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
 	}
 
+	SV_SkipBroadcast( cl );
 	MSG_Clear( &cl->datagram );
 
 	if( MSG_CheckOverflow( &msg ))
@@ -813,6 +821,10 @@ void SV_UpdateToReliableMessages( void )
 			MSG_WriteBits( &cl->netchan.message, MSG_GetBuf( &sv.reliable_datagram ), MSG_GetNumBitsWritten( &sv.reliable_datagram ));
 		else Netchan_CreateFragments( &cl->netchan, &sv.reliable_datagram );
 
+		// server datagram is going after the broadcasts written before
+		if( MSG_GetNumBitsWritten( &sv.datagram ) || ( FBitSet( cl->flags, FCL_HLTV_PROXY ) && MSG_GetNumBitsWritten( &sv.spec_datagram )))
+			SV_SyncBroadcast( cl, &cl->datagram );
+
 		if( MSG_GetNumBytesWritten( &sv.datagram ) < MSG_GetNumBytesLeft( &cl->datagram ))
 			MSG_WriteBits( &cl->datagram, MSG_GetBuf( &sv.datagram ), MSG_GetNumBitsWritten( &sv.datagram ));
 		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow\n", cl->name );
@@ -913,6 +925,9 @@ void SV_SendClientMessages( void )
 
 	// reset current client
 	sv.current_client = NULL;
+
+	// keep the broadcasts for the clients who didn't get them
+	SV_EndBroadcast();
 }
 
 /*
@@ -25,6 +25,7 @@ GNU General Public License for more details.
 #include "ref_common.h" // decals
 
 #define ENTVARS_COUNT	ARRAYSIZE( gEntvarsDescription )
+#define FIND_STRING_MEMO	64	// string_t compare results kept by SV_FindEntityByString
 
 // fatpvs stuff
 static byte fatpvs[MAX_MAP_LEAFS/8];
@@ -32,6 +33,32 @@ static byte fatphs[MAX_MAP_LEAFS/8];
 static byte clientpvs[MAX_MAP_LEAFS/8];	// for find client in PVS
 static vec3_t viewPoint[MAX_CLIENTS];
 
+// view clusters of the clients and their portal cameras, found again only
+// when the view origin moves, so multicast don't walk the bsp for each client
+typedef struct
+{
+	vec3_t	origin;
+	int	cluster;
+	qboolean	valid;
+} sv_viewleaf_t;
+
+typedef struct
+{
+	size_t	multicasts;
+	size_t	recipients;
+	size_t	vischecks;
+	size_t	leafcalls;	// view origins that had to be descended
+	size_t	copiedbytes;	// written to the client buffers one by one
+	size_t	broadcasts;	// written once to sv.broadcast
+	size_t	broadcastbytes;
+	size_t	syncs;		// parts of sv.broadcast copied to the clients
+	size_t	syncbytes;
+	int	framecount;	// sv.framecount when counters were reset
+} sv_multicount_t;
+
+static sv_viewleaf_t	sv_viewleafs[MAX_CLIENTS][MAX_VIEWENTS + 1];
+static sv_multicount_t	sv_multicount;
+
 // exports
 typedef void (__cdecl *LINK_ENTITY_FUNC)( entvars_t *pev );
 typedef void (__stdcall *GIVEFNPTRSTODLL)( enginefuncs_t* engfuncs, globalvars_t *pGlobals );
@@ -93,7 +120,7 @@ entavrs table for FindEntityByString
 */
 TYPEDESCRIPTION *SV_GetEntvarsDescirption( int number )
 {
-	if( number < 0 && number >= ENTVARS_COUNT )
+	if( number < 0 || number >= ENTVARS_COUNT )
 		return NULL;
 	return &gEntvarsDescription[number];
 }
@@ -261,6 +288,40 @@ void SV_ConvertTrace( TraceResult *dst, trace_t *src )
 	svgame.globals->trace_flags = 0;
 }
 
+/*
+=============
+SV_ClearViewLeafs
+
+clusters belong to the previous map
+=============
+*/
+void SV_ClearViewLeafs( void )
+{
+	memset( sv_viewleafs, 0, sizeof( sv_viewleafs ));
+}
+
+/*
+=============
+SV_ViewCluster
+
+cluster of the client view or camera, slot 0 is the view
+=============
+*/
+static int SV_ViewCluster( int clientnum, int slot, const vec3_t vieworg )
+{
+	sv_viewleaf_t	*vl = &sv_viewleafs[clientnum][slot];
+
+	if( !vl->valid || !VectorCompare( vl->origin, vieworg ))
+	{
+		vl->cluster = Mod_PointInLeaf( vieworg, sv.worldmodel->nodes )->cluster;
+		vl->valid = true;
+		VectorCopy( vieworg, vl->origin );
+		sv_multicount.leafcalls++;
+	}
+
+	return vl->cluster;
+}
+
 /*
 =============
 SV_CheckClientVisiblity
@@ -272,20 +333,18 @@ qboolean SV_CheckClientVisiblity( sv_client_t *cl, const byte *mask )
 {
 	int	i, clientnum;
 	vec3_t	vieworg;
-	mleaf_t	*leaf;
 
 	if( !mask ) return true; // GoldSrc rules
 
 	clientnum = cl - svs.clients;
 	VectorCopy( viewPoint[clientnum], vieworg );
+	sv_multicount.vischecks++;
 
 	// Invasion issues: wrong camera position received in ENGINE_SET_PVS
 	if( cl->pViewEntity && !VectorCompare( vieworg, cl->pViewEntity->v.origin ))
 		VectorCopy( cl->pViewEntity->v.origin, vieworg );
 
-	leaf = Mod_PointInLeaf( vieworg, sv.worldmodel->nodes );
-
-	if( CHECKVISBIT( mask, leaf->cluster ))
+	if( CHECKVISBIT( mask, SV_ViewCluster( clientnum, 0, vieworg )))
 		return true; // visible from player view or camera view
 
 	// now check all the portal cameras
@@ -297,9 +356,8 @@ qboolean SV_CheckClientVisiblity( sv_client_t *cl, const byte *mask )
 			continue;
 
 		VectorAdd( view->v.origin, view->v.view_ofs, vieworg );
-		leaf = Mod_PointInLeaf( vieworg, sv.worldmodel->nodes );
 
-		if( CHECKVISBIT( mask, leaf->cluster ))
+		if( CHECKVISBIT( mask, SV_ViewCluster( clientnum, i + 1, vieworg )))
 			return true; // visible from portal camera view
 	}
 
@@ -307,6 +365,152 @@ qboolean SV_CheckClientVisiblity( sv_client_t *cl, const byte *mask )
 	return false;
 }
 
+/*
+=============
+SV_MulticastStats_f
+
+multicast fan-out and bytes copied
+per frame since the last call
+=============
+*/
+void SV_MulticastStats_f( void )
+{
+	sv_multicount_t	*mc = &sv_multicount;
+	int		frames = sv.framecount - mc->framecount;
+
+	if( frames <= 0 )
+	{
+		Con_Printf( "sv_multicaststats: no frames were run\n" );
+		mc->framecount = sv.framecount;
+		return;
+	}
+
+	Con_Printf( "%i frames, per frame: %.1f multicasts, %.1f recipients\n", frames,
+		(double)mc->multicasts / frames, (double)mc->recipients / frames );
+	Con_Printf( "%.1f visibility checks and %.1f view leaf lookups per frame\n",
+		(double)mc->vischecks / frames, (double)mc->leafcalls / frames );
+	Con_Printf( "%.1f broadcasts written once, %.1f bytes per frame\n",
+		(double)mc->broadcasts / frames, (double)mc->broadcastbytes / frames );
+	Con_Printf( "%.1f copies from the broadcast buffer, %.1f bytes per frame\n",
+		(double)mc->syncs / frames, (double)mc->syncbytes / frames );
+	Con_Printf( "%.1f bytes copied per recipient per frame\n", (double)mc->copiedbytes / frames );
+
+	memset( mc, 0, sizeof( *mc ));
+	mc->framecount = sv.framecount;
+}
+
+/*
+=================
+SV_WriteBroadcast
+
+unreliable message for all spawned clients is written
+once, unless something filters the recipients.
+
+reliable MSG_ALL user messages could share a buffer the same way,
+but netchan.message is written directly by prints, stufftext,
+centerprint, setview, reliable events, cvar queries and others,
+so every one of them would have to call a sync first to keep the
+order of the reliable stream. They are still copied per client
+=================
+*/
+static qboolean SV_WriteBroadcast( const edict_t *ent, qboolean filter )
+{
+	if( !sv_broadcastarena.value || sv.broadcast_full )
+		return false;
+
+	if( SV_IsValidEdict( ent ) && ent->v.groupinfo )
+		return false;
+
+	if( filter && sv.current_client && FBitSet( sv.current_client->flags, FCL_PREDICT_MOVEMENT ))
+		return false;
+
+	// keep the order: after the first message that doesn't fit
+	// everything else is written to the clients directly
+	if( MSG_GetNumBytesWritten( &sv.multicast ) >= MSG_GetNumBytesLeft( &sv.broadcast ))
+	{
+		sv.broadcast_full = true;
+		return false;
+	}
+
+	MSG_WriteBits( &sv.broadcast, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
+	sv_multicount.broadcastbytes += MSG_GetNumBytesWritten( &sv.multicast );
+	sv_multicount.broadcasts++;
+	sv_multicount.multicasts++;
+	MSG_Clear( &sv.multicast );
+
+	return true;
+}
+
+/*
+=================
+SV_SyncBroadcast
+
+write the broadcasts this client didn't get yet,
+must be called before anything else is written to
+the client datagram to keep the messages order
+=================
+*/
+void SV_SyncBroadcast( sv_client_t *cl, sizebuf_t *msg )
+{
+	int	start = cl->broadcast_bit;
+	int	end = MSG_GetNumBitsWritten( &sv.broadcast );
+	int	head = ( 8 - ( start & 7 )) & 7;
+	byte	*data = MSG_GetData( &sv.broadcast );
+
+	cl->broadcast_bit = end;
+
+	if( start >= end || cl->state != cs_spawned || !cl->edict || FBitSet( cl->flags, FCL_FAKECLIENT ))
+		return;
+
+	sv_multicount.syncbytes += ( end - start + 7 ) >> 3;
+	sv_multicount.syncs++;
+
+	// the part can start in the middle of the byte
+	if( head )
+	{
+		head = Q_min( head, end - start );
+		MSG_WriteUBitLong( msg, ( data[start >> 3] >> ( start & 7 )) & ( BIT( head ) - 1 ), head );
+		start += head;
+	}
+
+	MSG_WriteBits( msg, data + ( start >> 3 ), end - start );
+}
+
+/*
+=================
+SV_SkipBroadcast
+
+client datagram is dropped, so are the broadcasts
+=================
+*/
+void SV_SkipBroadcast( sv_client_t *cl )
+{
+	cl->broadcast_bit = MSG_GetNumBitsWritten( &sv.broadcast );
+}
+
+/*
+=================
+SV_EndBroadcast
+
+clients that didn't send a packet this frame
+keep the broadcasts in their datagrams
+=================
+*/
+void SV_EndBroadcast( void )
+{
+	sv_client_t	*cl;
+	int		i;
+
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		SV_SyncBroadcast( cl, &cl->datagram );
+		cl->broadcast_bit = 0;
+	}
+
+	MSG_Clear( &sv.broadcast );
+	sv.broadcast_full = false;
+}
+
 /*
 =================
 SV_Multicast
@@ -352,6 +556,8 @@ static int SV_Multicast( int dest, const vec3_t origin, const edict_t *ent, qboo
 		reliable = true;
 		// intentional fallthrough
 	case MSG_BROADCAST:
+		if( dest == MSG_BROADCAST && SV_WriteBroadcast( ent, filter ))
+			return 1; // delivered at the frame end
 		// nothing to sort
 		break;
 	case MSG_PAS_R:
@@ -422,10 +628,17 @@ static int SV_Multicast( int dest, const vec3_t origin, const edict_t *ent, qboo
 
 		if( specproxy ) MSG_WriteBits( &sv.spec_datagram, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
 		else if( reliable ) MSG_WriteBits( &cl->netchan.message, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
-		else MSG_WriteBits( &cl->datagram, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
+		else
+		{
+			SV_SyncBroadcast( cl, &cl->datagram );
+			MSG_WriteBits( &cl->datagram, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
+		}
 		numsends++;
 	}
 
+	sv_multicount.copiedbytes += numsends * MSG_GetNumBytesWritten( &sv.multicast );
+	sv_multicount.recipients += numsends;
+	sv_multicount.multicasts++;
 	MSG_Clear( &sv.multicast );
 
 	return numsends; // just for debug
@@ -1524,16 +1737,47 @@ void GAME_EXPORT pfnChangePitch( edict_t* ent )
 	ent->v.angles[PITCH] = SV_AngleMod( ent->v.idealpitch, ent->v.angles[PITCH], ent->v.pitch_speed );
 }
 
+/*
+=========
+SV_FindEntvarsField
+
+games ask for the same few fields over and over
+=========
+*/
+static TYPEDESCRIPTION *SV_FindEntvarsField( const char *pszField )
+{
+	static TYPEDESCRIPTION	*lastdesc = NULL;
+	TYPEDESCRIPTION		*desc;
+	int			index = 0;
+
+	if( lastdesc && !Q_strcmp( pszField, lastdesc->fieldName ))
+		return lastdesc;
+
+	while(( desc = SV_GetEntvarsDescirption( index++ )) != NULL )
+	{
+		if( !Q_strcmp( pszField, desc->fieldName ))
+			return ( lastdesc = desc );
+	}
+
+	return NULL;
+}
+
 /*
 =========
 SV_FindEntityByString
 
+game dlls write the string fields directly, so the edicts
+are still scanned in order. every distinct string_t is
+compared once per call, most entities share a few of them
 =========
 */
 edict_t *SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, const char *pszValue )
 {
-	int		index = 0, e = 0;
-	TYPEDESCRIPTION	*desc = NULL;
+	string_t		memokey[FIND_STRING_MEMO];
+	signed char	memoval[FIND_STRING_MEMO];
+	int		e = 0, slot;
+	TYPEDESCRIPTION	*desc;
+	string_t		value;
 	edict_t		*ed;
 	const char	*t;
 
@@ -1542,11 +1786,7 @@ edict_t *SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, cons
 
 	if( pStartEdict ) e = NUM_FOR_EDICT( pStartEdict );
 
-	while(( desc = SV_GetEntvarsDescirption( index++ )) != NULL )
-	{
-		if( !Q_strcmp( pszField, desc->fieldName ))
-			break;
-	}
+	desc = SV_FindEntvarsField( pszField );
 
 	if( desc == NULL )
 	{
@@ -1554,30 +1794,42 @@ edict_t *SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, cons
 		return svgame.edicts;
 	}
 
+	switch( desc->fieldType )
+	{
+	case FIELD_STRING:
+	case FIELD_MODELNAME:
+	case FIELD_SOUNDNAME:
+		break;
+	default:
+		ASSERT( 0 );
+		return svgame.edicts;
+	}
+
+	memset( memoval, 0, sizeof( memoval ));
+
 	for( e++; e < svgame.numEntities; e++ )
 	{
 		ed = EDICT_NUM( e );
 		if( !SV_IsValidEdict( ed )) continue;
 
-		if( e <= svs.maxclients && !SV_ClientFromEdict( ed, ( svs.maxclients != 1 )))
-			continue;
+		value = *(string_t *)&((byte *)&ed->v)[desc->fieldOffset];
+		slot = (uint)value & ( FIND_STRING_MEMO - 1 );
 
-		switch( desc->fieldType )
+		// 1 is a match, -1 is not, 0 is not compared yet
+		if( !memoval[slot] || memokey[slot] != value )
 		{
-		case FIELD_STRING:
-		case FIELD_MODELNAME:
-		case FIELD_SOUNDNAME:
-			t = STRING( *(string_t *)&((byte *)&ed->v)[desc->fieldOffset] );
-			if( t != NULL && t != svgame.globals->pStringBase )
-			{
-				if( !Q_strcmp( t, pszValue ))
-					return ed;
-			}
-			break;
-		default:
-			ASSERT( 0 );
-			break;
+			t = STRING( value );
+			memokey[slot] = value;
+			memoval[slot] = ( t != NULL && t != svgame.globals->pStringBase && !Q_strcmp( t, pszValue )) ? 1 : -1;
 		}
+
+		if( memoval[slot] < 0 )
+			continue;
+
+		if( e <= svs.maxclients && !SV_ClientFromEdict( ed, ( svs.maxclients != 1 )))
+			continue;
+
+		return ed;
 	}
 
 	return svgame.edicts;
@@ -1628,43 +1880,15 @@ find the entity in sphere
 */
 edict_t *pfnFindEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius )
 {
-	float	distSquared;
-	int	j, e = 0;
-	float	eorg;
-	edict_t	*ent;
-
-	flRadius *= flRadius;
+	int	e = 0;
 
 	if( SV_IsValidEdict( pStartEdict ))
 		e = NUM_FOR_EDICT( pStartEdict );
 
-	for( e++; e < svgame.numEntities; e++ )
-	{
-		ent = EDICT_NUM( e );
-
-		if( !SV_IsValidEdict( ent ))
-			continue;
-
-		// ignore clients that not in a game
-		if( e <= svs.maxclients && !SV_ClientFromEdict( ent, true ))
-			continue;
-
-		distSquared = 0.0f;
-
-		for( j = 0; j < 3 && distSquared <= flRadius; j++ )
-		{
-			if( org[j] < ent->v.absmin[j] )
-				eorg = org[j] - ent->v.absmin[j];
-			else if( org[j] > ent->v.absmax[j] )
-				eorg = org[j] - ent->v.absmax[j];
-			else eorg = 0.0f;
+	e = SV_AreaEntityInSphere( e, org, flRadius );
 
-			distSquared += eorg * eorg;
-		}
-
-		if( distSquared < flRadius )
-			return ent;
-	}
+	if( e < svgame.numEntities )
+		return EDICT_NUM( e );
 
 	return svgame.edicts;
 }
@@ -2989,6 +3213,8 @@ void *pfnPvEntPrivateData( edict_t *pEdict )
 
 
 #ifdef XASH_64BIT
+#define STR64_HASH_SIZE	4096	// initial size, grows to stay under half full
+
 static struct str64_s
 {
 	size_t maxstringarray;
@@ -3004,7 +3230,118 @@ static struct str64_s
 	size_t numdups;
 	size_t numoverflows;
 	size_t totalalloc;
+
+	// interned strings between poldstringbase and plast,
+	// offsets from pstringarray, zero is a free slot
+	uint *hashtable;
+	size_t hashsize;
+	size_t hashcount;
+	size_t numlookups;
+	size_t numprobes;
+	size_t numrebuilds;
+	double lookuptime;
 } str64;
+
+/*
+==================
+SV_Str64HashInsert
+
+==================
+*/
+static void SV_Str64HashInsert( const char *pstring )
+{
+	uint i, mask = str64.hashsize - 1;
+
+	i = COM_HashKey( pstring, UINT_MAX ) & mask;
+	while( str64.hashtable[i] )
+		i = ( i + 1 ) & mask;
+
+	str64.hashtable[i] = pstring - str64.pstringarray;
+	str64.hashcount++;
+}
+
+/*
+==================
+SV_Str64HashAdd
+
+add new string, grow the table when it gets half full
+==================
+*/
+static void SV_Str64HashAdd( const char *pstring )
+{
+	if(( str64.hashcount + 1 ) * 2 > str64.hashsize )
+	{
+		uint *oldtable = str64.hashtable;
+		size_t i, oldsize = str64.hashsize;
+
+		str64.hashsize *= 2;
+		str64.hashtable = Mem_Calloc( host.mempool, str64.hashsize * sizeof( uint ));
+		str64.hashcount = 0;
+
+		for( i = 0; i < oldsize; i++ )
+		{
+			if( oldtable[i] )
+				SV_Str64HashInsert( str64.pstringarray + oldtable[i] );
+		}
+
+		Mem_Free( oldtable );
+	}
+
+	SV_Str64HashInsert( pstring );
+}
+
+/*
+==================
+SV_Str64HashFind
+
+==================
+*/
+static const char *SV_Str64HashFind( const char *szValue )
+{
+	uint i, mask = str64.hashsize - 1;
+	const char *pstring = NULL;
+	double start = Sys_DoubleTime();
+
+	str64.numlookups++;
+
+	for( i = COM_HashKey( szValue, UINT_MAX ) & mask; str64.hashtable[i]; i = ( i + 1 ) & mask )
+	{
+		str64.numprobes++;
+
+		if( !Q_strcmp( str64.pstringarray + str64.hashtable[i], szValue ))
+		{
+			pstring = str64.pstringarray + str64.hashtable[i];
+			break;
+		}
+	}
+
+	str64.lookuptime += Sys_DoubleTime() - start;
+
+	return pstring;
+}
+
+/*
+==================
+SV_Str64HashRebuild
+
+index the strings that can be found again,
+called when the search range was moved
+==================
+*/
+static void SV_Str64HashRebuild( void )
+{
+	const char *pstring;
+
+	if( !str64.hashtable )
+		return;
+
+	memset( str64.hashtable, 0, str64.hashsize * sizeof( uint ));
+	str64.hashcount = 0;
+	str64.numrebuilds++;
+
+	for( pstring = str64.poldstringbase + 1; pstring < str64.plast; pstring += Q_strlen( pstring ) + 1 )
+		SV_Str64HashAdd( pstring );
+}
 #endif
 
 /*
@@ -3024,6 +3361,8 @@ void SV_EmptyStringPool( void )
 		str64.pstringbase = str64.poldstringbase = str64.pstringarraystatic;
 		str64.plast = str64.pstringbase + 1;
 	}
+
+	SV_Str64HashRebuild();
 #else
 	Mem_EmptyPool( svgame.stringspool );
 #endif
@@ -3142,6 +3481,13 @@ void SV_AllocStringPool( void )
 	str64.pstringbase = str64.poldstringbase = ptr;
 	str64.plast = ptr + 1;
 	svgame.globals->pStringBase = ptr;
+
+	if( !str64.allowdup )
+	{
+		str64.hashsize = STR64_HASH_SIZE;
+		str64.hashtable = Mem_Calloc( host.mempool, str64.hashsize * sizeof( uint ));
+		str64.hashcount = 0;
+	}
 #else
 	svgame.stringspool = Mem_AllocPool( "Server Strings" );
 	svgame.globals->pStringBase = "";
@@ -3157,6 +3503,10 @@ void SV_FreeStringPool( void )
 		munmap( str64.pstringarray, (str64.maxstringarray * 2) & ~(sysconf( _SC_PAGESIZE ) - 1) );
 	else
 		Mem_Free( str64.staticstringarray );
+
+	if( str64.hashtable )
+		Mem_Free( str64.hashtable );
+	str64.hashtable = NULL;
 #else
 	Mem_FreePool( &svgame.stringspool );
 #endif
@@ -3175,20 +3525,15 @@ use -str64dup to disable deduplication, -str64alloc to set array size
 string_t GAME_EXPORT SV_AllocString( const char *szValue )
 {
 	const char *newString = NULL;
-	int cmp;
 
 	if( svgame.physFuncs.pfnAllocString != NULL )
 		return svgame.physFuncs.pfnAllocString( szValue );
 
 #ifdef XASH_64BIT
-	cmp = 1;
-
 	if( !str64.allowdup )
-		for( newString = str64.poldstringbase + 1;
-			newString < str64.plast && ( cmp = Q_strcmp( newString, szValue ) );
-			newString += Q_strlen( newString ) + 1 );
+		newString = SV_Str64HashFind( szValue );
 
-	if( cmp )
+	if( !newString )
 	{
 		uint len = Q_strlen( szValue );
 
@@ -3197,6 +3542,7 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 			str64.plast = str64.pstringbase + 1;
 			str64.poldstringbase = str64.pstringbase;
 			str64.numoverflows++;
+			SV_Str64HashRebuild();
 		}
 
 		//MsgDev( D_NOTE, "SV_AllocString: %ld %s\n", str64.plast - svgame.globals->pStringBase, szValue );
@@ -3205,6 +3551,9 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 
 		newString = str64.plast;
 		str64.plast += len + 1;
+
+		if( str64.hashtable )
+			SV_Str64HashAdd( newString );
 	}
 	else
 		str64.numdups++;
@@ -3231,6 +3580,17 @@ void SV_PrintStr64Stats_f( void )
 	Msg( "maximum array usage: %lu\n", str64.maxalloc );
 	Msg( "overflow counter: %lu\n", str64.numoverflows );
 	Msg( "dup string counter: %lu\n", str64.numdups );
+
+	if( !str64.hashtable )
+	{
+		Msg( "deduplication disabled\n" );
+		return;
+	}
+
+	Msg( "interned strings: %lu, table size %lu (%.1f%% load)\n", str64.hashcount, str64.hashsize, str64.hashcount * 100.0 / str64.hashsize );
+	Msg( "lookups: %lu, %.2f probes per lookup, %.3f msec total\n", str64.numlookups,
+		str64.numlookups ? (double)str64.numprobes / str64.numlookups : 0.0, str64.lookuptime * 1000.0 );
+	Msg( "table rebuilds: %lu\n", str64.numrebuilds );
 }
 #endif
 
@@ -24,6 +24,8 @@ CVAR_DEFINE_AUTO( sv_lan, "0", 0, "server is a lan server ( no heartbeat, no aut
 CVAR_DEFINE_AUTO( sv_lan_rate, "20000.0", 0, "rate for lan server" );
 CVAR_DEFINE_AUTO( sv_aim, "1", FCVAR_ARCHIVE|FCVAR_SERVER, "auto aiming option" );
 CVAR_DEFINE_AUTO( sv_unlag, "1", 0, "allow lag compensation on server-side" );
+CVAR_DEFINE_AUTO( sv_idleskip, "1", 0, "skip physics of entities that neither move nor think this frame" );
+CVAR_DEFINE_AUTO( sv_broadcastarena, "1", 0, "write unreliable broadcast messages once and copy them into each client packet" );
 CVAR_DEFINE_AUTO( sv_maxunlag, "0.5", 0, "max latency value which can be interpolated (by default ping should not exceed 500 units)" );
 CVAR_DEFINE_AUTO( sv_unlagpush, "0.0", 0, "interpolation bias for unlag time" );
 CVAR_DEFINE_AUTO( sv_unlagsamples, "1", 0, "max samples to interpolate" );
@@ -645,6 +647,9 @@ void Host_ServerFrame( void )
 	// clear edict flags for next frame
 	SV_PrepWorldFrame ();
 
+	// hitbox hulls are cached for one frame
+	Mod_StudioCacheNewFrame ();
+
 	// send a heartbeat to the master if needed
 	Master_Heartbeat ();
 }
@@ -907,6 +912,8 @@ void SV_Init( void )
 	sv_reconnect_limit = Cvar_Get ("sv_reconnect_limit", "3", FCVAR_ARCHIVE, "max reconnect attempts" );
 	Cvar_RegisterVariable( &sv_failuretime );
 	Cvar_RegisterVariable( &sv_unlag );
+	Cvar_RegisterVariable( &sv_idleskip );
+	Cvar_RegisterVariable( &sv_broadcastarena );
 	Cvar_RegisterVariable( &sv_maxunlag );
 	Cvar_RegisterVariable( &sv_unlagpush );
 	Cvar_RegisterVariable( &sv_unlagsamples );
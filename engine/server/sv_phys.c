@@ -21,6 +21,19 @@ GNU General Public License for more details.
 #include "ref_common.h"
 
 typedef int (*PHYSICAPI)( int, server_physics_api_t*, physics_interface_t* );
+
+// entity loop counters for sv_physstats
+typedef struct
+{
+	size_t	frames;
+	size_t	entities;
+	size_t	idle;		// skipped with nothing to do
+	size_t	thinks;
+	double	time;
+	double	maxtime;
+} physcount_t;
+
+static physcount_t	sv_physcount;
 #if !XASH_DEDICATED
 extern triangleapi_t gTriApi;
 #endif
@@ -210,6 +223,7 @@ qboolean SV_RunThink( edict_t *ent )
 		ent->v.nextthink = 0.0f;
 		svgame.globals->time = thinktime;
 		svgame.dllFuncs.pfnThink( ent );
+		sv_physcount.thinks++;
 	}
 
 	if( FBitSet( ent->v.flags, FL_KILLME ))
@@ -1706,6 +1720,30 @@ void SV_Physics_None( edict_t *ent )
 	SV_RunThink( ent );
 }
 
+/*
+================
+SV_EntityIsIdle
+
+nothing in SV_Physics_Entity would happen for this entity.
+game dll writes nextthink and the rest whenever it likes,
+so it's checked every frame instead of keeping a schedule
+================
+*/
+static qboolean SV_EntityIsIdle( edict_t *ent )
+{
+	if( ent->v.movetype != MOVETYPE_NONE )
+		return false;
+
+	if( ent->v.nextthink > 0.0f && ent->v.nextthink <= ( sv.time + sv.frametime ))
+		return false;
+
+	// conveyors, base velocity and removal
+	if( FBitSet( ent->v.flags, FL_ONGROUND|FL_BASEVELOCITY|FL_KILLME ))
+		return false;
+
+	return VectorIsNull( ent->v.basevelocity );
+}
+
 //============================================================================
 static void SV_Physics_Entity( edict_t *ent )
 {
@@ -1777,7 +1815,9 @@ SV_Physics
 */
 void SV_Physics( void )
 {
+	qboolean	skipidle;
 	edict_t	*ent;
+	double	time;
 	int    	i;
 
 	SV_CheckAllEnts ();
@@ -1787,6 +1827,10 @@ void SV_Physics( void )
 	// let the progs know that a new frame has started
 	svgame.dllFuncs.pfnStartFrame();
 
+	// physics override must see every entity
+	skipidle = sv_idleskip.value && !svgame.physFuncs.SV_PhysicsEntity;
+	time = Sys_DoubleTime();
+
 	// treat each object in turn
 	for( i = 0; i < svgame.numEntities; i++ )
 	{
@@ -1798,9 +1842,23 @@ void SV_Physics( void )
 		if( i > 0 && i <= svs.maxclients )
 			continue;
 
+		sv_physcount.entities++;
+
+		// force_retouch relinks even the stationary ones, it may be set by any think
+		if( skipidle && svgame.globals->force_retouch == 0.0f && SV_EntityIsIdle( ent ))
+		{
+			sv_physcount.idle++;
+			continue;
+		}
+
 		SV_Physics_Entity( ent );
 	}
 
+	time = Sys_DoubleTime() - time;
+	sv_physcount.maxtime = Q_max( sv_physcount.maxtime, time );
+	sv_physcount.time += time;
+	sv_physcount.frames++;
+
 	if( svgame.globals->force_retouch != 0.0f )
 		svgame.globals->force_retouch--;
 
@@ -1817,6 +1875,31 @@ void SV_Physics( void )
 	for( ; EDICT_NUM( svgame.numEntities - 1 )->free; svgame.numEntities-- );
 }
 
+/*
+================
+SV_PhysStats_f
+
+entity loop of SV_Physics since the last call
+================
+*/
+void SV_PhysStats_f( void )
+{
+	physcount_t	*pc = &sv_physcount;
+
+	if( !pc->frames )
+	{
+		Con_Printf( "sv_physstats: no frames were run\n" );
+		return;
+	}
+
+	Con_Printf( "%lu frames, idle skip is %s\n", pc->frames, sv_idleskip.value ? "on" : "off" );
+	Con_Printf( "per frame: %.1f entities, %.1f idle, %.1f thinks\n", (double)pc->entities / pc->frames,
+		(double)pc->idle / pc->frames, (double)pc->thinks / pc->frames );
+	Con_Printf( "entity loop: %.3f msec average, %.3f msec max\n", pc->time * 1000.0 / pc->frames, pc->maxtime * 1000.0 );
+
+	memset( pc, 0, sizeof( *pc ));
+}
+
 /*
 ================
 SV_GetServerTime
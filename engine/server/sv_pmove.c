@@ -1097,7 +1097,12 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed )
 	SV_SetupPMove( svgame.pmove, cl, ucmd, cl->physinfo );
 
 	// motor!
+	// physents must stay in place while the game dll moves
+	// the player, broad-phase keeps their bounds until it's done.
+	// pm_broadphase 2 checks it in PM_ClearBroadPhase
+	PM_BuildBroadPhase( svgame.pmove );
 	svgame.dllFuncs.pfnPM_Move( svgame.pmove, true );
+	PM_ClearBroadPhase( svgame.pmove );
 
 	// copy results back to client
 	SV_FinishPMove( svgame.pmove, cl );
@@ -408,52 +408,276 @@ ENTITY AREA CHECKING
 static int	iTouchLinkSemaphore = 0;	// prevent recursion when SV_TouchLinks is active
 areanode_t	sv_areanodes[AREA_NODES];
 static int	sv_numareanodes;
+static int	sv_areadepth;
+
+// link lists walked by traces and touches, for sv_areastats
+static struct
+{
+	size_t	numtraces;
+	size_t	tracenodes;
+	size_t	tracelinks;
+	size_t	numtouches;
+	size_t	touchnodes;
+	size_t	touchlinks;
+} sv_areacount;
+
+// non-solid edicts don't fit in areanode_t lists, they are linked here
+// by the same node index, only spatial queries look at them
+static link_t	sv_areaother[AREA_NODES];
+
+// edicts that are not linked anywhere, one bit per edict,
+// edicts past MAX_EDICTS are checked directly
+static uint	sv_unlinked[MAX_EDICTS >> 5];
+
+typedef struct
+{
+	vec3_t	mins, maxs;	// sphere bounds
+	const float	*org;
+	float	radius2;
+	int	start;		// edicts up to this one are skipped
+	int	best;		// first edict found so far
+} spherequery_t;
+
+/*
+===============
+SV_MarkUnlinked
+
+===============
+*/
+static void SV_MarkUnlinked( edict_t *ent, qboolean unlinked )
+{
+	int	e = NUM_FOR_EDICT( ent );
+
+	if( e < 0 || e >= MAX_EDICTS )
+		return;
+
+	if( unlinked ) SetBits( sv_unlinked[e >> 5], BIT( e & 31 ));
+	else ClearBits( sv_unlinked[e >> 5], BIT( e & 31 ));
+}
+
+/*
+===============
+SV_AreaMedian
+
+k-th smallest value, reorders the array
+===============
+*/
+static float SV_AreaMedian( float *values, int count )
+{
+	int	left = 0, right = count - 1, k = count >> 1;
+	int	i, j;
+	float	pivot, temp;
+
+	while( left < right )
+	{
+		pivot = values[( left + right ) >> 1];
+		i = left;
+		j = right;
+
+		while( i <= j )
+		{
+			while( values[i] < pivot ) i++;
+			while( values[j] > pivot ) j--;
+
+			if( i <= j )
+			{
+				temp = values[i];
+				values[i] = values[j];
+				values[j] = temp;
+				i++;
+				j--;
+			}
+		}
+
+		if( k <= j ) right = j;
+		else if( k >= i ) left = i;
+		else break;
+	}
+
+	return values[k];
+}
 
 /*
 ===============
 SV_CreateAreaNode
 
-builds a uniformly subdivided tree for the given world size
+builds a tree for the given world size.
+the uniform tree always has AREA_DEPTH levels split in the middle,
+otherwise large regions are split until they are AREA_LEAF_SIZE
+and crowded ones until AREA_MIN_SIZE, at the median of the edicts
 ===============
 */
-areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
+static areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs, vec3_t *centers, int numcenters, qboolean uniform )
 {
 	areanode_t	*anode;
 	vec3_t		size;
 	vec3_t		mins1, maxs1;
 	vec3_t		mins2, maxs2;
+	vec3_t		swap;
+	int		i, j, axis;
+	float		*values;
+	qboolean		split;
 
 	anode = &sv_areanodes[sv_numareanodes++];
 
 	ClearLink( &anode->trigger_edicts );
 	ClearLink( &anode->solid_edicts );
 	ClearLink( &anode->portal_edicts );
+	ClearLink( &sv_areaother[anode - sv_areanodes] );
+
+	VectorSubtract( maxs, mins, size );
+	if( size[0] > size[1] )
+		axis = 0;
+	else axis = 1;
+
+	if( uniform )
+		split = ( depth < AREA_DEPTH );
+	else if( depth >= AREA_MAX_DEPTH )
+		split = false;
+	else if( numcenters > AREA_MIN_LINKS )
+		split = ( size[axis] > AREA_MIN_SIZE );
+	else split = ( size[axis] > AREA_LEAF_SIZE );
+
+	sv_areadepth = Q_max( sv_areadepth, depth );
 
-	if( depth == AREA_DEPTH )
+	if( !split )
 	{
 		anode->axis = -1;
 		anode->children[0] = anode->children[1] = NULL;
 		return anode;
 	}
 
-	VectorSubtract( maxs, mins, size );
-	if( size[0] > size[1] )
-		anode->axis = 0;
-	else anode->axis = 1;
+	anode->axis = axis;
+	anode->dist = 0.5f * ( maxs[axis] + mins[axis] );
+
+	if( !uniform && numcenters > AREA_MIN_LINKS )
+	{
+		// split at the median, but don't cut off thin slices
+		values = Mem_Malloc( host.mempool, numcenters * sizeof( float ));
+		for( i = 0; i < numcenters; i++ )
+			values[i] = centers[i][axis];
+		anode->dist = SV_AreaMedian( values, numcenters );
+		anode->dist = bound( mins[axis] + size[axis] * 0.25f, anode->dist, maxs[axis] - size[axis] * 0.25f );
+		Mem_Free( values );
+	}
+
+	// edicts above the plane go first
+	for( i = 0, j = numcenters - 1; i <= j; )
+	{
+		if( centers[i][axis] > anode->dist )
+		{
+			i++;
+			continue;
+		}
+
+		VectorCopy( centers[i], swap );
+		VectorCopy( centers[j], centers[i] );
+		VectorCopy( swap, centers[j] );
+		j--;
+	}
 
-	anode->dist = 0.5f * ( maxs[anode->axis] + mins[anode->axis] );
 	VectorCopy( mins, mins1 );
 	VectorCopy( mins, mins2 );
 	VectorCopy( maxs, maxs1 );
 	VectorCopy( maxs, maxs2 );
 
-	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
-	anode->children[0] = SV_CreateAreaNode( depth+1, mins2, maxs2 );
-	anode->children[1] = SV_CreateAreaNode( depth+1, mins1, maxs1 );
+	maxs1[axis] = mins2[axis] = anode->dist;
+	anode->children[0] = SV_CreateAreaNode( depth+1, mins2, maxs2, centers, i, uniform );
+	anode->children[1] = SV_CreateAreaNode( depth+1, mins1, maxs1, centers + i, numcenters - i, uniform );
 
 	return anode;
 }
 
+/*
+===============
+SV_AreaNodeForEdict
+
+find the first node that the ent's box crosses
+===============
+*/
+static areanode_t *SV_AreaNodeForEdict( edict_t *ent )
+{
+	areanode_t	*node = sv_areanodes;
+
+	while( 1 )
+	{
+		if( node->axis == -1 ) break;
+		if( ent->v.absmin[node->axis] > node->dist )
+			node = node->children[0];
+		else if( ent->v.absmax[node->axis] < node->dist )
+			node = node->children[1];
+		else break; // crosses the node
+	}
+
+	return node;
+}
+
+/*
+===============
+SV_InsertAreaLink
+
+put the edict into the list of the node,
+non-solid bodies are ignored by the physics
+===============
+*/
+static void SV_InsertAreaLink( edict_t *ent, areanode_t *node )
+{
+	SV_MarkUnlinked( ent, false );
+
+	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
+		InsertLinkBefore( &ent->area, &sv_areaother[node - sv_areanodes] );
+	else if( ent->v.solid == SOLID_TRIGGER )
+		InsertLinkBefore( &ent->area, &node->trigger_edicts );
+	else if( ent->v.solid == SOLID_PORTAL )
+		InsertLinkBefore( &ent->area, &node->portal_edicts );
+	else InsertLinkBefore( &ent->area, &node->solid_edicts );
+}
+
+/*
+===============
+SV_BuildAreaNodes
+
+rebuild the tree for the edicts that are in the world now
+and move them to the new nodes. no touches are called
+===============
+*/
+void SV_BuildAreaNodes( qboolean uniform )
+{
+	edict_t	**ents;
+	vec3_t	*centers;
+	int	i, numents = 0;
+
+	if( !sv.worldmodel )
+		return;
+
+	ents = Mem_Malloc( host.mempool, svgame.numEntities * sizeof( edict_t* ));
+	centers = Mem_Malloc( host.mempool, svgame.numEntities * sizeof( vec3_t ));
+
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		edict_t	*ent = EDICT_NUM( i );
+
+		if( !ent->area.prev )
+			continue;
+
+		VectorAverage( ent->v.absmin, ent->v.absmax, centers[numents] );
+		ents[numents++] = ent;
+	}
+
+	sv_numareanodes = 0;
+	sv_areadepth = 0;
+	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs, centers, numents, uniform );
+
+	for( i = 0; i < numents; i++ )
+	{
+		ents[i]->area.prev = ents[i]->area.next = NULL;
+		SV_InsertAreaLink( ents[i], SV_AreaNodeForEdict( ents[i] ));
+	}
+
+	Mem_Free( centers );
+	Mem_Free( ents );
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -474,10 +698,14 @@ void SV_ClearWorld( void )
 	}
 
 	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	memset( sv_unlinked, 0xFF, sizeof( sv_unlinked ));
 	iTouchLinkSemaphore = 0;
 	sv_numareanodes = 0;
+	sv_areadepth = 0;
 
-	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+	// sized from the world bounds, SV_BuildAreaNodes
+	// refines it once the entities are spawned
+	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs, NULL, 0, false );
 }
 
 /*
@@ -490,6 +718,7 @@ void SV_UnlinkEdict( edict_t *ent )
 	// not linked in anywhere
 	if( !ent->area.prev ) return;
 
+	SV_MarkUnlinked( ent, true );
 	RemoveLink( &ent->area );
 	ent->area.prev = NULL;
 	ent->area.next = NULL;
@@ -508,11 +737,14 @@ void SV_TouchLinks( edict_t *ent, areanode_t *node )
 	vec3_t	test, offset;
 	model_t	*mod;
 
+	sv_areacount.touchnodes++;
+
 	// touch linked edicts
 	for( l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next )
 	{
 		next = l->next;
 		touch = EDICT_FROM_AREA( l );
+		sv_areacount.touchlinks++;
 
 		if( svgame.physFuncs.SV_TriggerTouch != NULL )
 		{
@@ -665,36 +897,178 @@ void SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
 		}
 	}
 
+	// link it in
+	node = SV_AreaNodeForEdict( ent );
+	SV_InsertAreaLink( ent, node );
+
 	// ignore non-solid bodies
 	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
 		return;
 
-	// find the first node that the ent's box crosses
-	node = sv_areanodes;
+	if( touch_triggers && !iTouchLinkSemaphore )
+	{
+		sv_areacount.numtouches++;
+		iTouchLinkSemaphore = true;
+		SV_TouchLinks( ent, sv_areanodes );
+		iTouchLinkSemaphore = false;
+	}
+}
+
+/*
+====================
+SV_EntityInSphere
+
+====================
+*/
+static qboolean SV_EntityInSphere( edict_t *ent, const spherequery_t *q )
+{
+	float	distSquared = 0.0f;
+	float	eorg;
+	int	j;
+
+	for( j = 0; j < 3 && distSquared <= q->radius2; j++ )
+	{
+		if( q->org[j] < ent->v.absmin[j] )
+			eorg = q->org[j] - ent->v.absmin[j];
+		else if( q->org[j] > ent->v.absmax[j] )
+			eorg = q->org[j] - ent->v.absmax[j];
+		else eorg = 0.0f;
+
+		distSquared += eorg * eorg;
+	}
+
+	return ( distSquared < q->radius2 );
+}
+
+/*
+====================
+SV_SphereLinks
+
+====================
+*/
+static void SV_SphereLinks( link_t *list, spherequery_t *q )
+{
+	edict_t	*ent;
+	link_t	*l;
+	int	e;
+
+	for( l = list->next; l != list; l = l->next )
+	{
+		// same as EDICT_FROM_AREA without the pointer truncation
+		ent = (edict_t *)((byte *)l - offsetof( edict_t, area ));
+		e = NUM_FOR_EDICT( ent );
 
+		if( e <= q->start || e >= q->best )
+			continue;
+
+		if( !SV_IsValidEdict( ent ))
+			continue;
+
+		// ignore clients that not in a game
+		if( e <= svs.maxclients && !SV_ClientFromEdict( ent, true ))
+			continue;
+
+		if( SV_EntityInSphere( ent, q ))
+			q->best = e;
+	}
+}
+
+/*
+====================
+SV_AreaSphere_r
+
+====================
+*/
+static void SV_AreaSphere_r( areanode_t *node, spherequery_t *q )
+{
 	while( 1 )
 	{
-		if( node->axis == -1 ) break;
-		if( ent->v.absmin[node->axis] > node->dist )
+		SV_SphereLinks( &node->trigger_edicts, q );
+		SV_SphereLinks( &node->solid_edicts, q );
+		SV_SphereLinks( &node->portal_edicts, q );
+		SV_SphereLinks( &sv_areaother[node - sv_areanodes], q );
+
+		if( node->axis == -1 )
+			return;
+
+		if( q->maxs[node->axis] > node->dist && q->mins[node->axis] < node->dist )
+		{
+			SV_AreaSphere_r( node->children[0], q );
+			node = node->children[1];
+		}
+		else if( q->maxs[node->axis] > node->dist )
 			node = node->children[0];
-		else if( ent->v.absmax[node->axis] < node->dist )
+		else if( q->mins[node->axis] < node->dist )
 			node = node->children[1];
-		else break; // crosses the node
+		else return;
 	}
+}
 
-	// link it in
-	if( ent->v.solid == SOLID_TRIGGER )
-		InsertLinkBefore( &ent->area, &node->trigger_edicts );
-	else if( ent->v.solid == SOLID_PORTAL )
-		InsertLinkBefore( &ent->area, &node->portal_edicts );
-	else InsertLinkBefore( &ent->area, &node->solid_edicts );
+/*
+====================
+SV_AreaEntityInSphere
 
-	if( touch_triggers && !iTouchLinkSemaphore )
+returns the lowest edict number after start that
+touches the sphere, numEntities if there is none.
+same result as testing every edict in order
+====================
+*/
+int SV_AreaEntityInSphere( int start, const vec3_t org, float radius )
+{
+	spherequery_t	q;
+	float		size = fabs( radius ) + 1.0f; // don't lose edicts to rounding
+	edict_t		*ent;
+	uint		bits;
+	int		i, e;
+
+	VectorSet( q.mins, org[0] - size, org[1] - size, org[2] - size );
+	VectorSet( q.maxs, org[0] + size, org[1] + size, org[2] + size );
+	q.org = org;
+	q.radius2 = radius * radius;
+	q.start = start;
+	q.best = svgame.numEntities;
+
+	SV_AreaSphere_r( sv_areanodes, &q );
+
+	// edicts that never were linked still keep their bounds
+	for( i = ( start + 1 ) >> 5; ( i << 5 ) < q.best && i < ( MAX_EDICTS >> 5 ); i++ )
 	{
-		iTouchLinkSemaphore = true;
-		SV_TouchLinks( ent, sv_areanodes );
-		iTouchLinkSemaphore = false;
+		if( !( bits = sv_unlinked[i] ))
+			continue;
+
+		for( e = i << 5; bits && e < q.best; e++, bits >>= 1 )
+		{
+			if( !( bits & 1 ) || e <= start )
+				continue;
+
+			ent = EDICT_NUM( e );
+
+			if( !SV_IsValidEdict( ent ))
+				continue;
+
+			if( e <= svs.maxclients && !SV_ClientFromEdict( ent, true ))
+				continue;
+
+			if( SV_EntityInSphere( ent, &q ))
+			{
+				q.best = e;
+				break;
+			}
+		}
 	}
+
+	for( e = Q_max( start + 1, MAX_EDICTS ); e < q.best; e++ )
+	{
+		ent = EDICT_NUM( e );
+
+		if( ent->area.prev || !SV_IsValidEdict( ent ))
+			continue;
+
+		if( SV_EntityInSphere( ent, &q ))
+			q.best = e;
+	}
+
+	return q.best;
 }
 
 /*
@@ -711,6 +1085,7 @@ void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
 	hull_t	*hull;
 	vec3_t	test, offset;
 	model_t	*mod;
+	int	cont;
 
 	// get water edicts
 	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
@@ -755,8 +1130,13 @@ void SV_WaterLinks( const vec3_t origin, int *pCont, areanode_t *node )
 			VectorSubtract( origin, offset, test );
 		}
 
-		// test hull for intersection with this model
-		if( PM_HullPointContents( hull, hull->firstclipnode, test ) == CONTENTS_EMPTY )
+		// test hull for intersection with this model, the custom
+		// hulls from physics interface may be rebuilt at any time
+		if( hull >= mod->hulls && hull < mod->hulls + MAX_MAP_HULLS )
+			cont = PM_HullPointContentsCached( hull, hull->firstclipnode, test );
+		else cont = PM_HullPointContents( hull, hull->firstclipnode, test );
+
+		if( cont == CONTENTS_EMPTY )
 			continue;
 
 		// compare contents ranking
@@ -787,7 +1167,7 @@ int SV_TruePointContents( const vec3_t p )
 	if( !p ) return CONTENTS_NONE;
 
 	// get base contents from world
-	cont = PM_HullPointContents( &sv.worldmodel->hulls[0], 0, p );
+	cont = PM_HullPointContentsCached( &sv.worldmodel->hulls[0], 0, p );
 
 	// check all water entities
 	SV_WaterLinks( p, &cont, sv_areanodes );
@@ -1247,10 +1627,13 @@ static void SV_ClipToLinks( areanode_t *node, moveclip_t *clip )
 	link_t	*l, *next;
 	edict_t	*touch;
 
+	sv_areacount.tracenodes++;
+
 	// touch linked edicts
 	for( l = node->solid_edicts.next; l != &node->solid_edicts; l = next )
 	{
 		next = l->next;
+		sv_areacount.tracelinks++;
 
 		touch = EDICT_FROM_AREA( l );
 
@@ -1279,10 +1662,13 @@ static void SV_ClipToPortals( areanode_t *node, moveclip_t *clip )
 	link_t	*l, *next;
 	edict_t	*touch;
 
+	sv_areacount.tracenodes++;
+
 	// touch linked edicts
 	for( l = node->portal_edicts.next; l != &node->portal_edicts; l = next )
 	{
 		next = l->next;
+		sv_areacount.tracelinks++;
 
 		touch = EDICT_FROM_AREA( l );
 
@@ -1384,6 +1770,7 @@ trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
 		}
 
 		World_MoveBounds( start, clip.mins2, clip.maxs2, trace_endpos, clip.boxmins, clip.boxmaxs );
+		sv_areacount.numtraces++;
 		SV_ClipToLinks( sv_areanodes, &clip );
 		SV_ClipToPortals( sv_areanodes, &clip );
 
@@ -1396,6 +1783,231 @@ trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
 	return clip.trace;
 }
 
+/*
+==================
+SV_AreaStats_f
+
+print the area tree and the link lists visited since last call
+==================
+*/
+void SV_AreaStats_f( void )
+{
+	int	i, count, total = 0, maxcount = 0, numleafs = 0;
+	link_t	*lists[4], *l;
+
+	for( i = 0; i < sv_numareanodes; i++ )
+	{
+		int	j;
+
+		lists[0] = &sv_areanodes[i].trigger_edicts;
+		lists[1] = &sv_areanodes[i].solid_edicts;
+		lists[2] = &sv_areanodes[i].portal_edicts;
+		lists[3] = &sv_areaother[i];
+
+		for( j = 0, count = 0; j < 4; j++ )
+		{
+			for( l = lists[j]->next; l != lists[j]; l = l->next )
+				count++;
+		}
+
+		if( sv_areanodes[i].axis == -1 )
+			numleafs++;
+		maxcount = Q_max( maxcount, count );
+		total += count;
+	}
+
+	Con_Printf( "area tree: %i nodes, %i leafs, depth %i\n", sv_numareanodes, numleafs, sv_areadepth );
+	Con_Printf( "linked edicts: %i, at most %i in one node\n", total, maxcount );
+
+	if( sv_areacount.numtraces )
+	{
+		Con_Printf( "traces: %lu, %.1f nodes and %.1f links per trace\n", sv_areacount.numtraces,
+			(double)sv_areacount.tracenodes / sv_areacount.numtraces, (double)sv_areacount.tracelinks / sv_areacount.numtraces );
+	}
+
+	if( sv_areacount.numtouches )
+	{
+		Con_Printf( "touches: %lu, %.1f nodes and %.1f links per touch\n", sv_areacount.numtouches,
+			(double)sv_areacount.touchnodes / sv_areacount.numtouches, (double)sv_areacount.touchlinks / sv_areacount.numtouches );
+	}
+
+	memset( &sv_areacount, 0, sizeof( sv_areacount ));
+}
+
+/*
+==================
+SV_TraceBench_f
+
+trace hulls between the entities of the map,
+with the uniform tree and with the adaptive one
+==================
+*/
+void SV_TraceBench_f( void )
+{
+	static vec3_t	hullmins[2] = {{ 0.0f, 0.0f, 0.0f }, { -16.0f, -16.0f, -36.0f }};
+	static vec3_t	hullmaxs[2] = {{ 0.0f, 0.0f, 0.0f }, { 16.0f, 16.0f, 36.0f }};
+	int		i, pass, count = 10000, numents = 0;
+	vec3_t		*origins, start, end;
+	double		time;
+	uint		seed;
+
+	if( sv.state != ss_active || !sv.worldmodel )
+	{
+		Con_Printf( "sv_tracebench: server is not active\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 )
+		count = Q_max( 1, Q_atoi( Cmd_Argv( 1 )));
+
+	// trace from one entity to another, most of them stand in the open
+	origins = Mem_Malloc( host.mempool, svgame.numEntities * sizeof( vec3_t ));
+
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		edict_t	*ent = EDICT_NUM( i );
+
+		if( !SV_IsValidEdict( ent ) || !ent->area.prev )
+			continue;
+
+		VectorAverage( ent->v.absmin, ent->v.absmax, origins[numents] );
+		numents++;
+	}
+
+	if( numents < 2 )
+	{
+		Con_Printf( "sv_tracebench: not enough entities\n" );
+		Mem_Free( origins );
+		return;
+	}
+
+	// the adaptive tree goes last, it stays
+	for( pass = 0; pass < 2; pass++ )
+	{
+		SV_BuildAreaNodes( pass == 0 );
+		memset( &sv_areacount, 0, sizeof( sv_areacount ));
+		seed = 0x1234567;
+
+		time = Sys_DoubleTime();
+
+		for( i = 0; i < count; i++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			VectorCopy( origins[( seed >> 8 ) % numents], start );
+			seed = seed * 1103515245 + 12345;
+			VectorCopy( origins[( seed >> 8 ) % numents], end );
+
+			SV_Move( start, hullmins[i & 1], hullmaxs[i & 1], end, MOVE_NORMAL, NULL, false );
+		}
+
+		time = Sys_DoubleTime() - time;
+
+		Con_Printf( "%s tree, %i nodes: %.2f usec per trace, %.1f nodes and %.1f links visited\n",
+			pass ? "adaptive" : "uniform", sv_numareanodes, time * 1e6 / count,
+			(double)sv_areacount.tracenodes / count, (double)sv_areacount.tracelinks / count );
+	}
+
+	memset( &sv_areacount, 0, sizeof( sv_areacount ));
+	Mem_Free( origins );
+}
+
+/*
+==================
+SV_ContentsTest_f
+
+check cached point contents of the world hulls
+against the full descent and time them both
+==================
+*/
+void SV_ContentsTest_f( void )
+{
+	int		i, j, count = 100000, numents = 0, mismatches = 0;
+	int		sum[2];
+	vec3_t		*points, center;
+	double		time[2];
+	hull_t		*hull;
+	uint		seed = 0x1234567;
+
+	if( sv.state != ss_active || !sv.worldmodel )
+	{
+		Con_Printf( "sv_contentstest: server is not active\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 )
+		count = Q_max( 1, Q_atoi( Cmd_Argv( 1 )));
+
+	// counters collected by the game so far
+	Con_Printf( "game queries:\n" );
+	PM_PrintContentsCacheStats( true );
+
+	// half of points around the entities, where the queries are
+	// coming from, the rest is anywhere inside the world bounds
+	points = Mem_Malloc( host.mempool, count * sizeof( vec3_t ));
+
+	for( i = 0; i < count; i++ )
+	{
+		edict_t	*ent = NULL;
+
+		seed = seed * 1103515245 + 12345;
+
+		if( i & 1 )
+		{
+			ent = EDICT_NUM( 1 + ( seed >> 8 ) % Q_max( 1, svgame.numEntities - 1 ));
+			if( !SV_IsValidEdict( ent ) || !ent->area.prev )
+				ent = NULL;
+		}
+
+		if( ent )
+		{
+			VectorAverage( ent->v.absmin, ent->v.absmax, center );
+			for( j = 0; j < 3; j++ )
+				points[i][j] = center[j] + COM_RandomFloat( -64.0f, 64.0f );
+			numents++;
+		}
+		else
+		{
+			for( j = 0; j < 3; j++ )
+				points[i][j] = COM_RandomFloat( sv.worldmodel->mins[j], sv.worldmodel->maxs[j] );
+		}
+	}
+
+	for( j = 0; j < MAX_MAP_HULLS; j++ )
+	{
+		hull = &sv.worldmodel->hulls[j];
+
+		if( !hull->planes )
+			continue;
+
+		time[0] = Sys_DoubleTime();
+		for( i = sum[0] = 0; i < count; i++ )
+			sum[0] += PM_HullPointContents( hull, hull->firstclipnode, points[i] );
+		time[0] = Sys_DoubleTime() - time[0];
+
+		time[1] = Sys_DoubleTime();
+		for( i = sum[1] = 0; i < count; i++ )
+			sum[1] += PM_HullPointContentsCached( hull, hull->firstclipnode, points[i] );
+		time[1] = Sys_DoubleTime() - time[1];
+
+		// second pass compares every point, the cache is warm now
+		for( i = 0; i < count; i++ )
+		{
+			if( PM_HullPointContentsCached( hull, hull->firstclipnode, points[i] ) != PM_HullPointContents( hull, hull->firstclipnode, points[i] ))
+				mismatches++;
+		}
+
+		if( sum[0] != sum[1] )
+			mismatches++;
+
+		Con_Printf( "hull %i: %.3f usec full descent, %.3f usec cached\n", j, time[0] * 1e6 / count, time[1] * 1e6 / count );
+	}
+
+	Con_Printf( "test queries:\n" );
+	PM_PrintContentsCacheStats( true );
+	Con_Printf( "%i points, %i near entities: %s, %i mismatches\n", count, numents, mismatches ? "FAILED" : "passed", mismatches );
+	Mem_Free( points );
+}
+
 trace_t SV_MoveNormal( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e )
 {
 	return SV_Move( start, mins, maxs, end, type, e, false );
@@ -65,8 +65,10 @@ For more information, please refer to <http://unlicense.org/>
 #undef XASH_MIPS
 #undef XASH_MOBILE_PLATFORM
 #undef XASH_MSVC
+#undef XASH_NEON
 #undef XASH_NETBSD
 #undef XASH_OPENBSD
+#undef XASH_SSE2
 #undef XASH_WIN32
 #undef XASH_WIN64
 #undef XASH_X86
@@ -211,6 +213,19 @@ For more information, please refer to <http://unlicense.org/>
 	#define XASH_64BIT 1
 #endif
 
+//================================================================
+//
+//           INSTRUCTION SET DEFINES
+//
+//================================================================
+#if defined __SSE2__ || defined _M_X64 || ( defined _M_IX86_FP && _M_IX86_FP >= 2 )
+	#define XASH_SSE2 1
+#endif
+
+#if defined __ARM_NEON || defined __ARM_NEON__
+	#define XASH_NEON 1
+#endif
+
 #if XASH_ARM == 8
 	#define XASH_ARMv8 1
 #elif XASH_ARM == 7
@@ -0,0 +1,456 @@
+/*
+r_worldcull.c - bsp world culling shared by the renderers
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "port.h"
+#include "xash3d_types.h"
+#include "cvardef.h"
+#include "const.h"
+#include "com_model.h"
+#include "cl_entity.h"
+#include "render_api.h"
+#include "ref_api.h"
+#include "xash3d_mathlib.h"
+#include "crtlib.h"
+#include "r_worldcull.h"
+
+#if XASH_SSE2
+#include <emmintrin.h>
+#endif
+
+#define Mem_Malloc( pool, size ) gEngfuncs._Mem_Alloc( pool, size, false, __FILE__, __LINE__ )
+#define Mem_Calloc( pool, size ) gEngfuncs._Mem_Alloc( pool, size, true, __FILE__, __LINE__ )
+#define Mem_Free( mem ) gEngfuncs._Mem_Free( mem, __FILE__, __LINE__ )
+#define Assert(x) if(!( x )) gEngfuncs.Host_Error( "assert failed at %s:%i\n", __FILE__, __LINE__ )
+
+// every renderer has one
+extern ref_api_t	gEngfuncs;
+
+/*
+=============================================================
+
+  WORLD TABLES
+
+=============================================================
+*/
+/*
+===============
+R_WorldCullFree
+
+===============
+*/
+void R_WorldCullFree( worldcull_t *wc )
+{
+	int	i;
+
+	if( wc->boundsbase )
+		Mem_Free( wc->boundsbase );
+
+	if( wc->visible )
+		Mem_Free( wc->visible );
+
+	for( i = 0; i < CULL_PVS_CACHE; i++ )
+	{
+		if( wc->pvs[i].visbytes )
+			Mem_Free( wc->pvs[i].visbytes );
+
+		if( wc->pvs[i].leafs )
+			Mem_Free( wc->pvs[i].leafs );
+	}
+
+	memset( wc, 0, sizeof( *wc ));
+}
+
+/*
+===============
+R_WorldCullInit
+
+pack node and leaf bounds of the world,
+must be called for every new map
+===============
+*/
+void R_WorldCullInit( worldcull_t *wc, model_t *world, byte *mempool )
+{
+	int		i, count;
+	mnode_t		*node;
+	mleaf_t		*leaf;
+	float		*out;
+
+	R_WorldCullFree( wc );
+
+	if( !world || world->type != mod_brush )
+		return;
+
+	wc->model = world;
+	wc->mempool = mempool;
+	count = world->numnodes + world->numleafs + 1;
+
+	// bounds are read four floats at time
+	wc->boundsbase = Mem_Calloc( mempool, count * 8 * sizeof( float ) + 15 );
+	wc->bounds = (float *)(((size_t)wc->boundsbase + 15 ) & ~(size_t)15 );
+
+	for( i = 0, node = world->nodes, out = wc->bounds; i < world->numnodes; i++, node++, out += 8 )
+	{
+		VectorCopy( node->minmaxs, out );
+		VectorCopy( node->minmaxs + 3, out + 4 );
+	}
+
+	for( i = 0, leaf = world->leafs; i <= world->numleafs; i++, leaf++, out += 8 )
+	{
+		VectorCopy( leaf->minmaxs, out );
+		VectorCopy( leaf->minmaxs + 3, out + 4 );
+	}
+
+	wc->visible = Mem_Malloc( mempool, count * sizeof( cullnode_t ));
+	wc->visbytes = ( world->numleafs + 7 ) >> 3;
+
+	for( i = 0; i < CULL_PVS_CACHE; i++ )
+		wc->pvs[i].leaf1 = wc->pvs[i].leaf2 = -1;
+}
+
+static int R_WorldCullIndex( const worldcull_t *wc, const mnode_t *node )
+{
+	if( node->contents < 0 )
+		return wc->model->numnodes + ((const mleaf_t *)node - wc->model->leafs );
+	return node - wc->model->nodes;
+}
+
+/*
+=============================================================
+
+  FRUSTUM TESTS
+
+=============================================================
+*/
+/*
+===============
+R_WorldCullSetPlane
+
+===============
+*/
+void R_WorldCullSetPlane( cullplanes_t *cp, int side, const vec3_t normal, float dist )
+{
+	int	group = side >> 2;
+	int	lane = side & 3;
+
+	Assert( side >= 0 && side < CULL_MAX_PLANES );
+
+	cp->normal[group][0][lane] = normal[0];
+	cp->normal[group][1][lane] = normal[1];
+	cp->normal[group][2][lane] = normal[2];
+	cp->dist[group][lane] = dist;
+	cp->numplanes = Q_max( cp->numplanes, side + 1 );
+}
+
+/*
+===============
+R_WorldCullSetPlanes
+
+===============
+*/
+void R_WorldCullSetPlanes( cullplanes_t *cp, const mplane_t *planes, int numplanes )
+{
+	int	i;
+
+	memset( cp, 0, sizeof( *cp ));
+
+	for( i = 0; i < numplanes; i++ )
+		R_WorldCullSetPlane( cp, i, planes[i].normal, planes[i].dist );
+}
+
+/*
+===============
+R_WorldCullPacked
+
+test the box against every plane in clipflags,
+returns -1 if the box is behind any of them (or touches
+one, if cp->inclusive), or clipflags without the planes
+it is in front of.
+the distances are summed in the same order as BoxOnPlaneSide does
+===============
+*/
+static int R_WorldCullPacked( const cullplanes_t *cp, const float *bounds, int clipflags )
+{
+	int	group, bits, outside, inside;
+#if XASH_SSE2
+	__m128	mins = _mm_load_ps( bounds );
+	__m128	maxs = _mm_load_ps( bounds + 4 );
+	__m128	minx = _mm_shuffle_ps( mins, mins, _MM_SHUFFLE( 0, 0, 0, 0 ));
+	__m128	miny = _mm_shuffle_ps( mins, mins, _MM_SHUFFLE( 1, 1, 1, 1 ));
+	__m128	minz = _mm_shuffle_ps( mins, mins, _MM_SHUFFLE( 2, 2, 2, 2 ));
+	__m128	maxx = _mm_shuffle_ps( maxs, maxs, _MM_SHUFFLE( 0, 0, 0, 0 ));
+	__m128	maxy = _mm_shuffle_ps( maxs, maxs, _MM_SHUFFLE( 1, 1, 1, 1 ));
+	__m128	maxz = _mm_shuffle_ps( maxs, maxs, _MM_SHUFFLE( 2, 2, 2, 2 ));
+
+	for( group = 0; group < 2; group++ )
+	{
+		__m128	n, lo, hi, dmax, dmin, dist;
+
+		bits = ( clipflags >> ( group << 2 )) & 15;
+		if( !bits ) continue;
+
+		// the corner farthest along the normal is max( n * mins, n * maxs ) per axis
+		n = _mm_loadu_ps( cp->normal[group][0] );
+		lo = _mm_mul_ps( n, minx );
+		hi = _mm_mul_ps( n, maxx );
+		dmax = _mm_max_ps( lo, hi );
+		dmin = _mm_min_ps( lo, hi );
+
+		n = _mm_loadu_ps( cp->normal[group][1] );
+		lo = _mm_mul_ps( n, miny );
+		hi = _mm_mul_ps( n, maxy );
+		dmax = _mm_add_ps( dmax, _mm_max_ps( lo, hi ));
+		dmin = _mm_add_ps( dmin, _mm_min_ps( lo, hi ));
+
+		n = _mm_loadu_ps( cp->normal[group][2] );
+		lo = _mm_mul_ps( n, minz );
+		hi = _mm_mul_ps( n, maxz );
+		dmax = _mm_add_ps( dmax, _mm_max_ps( lo, hi ));
+		dmin = _mm_add_ps( dmin, _mm_min_ps( lo, hi ));
+
+		dist = _mm_loadu_ps( cp->dist[group] );
+		if( cp->inclusive )
+			outside = _mm_movemask_ps( _mm_cmple_ps( dmax, dist ));
+		else outside = _mm_movemask_ps( _mm_cmplt_ps( dmax, dist ));
+		inside = _mm_movemask_ps( _mm_cmpge_ps( dmin, dist ));
+
+		if( outside & bits )
+			return -1;
+
+		clipflags &= ~(( inside & bits ) << ( group << 2 ));
+	}
+#else
+	int	i, j;
+
+	for( group = 0; group < 2; group++ )
+	{
+		bits = ( clipflags >> ( group << 2 )) & 15;
+		if( !bits ) continue;
+
+		outside = inside = 0;
+
+		for( i = 0; i < 4; i++ )
+		{
+			float	dmax = 0.0f, dmin = 0.0f;
+
+			if( !FBitSet( bits, BIT( i )))
+				continue;
+
+			for( j = 0; j < 3; j++ )
+			{
+				float	lo = cp->normal[group][j][i] * bounds[j];
+				float	hi = cp->normal[group][j][i] * bounds[j + 4];
+
+				dmax += Q_max( lo, hi );
+				dmin += Q_min( lo, hi );
+			}
+
+			if( dmax < cp->dist[group][i] || ( cp->inclusive && dmax == cp->dist[group][i] ))
+				outside |= BIT( i );
+			if( dmin >= cp->dist[group][i] )
+				inside |= BIT( i );
+		}
+
+		if( outside )
+			return -1;
+
+		clipflags &= ~( inside << ( group << 2 ));
+	}
+#endif
+	return clipflags;
+}
+
+/*
+=============================================================
+
+  PVS CACHE
+
+=============================================================
+*/
+/*
+===============
+R_WorldCullFindPVS
+
+restore the pvs computed for the same view leafs,
+a negative leaf1 is never cached
+===============
+*/
+qboolean R_WorldCullFindPVS( worldcull_t *wc, int leaf1, int leaf2, qboolean novis, byte *visbytes )
+{
+	cullpvs_t	*pvs;
+	int	i;
+
+	if( !wc->model || leaf1 < 0 )
+		return false;
+
+	for( i = 0, pvs = wc->pvs; i < CULL_PVS_CACHE; i++, pvs++ )
+	{
+		if( pvs->leaf1 != leaf1 || pvs->leaf2 != leaf2 || pvs->novis != novis )
+			continue;
+
+		memcpy( visbytes, pvs->visbytes, wc->visbytes );
+		pvs->lastused = ++wc->pvsframe;
+		wc->currentpvs = pvs;
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+===============
+R_WorldCullStorePVS
+
+keep the new pvs and the list of leafs in it
+===============
+*/
+void R_WorldCullStorePVS( worldcull_t *wc, int leaf1, int leaf2, qboolean novis, const byte *visbytes )
+{
+	cullpvs_t	*pvs, *best = NULL;
+	int	i;
+
+	if( !wc->model )
+		return;
+
+	// reuse a free entry or the one that wasn't used for longest time
+	for( i = 0, pvs = wc->pvs; i < CULL_PVS_CACHE; i++, pvs++ )
+	{
+		if( pvs->leaf1 < 0 )
+		{
+			best = pvs;
+			break;
+		}
+
+		if( !best || pvs->lastused < best->lastused )
+			best = pvs;
+	}
+
+	pvs = best;
+
+	if( !pvs->visbytes )
+	{
+		pvs->visbytes = Mem_Malloc( wc->mempool, wc->visbytes );
+		pvs->leafs = Mem_Malloc( wc->mempool, wc->model->numleafs * sizeof( int ));
+	}
+
+	memcpy( pvs->visbytes, visbytes, wc->visbytes );
+	pvs->leaf1 = leaf1;
+	pvs->leaf2 = leaf2;
+	pvs->novis = novis;
+	pvs->lastused = ++wc->pvsframe;
+	pvs->numleafs = 0;
+
+	for( i = 0; i < wc->model->numleafs; i++ )
+	{
+		if( visbytes[i >> 3] & ( 1 << ( i & 7 )))
+			pvs->leafs[pvs->numleafs++] = i;
+	}
+
+	wc->currentpvs = pvs;
+}
+
+/*
+===============
+R_WorldCullMarkNodes
+
+mark the leafs of the current pvs and their parents
+===============
+*/
+void R_WorldCullMarkNodes( worldcull_t *wc, int visframecount )
+{
+	cullpvs_t	*pvs = wc->currentpvs;
+	mnode_t	*node;
+	int	i;
+
+	if( !pvs ) return;
+
+	for( i = 0; i < pvs->numleafs; i++ )
+	{
+		node = (mnode_t *)&wc->model->leafs[pvs->leafs[i] + 1];
+
+		do
+		{
+			if( node->visframe == visframecount )
+				break;
+			node->visframe = visframecount;
+			node = node->parent;
+		} while( node );
+	}
+}
+
+/*
+=============================================================
+
+  VISIBLE NODES
+
+=============================================================
+*/
+static void R_WorldCullRecursive( worldcull_t *wc, const cullplanes_t *cp, mnode_t *node, const vec3_t origin, int clipflags, int visframecount )
+{
+	cullnode_t	*out;
+	int		side;
+
+	while( 1 )
+	{
+		if( node->contents == CONTENTS_SOLID )
+			return; // hit a solid leaf
+
+		if( node->visframe != visframecount )
+			return;
+
+		if( clipflags )
+		{
+			clipflags = R_WorldCullPacked( cp, &wc->bounds[R_WorldCullIndex( wc, node ) << 3], clipflags );
+			if( clipflags < 0 ) return;
+		}
+
+		if( node->contents < 0 )
+		{
+			out = &wc->visible[wc->numvisible++];
+			out->node = node;
+			out->clipflags = clipflags;
+			return;
+		}
+
+		// recurse down the children, front side first
+		side = ( PlaneDiff( origin, node->plane ) >= 0.0f ) ? 0 : 1;
+		R_WorldCullRecursive( wc, cp, node->children[side], origin, clipflags, visframecount );
+
+		out = &wc->visible[wc->numvisible++];
+		out->node = node;
+		out->clipflags = clipflags;
+
+		// and the back side without recursion
+		node = node->children[!side];
+	}
+}
+
+/*
+===============
+R_WorldCullNodes
+
+collect the nodes and leafs in the pvs that pass the frustum,
+front to back, every node goes between its front and back children.
+zero clipflags disables the frustum test
+===============
+*/
+int R_WorldCullNodes( worldcull_t *wc, const cullplanes_t *cp, const vec3_t origin, int clipflags, int visframecount )
+{
+	wc->numvisible = 0;
+
+	if( wc->model )
+		R_WorldCullRecursive( wc, cp, wc->model->nodes, origin, clipflags, visframecount );
+
+	return wc->numvisible;
+}
@@ -0,0 +1,81 @@
+/*
+r_worldcull.h - bsp world culling shared by the renderers
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef R_WORLDCULL_H
+#define R_WORLDCULL_H
+
+#include "xash3d_types.h"
+#include "com_model.h"
+
+#define CULL_MAX_PLANES		8	// two groups of four
+#define CULL_PVS_CACHE		4	// leaf lists kept for the recently used view leafs
+
+// frustum planes packed by axis, four planes in a row
+typedef struct
+{
+	vec4_t		normal[2][3];
+	vec4_t		dist[2];
+	int		numplanes;
+	qboolean		inclusive;	// also reject boxes that only touch a plane
+} cullplanes_t;
+
+// visible node or leaf, in front to back order
+typedef struct
+{
+	mnode_t		*node;
+	int		clipflags;	// planes the node still crosses
+} cullnode_t;
+
+// visible leafs for the pair of view leafs
+typedef struct
+{
+	int		leaf1, leaf2;	// -1 if unused
+	qboolean		novis;
+	uint		lastused;
+	byte		*visbytes;	// what R_FatPVS returned
+	int		*leafs;
+	int		numleafs;
+} cullpvs_t;
+
+typedef struct
+{
+	model_t		*model;		// tables below belong to this world
+	byte		*mempool;
+
+	// node and leaf bounds, mins and maxs padded to four floats
+	float		*bounds;
+	void		*boundsbase;
+
+	cullnode_t	*visible;		// output of R_WorldCullNodes
+	int		numvisible;
+
+	cullpvs_t		pvs[CULL_PVS_CACHE];
+	cullpvs_t		*currentpvs;
+	uint		pvsframe;
+	size_t		visbytes;
+} worldcull_t;
+
+//
+// r_worldcull.c
+//
+void R_WorldCullInit( worldcull_t *wc, model_t *world, byte *mempool );
+void R_WorldCullFree( worldcull_t *wc );
+void R_WorldCullSetPlane( cullplanes_t *cp, int side, const vec3_t normal, float dist );
+void R_WorldCullSetPlanes( cullplanes_t *cp, const mplane_t *planes, int numplanes );
+qboolean R_WorldCullFindPVS( worldcull_t *wc, int leaf1, int leaf2, qboolean novis, byte *visbytes );
+void R_WorldCullStorePVS( worldcull_t *wc, int leaf1, int leaf2, qboolean novis, const byte *visbytes );
+void R_WorldCullMarkNodes( worldcull_t *wc, int visframecount );
+int R_WorldCullNodes( worldcull_t *wc, const cullplanes_t *cp, const vec3_t origin, int clipflags, int visframecount );
+
+#endif//R_WORLDCULL_H
@@ -28,6 +28,12 @@ GNU General Public License for more details.
 #define MIN_DECAL_SCALE		0.01f
 #define MAX_DECAL_SCALE		16.0f
 
+// decal storage and spatial index
+#define DECAL_POLY_CHUNK		65536	// bytes of vertex storage per chunk
+#define DECAL_HASH_SIZE		1024	// MUST BE POWER OF 2
+#define DECAL_HASH_CELL		64.0f	// world units
+#define DECAL_HASH_MAXCELLS		64	// bigger queries just walk the surface list
+
 // clip edges
 #define LEFT_EDGE			0
 #define RIGHT_EDGE			1
@@ -49,16 +55,171 @@ typedef struct
 	vec3_t		m_Basis[3];
 } decalinfo_t;
 
+// chunk of decal vertex storage, the polys follow the header
+typedef struct decalchunk_s
+{
+	struct decalchunk_s	*next;
+	size_t		used;
+} decalchunk_t;
+
+// overlap test data, kept parallel to gDecalPool
+typedef struct
+{
+	vec3_t		basis[2];		// decal texture space, see R_SetupDecalTextureSpaceBasis
+	float		radius;		// half of the biggest decal side in world units
+	uint		sequence;		// order of linking into the surface list
+	uint		visitframe;	// cells may share the hash bucket
+	int		hashcell;		// bucket + 1, zero if not linked
+	int		hashnext;		// next decal + 1 in the same bucket
+	int		depth;		// used by R_CreateDecalList
+} decalnode_t;
+
+// real decals are kept aside while r_decalbench runs
+typedef struct
+{
+	decal_t		pool[MAX_RENDER_DECALS];
+	decalnode_t	nodes[MAX_RENDER_DECALS];
+	int		hash[DECAL_HASH_SIZE];
+	int		count;
+	float		maxradius;
+	uint		sequence;
+	decalchunk_t	*chunks;
+	glpoly_t		*freepolys[MAX_DECALCLIPVERT+1];
+	decal_t		**surfdecals;	// per world surface
+} decalstate_t;
+
 static float	g_DecalClipVerts[MAX_DECALCLIPVERT][VERTEXSIZE];
 static float	g_DecalClipVerts2[MAX_DECALCLIPVERT][VERTEXSIZE];
 
 decal_t	gDecalPool[MAX_RENDER_DECALS];
 static int	gDecalCount;
 
+static decalnode_t	g_decalnodes[MAX_RENDER_DECALS];
+static int	g_decalhash[DECAL_HASH_SIZE];	// first decal + 1
+static float	g_decalmaxradius;
+static uint	g_decalsequence;
+static uint	g_decalvisitframe;
+
+static decalchunk_t	*g_decalchunks;
+static glpoly_t	*g_decalfreepolys[MAX_DECALCLIPVERT+1];
+
 void R_ClearDecals( void )
 {
+	decalchunk_t	*chunk, *next;
+
 	memset( gDecalPool, 0, sizeof( gDecalPool ));
 	gDecalCount = 0;
+
+	for( chunk = g_decalchunks; chunk; chunk = next )
+	{
+		next = chunk->next;
+		Mem_Free( chunk );
+	}
+
+	g_decalchunks = NULL;
+	memset( g_decalfreepolys, 0, sizeof( g_decalfreepolys ));
+	memset( g_decalnodes, 0, sizeof( g_decalnodes ));
+	memset( g_decalhash, 0, sizeof( g_decalhash ));
+
+	g_decalmaxradius = 0.0f;
+	g_decalsequence = 0;
+}
+
+/*
+=============================================================
+
+  DECAL VERTEX STORAGE
+
+=============================================================
+*/
+static size_t R_DecalPolySize( int numverts )
+{
+	size_t	size = sizeof( glpoly_t ) + ( Q_max( numverts, 4 ) - 4 ) * VERTEXSIZE * sizeof( float );
+
+	return ( size + sizeof( void * ) - 1 ) & ~( sizeof( void * ) - 1 );
+}
+
+// polys are carved from big chunks and recycled by the vertex count
+static glpoly_t *R_DecalPolyAlloc( int numverts )
+{
+	decalchunk_t	*chunk = g_decalchunks;
+	size_t		size = R_DecalPolySize( numverts );
+	glpoly_t		*poly;
+
+	if( numverts > MAX_DECALCLIPVERT )
+		return Mem_Calloc( r_temppool, size );
+
+	if( g_decalfreepolys[numverts] )
+	{
+		poly = g_decalfreepolys[numverts];
+		g_decalfreepolys[numverts] = poly->next;
+	}
+	else
+	{
+		if( !chunk || chunk->used + size > DECAL_POLY_CHUNK )
+		{
+			chunk = Mem_Malloc( r_temppool, sizeof( decalchunk_t ) + DECAL_POLY_CHUNK );
+			chunk->next = g_decalchunks;
+			chunk->used = 0;
+			g_decalchunks = chunk;
+		}
+
+		poly = (glpoly_t *)((byte *)( chunk + 1 ) + chunk->used );
+		chunk->used += size;
+	}
+
+	memset( poly, 0, size );
+
+	return poly;
+}
+
+static void R_DecalPolyFree( glpoly_t *poly )
+{
+	if( poly->numverts > MAX_DECALCLIPVERT )
+	{
+		Mem_Free( poly );
+		return;
+	}
+
+	poly->next = g_decalfreepolys[poly->numverts];
+	g_decalfreepolys[poly->numverts] = poly;
+}
+
+/*
+=============================================================
+
+  DECAL SPATIAL INDEX
+
+=============================================================
+*/
+static int R_DecalHashCoord( float value )
+{
+	return (int)floor( value * ( 1.0f / DECAL_HASH_CELL ));
+}
+
+static int R_DecalHashKey( int x, int y, int z )
+{
+	return ((uint)x * 73856093U ^ (uint)y * 19349663U ^ (uint)z * 83492791U ) & ( DECAL_HASH_SIZE - 1 );
+}
+
+static void R_DecalUnlinkNode( decal_t *pdecal )
+{
+	decalnode_t	*node = &g_decalnodes[pdecal - gDecalPool];
+	int		*link;
+
+	if( !node->hashcell )
+		return;
+
+	for( link = &g_decalhash[node->hashcell - 1]; *link; link = &g_decalnodes[*link - 1].hashnext )
+	{
+		if( *link - 1 == pdecal - gDecalPool )
+		{
+			*link = node->hashnext;
+			break;
+		}
+	}
+
+	node->hashcell = 0;
 }
 
 // unlink pdecal from any surface it's attached to
@@ -90,8 +251,9 @@ static void R_DecalUnlink( decal_t *pdecal )
 	}
 
 	if( pdecal->polys )
-		Mem_Free( pdecal->polys );
+		R_DecalPolyFree( pdecal->polys );
 
+	R_DecalUnlinkNode( pdecal );
 	pdecal->psurface = NULL;
 	pdecal->polys = NULL;
 }
@@ -199,6 +361,31 @@ void R_SetupDecalTextureSpaceBasis( decal_t *pDecal, msurface_t *surf, int textu
 	VectorScale( textureSpaceBasis[1], decalWorldScale[1], textureSpaceBasis[1] );
 }
 
+// Remember the decal texture space for the overlap test and put the decal into the spatial index.
+static void R_DecalLinkNode( decal_t *pdecal, msurface_t *surf )
+{
+	decalnode_t	*node = &g_decalnodes[pdecal - gDecalPool];
+	vec3_t		textureSpaceBasis[3];
+	float		decalWorldScale[2];
+	int		width, height;
+
+	R_DecalUnlinkNode( pdecal );
+
+	R_SetupDecalTextureSpaceBasis( pdecal, surf, pdecal->texture, textureSpaceBasis, decalWorldScale );
+	VectorCopy( textureSpaceBasis[0], node->basis[0] );
+	VectorCopy( textureSpaceBasis[1], node->basis[1] );
+
+	R_GetDecalDimensions( pdecal->texture, &width, &height );
+	node->radius = Q_max( width, height ) * 0.5f / pdecal->scale;
+	g_decalmaxradius = Q_max( g_decalmaxradius, node->radius );
+	node->sequence = ++g_decalsequence;
+
+	node->hashcell = R_DecalHashKey( R_DecalHashCoord( pdecal->position[0] ),
+		R_DecalHashCoord( pdecal->position[1] ), R_DecalHashCoord( pdecal->position[2] )) + 1;
+	node->hashnext = g_decalhash[node->hashcell - 1];
+	g_decalhash[node->hashcell - 1] = pdecal - gDecalPool + 1;
+}
+
 // Build the initial list of vertices from the surface verts into the global array, 'verts'.
 void R_SetupDecalVertsForMSurface( decal_t *pDecal, msurface_t *surf,	vec3_t textureSpaceBasis[3], float *verts )
 {
@@ -361,10 +548,11 @@ float *R_DoDecalSHClip( float *pInVerts, decal_t *pDecal, int nStartVerts, int *
 	int	outCount;
 
 	// clip the polygon to the decal texture space
+	// and stop as soon as nothing is left
 	outCount = SHClip( pInVerts, nStartVerts, g_DecalClipVerts2[0], LEFT_EDGE );
-	outCount = SHClip( g_DecalClipVerts2[0], outCount, g_DecalClipVerts[0], RIGHT_EDGE );
-	outCount = SHClip( g_DecalClipVerts[0], outCount, g_DecalClipVerts2[0], TOP_EDGE );
-	outCount = SHClip( g_DecalClipVerts2[0], outCount, pOutVerts, BOTTOM_EDGE );
+	if( outCount ) outCount = SHClip( g_DecalClipVerts2[0], outCount, g_DecalClipVerts[0], RIGHT_EDGE );
+	if( outCount ) outCount = SHClip( g_DecalClipVerts[0], outCount, g_DecalClipVerts2[0], TOP_EDGE );
+	if( outCount ) outCount = SHClip( g_DecalClipVerts2[0], outCount, pOutVerts, BOTTOM_EDGE );
 
 	if( pVertCount )
 		*pVertCount = outCount;
@@ -419,6 +607,65 @@ static void R_DecalVertsLight( float *v, msurface_t *surf, int vertCount )
 	}
 }
 
+// Compute how much of pDecal is covered by the decal in decalinfo, zero if they don't touch
+static float R_DecalOverlapArea( decalinfo_t *decalinfo, decal_t *pDecal, vec3_t decalExtents[2] )
+{
+	decalnode_t	*node = &g_decalnodes[pDecal - gDecalPool];
+	vec3_t		testPosition[2];
+	vec2_t		vDecalMin, vDecalMax;
+	vec2_t		vUnionMin, vUnionMax;
+
+	VectorSubtract( decalinfo->m_Position, decalExtents[0], testPosition[0] );
+	VectorSubtract( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+
+	// Here, we project the min and max extents of the decal that got passed in into
+	// this decal's (pDecal's) [0,0,1,1] clip space, just like we would if we were
+	// clipping a triangle into pDecal's clip space.
+	Vector2Set( vDecalMin,
+		DotProduct( testPosition[0], node->basis[0] ) - pDecal->dx + 0.5f,
+		DotProduct( testPosition[1], node->basis[1] ) - pDecal->dy + 0.5f );
+
+	VectorAdd( decalinfo->m_Position, decalExtents[0], testPosition[0] );
+	VectorAdd( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+
+	Vector2Set( vDecalMax,
+		DotProduct( testPosition[0], node->basis[0] ) - pDecal->dx + 0.5f,
+		DotProduct( testPosition[1], node->basis[1] ) - pDecal->dy + 0.5f );
+
+	// Now figure out the part of the projection that intersects pDecal's
+	// clip box [0,0,1,1].
+	Vector2Set( vUnionMin, max( vDecalMin[0], 0 ), max( vDecalMin[1], 0 ));
+	Vector2Set( vUnionMax, min( vDecalMax[0], 1 ), min( vDecalMax[1], 1 ));
+
+	if( vUnionMin[0] < 1 && vUnionMin[1] < 1 && vUnionMax[0] > 0 && vUnionMax[1] > 0 )
+	{
+		// Figure out how much of this intersects the (0,0) - (1,1) bbox.
+		return (vUnionMax[0] - vUnionMin[1]) * (vUnionMax[1] - vUnionMin[1]);
+	}
+
+	return 0.0f;
+}
+
+// Distance from the decal center that covers every decal it can overlap.
+// Returns zero if the surface basis is too skewed to bound it.
+static float R_DecalQueryRadius( decalinfo_t *decalinfo, vec3_t decalExtents[2] )
+{
+	vec3_t	cross;
+	float	det;
+
+	// the decals on a surface overlap only if the distance between
+	// their centers along both basis vectors is below the sum of the
+	// half sizes, and the centers are never more than DECAL_DISTANCE
+	// away from the surface plane
+	CrossProduct( decalinfo->m_Basis[1], decalinfo->m_Basis[2], cross );
+	det = fabs( DotProduct( decalinfo->m_Basis[0], cross ));
+
+	if( det < 0.25f )
+		return 0.0f;
+
+	return ( VectorLength( decalExtents[0] ) + VectorLength( decalExtents[1] ) + g_decalmaxradius * 2.0f + DECAL_DISTANCE * 2.0f + 1.0f ) / det;
+}
+
 // Check for intersecting decals on this surface
 static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int *pcount )
 {
@@ -426,7 +673,11 @@ static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int
 	decal_t		*plast, *pDecal;
 	vec3_t		decalExtents[2];
 	float		lastArea = 2;
+	uint		lastSequence = 0;
+	int		mins[3], maxs[3];
 	int		mapSize[2];
+	int		i, x, y, z;
+	float		radius;
 
 	plast = NULL;
 	*pcount = 0;
@@ -439,65 +690,85 @@ static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int
 	VectorScale( decalinfo->m_Basis[0], ((mapSize[0] / decalinfo->m_scale) * 0.5f), decalExtents[0] );
 	VectorScale( decalinfo->m_Basis[1], ((mapSize[1] / decalinfo->m_scale) * 0.5f), decalExtents[1] );
 
-	pDecal = surf->pdecals;
+	radius = R_DecalQueryRadius( decalinfo, decalExtents );
 
-	while( pDecal )
+	for( i = 0; i < 3 && radius > 0.0f; i++ )
 	{
-		texture = pDecal->texture;
+		mins[i] = R_DecalHashCoord( decalinfo->m_Position[i] - radius );
+		maxs[i] = R_DecalHashCoord( decalinfo->m_Position[i] + radius );
+	}
 
-		// Don't steal bigger decals and replace them with smaller decals
-		// Don't steal permanent decals
-		if( !FBitSet( pDecal->flags, FDECAL_PERMANENT ))
+	if( radius <= 0.0f || ( maxs[0] - mins[0] + 1 ) * ( maxs[1] - mins[1] + 1 ) * ( maxs[2] - mins[2] + 1 ) > DECAL_HASH_MAXCELLS )
+	{
+		// walk the whole surface list
+		for( pDecal = surf->pdecals; pDecal; pDecal = pDecal->pnext )
 		{
-			vec3_t	testBasis[3];
-			vec3_t	testPosition[2];
-			float	testWorldScale[2];
-			vec2_t	vDecalMin, vDecalMax;
-			vec2_t	vUnionMin, vUnionMax;
+			float	flArea;
 
-			R_SetupDecalTextureSpaceBasis( pDecal, surf, texture, testBasis, testWorldScale );
+			// Don't steal bigger decals and replace them with smaller decals
+			// Don't steal permanent decals
+			if( FBitSet( pDecal->flags, FDECAL_PERMANENT ))
+				continue;
 
-			VectorSubtract( decalinfo->m_Position, decalExtents[0], testPosition[0] );
-			VectorSubtract( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+			flArea = R_DecalOverlapArea( decalinfo, pDecal, decalExtents );
 
-			// Here, we project the min and max extents of the decal that got passed in into
-			// this decal's (pDecal's) [0,0,1,1] clip space, just like we would if we were
-			// clipping a triangle into pDecal's clip space.
-			Vector2Set( vDecalMin,
-				DotProduct( testPosition[0], testBasis[0] ) - pDecal->dx + 0.5f,
-				DotProduct( testPosition[1], testBasis[1] ) - pDecal->dy + 0.5f );
+			if( flArea > 0.6f )
+			{
+				*pcount += 1;
 
-			VectorAdd( decalinfo->m_Position, decalExtents[0], testPosition[0] );
-			VectorAdd( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+				if( !plast || flArea <= lastArea )
+				{
+					plast = pDecal;
+					lastArea =  flArea;
+				}
+			}
+		}
 
-			Vector2Set( vDecalMax,
-				DotProduct( testPosition[0], testBasis[0] ) - pDecal->dx + 0.5f,
-				DotProduct( testPosition[1], testBasis[1] ) - pDecal->dy + 0.5f );
+		return plast;
+	}
 
-			// Now figure out the part of the projection that intersects pDecal's
-			// clip box [0,0,1,1].
-			Vector2Set( vUnionMin, max( vDecalMin[0], 0 ), max( vDecalMin[1], 0 ));
-			Vector2Set( vUnionMax, min( vDecalMax[0], 1 ), min( vDecalMax[1], 1 ));
+	g_decalvisitframe++;
 
-			if( vUnionMin[0] < 1 && vUnionMin[1] < 1 && vUnionMax[0] > 0 && vUnionMax[1] > 0 )
+	for( x = mins[0]; x <= maxs[0]; x++ )
+	{
+		for( y = mins[1]; y <= maxs[1]; y++ )
+		{
+			for( z = mins[2]; z <= maxs[2]; z++ )
 			{
-				// Figure out how much of this intersects the (0,0) - (1,1) bbox.
-				float	flArea = (vUnionMax[0] - vUnionMin[1]) * (vUnionMax[1] - vUnionMin[1]);
-
-				if( flArea > 0.6f )
+				for( i = g_decalhash[R_DecalHashKey( x, y, z )]; i; i = g_decalnodes[i - 1].hashnext )
 				{
-					*pcount += 1;
+					decalnode_t	*node = &g_decalnodes[i - 1];
+					float		flArea;
+
+					if( node->visitframe == g_decalvisitframe )
+						continue;
+					node->visitframe = g_decalvisitframe;
 
-					if( !plast || flArea <= lastArea )
+					pDecal = &gDecalPool[i - 1];
+
+					if( pDecal->psurface != surf || FBitSet( pDecal->flags, FDECAL_PERMANENT ))
+						continue;
+
+					flArea = R_DecalOverlapArea( decalinfo, pDecal, decalExtents );
+
+					if( flArea > 0.6f )
 					{
-						plast = pDecal;
-						lastArea =  flArea;
+						*pcount += 1;
+
+						// same pick as the surface list walk: the smallest
+						// area and the last linked decal among the equal ones
+						if( !plast || flArea < lastArea || ( flArea == lastArea && node->sequence > lastSequence ))
+						{
+							plast = pDecal;
+							lastArea = flArea;
+							lastSequence = node->sequence;
+						}
 					}
 				}
 			}
 		}
-		pDecal = pDecal->pnext;
 	}
+
 	return plast;
 }
 
@@ -505,25 +776,22 @@ static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int
 ====================
 R_DecalCreatePoly
 
-creates mesh for decal on first rendering
+store the clipped and lit decal vertices,
+they are reused until the decal is removed
 ====================
 */
-glpoly_t *R_DecalCreatePoly( decalinfo_t *decalinfo, decal_t *pdecal, msurface_t *surf )
+static glpoly_t *R_DecalCreatePoly( decal_t *pdecal, msurface_t *surf, const float *v, int lnumverts )
 {
-	int		lnumverts;
 	glpoly_t	*poly;
-	float		*v;
 	int		i;
 
 	if( pdecal->polys )	// already created?
 		return pdecal->polys;
 
-	v = R_DecalSetupVerts( pdecal, surf, pdecal->texture, &lnumverts );
 	if( !lnumverts ) return NULL;	// probably this never happens
 
 	// allocate glpoly
-	// REFTODO: com_studiocache pool!
-	poly = Mem_Calloc( r_temppool, sizeof( glpoly_t ) + ( lnumverts - 4 ) * VERTEXSIZE * sizeof( float ));
+	poly = R_DecalPolyAlloc( lnumverts );
 	poly->next = pdecal->polys;
 	poly->flags = surf->flags;
 	pdecal->polys = poly;
@@ -542,7 +810,7 @@ glpoly_t *R_DecalCreatePoly( decalinfo_t *decalinfo, decal_t *pdecal, msurface_t
 }
 
 // Add the decal to the surface's list of decals.
-static void R_AddDecalToSurface( decal_t *pdecal, msurface_t *surf, decalinfo_t *decalinfo )
+static void R_AddDecalToSurface( decal_t *pdecal, msurface_t *surf, const float *v, int numverts )
 {
 	decal_t	*pold;
 
@@ -567,8 +835,10 @@ static void R_AddDecalToSurface( decal_t *pdecal, msurface_t *surf, decalinfo_t
 	// and will be culled, drawing and sorting
 	// together with surface
 
+	R_DecalLinkNode( pdecal, surf );
+
 	// alloc clipped poly for decal
-	R_DecalCreatePoly( decalinfo, pdecal, surf );
+	R_DecalCreatePoly( pdecal, surf, v, numverts );
 	R_AddDecalVBO( pdecal, surf );
 }
 
@@ -576,6 +846,7 @@ static void R_DecalCreate( decalinfo_t *decalinfo, msurface_t *surf, float x, fl
 {
 	decal_t	*pdecal, *pold;
 	int	count, vertCount;
+	float	*v;
 
 	if( !surf ) return;	// ???
 
@@ -599,7 +870,7 @@ static void R_DecalCreate( decalinfo_t *decalinfo, msurface_t *surf, float x, fl
 
 	// check to see if the decal actually intersects the surface
 	// if not, then remove the decal
-	R_DecalVertsClip( pdecal, surf, decalinfo->m_iTexture, &vertCount );
+	v = R_DecalVertsClip( pdecal, surf, decalinfo->m_iTexture, &vertCount );
 
 	if( !vertCount )
 	{
@@ -607,8 +878,11 @@ static void R_DecalCreate( decalinfo_t *decalinfo, msurface_t *surf, float x, fl
 		return;
 	}
 
+	// the clipped verts become the decal mesh, no need to clip it again
+	R_DecalVertsLight( v, surf, vertCount );
+
 	// add to the surface's list
-	R_AddDecalToSurface( pdecal, surf, decalinfo );
+	R_AddDecalToSurface( pdecal, surf, v, vertCount );
 }
 
 void R_DecalSurface( msurface_t *surf, decalinfo_t *decalinfo )
@@ -840,6 +1114,171 @@ void R_DecalShoot( int textureIndex, int entityIndex, int modelIndex, vec3_t pos
 	R_DecalNode( model, &model->nodes[hull->firstclipnode], &decalInfo );
 }
 
+/*
+===============
+R_DecalSaveState
+
+keep the real decals aside and start from the empty pool,
+pool indices are used by VBO so it stays in place
+===============
+*/
+static decalstate_t *R_DecalSaveState( void )
+{
+	decalstate_t	*state = Mem_Malloc( r_temppool, sizeof( *state ));
+	int		i;
+
+	memcpy( state->pool, gDecalPool, sizeof( gDecalPool ));
+	memcpy( state->nodes, g_decalnodes, sizeof( g_decalnodes ));
+	memcpy( state->hash, g_decalhash, sizeof( g_decalhash ));
+	memcpy( state->freepolys, g_decalfreepolys, sizeof( g_decalfreepolys ));
+	state->count = gDecalCount;
+	state->maxradius = g_decalmaxradius;
+	state->sequence = g_decalsequence;
+	state->chunks = g_decalchunks;
+	state->surfdecals = Mem_Malloc( r_temppool, sizeof( decal_t * ) * WORLDMODEL->numsurfaces );
+
+	for( i = 0; i < WORLDMODEL->numsurfaces; i++ )
+	{
+		state->surfdecals[i] = WORLDMODEL->surfaces[i].pdecals;
+		WORLDMODEL->surfaces[i].pdecals = NULL;
+	}
+
+	// don't let R_ClearDecals free the saved chunks
+	g_decalchunks = NULL;
+	R_ClearDecals();
+
+	return state;
+}
+
+/*
+===============
+R_DecalRestoreState
+
+free the scratch decals and bring the real ones back
+===============
+*/
+static void R_DecalRestoreState( decalstate_t *state )
+{
+	int	i;
+
+	// big polys are allocated one by one
+	for( i = 0; i < MAX_RENDER_DECALS; i++ )
+		R_DecalUnlink( &gDecalPool[i] );
+	R_ClearDecals();
+
+	memcpy( gDecalPool, state->pool, sizeof( gDecalPool ));
+	memcpy( g_decalnodes, state->nodes, sizeof( g_decalnodes ));
+	memcpy( g_decalhash, state->hash, sizeof( g_decalhash ));
+	memcpy( g_decalfreepolys, state->freepolys, sizeof( g_decalfreepolys ));
+	gDecalCount = state->count;
+	g_decalmaxradius = state->maxradius;
+	g_decalsequence = state->sequence;
+	g_decalchunks = state->chunks;
+
+	for( i = 0; i < WORLDMODEL->numsurfaces; i++ )
+		WORLDMODEL->surfaces[i].pdecals = state->surfdecals[i];
+
+	// scratch decals took the same VBO slots
+	for( i = 0; i < MAX_RENDER_DECALS; i++ )
+	{
+		if( gDecalPool[i].psurface )
+			R_AddDecalVBO( &gDecalPool[i], gDecalPool[i].psurface );
+	}
+
+	Mem_Free( state->surfdecals );
+	Mem_Free( state );
+}
+
+/*
+===============
+R_DecalBench_f
+
+spray decals over the biggest world surface
+and print the time spent in R_DecalShoot,
+real decals are not affected
+===============
+*/
+void R_DecalBench_f( void )
+{
+	int		i, shots = 1000, numdecals = 0;
+	float		spread = 32.0f;
+	msurface_t	*surf, *best = NULL;
+	vec3_t		center, normal, axis[2], pos;
+	uint		seed = 0x1234567;
+	double		start, time;
+	decal_t		*pdecal;
+	decalstate_t	*state;
+	float		*v;
+
+	if( !WORLDMODEL )
+	{
+		gEngfuncs.Con_Printf( "r_decalbench: no map loaded\n" );
+		return;
+	}
+
+	if( gEngfuncs.Cmd_Argc() > 1 )
+		shots = Q_max( 1, Q_atoi( gEngfuncs.Cmd_Argv( 1 )));
+
+	if( gEngfuncs.Cmd_Argc() > 2 )
+		spread = Q_max( 0.0f, Q_atof( gEngfuncs.Cmd_Argv( 2 )));
+
+	// pick the biggest surface decals can stick to
+	for( i = 0, surf = WORLDMODEL->surfaces; i < WORLDMODEL->numsurfaces; i++, surf++ )
+	{
+		if( !surf->polys || FBitSet( surf->flags, SURF_DRAWTURB|SURF_DRAWSKY|SURF_CONVEYOR|SURF_TRANSPARENT ))
+			continue;
+
+		if( !best || surf->extents[0] * surf->extents[1] > best->extents[0] * best->extents[1] )
+			best = surf;
+	}
+
+	if( !best )
+	{
+		gEngfuncs.Con_Printf( "r_decalbench: no surface to decal\n" );
+		return;
+	}
+
+	VectorClear( center );
+	for( i = 0, v = best->polys->verts[0]; i < best->polys->numverts; i++, v += VERTEXSIZE )
+		VectorAdd( center, v, center );
+	VectorScale( center, 1.0f / best->polys->numverts, center );
+
+	R_DecalComputeBasis( best, 0, axis );
+	VectorCopy( axis[2], normal );
+	VectorNormalize2( best->texinfo->vecs[0], axis[0] );
+	VectorNormalize2( best->texinfo->vecs[1], axis[1] );
+
+	state = R_DecalSaveState();
+	start = gEngfuncs.pfnTime();
+
+	for( i = 0; i < shots; i++ )
+	{
+		float	s, t;
+
+		// same sequence on every run
+		seed = seed * 1103515245 + 12345;
+		s = (( seed >> 8 ) & 0xFFFF ) * ( 2.0f / 0xFFFF ) - 1.0f;
+		seed = seed * 1103515245 + 12345;
+		t = (( seed >> 8 ) & 0xFFFF ) * ( 2.0f / 0xFFFF ) - 1.0f;
+
+		VectorMA( center, 1.0f, normal, pos );
+		VectorMA( pos, s * spread, axis[0], pos );
+		VectorMA( pos, t * spread, axis[1], pos );
+
+		R_DecalShoot( tr.defaultTexture, 0, 0, pos, 0, 1.0f );
+	}
+
+	time = gEngfuncs.pfnTime() - start;
+
+	for( pdecal = best->pdecals; pdecal; pdecal = pdecal->pnext )
+		numdecals++;
+
+	gEngfuncs.Con_Printf( "%i shots with %g units spread: %.2f usec per shot, %i decals on the surface\n",
+		shots, spread, time * 1e6 / shots, numdecals );
+
+	R_DecalRestoreState( state );
+}
+
 // Build the vertex list for a decal on a surface and clip it to the surface.
 // This is a template so it can work on world surfaces and dynamic displacement
 // triangles the same way.
@@ -885,7 +1324,14 @@ void DrawSingleDecal( decal_t *pDecal, msurface_t *fa )
 	float	*v;
 	int	i, numVerts;
 
-	v = R_DecalSetupVerts( pDecal, fa, pDecal->texture, &numVerts );
+	// draw straight from the stored mesh
+	if( pDecal->polys )
+	{
+		v = pDecal->polys->verts[0];
+		numVerts = pDecal->polys->numverts;
+	}
+	else v = R_DecalSetupVerts( pDecal, fa, pDecal->texture, &numVerts );
+
 	if( !numVerts ) return;
 
 	GL_Bind( XASH_TEXTURE0, pDecal->texture );
@@ -1165,23 +1611,45 @@ int R_CreateDecalList( decallist_t *pList )
 
 	if( WORLDMODEL )
 	{
+		decal_t	*pdecals;
+
+		// compute depths with a single walk over every surface list
+		for( i = 0; i < MAX_RENDER_DECALS; i++ )
+			g_decalnodes[i].depth = -1;
+
+		for( i = 0; i < MAX_RENDER_DECALS; i++ )
+		{
+			decal_t	*decal = &gDecalPool[i];
+
+			if( decal->psurface == NULL || decal->psurface->pdecals != decal )
+				continue;
+
+			for( pdecals = decal, depth = 0; pdecals; pdecals = pdecals->pnext, depth++ )
+				g_decalnodes[pdecals - gDecalPool].depth = depth;
+		}
+
 		for( i = 0; i < MAX_RENDER_DECALS; i++ )
 		{
 			decal_t	*decal = &gDecalPool[i];
-			decal_t	*pdecals;
 
 			// decal is in use and is not a custom decal
 			if( decal->psurface == NULL || FBitSet( decal->flags, FDECAL_DONTSAVE ))
 				 continue;
 
 			// compute depth
-			depth = 0;
-			pdecals = decal->psurface->pdecals;
+			depth = g_decalnodes[i].depth;
 
-			while( pdecals && pdecals != decal )
+			if( depth == -1 )
 			{
-				depth++;
-				pdecals = pdecals->pnext;
+				// not in the surface list
+				depth = 0;
+				pdecals = decal->psurface->pdecals;
+
+				while( pdecals && pdecals != decal )
+				{
+					depth++;
+					pdecals = pdecals->pnext;
+				}
 			}
 
 			pList[total].depth = depth;
@@ -25,6 +25,7 @@ GNU General Public License for more details.
 #include "protocol.h"
 #include "dlight.h"
 #include "gl_frustum.h"
+#include "r_worldcull.h"
 #include "ref_api.h"
 #include "xash3d_mathlib.h"
 #include "ref_params.h"
@@ -241,6 +242,7 @@ typedef struct
 
 	// cull info
 	vec3_t		modelorg;		// relative to viewpoint
+	worldcull_t	worldcull;	// packed bounds and cached leaf lists of the world
 
 	qboolean fCustomSkybox;
 } gl_globals_t;
@@ -318,6 +320,7 @@ float *R_DecalSetupVerts( decal_t *pDecal, msurface_t *surf, int texture, int *o
 void DrawSingleDecal( decal_t *pDecal, msurface_t *fa );
 void R_EntityRemoveDecals( model_t *mod );
 void DrawDecalsBatch( void );
+void R_DecalBench_f( void );
 void R_ClearDecals( void );
 
 //
@@ -418,6 +421,7 @@ void R_ClearStaticEntities( void );
 // gl_rsurf.c
 //
 void R_MarkLeaves( void );
+void R_CullBench_f( void );
 void R_DrawWorld( void );
 void R_DrawWaterSurfaces( void );
 void R_DrawBrushModel( cl_entity_t *e );
@@ -430,6 +434,9 @@ void R_DrawAlphaTextureChains( void );
 void GL_RebuildLightmaps( void );
 void GL_InitRandomTable( void );
 void GL_BuildLightmaps( void );
+void GL_UpdateLightGamma( void );
+void R_LightmapBench_f( void );
+void R_LightmapStats_f( void );
 void GL_ResetFogColor( void );
 void R_GenerateVBO( void );
 void R_ClearVBO( void );
@@ -455,6 +462,8 @@ void R_DrawSpriteModel( cl_entity_t *e );
 // gl_studio.c
 //
 void R_StudioInit( void );
+void R_StudioShutdown( void );
+void R_StudioBench_f( void );
 void Mod_LoadStudioModel( model_t *mod, const void *buffer, qboolean *loaded );
 void R_StudioLerpMovement( cl_entity_t *e, double time, vec3_t origin, vec3_t angles );
 float CL_GetSequenceDuration( cl_entity_t *ent, int sequence );
@@ -715,6 +724,7 @@ extern cvar_t	*gl_check_errors;
 extern cvar_t	*gl_texture_lodbias;
 extern cvar_t	*gl_texture_nearest;
 extern cvar_t	*gl_lightmap_nearest;
+extern cvar_t	*gl_lightmap_threads;
 extern cvar_t	*gl_keeptjunctions;
 extern cvar_t	*gl_emboss_scale;
 extern cvar_t	*gl_round_down;
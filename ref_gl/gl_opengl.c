@@ -6,6 +6,7 @@ cvar_t	*gl_texture_anisotropy;
 cvar_t	*gl_texture_lodbias;
 cvar_t	*gl_texture_nearest;
 cvar_t	*gl_lightmap_nearest;
+cvar_t	*gl_lightmap_threads;
 cvar_t	*gl_keeptjunctions;
 cvar_t	*gl_emboss_scale;
 cvar_t	*gl_detailscale;
@@ -849,6 +850,7 @@ void GL_InitCommands( void )
 	gl_extensions = gEngfuncs.Cvar_Get( "gl_allow_extensions", "1", FCVAR_GLCONFIG, "allow gl_extensions" );
 	gl_texture_nearest = gEngfuncs.Cvar_Get( "gl_texture_nearest", "0", FCVAR_ARCHIVE, "disable texture filter" );
 	gl_lightmap_nearest = gEngfuncs.Cvar_Get( "gl_lightmap_nearest", "0", FCVAR_ARCHIVE, "disable lightmap filter" );
+	gl_lightmap_threads = gEngfuncs.Cvar_Get( "gl_lightmap_threads", "0", FCVAR_ARCHIVE, "threads used to compose lightmaps (0 - one per cpu)" );
 	gl_check_errors = gEngfuncs.Cvar_Get( "gl_check_errors", "1", FCVAR_ARCHIVE, "ignore video engine errors" );
 	gl_vsync = gEngfuncs.pfnGetCvarPointer( "gl_vsync", 0 );
 	gl_detailscale = gEngfuncs.Cvar_Get( "gl_detailscale", "4.0", FCVAR_ARCHIVE, "default scale applies while auto-generate list of detail textures" );
@@ -883,6 +885,11 @@ void GL_InitCommands( void )
 
 	gEngfuncs.Cmd_AddCommand( "r_info", R_RenderInfo_f, "display renderer info" );
 	gEngfuncs.Cmd_AddCommand( "timerefresh", SCR_TimeRefresh_f, "turn quickly and print rendering statistcs" );
+	gEngfuncs.Cmd_AddCommand( "r_lightmapbench", R_LightmapBench_f, "compose static lightmaps on the cpu and print texels per second" );
+	gEngfuncs.Cmd_AddCommand( "r_lightmapstats", R_LightmapStats_f, "print lightmap atlas pages and fill ratio" );
+	gEngfuncs.Cmd_AddCommand( "r_studiobench", R_StudioBench_f, "skin and fill studio vertex arrays on the cpu and print timings" );
+	gEngfuncs.Cmd_AddCommand( "r_decalbench", R_DecalBench_f, "spray decals over a world surface and print the time per shot" );
+	gEngfuncs.Cmd_AddCommand( "r_cullbench", R_CullBench_f, "cull the world from every leaf and compare with the scalar traversal" );
 }
 
 /*
@@ -937,6 +944,11 @@ GL_RemoveCommands
 void GL_RemoveCommands( void )
 {
 	gEngfuncs.Cmd_RemoveCommand( "r_info" );
+	gEngfuncs.Cmd_RemoveCommand( "r_lightmapbench" );
+	gEngfuncs.Cmd_RemoveCommand( "r_lightmapstats" );
+	gEngfuncs.Cmd_RemoveCommand( "r_studiobench" );
+	gEngfuncs.Cmd_RemoveCommand( "r_decalbench" );
+	gEngfuncs.Cmd_RemoveCommand( "r_cullbench" );
 }
 
 /*
@@ -990,6 +1002,9 @@ void R_Shutdown( void )
 
 	GL_RemoveCommands();
 	R_ShutdownImages();
+	R_ClearDecals();
+	R_StudioShutdown();
+	R_WorldCullFree( &tr.worldcull );
 
 	Mem_FreePool( &r_temppool );
 
@@ -995,6 +995,7 @@ void R_CheckGamma( void )
 	{
 		// paranoia cubemaps uses this
 		gEngfuncs.BuildGammaTable( 1.8f, 0.0f );
+		GL_UpdateLightGamma();
 
 		// paranoia cubemap rendering
 		if( gEngfuncs.drawFuncs->GL_BuildLightmaps )
@@ -177,6 +177,7 @@ void R_NewMap( void )
 
 	R_SetupSky( MOVEVARS->skyName );
 
+	R_WorldCullInit( &tr.worldcull, WORLDMODEL, r_temppool );
 	GL_BuildLightmaps ();
 	R_GenerateVBO();
 
@@ -16,16 +16,88 @@ GNU General Public License for more details.
 #include "gl_local.h"
 #include "xash3d_mathlib.h"
 #include "mod_local.h"
+#if XASH_SSE2
+#include <emmintrin.h>
+#endif
+
+#if !XASH_EMSCRIPTEN && !XASH_DOS4GW
+#define HAVE_LM_THREADS
+#endif
+
+#ifdef HAVE_LM_THREADS
+#if XASH_WIN32
+#define thread_t		HANDLE
+#else // !XASH_WIN32
+#include <pthread.h>
+#include <unistd.h>
+#define thread_t		pthread_t
+#endif // !XASH_WIN32
+#endif // HAVE_LM_THREADS
+
+#define LM_MAX_WORKERS	16
+#define LM_MIN_JOBS		64	// smaller pages are not worth waking the workers
 
 typedef struct
 {
-	int		allocated[BLOCK_SIZE_MAX];
+	short		x, y;
+	short		width;
+} lmskyline_t;
+
+typedef struct
+{
+	lmskyline_t	nodes[BLOCK_SIZE_MAX+1];	// skyline from left to right, always covers the whole block
+	int		numnodes;
+	int		size;
+	int		used;			// allocated texels
+} lmpacker_t;
+
+typedef struct
+{
+	lmpacker_t	packer;
+	int		lightmap_used[MAX_LIGHTMAPS];	// texels used on each static page
 	int		current_lightmap_texture;
 	msurface_t	*dynamic_surfaces;
 	msurface_t	*lightmap_surfaces[MAX_LIGHTMAPS];
 	byte		lightmap_buffer[BLOCK_SIZE_MAX*BLOCK_SIZE_MAX*4];
 } gllightmapstate_t;
 
+typedef struct
+{
+	msurface_t	*surf;
+	model_t		*model;
+	short		width, height;	// in luxels
+	short		x, y;		// LM_SimulatePacking results
+	int		page;
+} lmsurf_t;
+
+typedef struct
+{
+	msurface_t	*surf;
+	byte		*dest;		// region reserved by LM_AllocBlock
+	int		stride;
+} lmjob_t;
+
+typedef struct
+{
+	lmjob_t		*jobs;
+	int		numjobs;
+	int		maxjobs;
+	int		maxsize;		// largest surface in the queue, in channels
+#if XASH_WIN32
+	volatile LONG	next;
+#else
+	volatile int	next;
+#endif
+} lmqueue_t;
+
+typedef struct
+{
+	uint		*blocklights;	// private accumulation buffer
+#ifdef HAVE_LM_THREADS
+	thread_t		thread;
+#endif
+} lmworker_t;
+
 static int		nColinElim; // stats
 static vec2_t		world_orthocenter;
 static vec2_t		world_orthohalf;
@@ -38,6 +110,9 @@ static qboolean		draw_fullbrights = false;
 static qboolean		draw_details = false;
 static msurface_t		*skychain = NULL;
 static gllightmapstate_t	gl_lms;
+static lmqueue_t		lm_queue;
+static lmworker_t		lm_workers[LM_MAX_WORKERS];
+static uint		r_lightgamma[256];	// LightToTexGamma, cached for composition
 
 static void LM_UploadBlock( qboolean dynamic );
 static qboolean R_AddSurfToVBO( msurface_t *surf, qboolean buildlightmaps );
@@ -514,6 +589,7 @@ void R_AddDynamicLights( msurface_t *surf )
 	mtexinfo_t	*tex;
 	dlight_t		*dl;
 	uint		*bl;
+	int		color[3];
 
 	// no dlighted surfaces here
 	if( !R_CountSurfaceDlights( surf )) return;
@@ -566,6 +642,10 @@ void R_AddDynamicLights( msurface_t *surf )
 		tl = DotProduct( impact, info->lmvecs[1] ) + info->lmvecs[1][3] - info->lightmapmins[1];
 		bl = r_blocklights;
 
+		color[0] = r_lightgamma[dl->color.r];
+		color[1] = r_lightgamma[dl->color.g];
+		color[2] = r_lightgamma[dl->color.b];
+
 		for( t = 0, tacc = 0; t < tmax; t++, tacc += sample_size )
 		{
 			td = (tl - tacc) * sample_frac;
@@ -581,9 +661,9 @@ void R_AddDynamicLights( msurface_t *surf )
 
 				if( dist < minlight )
 				{
-					bl[0] += ((int)((rad - dist) * 256) * gEngfuncs.LightToTexGamma( dl->color.r )) / 256;
-					bl[1] += ((int)((rad - dist) * 256) * gEngfuncs.LightToTexGamma( dl->color.g )) / 256;
-					bl[2] += ((int)((rad - dist) * 256) * gEngfuncs.LightToTexGamma( dl->color.b )) / 256;
+					bl[0] += ((int)((rad - dist) * 256) * color[0] ) / 256;
+					bl[1] += ((int)((rad - dist) * 256) * color[1] ) / 256;
+					bl[2] += ((int)((rad - dist) * 256) * color[2] ) / 256;
 				}
 			}
 		}
@@ -608,102 +688,120 @@ void R_SetCacheState( msurface_t *surf )
 /*
 =============================================================================
 
-  LIGHTMAP ALLOCATION
+  LIGHTMAP COMPOSITION
 
 =============================================================================
 */
-static void LM_InitBlock( void )
-{
-	memset( gl_lms.allocated, 0, sizeof( gl_lms.allocated ));
-}
+/*
+===============
+GL_UpdateLightGamma
 
-static int LM_AllocBlock( int w, int h, int *x, int *y )
+composition reads gamma through the local table,
+refresh it every time engine rebuilds gamma tables
+===============
+*/
+void GL_UpdateLightGamma( void )
 {
-	int	i, j;
-	int	best, best2;
+	int	i;
 
-	best = BLOCK_SIZE;
+	for( i = 0; i < 256; i++ )
+		r_lightgamma[i] = gEngfuncs.LightToTexGamma( i );
+}
 
-	for( i = 0; i < BLOCK_SIZE - w; i++ )
-	{
-		best2 = 0;
+/*
+=================
+R_AccumulateLightStyles
 
-		for( j = 0; j < w; j++ )
-		{
-			if( gl_lms.allocated[i+j] >= best )
-				break;
-			if( gl_lms.allocated[i+j] > best2 )
-				best2 = gl_lms.allocated[i+j];
-		}
+sum all the lightstyles of the surface into blocklights,
+samples and blocklights are both laid out as flat rgb
+=================
+*/
+static void R_AccumulateLightStyles( msurface_t *surf, uint *blocklights, int size )
+{
+	int		i, map, count = size * 3;
+	const byte	*lm = (const byte *)surf->samples;
+	uint		scale;
 
-		if( j == w )
-		{
-			// this is a valid spot
-			*x = i;
-			*y = best = best2;
-		}
-	}
+	memset( blocklights, 0, sizeof( uint ) * count );
 
-	if( best + h > BLOCK_SIZE )
-		return false;
+	if( !lm ) return;
 
-	for( i = 0; i < w; i++ )
-		gl_lms.allocated[*x + i] = best + h;
+	for( map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255; map++, lm += count )
+	{
+		scale = tr.lightstylevalue[surf->styles[map]];
+		i = 0;
+#if XASH_SSE2
+		{
+			__m128i	vscale = _mm_set1_epi32( scale );
+			__m128i	v, even, odd;
 
-	return true;
-}
+			for( ; i + 4 <= count; i += 4 )
+			{
+				v = _mm_setr_epi32( r_lightgamma[lm[i+0]], r_lightgamma[lm[i+1]], r_lightgamma[lm[i+2]], r_lightgamma[lm[i+3]] );
 
-static void LM_UploadDynamicBlock( void )
-{
-	int	height = 0, i;
+				// no 32-bit mullo in SSE2, multiply even and odd lanes separately
+				even = _mm_mul_epu32( v, vscale );
+				odd = _mm_mul_epu32( _mm_srli_epi64( v, 32 ), vscale );
+				v = _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 )), _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 )));
 
-	for( i = 0; i < BLOCK_SIZE; i++ )
-	{
-		if( gl_lms.allocated[i] > height )
-			height = gl_lms.allocated[i];
+				_mm_storeu_si128( (__m128i *)&blocklights[i], _mm_add_epi32( _mm_loadu_si128( (__m128i *)&blocklights[i] ), v ));
+			}
+		}
+#endif
+		for( ; i < count; i++ )
+			blocklights[i] += r_lightgamma[lm[i]] * scale;
 	}
-
-	pglTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, BLOCK_SIZE, height, GL_RGBA, GL_UNSIGNED_BYTE, gl_lms.lightmap_buffer );
 }
 
-static void LM_UploadBlock( qboolean dynamic )
+/*
+=================
+R_PackLightMap
+
+clamp blocklights into RGBA texels
+=================
+*/
+static void R_PackLightMap( const uint *bl, byte *dest, int stride, int smax, int tmax )
 {
-	int	i;
+	int	s, t;
+#if XASH_SSE2
+	__m128i	alpha = _mm_set1_epi32( 0xFF000000 );
+	__m128	a, b, c, t0, t1, t2, t3;
+#endif
 
-	if( dynamic )
-	{
-		int	height = 0;
+	stride -= (smax << 2);
 
-		for( i = 0; i < BLOCK_SIZE; i++ )
+	for( t = 0; t < tmax; t++, dest += stride )
+	{
+		s = 0;
+#if XASH_SSE2
+		// four texels at once, spread rgb triplets over four lanes first
+		for( ; s + 4 <= smax; s += 4, bl += 12, dest += 16 )
 		{
-			if( gl_lms.allocated[i] > height )
-				height = gl_lms.allocated[i];
+			a = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i *)( bl + 0 )));	// r0 g0 b0 r1
+			b = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i *)( bl + 4 )));	// g1 b1 r2 g2
+			c = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i *)( bl + 8 )));	// b2 r3 g3 b3
+
+			t0 = a;
+			t1 = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 3, 3 )), b, _MM_SHUFFLE( 1, 1, 2, 0 ));
+			t2 = _mm_shuffle_ps( b, c, _MM_SHUFFLE( 0, 0, 3, 2 ));
+			t3 = _mm_castsi128_ps( _mm_shuffle_epi32( _mm_castps_si128( c ), _MM_SHUFFLE( 3, 3, 2, 1 )));
+
+			// saturating packs give exactly Q_min( bl >> 7, 255 )
+			_mm_storeu_si128( (__m128i *)dest, _mm_or_si128( alpha, _mm_packus_epi16(
+				_mm_packs_epi32( _mm_srli_epi32( _mm_castps_si128( t0 ), 7 ), _mm_srli_epi32( _mm_castps_si128( t1 ), 7 )),
+				_mm_packs_epi32( _mm_srli_epi32( _mm_castps_si128( t2 ), 7 ), _mm_srli_epi32( _mm_castps_si128( t3 ), 7 )))));
 		}
+#endif
+		for( ; s < smax; s++ )
+		{
+			dest[0] = Q_min((bl[0] >> 7), 255 );
+			dest[1] = Q_min((bl[1] >> 7), 255 );
+			dest[2] = Q_min((bl[2] >> 7), 255 );
+			dest[3] = 255;
 
-		GL_Bind( XASH_TEXTURE0, tr.dlightTexture );
-		pglTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, BLOCK_SIZE, height, GL_RGBA, GL_UNSIGNED_BYTE, gl_lms.lightmap_buffer );
-	}
-	else
-	{
-		rgbdata_t	r_lightmap;
-		char	lmName[16];
-
-		i = gl_lms.current_lightmap_texture;
-
-		// upload static lightmaps only during loading
-		memset( &r_lightmap, 0, sizeof( r_lightmap ));
-		Q_snprintf( lmName, sizeof( lmName ), "*lightmap%i", i );
-
-		r_lightmap.width = BLOCK_SIZE;
-		r_lightmap.height = BLOCK_SIZE;
-		r_lightmap.type = PF_RGBA_32;
-		r_lightmap.size = r_lightmap.width * r_lightmap.height * 4;
-		r_lightmap.flags = IMAGE_HAS_COLOR;
-		r_lightmap.buffer = gl_lms.lightmap_buffer;
-		tr.lightmapTextures[i] = GL_LoadTextureInternal( lmName, &r_lightmap, TF_FONT|TF_ATLAS_PAGE );
-
-		if( ++gl_lms.current_lightmap_texture == MAX_LIGHTMAPS )
-			gEngfuncs.Host_Error( "AllocBlock: full\n" );
+			bl += 3;
+			dest += 4;
+		}
 	}
 }
 
@@ -718,139 +816,491 @@ format in r_blocklights
 static void R_BuildLightMap( msurface_t *surf, byte *dest, int stride, qboolean dynamic )
 {
 	int		smax, tmax;
-	uint		*bl, scale;
-	int		i, map, size, s, t;
 	int		sample_size;
 	mextrasurf_t	*info = surf->info;
-	color24		*lm;
 
 	sample_size = gEngfuncs.Mod_SampleSizeForFace( surf );
 	smax = ( info->lightextents[0] / sample_size ) + 1;
 	tmax = ( info->lightextents[1] / sample_size ) + 1;
-	size = smax * tmax;
-
-	lm = surf->samples;
-
-	memset( r_blocklights, 0, sizeof( uint ) * size * 3 );
 
 	// add all the lightmaps
-	for( map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255 && lm; map++ )
-	{
-		scale = tr.lightstylevalue[surf->styles[map]];
-
-		for( i = 0, bl = r_blocklights; i < size; i++, bl += 3, lm++ )
-		{
-			bl[0] += gEngfuncs.LightToTexGamma( lm->r ) * scale;
-			bl[1] += gEngfuncs.LightToTexGamma( lm->g ) * scale;
-			bl[2] += gEngfuncs.LightToTexGamma( lm->b ) * scale;
-		}
-	}
+	R_AccumulateLightStyles( surf, r_blocklights, smax * tmax );
 
 	// add all the dynamic lights
 	if( surf->dlightframe == tr.framecount && dynamic )
 		R_AddDynamicLights( surf );
 
 	// Put into texture format
-	stride -= (smax << 2);
-	bl = r_blocklights;
-
-	for( t = 0; t < tmax; t++, dest += stride )
-	{
-		for( s = 0; s < smax; s++ )
-		{
-			dest[0] = Q_min((bl[0] >> 7), 255 );
-			dest[1] = Q_min((bl[1] >> 7), 255 );
-			dest[2] = Q_min((bl[2] >> 7), 255 );
-			dest[3] = 255;
-
-			bl += 3;
-			dest += 4;
-		}
-	}
+	R_PackLightMap( r_blocklights, dest, stride, smax, tmax );
 }
 
 /*
-================
-DrawGLPoly
-================
+=================
+LM_QueueSurface
+
+static lightmaps are composed in a batch right before
+the page is uploaded, every surface owns its region of
+the page so the jobs can be spread across the workers
+=================
 */
-void DrawGLPoly( glpoly_t *p, float xScale, float yScale )
+static void LM_QueueSurface( msurface_t *surf, byte *dest, int stride, int size )
 {
-	float		*v;
-	float		sOffset, sy;
-	float		tOffset, cy;
-	cl_entity_t	*e = RI.currententity;
-	int		i, hasScale = false;
-
-	if( !p ) return;
-
-	if( FBitSet( p->flags, SURF_DRAWTILED ))
-		GL_ResetFogColor();
+	lmjob_t	*job;
 
-	if( p->flags & SURF_CONVEYOR )
+	if( lm_queue.numjobs == lm_queue.maxjobs )
 	{
-		float		flConveyorSpeed = 0.0f;
-		float		flRate, flAngle;
-		gl_texture_t	*texture;
+		lm_queue.maxjobs = Q_max( lm_queue.maxjobs * 2, 256 );
+		lm_queue.jobs = Mem_Realloc( r_temppool, lm_queue.jobs, lm_queue.maxjobs * sizeof( lmjob_t ));
+	}
 
-		if( ENGINE_GET_PARM( PARM_QUAKE_COMPATIBLE ) && RI.currententity == gEngfuncs.GetEntityByIndex( 0 ) )
-		{
-			// same as doom speed
-			flConveyorSpeed = -35.0f;
-		}
-		else
-		{
-			flConveyorSpeed = (e->curstate.rendercolor.g<<8|e->curstate.rendercolor.b) / 16.0f;
-			if( e->curstate.rendercolor.r ) flConveyorSpeed = -flConveyorSpeed;
-		}
-		texture = R_GetTexture( glState.currentTextures[glState.activeTMU] );
+	job = &lm_queue.jobs[lm_queue.numjobs++];
+	job->surf = surf;
+	job->dest = dest;
+	job->stride = stride;
+	lm_queue.maxsize = Q_max( lm_queue.maxsize, size * 3 );
+}
 
-		flRate = fabs( flConveyorSpeed ) / (float)texture->srcWidth;
-		flAngle = ( flConveyorSpeed >= 0 ) ? 180 : 0;
+static int LM_NextJob( void )
+{
+#if !defined( HAVE_LM_THREADS )
+	return lm_queue.next++;
+#elif XASH_WIN32
+	return InterlockedIncrement( &lm_queue.next ) - 1;
+#else
+	return __atomic_fetch_add( &lm_queue.next, 1, __ATOMIC_RELAXED );
+#endif
+}
 
-		SinCos( flAngle * ( M_PI_F / 180.0f ), &sy, &cy );
-		sOffset = gpGlobals->time * cy * flRate;
-		tOffset = gpGlobals->time * sy * flRate;
+/*
+=================
+LM_RunJobs
 
-		// make sure that we are positive
-		if( sOffset < 0.0f ) sOffset += 1.0f + -(int)sOffset;
-		if( tOffset < 0.0f ) tOffset += 1.0f + -(int)tOffset;
+worker loop, must not call into the engine except
+the pure helpers like Mod_SampleSizeForFace
+=================
+*/
+static void LM_RunJobs( lmworker_t *worker )
+{
+	int		i, smax, tmax, sample_size;
+	lmjob_t		*job;
 
-		// make sure that we are in a [0,1] range
-		sOffset = sOffset - (int)sOffset;
-		tOffset = tOffset - (int)tOffset;
-	}
-	else
+	while(( i = LM_NextJob( )) < lm_queue.numjobs )
 	{
-		sOffset = tOffset = 0.0f;
+		job = &lm_queue.jobs[i];
+		sample_size = gEngfuncs.Mod_SampleSizeForFace( job->surf );
+		smax = ( job->surf->info->lightextents[0] / sample_size ) + 1;
+		tmax = ( job->surf->info->lightextents[1] / sample_size ) + 1;
+
+		R_AccumulateLightStyles( job->surf, worker->blocklights, smax * tmax );
+		R_PackLightMap( worker->blocklights, job->dest, job->stride, smax, tmax );
 	}
+}
 
-	if( xScale != 0.0f && yScale != 0.0f )
-		hasScale = true;
+#ifdef HAVE_LM_THREADS
+#if XASH_WIN32
+static DWORD WINAPI LM_WorkerThread( LPVOID arg )
+{
+	LM_RunJobs( arg );
+	return 0;
+}
+#else
+static void *LM_WorkerThread( void *arg )
+{
+	LM_RunJobs( arg );
+	return NULL;
+}
+#endif
+#endif // HAVE_LM_THREADS
 
-	pglBegin( GL_POLYGON );
+static qboolean LM_StartWorker( lmworker_t *worker )
+{
+#if !defined( HAVE_LM_THREADS )
+	return false;
+#elif XASH_WIN32
+	worker->thread = CreateThread( NULL, 0, LM_WorkerThread, worker, 0, NULL );
+	return worker->thread != NULL;
+#else
+	return pthread_create( &worker->thread, NULL, LM_WorkerThread, worker ) == 0;
+#endif
+}
 
-	for( i = 0, v = p->verts[0]; i < p->numverts; i++, v += VERTEXSIZE )
+static void LM_JoinWorker( lmworker_t *worker )
+{
+#if !defined( HAVE_LM_THREADS )
+	return;
+#elif XASH_WIN32
+	WaitForSingleObject( worker->thread, INFINITE );
+	CloseHandle( worker->thread );
+#else
+	pthread_join( worker->thread, NULL );
+#endif
+}
+
+/*
+=================
+LM_NumWorkers
+
+gl_lightmap_threads 0 means one worker per cpu
+=================
+*/
+static int LM_NumWorkers( void )
+{
+	int	count = gl_lightmap_threads->value;
+
+	if( count <= 0 )
 	{
-		if( hasScale )
-			pglTexCoord2f(( v[3] + sOffset ) * xScale, ( v[4] + tOffset ) * yScale );
-		else pglTexCoord2f( v[3] + sOffset, v[4] + tOffset );
+#if !defined( HAVE_LM_THREADS )
+		count = 1;
+#elif XASH_WIN32
+		SYSTEM_INFO	info;
 
-		pglVertex3fv( v );
+		GetSystemInfo( &info );
+		count = info.dwNumberOfProcessors;
+#else
+		count = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
 	}
 
-	pglEnd();
-
-	if( FBitSet( p->flags, SURF_DRAWTILED ))
-		GL_SetupFogColorForSurfaces();
+	return bound( 1, count, LM_MAX_WORKERS );
 }
 
 /*
-================
-DrawGLPolyChain
+=================
+LM_ComposeQueue
 
-Render lightmaps
-================
+compose all the queued surfaces, the calling thread
+works as a first worker and waits for the rest
+=================
+*/
+static void LM_ComposeQueue( int numworkers )
+{
+	int	i, started;
+
+	if( !lm_queue.numjobs )
+		return;
+
+	numworkers = bound( 1, numworkers, LM_MAX_WORKERS );
+
+	// scratch is allocated here, engine mempools aren't thread-safe
+	for( i = 0; i < numworkers; i++ )
+		lm_workers[i].blocklights = Mem_Malloc( r_temppool, lm_queue.maxsize * sizeof( uint ));
+
+	lm_queue.next = 0;
+
+	for( started = 1; started < numworkers; started++ )
+	{
+		if( !LM_StartWorker( &lm_workers[started] ))
+			break; // whatever is left will be done by us
+	}
+
+	LM_RunJobs( &lm_workers[0] );
+
+	for( i = 1; i < started; i++ )
+		LM_JoinWorker( &lm_workers[i] );
+
+	for( i = 0; i < numworkers; i++ )
+	{
+		Mem_Free( lm_workers[i].blocklights );
+		lm_workers[i].blocklights = NULL;
+	}
+
+	lm_queue.numjobs = lm_queue.maxsize = 0;
+}
+
+/*
+=================
+LM_FreeQueue
+=================
+*/
+static void LM_FreeQueue( void )
+{
+	if( lm_queue.jobs )
+		Mem_Free( lm_queue.jobs );
+	memset( &lm_queue, 0, sizeof( lm_queue ));
+}
+
+/*
+=============================================================================
+
+  LIGHTMAP ALLOCATION
+
+=============================================================================
+*/
+/*
+=================
+LM_InitPacker
+
+skyline allocator: the free space of the block is described by the
+top edge of allocated rectangles, every new rectangle is placed on
+the lowest spot and then on the spot that leaves less space below it
+=================
+*/
+static void LM_InitPacker( lmpacker_t *packer, int size )
+{
+	packer->nodes[0].x = 0;
+	packer->nodes[0].y = 0;
+	packer->nodes[0].width = size;
+	packer->numnodes = 1;
+	packer->size = size;
+	packer->used = 0;
+}
+
+/*
+=================
+LM_SkylineFit
+
+check rectangle placed on top of node, returns the resulting
+height and the area wasted below the rectangle
+=================
+*/
+static qboolean LM_SkylineFit( const lmpacker_t *packer, int node, int w, int h, int *y, int *waste )
+{
+	const lmskyline_t	*n = &packer->nodes[node];
+	int		i, left, span, top = 0;
+
+	if( n->x + w > packer->size )
+		return false;
+
+	for( i = node, left = w; left > 0; i++ )
+	{
+		top = Q_max( top, packer->nodes[i].y );
+		left -= packer->nodes[i].width;
+	}
+
+	if( top + h > packer->size )
+		return false;
+
+	*waste = 0;
+
+	for( i = node, left = w; left > 0; i++ )
+	{
+		span = Q_min( left, packer->nodes[i].width );
+		*waste += ( top - packer->nodes[i].y ) * span;
+		left -= span;
+	}
+
+	*y = top;
+
+	return true;
+}
+
+static qboolean LM_PackRect( lmpacker_t *packer, int w, int h, int *x, int *y )
+{
+	int		i, best = -1, besttop = 0, bestwaste = 0;
+	int		top, waste;
+	lmskyline_t	*n;
+
+	for( i = 0; i < packer->numnodes; i++ )
+	{
+		if( !LM_SkylineFit( packer, i, w, h, &top, &waste ))
+			continue;
+
+		if( best == -1 || top < besttop || ( top == besttop && waste < bestwaste ))
+		{
+			best = i;
+			besttop = top;
+			bestwaste = waste;
+		}
+	}
+
+	if( best == -1 )
+		return false;
+
+	*x = packer->nodes[best].x;
+	*y = besttop;
+
+	// new node replaces the covered part of the skyline
+	memmove( &packer->nodes[best+1], &packer->nodes[best], ( packer->numnodes - best ) * sizeof( lmskyline_t ));
+	packer->numnodes++;
+
+	n = &packer->nodes[best];
+	n->y = besttop + h;
+	n->width = w;
+
+	for( i = best + 1; i < packer->numnodes; )
+	{
+		int	shrink = n->x + n->width - packer->nodes[i].x;
+
+		if( shrink <= 0 )
+			break;
+
+		if( shrink < packer->nodes[i].width )
+		{
+			packer->nodes[i].x += shrink;
+			packer->nodes[i].width -= shrink;
+			break;
+		}
+
+		memmove( &packer->nodes[i], &packer->nodes[i+1], ( packer->numnodes - i - 1 ) * sizeof( lmskyline_t ));
+		packer->numnodes--;
+	}
+
+	// merge neighbours on the same level
+	for( i = Q_max( best - 1, 0 ); i < packer->numnodes - 1 && i <= best; )
+	{
+		if( packer->nodes[i].y == packer->nodes[i+1].y )
+		{
+			packer->nodes[i].width += packer->nodes[i+1].width;
+			memmove( &packer->nodes[i+1], &packer->nodes[i+2], ( packer->numnodes - i - 2 ) * sizeof( lmskyline_t ));
+			packer->numnodes--;
+			best--;
+		}
+		else i++;
+	}
+
+	packer->used += w * h;
+
+	return true;
+}
+
+static int LM_PackerHeight( const lmpacker_t *packer )
+{
+	int	i, height = 0;
+
+	for( i = 0; i < packer->numnodes; i++ )
+		height = Q_max( height, packer->nodes[i].y );
+
+	return height;
+}
+
+static void LM_InitBlock( void )
+{
+	LM_InitPacker( &gl_lms.packer, BLOCK_SIZE );
+}
+
+static int LM_AllocBlock( int w, int h, int *x, int *y )
+{
+	return LM_PackRect( &gl_lms.packer, w, h, x, y );
+}
+
+static void LM_UploadDynamicBlock( void )
+{
+	int	height = LM_PackerHeight( &gl_lms.packer );
+
+	pglTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, BLOCK_SIZE, height, GL_RGBA, GL_UNSIGNED_BYTE, gl_lms.lightmap_buffer );
+}
+
+static void LM_UploadBlock( qboolean dynamic )
+{
+	int	i;
+
+	if( dynamic )
+	{
+		int	height = LM_PackerHeight( &gl_lms.packer );
+
+		GL_Bind( XASH_TEXTURE0, tr.dlightTexture );
+		pglTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, BLOCK_SIZE, height, GL_RGBA, GL_UNSIGNED_BYTE, gl_lms.lightmap_buffer );
+	}
+	else
+	{
+		rgbdata_t	r_lightmap;
+		char	lmName[16];
+
+		// page is complete, fill it before upload
+		LM_ComposeQueue( lm_queue.numjobs < LM_MIN_JOBS ? 1 : LM_NumWorkers( ));
+
+		i = gl_lms.current_lightmap_texture;
+		gl_lms.lightmap_used[i] = gl_lms.packer.used;
+
+		// upload static lightmaps only during loading
+		memset( &r_lightmap, 0, sizeof( r_lightmap ));
+		Q_snprintf( lmName, sizeof( lmName ), "*lightmap%i", i );
+
+		r_lightmap.width = BLOCK_SIZE;
+		r_lightmap.height = BLOCK_SIZE;
+		r_lightmap.type = PF_RGBA_32;
+		r_lightmap.size = r_lightmap.width * r_lightmap.height * 4;
+		r_lightmap.flags = IMAGE_HAS_COLOR;
+		r_lightmap.buffer = gl_lms.lightmap_buffer;
+		tr.lightmapTextures[i] = GL_LoadTextureInternal( lmName, &r_lightmap, TF_FONT|TF_ATLAS_PAGE );
+
+		if( ++gl_lms.current_lightmap_texture == MAX_LIGHTMAPS )
+			gEngfuncs.Host_Error( "AllocBlock: full\n" );
+	}
+}
+
+/*
+================
+DrawGLPoly
+================
+*/
+void DrawGLPoly( glpoly_t *p, float xScale, float yScale )
+{
+	float		*v;
+	float		sOffset, sy;
+	float		tOffset, cy;
+	cl_entity_t	*e = RI.currententity;
+	int		i, hasScale = false;
+
+	if( !p ) return;
+
+	if( FBitSet( p->flags, SURF_DRAWTILED ))
+		GL_ResetFogColor();
+
+	if( p->flags & SURF_CONVEYOR )
+	{
+		float		flConveyorSpeed = 0.0f;
+		float		flRate, flAngle;
+		gl_texture_t	*texture;
+
+		if( ENGINE_GET_PARM( PARM_QUAKE_COMPATIBLE ) && RI.currententity == gEngfuncs.GetEntityByIndex( 0 ) )
+		{
+			// same as doom speed
+			flConveyorSpeed = -35.0f;
+		}
+		else
+		{
+			flConveyorSpeed = (e->curstate.rendercolor.g<<8|e->curstate.rendercolor.b) / 16.0f;
+			if( e->curstate.rendercolor.r ) flConveyorSpeed = -flConveyorSpeed;
+		}
+		texture = R_GetTexture( glState.currentTextures[glState.activeTMU] );
+
+		flRate = fabs( flConveyorSpeed ) / (float)texture->srcWidth;
+		flAngle = ( flConveyorSpeed >= 0 ) ? 180 : 0;
+
+		SinCos( flAngle * ( M_PI_F / 180.0f ), &sy, &cy );
+		sOffset = gpGlobals->time * cy * flRate;
+		tOffset = gpGlobals->time * sy * flRate;
+
+		// make sure that we are positive
+		if( sOffset < 0.0f ) sOffset += 1.0f + -(int)sOffset;
+		if( tOffset < 0.0f ) tOffset += 1.0f + -(int)tOffset;
+
+		// make sure that we are in a [0,1] range
+		sOffset = sOffset - (int)sOffset;
+		tOffset = tOffset - (int)tOffset;
+	}
+	else
+	{
+		sOffset = tOffset = 0.0f;
+	}
+
+	if( xScale != 0.0f && yScale != 0.0f )
+		hasScale = true;
+
+	pglBegin( GL_POLYGON );
+
+	for( i = 0, v = p->verts[0]; i < p->numverts; i++, v += VERTEXSIZE )
+	{
+		if( hasScale )
+			pglTexCoord2f(( v[3] + sOffset ) * xScale, ( v[4] + tOffset ) * yScale );
+		else pglTexCoord2f( v[3] + sOffset, v[4] + tOffset );
+
+		pglVertex3fv( v );
+	}
+
+	pglEnd();
+
+	if( FBitSet( p->flags, SURF_DRAWTILED ))
+		GL_SetupFogColorForSurfaces();
+}
+
+/*
+================
+DrawGLPolyChain
+
+Render lightmaps
+================
 */
 void DrawGLPolyChain( glpoly_t *p, float soffset, float toffset )
 {
@@ -3026,77 +3476,47 @@ qboolean R_AddSurfToVBO( msurface_t *surf, qboolean buildlightmap )
 */
 /*
 ================
-R_RecursiveWorldNode
+R_DrawWorldLeaf
 ================
 */
-void R_RecursiveWorldNode( mnode_t *node, uint clipflags )
+static void R_DrawWorldLeaf( mleaf_t *pleaf )
 {
-	int		i, clipped;
-	msurface_t	*surf, **mark;
-	mleaf_t		*pleaf;
-	int		c, side;
-	float		dot;
-loc0:
-	if( node->contents == CONTENTS_SOLID )
-		return; // hit a solid leaf
+	msurface_t	**mark;
+	int		c;
 
-	if( node->visframe != tr.visframecount )
-		return;
+	mark = pleaf->firstmarksurface;
+	c = pleaf->nummarksurfaces;
 
-	if( clipflags && !CVAR_TO_BOOL( r_nocull ))
+	if( c )
 	{
-		for( i = 0; i < 6; i++ )
+		do
 		{
-			const mplane_t	*p = &RI.frustum.planes[i];
-
-			if( !FBitSet( clipflags, BIT( i )))
-				continue;
-
-			clipped = BoxOnPlaneSide( node->minmaxs, node->minmaxs + 3, p );
-			if( clipped == 2 ) return;
-			if( clipped == 1 ) ClearBits( clipflags, BIT( i ));
-		}
+			(*mark)->visframe = tr.framecount;
+			mark++;
+		} while( --c );
 	}
 
-	// if a leaf node, draw stuff
-	if( node->contents < 0 )
-	{
-		pleaf = (mleaf_t *)node;
+	// deal with model fragments in this leaf
+	if( pleaf->efrags )
+		gEngfuncs.R_StoreEfrags( &pleaf->efrags, tr.realframecount );
 
-		mark = pleaf->firstmarksurface;
-		c = pleaf->nummarksurfaces;
+	r_stats.c_world_leafs++;
+}
 
-		if( c )
-		{
-			do
-			{
-				(*mark)->visframe = tr.framecount;
-				mark++;
-			} while( --c );
-		}
+/*
+================
+R_DrawWorldNode
+================
+*/
+static void R_DrawWorldNode( mnode_t *node, uint clipflags )
+{
+	msurface_t	*surf;
+	int		c;
 
-		// deal with model fragments in this leaf
-		if( pleaf->efrags )
-			gEngfuncs.R_StoreEfrags( &pleaf->efrags, tr.realframecount );
-
-		r_stats.c_world_leafs++;
-		return;
-	}
-
-	// node is just a decision point, so go down the apropriate sides
-
-	// find which side of the node we are on
-	dot = PlaneDiff( tr.modelorg, node->plane );
-	side = (dot >= 0.0f) ? 0 : 1;
-
-	// recurse down the children, front side first
-	R_RecursiveWorldNode( node->children[side], clipflags );
-
-	// draw stuff
-	for( c = node->numsurfaces, surf = WORLDMODEL->surfaces + node->firstsurface; c; c--, surf++ )
-	{
-		if( R_CullSurface( surf, &RI.frustum, clipflags ))
-			continue;
+	for( c = node->numsurfaces, surf = WORLDMODEL->surfaces + node->firstsurface; c; c--, surf++ )
+	{
+		if( R_CullSurface( surf, &RI.frustum, clipflags ))
+			continue;
 
 		if( surf->flags & SURF_DRAWSKY )
 		{
@@ -3110,10 +3530,34 @@ loc0:
 			surf->texinfo->texture->texturechain = surf;
 		}
 	}
+}
 
-	// recurse down the back side
-	node = node->children[!side];
-	goto loc0;
+/*
+================
+R_DrawWorldNodes
+
+walk the nodes and leafs that passed the pvs and frustum,
+they come in the same order as the old recursion visited them
+================
+*/
+static void R_DrawWorldNodes( uint clipflags )
+{
+	cullplanes_t	planes;
+	cullnode_t	*item;
+	int		i, count;
+
+	if( CVAR_TO_BOOL( r_nocull ))
+		clipflags = 0;
+
+	R_WorldCullSetPlanes( &planes, RI.frustum.planes, FRUSTUM_PLANES );
+	count = R_WorldCullNodes( &tr.worldcull, &planes, tr.modelorg, clipflags, tr.visframecount );
+
+	for( i = 0, item = tr.worldcull.visible; i < count; i++, item++ )
+	{
+		if( item->node->contents < 0 )
+			R_DrawWorldLeaf( (mleaf_t *)item->node );
+		else R_DrawWorldNode( item->node, item->clipflags );
+	}
 }
 
 /*
@@ -3335,7 +3779,7 @@ void R_DrawWorld( void )
 	start = gEngfuncs.pfnTime();
 	if( RI.drawOrtho )
 		R_DrawWorldTopView( WORLDMODEL->nodes, RI.frustum.clipFlags );
-	else R_RecursiveWorldNode( WORLDMODEL->nodes, RI.frustum.clipFlags );
+	else R_DrawWorldNodes( RI.frustum.clipFlags );
 	end = gEngfuncs.pfnTime();
 
 	r_stats.t_world_node = end - start;
@@ -3380,9 +3824,8 @@ void R_MarkLeaves( void )
 	qboolean	novis = false;
 	qboolean	force = false;
 	mleaf_t	*leaf = NULL;
-	mnode_t	*node;
+	int	leaf1, leaf2;
 	vec3_t	test;
-	int	i;
 
 	if( !RI.drawWorld ) return;
 
@@ -3427,14 +3870,129 @@ void R_MarkLeaves( void )
 	if( r_novis->value || RI.drawOrtho || !RI.viewleaf || !WORLDMODEL->visdata )
 		novis = true;
 
-	gEngfuncs.R_FatPVS( RI.pvsorigin, REFPVS_RADIUS, RI.visbytes, FBitSet( RI.params, RP_OLDVIEWLEAF ), novis );
-	if( force && !novis ) gEngfuncs.R_FatPVS( test, REFPVS_RADIUS, RI.visbytes, true, novis );
+	// the pvs of a leaf pair doesn't change, so keep the last few of them.
+	// merging into the previous pvs depends on it and can't be cached
+	leaf1 = ( RI.viewleaf && !FBitSet( RI.params, RP_OLDVIEWLEAF )) ? RI.viewleaf - WORLDMODEL->leafs : -1;
+	leaf2 = ( force && !novis ) ? leaf - WORLDMODEL->leafs : -1;
+
+	if( !R_WorldCullFindPVS( &tr.worldcull, leaf1, leaf2, novis, RI.visbytes ))
+	{
+		gEngfuncs.R_FatPVS( RI.pvsorigin, REFPVS_RADIUS, RI.visbytes, FBitSet( RI.params, RP_OLDVIEWLEAF ), novis );
+		if( force && !novis ) gEngfuncs.R_FatPVS( test, REFPVS_RADIUS, RI.visbytes, true, novis );
+		R_WorldCullStorePVS( &tr.worldcull, leaf1, leaf2, novis, RI.visbytes );
+	}
+
+	R_WorldCullMarkNodes( &tr.worldcull, tr.visframecount );
+}
+
+/*
+===============
+R_CullBenchRecursive
+
+the scalar traversal, kept to check the packed one
+===============
+*/
+static void R_CullBenchRecursive( mnode_t *node, uint clipflags, uint *hash, int *count )
+{
+	int	i, clipped, side;
 
-	for( i = 0; i < WORLDMODEL->numleafs; i++ )
+	while( 1 )
 	{
-		if( CHECKVISBIT( RI.visbytes, i ))
+		if( node->contents == CONTENTS_SOLID )
+			return;
+
+		if( node->visframe != tr.visframecount )
+			return;
+
+		if( clipflags )
 		{
-			node = (mnode_t *)&WORLDMODEL->leafs[i+1];
+			for( i = 0; i < FRUSTUM_PLANES; i++ )
+			{
+				if( !FBitSet( clipflags, BIT( i )))
+					continue;
+
+				clipped = BoxOnPlaneSide( node->minmaxs, node->minmaxs + 3, &RI.frustum.planes[i] );
+				if( clipped == 2 ) return;
+				if( clipped == 1 ) ClearBits( clipflags, BIT( i ));
+			}
+		}
+
+		if( node->contents < 0 )
+		{
+			*hash = *hash * 31 + ((mleaf_t *)node - WORLDMODEL->leafs ) + WORLDMODEL->numnodes;
+			(*count)++;
+			return;
+		}
+
+		side = ( PlaneDiff( tr.modelorg, node->plane ) >= 0.0f ) ? 0 : 1;
+		R_CullBenchRecursive( node->children[side], clipflags, hash, count );
+
+		*hash = *hash * 31 + ( node - WORLDMODEL->nodes );
+		(*count)++;
+
+		node = node->children[!side];
+	}
+}
+
+/*
+===============
+R_CullBench_f
+
+stand in the world leafs looking around,
+time the pvs marking and the frustum traversal
+against the scalar code they replaced
+===============
+*/
+void R_CullBench_f( void )
+{
+	int		i, j, pass, frames = 256, numleafs, mismatch = 0;
+	double		start, old_pvs = 0.0, new_pvs = 0.0, old_cull = 0.0, new_cull = 0.0;
+	int		old_count = 0, new_count = 0;
+	vec3_t		angles, cullorigin, vforward, vright, vup, modelorg;
+	gl_frustum_t	frustum;
+	cullplanes_t	planes;
+	mleaf_t		*leaf;
+	mnode_t		*node;
+
+	if( !WORLDMODEL || !tr.worldcull.model )
+	{
+		gEngfuncs.Con_Printf( "r_cullbench: no map loaded\n" );
+		return;
+	}
+
+	if( gEngfuncs.Cmd_Argc() > 1 )
+		frames = Q_max( 4, Q_atoi( gEngfuncs.Cmd_Argv( 1 )));
+
+	numleafs = WORLDMODEL->numleafs;
+	frustum = RI.frustum;
+	VectorCopy( RI.cullorigin, cullorigin );
+	VectorCopy( RI.cull_vforward, vforward );
+	VectorCopy( RI.cull_vright, vright );
+	VectorCopy( RI.cull_vup, vup );
+	VectorCopy( tr.modelorg, modelorg );
+
+	// visit the leafs by four, going back and forth as a player crossing leaf borders does
+	for( i = 0; i < frames; i++ )
+	{
+		uint	old_hash = 0, new_hash = 0;
+		int	n = 0, count;
+
+		leaf = &WORLDMODEL->leafs[1 + ((( i >> 4 ) << 2 ) + ( i & 3 )) % numleafs];
+		if( leaf->contents == CONTENTS_SOLID )
+			continue;
+
+		pass = i & 15;
+
+		// full pvs and a scan of all leafs
+		tr.visframecount++;
+		start = gEngfuncs.pfnTime();
+		gEngfuncs.R_FatPVS( leaf->minmaxs, REFPVS_RADIUS, RI.visbytes, false, !WORLDMODEL->visdata );
+		for( j = 0; j < numleafs; j++ )
+		{
+			if( !CHECKVISBIT( RI.visbytes, j ))
+				continue;
+
+			node = (mnode_t *)&WORLDMODEL->leafs[j+1];
 			do
 			{
 				if( node->visframe == tr.visframecount )
@@ -3443,7 +4001,61 @@ void R_MarkLeaves( void )
 				node = node->parent;
 			} while( node );
 		}
+		old_pvs += gEngfuncs.pfnTime() - start;
+
+		// cached pvs and its leaf list
+		tr.visframecount++;
+		start = gEngfuncs.pfnTime();
+		if( !R_WorldCullFindPVS( &tr.worldcull, leaf - WORLDMODEL->leafs, -1, !WORLDMODEL->visdata, RI.visbytes ))
+		{
+			gEngfuncs.R_FatPVS( leaf->minmaxs, REFPVS_RADIUS, RI.visbytes, false, !WORLDMODEL->visdata );
+			R_WorldCullStorePVS( &tr.worldcull, leaf - WORLDMODEL->leafs, -1, !WORLDMODEL->visdata, RI.visbytes );
+		}
+		R_WorldCullMarkNodes( &tr.worldcull, tr.visframecount );
+		new_pvs += gEngfuncs.pfnTime() - start;
+
+		// look from the leaf center into a different direction every time
+		VectorAverage( leaf->minmaxs, leaf->minmaxs + 3, RI.cullorigin );
+		VectorSet( angles, ( pass & 1 ) ? -30.0f : 15.0f, pass * 22.5f, 0.0f );
+		AngleVectors( angles, RI.cull_vforward, RI.cull_vright, RI.cull_vup );
+		GL_FrustumInitProj( &RI.frustum, 0.0f, Q_max( 256.0f, RI.farClip ), 90.0f, 73.74f );
+		VectorCopy( RI.cullorigin, tr.modelorg );
+
+		start = gEngfuncs.pfnTime();
+		R_CullBenchRecursive( WORLDMODEL->nodes, RI.frustum.clipFlags, &old_hash, &n );
+		old_cull += gEngfuncs.pfnTime() - start;
+
+		start = gEngfuncs.pfnTime();
+		R_WorldCullSetPlanes( &planes, RI.frustum.planes, FRUSTUM_PLANES );
+		count = R_WorldCullNodes( &tr.worldcull, &planes, tr.modelorg, RI.frustum.clipFlags, tr.visframecount );
+		new_cull += gEngfuncs.pfnTime() - start;
+
+		for( j = 0; j < count; j++ )
+		{
+			node = tr.worldcull.visible[j].node;
+			if( node->contents < 0 )
+				new_hash = new_hash * 31 + ((mleaf_t *)node - WORLDMODEL->leafs ) + WORLDMODEL->numnodes;
+			else new_hash = new_hash * 31 + ( node - WORLDMODEL->nodes );
+		}
+
+		if( n != count || old_hash != new_hash )
+			mismatch++;
+
+		old_count += n;
+		new_count += count;
 	}
+
+	RI.frustum = frustum;
+	VectorCopy( cullorigin, RI.cullorigin );
+	VectorCopy( vforward, RI.cull_vforward );
+	VectorCopy( vright, RI.cull_vright );
+	VectorCopy( vup, RI.cull_vup );
+	VectorCopy( modelorg, tr.modelorg );
+	tr.fResetVis = true; // the view pvs is gone
+
+	gEngfuncs.Con_Printf( "%i frames: pvs %.2f usec (was %.2f), frustum %.2f usec (was %.2f)\n",
+		frames, new_pvs * 1e6 / frames, old_pvs * 1e6 / frames, new_cull * 1e6 / frames, old_cull * 1e6 / frames );
+	gEngfuncs.Con_Printf( "%i nodes and leafs visible (was %i), %i frames differ\n", new_count, old_count, mismatch );
 }
 
 /*
@@ -3483,7 +4095,290 @@ void GL_CreateSurfaceLightmap( msurface_t *surf, model_t *loadmodel )
 	base += ( surf->light_t * BLOCK_SIZE + surf->light_s ) * 4;
 
 	R_SetCacheState( surf );
-	R_BuildLightMap( surf, base, BLOCK_SIZE * 4, false );
+	LM_QueueSurface( surf, base, BLOCK_SIZE * 4, smax * tmax );
+}
+
+/*
+==================
+LM_GatherSurfaces
+
+collect lightmapped surfaces of all brush models,
+caller must free the list
+==================
+*/
+static int LM_GatherSurfaces( lmsurf_t **out )
+{
+	int		i, j, count = 0;
+	int		sample_size;
+	lmsurf_t		*list;
+	msurface_t	*surf;
+	model_t		*m;
+
+	for( i = 0; i < ENGINE_GET_PARM( PARM_NUMMODELS ); i++ )
+	{
+		if(( m = gEngfuncs.pfnGetModelByIndex( i + 1 )) == NULL )
+			continue;
+
+		if( m->name[0] == '*' || m->type != mod_brush || !m->lightdata )
+			continue;
+
+		count += m->numsurfaces;
+	}
+
+	*out = list = Mem_Malloc( r_temppool, Q_max( count, 1 ) * sizeof( lmsurf_t ));
+	count = 0;
+
+	for( i = 0; i < ENGINE_GET_PARM( PARM_NUMMODELS ); i++ )
+	{
+		if(( m = gEngfuncs.pfnGetModelByIndex( i + 1 )) == NULL )
+			continue;
+
+		if( m->name[0] == '*' || m->type != mod_brush || !m->lightdata )
+			continue;
+
+		for( j = 0, surf = m->surfaces; j < m->numsurfaces; j++, surf++ )
+		{
+			if( FBitSet( surf->flags, SURF_DRAWTILED ))
+				continue;
+
+			sample_size = gEngfuncs.Mod_SampleSizeForFace( surf );
+			list[count].surf = surf;
+			list[count].model = m;
+			list[count].width = ( surf->info->lightextents[0] / sample_size ) + 1;
+			list[count].height = ( surf->info->lightextents[1] / sample_size ) + 1;
+			list[count].page = -1;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+==================
+LM_SurfaceCompare
+
+tallest first, then widest, source order breaks ties
+so the layout is the same on every rebuild
+==================
+*/
+static int LM_SurfaceCompare( const void *a, const void *b )
+{
+	const lmsurf_t	*s1 = (const lmsurf_t *)a;
+	const lmsurf_t	*s2 = (const lmsurf_t *)b;
+
+	if( s1->height != s2->height )
+		return s2->height - s1->height;
+	if( s1->width != s2->width )
+		return s2->width - s1->width;
+	if( s1->surf < s2->surf )
+		return -1;
+	if( s1->surf > s2->surf )
+		return 1;
+	return 0;
+}
+
+/*
+==================
+GL_AllocLightmaps
+
+place surfaces of all brush models in the atlas,
+sorted by height they pack much tighter
+==================
+*/
+static void GL_AllocLightmaps( void )
+{
+	lmsurf_t	*list;
+	int	i, count;
+
+	count = LM_GatherSurfaces( &list );
+	qsort( list, count, sizeof( lmsurf_t ), LM_SurfaceCompare );
+
+	for( i = 0; i < count; i++ )
+		GL_CreateSurfaceLightmap( list[i].surf, list[i].model );
+
+	Mem_Free( list );
+}
+
+/*
+==================
+LM_AllocColumns
+
+the column allocator used before the skyline,
+r_lightmapstats keeps it for the comparison
+==================
+*/
+static qboolean LM_AllocColumns( int *allocated, int size, int w, int h, int *x, int *y )
+{
+	int	i, j;
+	int	best, best2;
+
+	best = size;
+
+	for( i = 0; i < size - w; i++ )
+	{
+		best2 = 0;
+
+		for( j = 0; j < w; j++ )
+		{
+			if( allocated[i+j] >= best )
+				break;
+			if( allocated[i+j] > best2 )
+				best2 = allocated[i+j];
+		}
+
+		if( j == w )
+		{
+			*x = i;
+			*y = best = best2;
+		}
+	}
+
+	if( best + h > size )
+		return false;
+
+	for( i = 0; i < w; i++ )
+		allocated[*x + i] = best + h;
+
+	return true;
+}
+
+/*
+==================
+LM_SimulatePacking
+
+lay out the list without touching the atlas,
+returns number of pages used
+==================
+*/
+static int LM_SimulatePacking( lmsurf_t *list, int count, qboolean skyline )
+{
+	lmpacker_t	packer;
+	int		allocated[BLOCK_SIZE_MAX];
+	int		i, pass, pages = 1;
+	int		x = 0, y = 0;
+	qboolean		fit = false;
+
+	LM_InitPacker( &packer, BLOCK_SIZE );
+	memset( allocated, 0, sizeof( allocated ));
+
+	for( i = 0; i < count; i++ )
+	{
+		for( pass = 0; pass < 2; pass++ )
+		{
+			if( skyline ) fit = LM_PackRect( &packer, list[i].width, list[i].height, &x, &y );
+			else fit = LM_AllocColumns( allocated, BLOCK_SIZE, list[i].width, list[i].height, &x, &y );
+
+			if( fit || pass )
+				break;
+
+			// page is full, try again on the new one
+			LM_InitPacker( &packer, BLOCK_SIZE );
+			memset( allocated, 0, sizeof( allocated ));
+			pages++;
+		}
+
+		list[i].x = x;
+		list[i].y = y;
+		list[i].page = fit ? pages - 1 : -1;
+	}
+
+	return pages;
+}
+
+/*
+==================
+LM_CountOverlaps
+
+paint all the pages into occupancy map to validate the layout,
+returns number of luxels that are shared or out of the block
+==================
+*/
+static int LM_CountOverlaps( const lmsurf_t *list, int count, int pages )
+{
+	int	i, page, s, t, bad = 0;
+	byte	*map;
+
+	map = Mem_Malloc( r_temppool, BLOCK_SIZE * BLOCK_SIZE );
+
+	for( page = 0; page < pages; page++ )
+	{
+		memset( map, 0, BLOCK_SIZE * BLOCK_SIZE );
+
+		for( i = 0; i < count; i++ )
+		{
+			if( list[i].page != page )
+				continue;
+
+			for( t = list[i].y; t < list[i].y + list[i].height; t++ )
+			{
+				for( s = list[i].x; s < list[i].x + list[i].width; s++ )
+				{
+					if( s >= BLOCK_SIZE || t >= BLOCK_SIZE || map[t * BLOCK_SIZE + s] )
+						bad++;
+					else map[t * BLOCK_SIZE + s] = 1;
+				}
+			}
+		}
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		if( list[i].page == -1 )
+			bad += list[i].width * list[i].height;
+	}
+
+	Mem_Free( map );
+
+	return bad;
+}
+
+/*
+==================
+R_LightmapStats_f
+
+pack lightmaps of the current map with the old and the new allocator
+and print the atlas occupancy, works without GL
+==================
+*/
+void R_LightmapStats_f( void )
+{
+	int		i, count, pages, bad;
+	double		luxels = 0.0, capacity;
+	lmsurf_t		*list;
+
+	if( !WORLDMODEL || BLOCK_SIZE <= 0 )
+	{
+		gEngfuncs.Con_Printf( "r_lightmapstats: no map loaded\n" );
+		return;
+	}
+
+	count = LM_GatherSurfaces( &list );
+	capacity = BLOCK_SIZE * BLOCK_SIZE;
+
+	for( i = 0; i < count; i++ )
+		luxels += list[i].width * list[i].height;
+
+	gEngfuncs.Con_Printf( "%i surfaces, %.0f luxels, %ix%i blocks\n", count, luxels, BLOCK_SIZE, BLOCK_SIZE );
+
+	pages = LM_SimulatePacking( list, count, false );
+	bad = LM_CountOverlaps( list, count, pages );
+	gEngfuncs.Con_Printf( "columns, source order: %i pages, %.1f%% filled, %i bad luxels\n", pages, luxels * 100.0 / ( pages * capacity ), bad );
+
+	qsort( list, count, sizeof( lmsurf_t ), LM_SurfaceCompare );
+	pages = LM_SimulatePacking( list, count, true );
+	bad = LM_CountOverlaps( list, count, pages );
+	gEngfuncs.Con_Printf( "skyline, sorted: %i pages, %.1f%% filled, %i bad luxels\n", pages, luxels * 100.0 / ( pages * capacity ), bad );
+
+	Mem_Free( list );
+
+	if( !gl_lms.current_lightmap_texture )
+		return;
+
+	gEngfuncs.Con_Printf( "uploaded: %i pages\n", gl_lms.current_lightmap_texture );
+
+	for( i = 0; i < gl_lms.current_lightmap_texture; i++ )
+		gEngfuncs.Con_Printf( "  *lightmap%i: %.1f%% filled\n", i, gl_lms.lightmap_used[i] * 100.0 / capacity );
 }
 
 /*
@@ -3496,8 +4391,7 @@ when gamma is changed
 */
 void GL_RebuildLightmaps( void )
 {
-	int	i, j;
-	model_t	*m;
+	int	i;
 
 	if( !ENGINE_GET_PARM( PARM_CLIENT_ACTIVE ) )
 		return; // wait for worldmodel
@@ -3517,21 +4411,12 @@ void GL_RebuildLightmaps( void )
 
 	// setup all the lightstyles
 	CL_RunLightStyles();
+	GL_UpdateLightGamma();
 
 	LM_InitBlock();
-
-	for( i = 0; i < ENGINE_GET_PARM( PARM_NUMMODELS ); i++ )
-	{
-		if(( m = gEngfuncs.pfnGetModelByIndex( i + 1 )) == NULL )
-			continue;
-
-		if( m->name[0] == '*' || m->type != mod_brush )
-			continue;
-
-		for( j = 0; j < m->numsurfaces; j++ )
-			GL_CreateSurfaceLightmap( m->surfaces + j, m );
-	}
+	GL_AllocLightmaps();
 	LM_UploadBlock( false );
+	LM_FreeQueue();
 
 	if( gEngfuncs.drawFuncs->GL_BuildLightmaps )
 	{
@@ -3581,8 +4466,11 @@ void GL_BuildLightmaps( void )
 
 	// setup all the lightstyles
 	CL_RunLightStyles();
+	GL_UpdateLightGamma();
 
+	// polygons need lightmap coords, so allocate them first
 	LM_InitBlock();
+	GL_AllocLightmaps();
 
 	for( i = 0; i < ENGINE_GET_PARM( PARM_NUMMODELS ); i++ )
 	{
@@ -3598,8 +4486,6 @@ void GL_BuildLightmaps( void )
 			m->surfaces[j].pdecals = NULL;
 			m->surfaces[j].visframe = 0;
 
-			GL_CreateSurfaceLightmap( m->surfaces + j, m );
-
 			if( m->surfaces[j].flags & SURF_DRAWTURB )
 				continue;
 
@@ -3614,6 +4500,7 @@ void GL_BuildLightmaps( void )
 	}
 
 	LM_UploadBlock( false );
+	LM_FreeQueue();
 
 	if( gEngfuncs.drawFuncs->GL_BuildLightmaps )
 	{
@@ -3626,6 +4513,184 @@ void GL_BuildLightmaps( void )
 	ClearBits( vid_gamma->flags, FCVAR_CHANGED );
 }
 
+/*
+==================
+R_BuildLightMapReference
+
+per-texel composition as it was done before the gamma
+table, lightmapbench uses it to verify the batched path
+==================
+*/
+static void R_BuildLightMapReference( msurface_t *surf, byte *dest, int stride, uint *blocklights )
+{
+	int		smax, tmax;
+	uint		*bl, scale;
+	int		i, map, size, s, t;
+	int		sample_size;
+	color24		*lm;
+
+	sample_size = gEngfuncs.Mod_SampleSizeForFace( surf );
+	smax = ( surf->info->lightextents[0] / sample_size ) + 1;
+	tmax = ( surf->info->lightextents[1] / sample_size ) + 1;
+	size = smax * tmax;
+	lm = surf->samples;
+
+	memset( blocklights, 0, sizeof( uint ) * size * 3 );
+
+	for( map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255 && lm; map++ )
+	{
+		scale = tr.lightstylevalue[surf->styles[map]];
+
+		for( i = 0, bl = blocklights; i < size; i++, bl += 3, lm++ )
+		{
+			bl[0] += gEngfuncs.LightToTexGamma( lm->r ) * scale;
+			bl[1] += gEngfuncs.LightToTexGamma( lm->g ) * scale;
+			bl[2] += gEngfuncs.LightToTexGamma( lm->b ) * scale;
+		}
+	}
+
+	stride -= (smax << 2);
+	bl = blocklights;
+
+	for( t = 0; t < tmax; t++, dest += stride )
+	{
+		for( s = 0; s < smax; s++, bl += 3, dest += 4 )
+		{
+			dest[0] = Q_min((bl[0] >> 7), 255 );
+			dest[1] = Q_min((bl[1] >> 7), 255 );
+			dest[2] = Q_min((bl[2] >> 7), 255 );
+			dest[3] = 255;
+		}
+	}
+}
+
+/*
+==================
+LM_QueueAllSurfaces
+
+lay out lightmaps of all brush models one after another
+starting from base, returns total number of texels.
+NULL base only counts them
+==================
+*/
+static int LM_QueueAllSurfaces( byte *base )
+{
+	int		i, j, texels = 0;
+	int		smax, tmax, sample_size;
+	msurface_t	*surf;
+	model_t		*m;
+
+	for( i = 0; i < ENGINE_GET_PARM( PARM_NUMMODELS ); i++ )
+	{
+		if(( m = gEngfuncs.pfnGetModelByIndex( i + 1 )) == NULL )
+			continue;
+
+		if( m->name[0] == '*' || m->type != mod_brush || !m->lightdata )
+			continue;
+
+		for( j = 0, surf = m->surfaces; j < m->numsurfaces; j++, surf++ )
+		{
+			if( FBitSet( surf->flags, SURF_DRAWTILED ))
+				continue;
+
+			sample_size = gEngfuncs.Mod_SampleSizeForFace( surf );
+			smax = ( surf->info->lightextents[0] / sample_size ) + 1;
+			tmax = ( surf->info->lightextents[1] / sample_size ) + 1;
+
+			if( base ) LM_QueueSurface( surf, base + texels * 4, smax * 4, smax * tmax );
+			texels += smax * tmax;
+		}
+	}
+
+	return texels;
+}
+
+/*
+==================
+R_LightmapBench_f
+
+compose static lightmaps of all brush models into the
+system memory, no GL calls so the numbers show just the cpu
+==================
+*/
+void R_LightmapBench_f( void )
+{
+	int		i, pass, passes = 10;
+	int		texels, numjobs, maxsize;
+	int		numworkers = LM_NumWorkers();
+	double		start, reftime = 0.0, serialtime = 0.0, threadtime = 0.0;
+	byte		*reference, *serial, *threaded;
+	uint		*blocklights;
+	qboolean		match;
+
+	if( !WORLDMODEL )
+	{
+		gEngfuncs.Con_Printf( "r_lightmapbench: no map loaded\n" );
+		return;
+	}
+
+	if( gEngfuncs.Cmd_Argc() > 1 )
+		passes = Q_max( 1, Q_atoi( gEngfuncs.Cmd_Argv( 1 )));
+
+	if(( texels = LM_QueueAllSurfaces( NULL )) == 0 )
+	{
+		gEngfuncs.Con_Printf( "r_lightmapbench: map has no lightmaps\n" );
+		return;
+	}
+
+	GL_UpdateLightGamma();
+
+	reference = Mem_Malloc( r_temppool, texels * 4 );
+	serial = Mem_Malloc( r_temppool, texels * 4 );
+	threaded = Mem_Malloc( r_temppool, texels * 4 );
+
+	LM_QueueAllSurfaces( serial );
+	numjobs = lm_queue.numjobs;
+	maxsize = lm_queue.maxsize;
+	blocklights = Mem_Malloc( r_temppool, maxsize * sizeof( uint ));
+
+	for( pass = 0; pass < passes; pass++ )
+	{
+		start = gEngfuncs.pfnTime();
+		for( i = 0; i < numjobs; i++ )
+			R_BuildLightMapReference( lm_queue.jobs[i].surf, reference + ( lm_queue.jobs[i].dest - serial ), lm_queue.jobs[i].stride, blocklights );
+		reftime += gEngfuncs.pfnTime() - start;
+
+		start = gEngfuncs.pfnTime();
+		LM_ComposeQueue( 1 );
+		serialtime += gEngfuncs.pfnTime() - start;
+
+		// same jobs again, into the other buffer
+		lm_queue.numjobs = numjobs;
+		lm_queue.maxsize = maxsize;
+		for( i = 0; i < numjobs; i++ )
+			lm_queue.jobs[i].dest = threaded + ( lm_queue.jobs[i].dest - serial );
+
+		start = gEngfuncs.pfnTime();
+		LM_ComposeQueue( numworkers );
+		threadtime += gEngfuncs.pfnTime() - start;
+
+		lm_queue.numjobs = numjobs;
+		lm_queue.maxsize = maxsize;
+		for( i = 0; i < numjobs; i++ )
+			lm_queue.jobs[i].dest = serial + ( lm_queue.jobs[i].dest - threaded );
+	}
+
+	match = !memcmp( reference, serial, texels * 4 ) && !memcmp( reference, threaded, texels * 4 );
+
+	gEngfuncs.Con_Printf( "%i surfaces, %i texels, %i passes\n", numjobs, texels, passes );
+	gEngfuncs.Con_Printf( "reference: %.2f Mtexels/sec\n", (double)texels * passes / Q_max( reftime, 1e-9 ) / 1e6 );
+	gEngfuncs.Con_Printf( "batched: %.2f Mtexels/sec\n", (double)texels * passes / Q_max( serialtime, 1e-9 ) / 1e6 );
+	gEngfuncs.Con_Printf( "%i workers: %.2f Mtexels/sec\n", numworkers, (double)texels * passes / Q_max( threadtime, 1e-9 ) / 1e6 );
+	gEngfuncs.Con_Printf( "results %s\n", match ? "match" : "^1MISMATCH^7" );
+
+	Mem_Free( blocklights );
+	Mem_Free( threaded );
+	Mem_Free( serial );
+	Mem_Free( reference );
+	LM_FreeQueue();
+}
+
 void GL_InitRandomTable( void )
 {
 	int	tu, tv;
@@ -56,6 +56,19 @@ typedef struct sortedmesh_s
 	int		flags;			// face flags
 } sortedmesh_t;
 
+#define STUDIO_MESHCACHE_HASH		1024	// must be power of two
+
+// triangle commands of a mesh unpacked into an indexed triangle list
+typedef struct studiomeshcache_s
+{
+	const mstudiomesh_t		*mesh;		// key, points into the studio header
+	struct studiomeshcache_s	*next;		// next in hash chain
+	short			*verts;		// unique vertices in tricmd layout: vertex, normal, s, t
+	unsigned short		*elems;
+	int			numverts;		// 0 if mesh can't be cached
+	int			numelems;
+} studiomeshcache_t;
+
 typedef struct
 {
 	double		time;
@@ -132,6 +145,7 @@ static cvar_t			*r_studio_drawelements;
 
 static r_studio_interface_t	*pStudioDraw;
 static studio_draw_state_t	g_studio;		// global studio state
+static studiomeshcache_t	*g_meshcache[STUDIO_MESHCACHE_HASH];
 
 // global variables
 static qboolean		m_fDoRemap;
@@ -155,7 +169,7 @@ void R_StudioInit( void )
 	cl_himodels = gEngfuncs.Cvar_Get( "cl_himodels", "1", FCVAR_ARCHIVE, "draw high-resolution player models in multiplayer" );
 	r_studio_sort_textures = gEngfuncs.Cvar_Get( "r_studio_sort_textures", "0", FCVAR_ARCHIVE, "change draw order for additive meshes" );
 	r_drawviewmodel = gEngfuncs.Cvar_Get( "r_drawviewmodel", "1", 0, "draw firstperson weapon model" );
-	r_studio_drawelements = gEngfuncs.Cvar_Get( "r_studio_drawelements", "1", FCVAR_ARCHIVE, "use glDrawElements for studiomodels" );
+	r_studio_drawelements = gEngfuncs.Cvar_Get( "r_studio_drawelements", "1", FCVAR_ARCHIVE, "use glDrawElements for studiomodels (2 - rebuild arrays from tricmds every frame)" );
 
 	Matrix3x4_LoadIdentity( g_studio.rotationmatrix );
 	r_glowshellfreq = gEngfuncs.Cvar_Get( "r_glowshellfreq", "2.2", 0, "glowing shell frequency update" );
@@ -2246,7 +2260,253 @@ _inline void R_StudioBuildArrayChromeMesh( short *ptricmds, vec3_t *pstudionorms
 	}
 }
 
-_inline void R_StudioDrawArrays( uint startverts, uint startelems )
+/*
+===============
+R_StudioMeshCacheHash
+
+===============
+*/
+static uint R_StudioMeshCacheHash( const mstudiomesh_t *pmesh )
+{
+	size_t	key = (size_t)pmesh;
+
+	return (uint)(( key >> 4 ) ^ ( key >> 14 )) & ( STUDIO_MESHCACHE_HASH - 1 );
+}
+
+/*
+===============
+R_StudioBuildMeshCache
+
+unpack strips and fans into a triangle list, vertices that share
+position, normal and texcoord are emitted only once.
+Triangle order and winding are the same as R_StudioBuildIndices gives
+===============
+*/
+static studiomeshcache_t *R_StudioBuildMeshCache( const mstudiomesh_t *pmesh, const short *ptricmds )
+{
+	int		i, n, total = 0, numelems = 0, numverts = 0;
+	int		hashsize, *hash, *remap, first, prev1, prev2;
+	const short	*cmd;
+	short		*verts;
+	unsigned short	*elems;
+	studiomeshcache_t	*cache;
+	uint		h;
+
+	for( cmd = ptricmds; ( i = *( cmd++ )); cmd += abs( i ) * 4 )
+		total += abs( i );
+
+	for( hashsize = 64; hashsize < total * 2; hashsize <<= 1 );
+
+	hash = Mem_Malloc( r_temppool, hashsize * sizeof( int ));
+	remap = Mem_Malloc( r_temppool, Q_max( total, 1 ) * sizeof( int ));
+	verts = Mem_Malloc( r_temppool, Q_max( total, 1 ) * 4 * sizeof( short ));
+	memset( hash, 0xFF, hashsize * sizeof( int ));
+
+	// merge the same vertices
+	for( cmd = ptricmds, n = 0; ( i = *( cmd++ )); )
+	{
+		for( i = abs( i ); i > 0; i--, cmd += 4, n++ )
+		{
+			h = ((uint)cmd[0] * 73856093u ^ (uint)cmd[1] * 19349663u ^ (uint)cmd[2] * 83492791u ^ (uint)cmd[3] * 2654435761u ) & ( hashsize - 1 );
+
+			while( hash[h] != -1 && memcmp( &verts[hash[h] * 4], cmd, 4 * sizeof( short )))
+				h = ( h + 1 ) & ( hashsize - 1 );
+
+			if( hash[h] == -1 )
+			{
+				memcpy( &verts[numverts * 4], cmd, 4 * sizeof( short ));
+				hash[h] = numverts++;
+			}
+
+			remap[n] = hash[h];
+		}
+	}
+
+	cache = Mem_Calloc( r_temppool, sizeof( *cache ) + numverts * 4 * sizeof( short ) + Q_max( total, 1 ) * 3 * sizeof( unsigned short ));
+	cache->mesh = pmesh;
+
+	if( numverts <= MAXSTUDIOVERTS )
+	{
+		cache->verts = (short *)( cache + 1 );
+		cache->elems = (unsigned short *)( cache->verts + numverts * 4 );
+		memcpy( cache->verts, verts, numverts * 4 * sizeof( short ));
+		elems = cache->elems;
+
+		for( cmd = ptricmds, n = 0; ( i = *( cmd++ )); )
+		{
+			qboolean	tri_strip = ( i > 0 );
+			int	vertexState = 0;
+
+			first = prev1 = prev2 = 0;
+
+			for( i = abs( i ); i > 0; i--, cmd += 4, n++ )
+			{
+				if( vertexState++ < 3 )
+				{
+					elems[numelems++] = remap[n];
+					if( vertexState == 1 ) first = remap[n];
+				}
+				else if( !tri_strip )
+				{
+					elems[numelems++] = first;
+					elems[numelems++] = prev1;
+					elems[numelems++] = remap[n];
+				}
+				else if( vertexState & 1 )
+				{
+					elems[numelems++] = prev2;
+					elems[numelems++] = prev1;
+					elems[numelems++] = remap[n];
+				}
+				else
+				{
+					elems[numelems++] = prev1;
+					elems[numelems++] = prev2;
+					elems[numelems++] = remap[n];
+				}
+
+				prev2 = prev1;
+				prev1 = remap[n];
+			}
+		}
+
+		cache->numverts = numverts;
+		cache->numelems = numelems;
+	}
+
+	Mem_Free( verts );
+	Mem_Free( remap );
+	Mem_Free( hash );
+
+	return cache;
+}
+
+/*
+===============
+R_StudioGetMeshCache
+
+===============
+*/
+static studiomeshcache_t *R_StudioGetMeshCache( const mstudiomesh_t *pmesh, const short *ptricmds )
+{
+	uint		h = R_StudioMeshCacheHash( pmesh );
+	studiomeshcache_t	*cache;
+
+	for( cache = g_meshcache[h]; cache; cache = cache->next )
+	{
+		if( cache->mesh == pmesh )
+			return cache;
+	}
+
+	cache = R_StudioBuildMeshCache( pmesh, ptricmds );
+	cache->next = g_meshcache[h];
+	g_meshcache[h] = cache;
+
+	return cache;
+}
+
+/*
+===============
+R_StudioFreeMeshCache
+
+release meshes that belongs to the studio header,
+NULL releases everything
+===============
+*/
+static void R_StudioFreeMeshCache( const studiohdr_t *phdr )
+{
+	studiomeshcache_t	**prev, *cache;
+	int		i;
+
+	for( i = 0; i < STUDIO_MESHCACHE_HASH; i++ )
+	{
+		for( prev = &g_meshcache[i]; ( cache = *prev ) != NULL; )
+		{
+			if( phdr && ( (const byte *)cache->mesh < (const byte *)phdr || (const byte *)cache->mesh >= (const byte *)phdr + phdr->length ))
+			{
+				prev = &cache->next;
+				continue;
+			}
+
+			*prev = cache->next;
+			Mem_Free( cache );
+		}
+	}
+}
+
+/*
+===============
+R_StudioShutdown
+
+mesh caches are allocated from r_temppool,
+release them before the pool goes away
+===============
+*/
+void R_StudioShutdown( void )
+{
+	R_StudioFreeMeshCache( NULL );
+}
+
+/*
+===============
+R_StudioFillMeshArrays
+
+light and copy unique vertices of the cached mesh
+into the arrays, lighting is computed once per vertex
+===============
+*/
+static void R_StudioFillMeshArrays( const studiomeshcache_t *cache, vec3_t *pstudionorms, float s, float t, float scale )
+{
+	short	*v = cache->verts;
+	int	i, idx;
+
+	if( FBitSet( g_nFaceFlags, STUDIO_NF_CHROME ) && scale > 0.0f )
+	{
+		color24	*clr = &RI.currententity->curstate.rendercolor;
+
+		// glowshell
+		for( i = 0; i < cache->numverts; i++, v += 4 )
+		{
+			idx = g_studio.normaltable[v[0]];
+			VectorMA( g_studio.verts[v[0]], scale, g_studio.norms[v[0]], g_studio.arrayverts[i] );
+			Vector4Set( g_studio.arraycolor[i], clr->r, clr->g, clr->b, 255 );
+			g_studio.arraycoord[i][0] = g_studio.chrome[idx][0] * s;
+			g_studio.arraycoord[i][1] = g_studio.chrome[idx][1] * t;
+		}
+	}
+	else if( FBitSet( g_nFaceFlags, STUDIO_NF_CHROME ))
+	{
+		for( i = 0; i < cache->numverts; i++, v += 4 )
+		{
+			R_StudioSetColorArray( v, pstudionorms, g_studio.arraycolor[i] );
+			VectorCopy( g_studio.verts[v[0]], g_studio.arrayverts[i] );
+			g_studio.arraycoord[i][0] = g_studio.chrome[v[1]][0] * s;
+			g_studio.arraycoord[i][1] = g_studio.chrome[v[1]][1] * t;
+		}
+	}
+	else if( FBitSet( g_nFaceFlags, STUDIO_NF_UV_COORDS ))
+	{
+		for( i = 0; i < cache->numverts; i++, v += 4 )
+		{
+			R_StudioSetColorArray( v, pstudionorms, g_studio.arraycolor[i] );
+			VectorCopy( g_studio.verts[v[0]], g_studio.arrayverts[i] );
+			g_studio.arraycoord[i][0] = HalfToFloat( v[2] );
+			g_studio.arraycoord[i][1] = HalfToFloat( v[3] );
+		}
+	}
+	else
+	{
+		for( i = 0; i < cache->numverts; i++, v += 4 )
+		{
+			R_StudioSetColorArray( v, pstudionorms, g_studio.arraycolor[i] );
+			VectorCopy( g_studio.verts[v[0]], g_studio.arrayverts[i] );
+			g_studio.arraycoord[i][0] = v[2] * s;
+			g_studio.arraycoord[i][1] = v[3] * t;
+		}
+	}
+}
+
+_inline void R_StudioDrawArrays( const unsigned short *elems, uint numelems, uint startverts, uint endverts )
 {
 	pglEnableClientState( GL_VERTEX_ARRAY );
 	pglVertexPointer( 3, GL_FLOAT, 12, g_studio.arrayverts );
@@ -2262,11 +2522,10 @@ _inline void R_StudioDrawArrays( uint startverts, uint startelems )
 
 #if !defined XASH_NANOGL || defined XASH_WES && XASH_EMSCRIPTEN // WebGL need to know array sizes
 	if( pglDrawRangeElements )
-		pglDrawRangeElements( GL_TRIANGLES, startverts, g_studio.numverts,
-			g_studio.numelems - startelems, GL_UNSIGNED_SHORT, &g_studio.arrayelems[startelems] );
+		pglDrawRangeElements( GL_TRIANGLES, startverts, endverts, numelems, GL_UNSIGNED_SHORT, elems );
 	else
 #endif
-		pglDrawElements( GL_TRIANGLES, g_studio.numelems - startelems, GL_UNSIGNED_SHORT, &g_studio.arrayelems[startelems] );
+		pglDrawElements( GL_TRIANGLES, numelems, GL_UNSIGNED_SHORT, elems );
 	pglDisableClientState( GL_VERTEX_ARRAY );
 	pglDisableClientState( GL_TEXTURE_COORD_ARRAY );
 	if( !( g_nForceFaceFlags & STUDIO_NF_CHROME ) )
@@ -2275,32 +2534,24 @@ _inline void R_StudioDrawArrays( uint startverts, uint startelems )
 
 /*
 ===============
-R_StudioDrawPoints
+R_StudioPrepareMeshes
 
+skin and light the current submodel on the cpu,
+returns the glowshell scale
 ===============
 */
-static void R_StudioDrawPoints( void )
+static float R_StudioPrepareMeshes( mstudiotexture_t *ptexture, short *pskinref )
 {
-	int		i, j, k, m_skinnum;
+	int		i, j, k;
 	float		shellscale = 0.0f;
 	qboolean		need_sort = false;
 	byte		*pvertbone;
 	byte		*pnormbone;
 	vec3_t		*pstudioverts;
 	vec3_t		*pstudionorms;
-	mstudiotexture_t	*ptexture;
 	mstudiomesh_t	*pmesh;
-	short		*pskinref;
 	float		lv_tmp;
 
-	if( !m_pStudioHeader ) return;
-
-
-	g_studio.numverts = g_studio.numelems = 0;
-
-	// safety bounding the skinnum
-	m_skinnum = bound( 0, RI.currententity->curstate.skin, ( m_pStudioHeader->numskinfamilies - 1 ));
-	ptexture = (mstudiotexture_t *)((byte *)m_pStudioHeader + m_pStudioHeader->textureindex);
 	pvertbone = ((byte *)m_pStudioHeader + m_pSubModel->vertinfoindex);
 	pnormbone = ((byte *)m_pStudioHeader + m_pSubModel->norminfoindex);
 
@@ -2308,9 +2559,6 @@ static void R_StudioDrawPoints( void )
 	pstudioverts = (vec3_t *)((byte *)m_pStudioHeader + m_pSubModel->vertindex);
 	pstudionorms = (vec3_t *)((byte *)m_pStudioHeader + m_pSubModel->normindex);
 
-	pskinref = (short *)((byte *)m_pStudioHeader + m_pStudioHeader->skinindex);
-	if( m_skinnum != 0 ) pskinref += (m_skinnum * m_pStudioHeader->numskinref);
-
 	if( FBitSet( m_pStudioHeader->flags, STUDIO_HAS_BONEWEIGHTS ) && m_pSubModel->blendvertinfoindex != 0 && m_pSubModel->blendnorminfoindex != 0 )
 	{
 		mstudioboneweight_t	*pvertweight = (mstudioboneweight_t *)((byte *)m_pStudioHeader + m_pSubModel->blendvertinfoindex);
@@ -2389,6 +2637,38 @@ static void R_StudioDrawPoints( void )
 		qsort( g_studio.meshes, m_pSubModel->nummesh, sizeof( sortedmesh_t ), R_StudioMeshCompare );
 	}
 
+	return shellscale;
+}
+
+/*
+===============
+R_StudioDrawPoints
+
+===============
+*/
+static void R_StudioDrawPoints( void )
+{
+	int		j, m_skinnum;
+	float		shellscale;
+	vec3_t		*pstudionorms;
+	mstudiotexture_t	*ptexture;
+	mstudiomesh_t	*pmesh;
+	short		*pskinref;
+
+	if( !m_pStudioHeader ) return;
+
+
+	g_studio.numverts = g_studio.numelems = 0;
+
+	// safety bounding the skinnum
+	m_skinnum = bound( 0, RI.currententity->curstate.skin, ( m_pStudioHeader->numskinfamilies - 1 ));
+	ptexture = (mstudiotexture_t *)((byte *)m_pStudioHeader + m_pStudioHeader->textureindex);
+
+	pskinref = (short *)((byte *)m_pStudioHeader + m_pStudioHeader->skinindex);
+	if( m_skinnum != 0 ) pskinref += (m_skinnum * m_pStudioHeader->numskinref);
+
+	shellscale = R_StudioPrepareMeshes( ptexture, pskinref );
+
 	// NOTE: rewind normals at start
 	pstudionorms = (vec3_t *)((byte *)m_pStudioHeader + m_pSubModel->normindex);
 
@@ -2397,6 +2677,7 @@ static void R_StudioDrawPoints( void )
 		float	oldblend = tr.blend;
 		uint startArrayVerts = g_studio.numverts;
 		uint startArrayElems = g_studio.numelems;
+		studiomeshcache_t	*cache = NULL;
 		short	*ptricmds;
 		float	s, t;
 
@@ -2430,7 +2711,16 @@ static void R_StudioDrawPoints( void )
 
 		R_StudioSetupSkin( m_pStudioHeader, pskinref[pmesh->skinref] );
 
-		if( CVAR_TO_BOOL(r_studio_drawelements) )
+		if( r_studio_drawelements->value == 1.0f )
+			cache = R_StudioGetMeshCache( pmesh, ptricmds );
+
+		if( cache && cache->numverts )
+		{
+			// static topology, only vertices are filled every frame
+			R_StudioFillMeshArrays( cache, pstudionorms, s, t, shellscale );
+			R_StudioDrawArrays( cache->elems, cache->numelems, 0, cache->numverts - 1 );
+		}
+		else if( CVAR_TO_BOOL(r_studio_drawelements) )
 		{
 			if( FBitSet( g_nFaceFlags, STUDIO_NF_CHROME ))
 				R_StudioBuildArrayChromeMesh( ptricmds, pstudionorms, s, t, shellscale );
@@ -2438,7 +2728,7 @@ static void R_StudioDrawPoints( void )
 				R_StudioBuildArrayFloatMesh( ptricmds, pstudionorms );
 			else R_StudioBuildArrayNormalMesh( ptricmds, pstudionorms, s, t );
 
-			R_StudioDrawArrays( startArrayVerts, startArrayElems );
+			R_StudioDrawArrays( &g_studio.arrayelems[startArrayElems], g_studio.numelems - startArrayElems, startArrayVerts, g_studio.numverts );
 		}
 		else
 		{
@@ -2466,6 +2756,193 @@ static void R_StudioDrawPoints( void )
 	}
 }
 
+/*
+===============
+R_StudioExpandMesh
+
+store every triangle corner, so the arrays
+can be compared whatever the indexing was
+===============
+*/
+static void R_StudioExpandMesh( const unsigned short *elems, int numelems, byte *out )
+{
+	int	i;
+
+	for( i = 0; i < numelems; i++, out += sizeof( vec3_t ) + sizeof( vec2_t ) + 4 )
+	{
+		memcpy( out, g_studio.arrayverts[elems[i]], sizeof( vec3_t ));
+		memcpy( out + sizeof( vec3_t ), g_studio.arraycoord[elems[i]], sizeof( vec2_t ));
+		memcpy( out + sizeof( vec3_t ) + sizeof( vec2_t ), g_studio.arraycolor[elems[i]], 4 );
+	}
+}
+
+static void R_StudioBuildStripArrays( short *ptricmds, vec3_t *pstudionorms, float s, float t, float shellscale )
+{
+	g_studio.numverts = g_studio.numelems = 0;
+
+	if( FBitSet( g_nFaceFlags, STUDIO_NF_CHROME ))
+		R_StudioBuildArrayChromeMesh( ptricmds, pstudionorms, s, t, shellscale );
+	else if( FBitSet( g_nFaceFlags, STUDIO_NF_UV_COORDS ))
+		R_StudioBuildArrayFloatMesh( ptricmds, pstudionorms );
+	else R_StudioBuildArrayNormalMesh( ptricmds, pstudionorms, s, t );
+}
+
+/*
+===============
+R_StudioBench_f
+
+skin, light and fill vertex arrays for every bodypart
+of the model with both array paths, no GL calls are made
+===============
+*/
+void R_StudioBench_f( void )
+{
+	int		i, j, b, frame, frames = 100;
+	int		nummeshes = 0, numstripverts = 0, numunique = 0, mismatches = 0;
+	double		start, skintime = 0.0, striptime = 0.0, cachedtime = 0.0;
+	cl_entity_t	ent, *oldent = RI.currententity;
+	studiohdr_t	*oldhdr = m_pStudioHeader;
+	mstudiomodel_t	*oldsubmodel = m_pSubModel;
+	mstudiobodyparts_t	*oldbodypart = m_pBodyPart;
+	int		oldforceflags = g_nForceFaceFlags;
+	float		oldblend = tr.blend;
+	float		shellscale, s, t;
+	mstudiotexture_t	*ptexture;
+	studiomeshcache_t	*cache;
+	vec3_t		*pstudionorms;
+	mstudiomesh_t	*pmesh;
+	short		*pskinref, *ptricmds;
+	byte		*expected, *result;
+	size_t		cornersize = sizeof( vec3_t ) + sizeof( vec2_t ) + 4;
+	model_t		*mod;
+
+	if( gEngfuncs.Cmd_Argc() < 2 )
+	{
+		gEngfuncs.Con_Printf( S_USAGE "r_studiobench <model> [frames]\n" );
+		return;
+	}
+
+	mod = gEngfuncs.Mod_ForName( gEngfuncs.Cmd_Argv( 1 ), false, false );
+
+	if( !mod || mod->type != mod_studio )
+	{
+		gEngfuncs.Con_Printf( "r_studiobench: %s is not a studio model\n", gEngfuncs.Cmd_Argv( 1 ));
+		return;
+	}
+
+	if( gEngfuncs.Cmd_Argc() > 2 )
+		frames = Q_max( 1, Q_atoi( gEngfuncs.Cmd_Argv( 2 )));
+
+	memset( &ent, 0, sizeof( ent ));
+	ent.model = mod;
+	RI.currententity = &ent;
+	m_pStudioHeader = (studiohdr_t *)gEngfuncs.Mod_Extradata( mod_studio, mod );
+	g_nForceFaceFlags = 0;
+	tr.blend = 1.0f;
+
+	// rest pose with a fixed light from above
+	for( i = 0; i < m_pStudioHeader->numbones; i++ )
+	{
+		Matrix3x4_LoadIdentity( g_studio.bonestransform[i] );
+		Matrix3x4_LoadIdentity( g_studio.lighttransform[i] );
+		VectorSet( g_studio.blightvec[i], 0.0f, 0.0f, -1.0f );
+	}
+
+	VectorSet( g_studio.lightvec, 0.0f, 0.0f, -1.0f );
+	VectorSet( g_studio.lightcolor, 1.0f, 1.0f, 1.0f );
+	g_studio.ambientlight = 64.0f;
+	g_studio.shadelight = 128.0f;
+	g_studio.numlocallights = 0;
+	g_studio.framecount++;
+
+	ptexture = (mstudiotexture_t *)((byte *)m_pStudioHeader + m_pStudioHeader->textureindex);
+	pskinref = (short *)((byte *)m_pStudioHeader + m_pStudioHeader->skinindex);
+
+	for( b = 0; b < m_pStudioHeader->numbodyparts; b++ )
+	{
+		R_StudioSetupModel( b, NULL, NULL );
+		pstudionorms = (vec3_t *)((byte *)m_pStudioHeader + m_pSubModel->normindex);
+		shellscale = R_StudioPrepareMeshes( ptexture, pskinref );
+
+		// validate the cached topology against the strips
+		for( j = 0; j < m_pSubModel->nummesh; j++ )
+		{
+			pmesh = g_studio.meshes[j].mesh;
+			ptricmds = (short *)((byte *)m_pStudioHeader + pmesh->triindex);
+			g_nFaceFlags = g_studio.meshes[j].flags;
+			s = 1.0f / (float)ptexture[pskinref[pmesh->skinref]].width;
+			t = 1.0f / (float)ptexture[pskinref[pmesh->skinref]].height;
+
+			R_StudioBuildStripArrays( ptricmds, pstudionorms, s, t, shellscale );
+			expected = Mem_Malloc( r_temppool, Q_max( g_studio.numelems, 1 ) * cornersize );
+			R_StudioExpandMesh( g_studio.arrayelems, g_studio.numelems, expected );
+
+			cache = R_StudioGetMeshCache( pmesh, ptricmds );
+			nummeshes++;
+			numstripverts += g_studio.numverts;
+			numunique += cache->numverts;
+
+			if( cache->numverts && cache->numelems == g_studio.numelems )
+			{
+				R_StudioFillMeshArrays( cache, pstudionorms, s, t, shellscale );
+				result = Mem_Malloc( r_temppool, Q_max( cache->numelems, 1 ) * cornersize );
+				R_StudioExpandMesh( cache->elems, cache->numelems, result );
+				if( memcmp( expected, result, cache->numelems * cornersize ))
+					mismatches++;
+				Mem_Free( result );
+			}
+			else mismatches++;
+
+			Mem_Free( expected );
+		}
+
+		for( frame = 0; frame < frames; frame++ )
+		{
+			g_studio.framecount++;
+
+			start = gEngfuncs.pfnTime();
+			shellscale = R_StudioPrepareMeshes( ptexture, pskinref );
+			skintime += gEngfuncs.pfnTime() - start;
+
+			start = gEngfuncs.pfnTime();
+			for( j = 0; j < m_pSubModel->nummesh; j++ )
+			{
+				pmesh = g_studio.meshes[j].mesh;
+				g_nFaceFlags = g_studio.meshes[j].flags;
+				s = 1.0f / (float)ptexture[pskinref[pmesh->skinref]].width;
+				t = 1.0f / (float)ptexture[pskinref[pmesh->skinref]].height;
+				R_StudioBuildStripArrays( (short *)((byte *)m_pStudioHeader + pmesh->triindex), pstudionorms, s, t, shellscale );
+			}
+			striptime += gEngfuncs.pfnTime() - start;
+
+			start = gEngfuncs.pfnTime();
+			for( j = 0; j < m_pSubModel->nummesh; j++ )
+			{
+				pmesh = g_studio.meshes[j].mesh;
+				g_nFaceFlags = g_studio.meshes[j].flags;
+				s = 1.0f / (float)ptexture[pskinref[pmesh->skinref]].width;
+				t = 1.0f / (float)ptexture[pskinref[pmesh->skinref]].height;
+				cache = R_StudioGetMeshCache( pmesh, (short *)((byte *)m_pStudioHeader + pmesh->triindex));
+				if( cache->numverts ) R_StudioFillMeshArrays( cache, pstudionorms, s, t, shellscale );
+			}
+			cachedtime += gEngfuncs.pfnTime() - start;
+		}
+	}
+
+	gEngfuncs.Con_Printf( "%s: %i meshes, %i strip vertices, %i unique\n", mod->name, nummeshes, numstripverts, numunique );
+	gEngfuncs.Con_Printf( "skinning and lighting: %.2f usec\n", skintime * 1e6 / frames );
+	gEngfuncs.Con_Printf( "strip arrays: %.2f usec\n", striptime * 1e6 / frames );
+	gEngfuncs.Con_Printf( "cached arrays: %.2f usec\n", cachedtime * 1e6 / frames );
+	gEngfuncs.Con_Printf( "results %s\n", mismatches ? "^1MISMATCH^7" : "match" );
+
+	RI.currententity = oldent;
+	m_pStudioHeader = oldhdr;
+	m_pSubModel = oldsubmodel;
+	m_pBodyPart = oldbodypart;
+	g_nForceFaceFlags = oldforceflags;
+	tr.blend = oldblend;
+}
+
 /*
 ===============
 R_StudioDrawHulls
@@ -3851,6 +4328,9 @@ void Mod_StudioLoadTextures( model_t *mod, void *data )
 	if( !phdr )
 		return;
 
+	// mesh caches are pointing into the header
+	R_StudioFreeMeshCache( phdr );
+
 	ptexture = (mstudiotexture_t *)(((byte *)phdr) + phdr->textureindex);
 	if( phdr->textureindex > 0 && phdr->numtextures <= MAXSTUDIOSKINS )
 	{
@@ -3873,6 +4353,9 @@ void Mod_StudioUnloadTextures( void *data )
 	if( !phdr )
 		return;
 
+	// mesh caches are pointing into the header
+	R_StudioFreeMeshCache( phdr );
+
 	ptexture = (mstudiotexture_t *)(((byte *)phdr) + phdr->textureindex);
 
 	// release all textures
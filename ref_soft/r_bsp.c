@@ -778,161 +778,134 @@ int r_leafkeys[MAX_MAP_LEAFS];
 #endif
 /*
 ================
-R_RecursiveWorldNode
+R_RenderWorldLeaf
 ================
 */
-void R_RecursiveWorldNode (mnode_t *node, int clipflags)
+static void R_RenderWorldLeaf (mleaf_t *pleaf)
 {
-	int			i, c, side, *pindex;
-	vec3_t		acceptpt, rejectpt;
-	mplane_t	*plane;
-	msurface_t	*surf, **mark;
-	mleaf_t		*pleaf;
-	double		d, dot;
-
-	if (node->contents == CONTENTS_SOLID)
-		return;		// solid
+	msurface_t	**mark;
+	int			c;
 
-	if (node->visframe != tr.visframecount)
-		return;
+	mark = pleaf->firstmarksurface;
+	c = pleaf->nummarksurfaces;
 
-// cull the clipping planes if not trivial accept
-// FIXME: the compiler is doing a lousy job of optimizing here; it could be
-//  twice as fast in ASM
-	if (clipflags)
+	if (c)
 	{
-		for (i=0 ; i<4 ; i++)
+		do
 		{
-			if (! (clipflags & (1<<i)) )
-				continue;	// don't need to clip against it
-
-		// generate accept and reject points
-		// FIXME: do with fast look-ups or integer tests based on the sign bit
-		// of the floating point values
-
-			pindex = qfrustum.pfrustum_indexes[i];
+			(*mark)->visframe = tr.framecount;
+			mark++;
+		} while (--c);
+	}
 
-			rejectpt[0] = (float)node->minmaxs[pindex[0]];
-			rejectpt[1] = (float)node->minmaxs[pindex[1]];
-			rejectpt[2] = (float)node->minmaxs[pindex[2]];
+// deal with model fragments in this leaf
+	if (pleaf->efrags)
+	{
+		gEngfuncs.R_StoreEfrags(&pleaf->efrags,tr.realframecount);
+	}
 
-			d = DotProduct (rejectpt, qfrustum.view_clipplanes[i].normal);
-			d -= qfrustum.view_clipplanes[i].dist;
+//	pleaf->cluster
+	LEAF_KEY(pleaf) = r_currentkey;
+	r_currentkey++;		// all bmodels in a leaf share the same key
+}
 
-			if (d <= 0)
-				return;
+/*
+================
+R_RenderWorldNode
+================
+*/
+static void R_RenderWorldNode (mnode_t *node, int clipflags)
+{
+	int			c;
+	mplane_t	*plane;
+	msurface_t	*surf;
+	double		dot;
 
-			acceptpt[0] = (float)node->minmaxs[pindex[3+0]];
-			acceptpt[1] = (float)node->minmaxs[pindex[3+1]];
-			acceptpt[2] = (float)node->minmaxs[pindex[3+2]];
+	c = node->numsurfaces;
 
-			d = DotProduct (acceptpt, qfrustum.view_clipplanes[i].normal);
-			d -= qfrustum.view_clipplanes[i].dist;
+	if (!c)
+		return;
 
-			if (d >= 0)
-				clipflags &= ~(1<<i);	// node is entirely on screen
-		}
-	}
+// find which side of the node we are on
+	plane = node->plane;
 
-// if a leaf node, draw stuff
-	if (node->contents < 0)
+	switch (plane->type)
 	{
-		pleaf = (mleaf_t *)node;
+	case PLANE_X:
+		dot = tr.modelorg[0] - plane->dist;
+		break;
+	case PLANE_Y:
+		dot = tr.modelorg[1] - plane->dist;
+		break;
+	case PLANE_Z:
+		dot = tr.modelorg[2] - plane->dist;
+		break;
+	default:
+		dot = DotProduct (tr.modelorg, plane->normal) - plane->dist;
+		break;
+	}
 
-		mark = pleaf->firstmarksurface;
-		c = pleaf->nummarksurfaces;
+// draw stuff
+	surf = WORLDMODEL->surfaces + node->firstsurface;
 
-		if (c)
+	if (dot < -BACKFACE_EPSILON)
+	{
+		do
 		{
-			do
+			if ((surf->flags & SURF_PLANEBACK) &&
+				(surf->visframe == tr.framecount))
 			{
-				(*mark)->visframe = tr.framecount;
-				mark++;
-			} while (--c);
-		}
-
-	// deal with model fragments in this leaf
-		if (pleaf->efrags)
-		{
-			gEngfuncs.R_StoreEfrags(&pleaf->efrags,tr.realframecount);
-		}
-
+				R_RenderFace (surf, clipflags);
+			}
 
-	//	pleaf->cluster
-		LEAF_KEY(pleaf) = r_currentkey;
-		r_currentkey++;		// all bmodels in a leaf share the same key
+			surf++;
+		} while (--c);
 	}
-	else
+	else if (dot > BACKFACE_EPSILON)
 	{
-	// node is just a decision point, so go down the apropriate sides
-
-	// find which side of the node we are on
-		plane = node->plane;
-
-		switch (plane->type)
+		do
 		{
-		case PLANE_X:
-			dot = tr.modelorg[0] - plane->dist;
-			break;
-		case PLANE_Y:
-			dot = tr.modelorg[1] - plane->dist;
-			break;
-		case PLANE_Z:
-			dot = tr.modelorg[2] - plane->dist;
-			break;
-		default:
-			dot = DotProduct (tr.modelorg, plane->normal) - plane->dist;
-			break;
-		}
-
-		if (dot >= 0)
-			side = 0;
-		else
-			side = 1;
+			if (!(surf->flags & SURF_PLANEBACK) &&
+				(surf->visframe == tr.framecount))
+			{
+				R_RenderFace (surf, clipflags);
+			}
 
-	// recurse down the children, front side first
-		R_RecursiveWorldNode (node->children[side], clipflags);
+			surf++;
+		} while (--c);
+	}
 
-	// draw stuff
-		c = node->numsurfaces;
+// all surfaces on the same node share the same sequence number
+	r_currentkey++;
+}
 
-		if (c)
-		{
-			surf = WORLDMODEL->surfaces + node->firstsurface;
+/*
+================
+R_RenderWorldNodes
 
-			if (dot < -BACKFACE_EPSILON)
-			{
-				do
-				{
-					if ((surf->flags & SURF_PLANEBACK) &&
-						(surf->visframe == tr.framecount))
-					{
-						R_RenderFace (surf, clipflags);
-					}
+nodes and leafs that passed the pvs and the view planes
+come front to back, the same order the recursion had
+================
+*/
+static void R_RenderWorldNodes (int clipflags)
+{
+	cullplanes_t	planes;
+	cullnode_t		*item;
+	int				i, count;
 
-					surf++;
-				} while (--c);
-			}
-			else if (dot > BACKFACE_EPSILON)
-			{
-				do
-				{
-					if (!(surf->flags & SURF_PLANEBACK) &&
-						(surf->visframe == tr.framecount))
-					{
-						R_RenderFace (surf, clipflags);
-					}
+	memset (&planes, 0, sizeof (planes));
+	planes.inclusive = true;	// the old recursion rejected on d <= 0
 
-					surf++;
-				} while (--c);
-			}
+	for (i = 0; i < 4; i++)
+		R_WorldCullSetPlane (&planes, i, qfrustum.view_clipplanes[i].normal, qfrustum.view_clipplanes[i].dist);
 
-		// all surfaces on the same node share the same sequence number
-			r_currentkey++;
-		}
+	count = R_WorldCullNodes (&tr.worldcull, &planes, tr.modelorg, clipflags, tr.visframecount);
 
-	// recurse down the back side
-		R_RecursiveWorldNode (node->children[!side], clipflags);
+	for (i = 0, item = tr.worldcull.visible; i < count; i++, item++)
+	{
+		if (item->node->contents < 0)
+			R_RenderWorldLeaf ((mleaf_t *)item->node);
+		else R_RenderWorldNode (item->node, item->clipflags);
 	}
 }
 
@@ -959,5 +932,5 @@ void R_RenderWorld (void)
 	RI.currentmodel = WORLDMODEL;
 	r_pcurrentvertbase = RI.currentmodel->vertexes;
 
-	R_RecursiveWorldNode (RI.currentmodel->nodes, 15);
+	R_RenderWorldNodes (15);
 }
@@ -28,6 +28,11 @@ GNU General Public License for more details.
 #define MIN_DECAL_SCALE		0.01f
 #define MAX_DECAL_SCALE		16.0f
 
+// decal spatial index
+#define DECAL_HASH_SIZE		1024	// MUST BE POWER OF 2
+#define DECAL_HASH_CELL		64.0f	// world units
+#define DECAL_HASH_MAXCELLS		64	// bigger queries just walk the surface list
+
 // clip edges
 #define LEFT_EDGE			0
 #define RIGHT_EDGE			1
@@ -49,18 +54,79 @@ typedef struct
 	vec3_t		m_Basis[3];
 } decalinfo_t;
 
+// overlap test data, kept parallel to gDecalPool
+typedef struct
+{
+	vec3_t		basis[2];		// decal texture space, see R_SetupDecalTextureSpaceBasis
+	float		radius;		// half of the biggest decal side in world units
+	uint		sequence;		// order of linking into the surface list
+	uint		visitframe;	// cells may share the hash bucket
+	int		hashcell;		// bucket + 1, zero if not linked
+	int		hashnext;		// next decal + 1 in the same bucket
+	int		depth;		// used by R_CreateDecalList
+} decalnode_t;
+
 static float	g_DecalClipVerts[MAX_DECALCLIPVERT][VERTEXSIZE];
 static float	g_DecalClipVerts2[MAX_DECALCLIPVERT][VERTEXSIZE];
 
 decal_t	gDecalPool[MAX_RENDER_DECALS];
 static int	gDecalCount;
 
+static decalnode_t	g_decalnodes[MAX_RENDER_DECALS];
+static int	g_decalhash[DECAL_HASH_SIZE];	// first decal + 1
+static float	g_decalmaxradius;
+static uint	g_decalsequence;
+static uint	g_decalvisitframe;
+
 void R_ClearDecals( void )
 {
 	memset( gDecalPool, 0, sizeof( gDecalPool ));
 	gDecalCount = 0;
+
+	memset( g_decalnodes, 0, sizeof( g_decalnodes ));
+	memset( g_decalhash, 0, sizeof( g_decalhash ));
+	g_decalmaxradius = 0.0f;
+	g_decalsequence = 0;
+}
+
+/*
+=============================================================
+
+  DECAL SPATIAL INDEX
+
+=============================================================
+*/
+static int R_DecalHashCoord( float value )
+{
+	return (int)floor( value * ( 1.0f / DECAL_HASH_CELL ));
+}
+
+static int R_DecalHashKey( int x, int y, int z )
+{
+	return ((uint)x * 73856093U ^ (uint)y * 19349663U ^ (uint)z * 83492791U ) & ( DECAL_HASH_SIZE - 1 );
+}
+
+static void R_DecalUnlinkNode( decal_t *pdecal )
+{
+	decalnode_t	*node = &g_decalnodes[pdecal - gDecalPool];
+	int		*link;
+
+	if( !node->hashcell )
+		return;
+
+	for( link = &g_decalhash[node->hashcell - 1]; *link; link = &g_decalnodes[*link - 1].hashnext )
+	{
+		if( *link - 1 == pdecal - gDecalPool )
+		{
+			*link = node->hashnext;
+			break;
+		}
+	}
+
+	node->hashcell = 0;
 }
 
+
 // unlink pdecal from any surface it's attached to
 static void R_DecalUnlink( decal_t *pdecal )
 {
@@ -92,6 +158,7 @@ static void R_DecalUnlink( decal_t *pdecal )
 	if( pdecal->polys )
 		Mem_Free( pdecal->polys );
 
+	R_DecalUnlinkNode( pdecal );
 	pdecal->psurface = NULL;
 	pdecal->polys = NULL;
 }
@@ -199,6 +266,31 @@ void R_SetupDecalTextureSpaceBasis( decal_t *pDecal, msurface_t *surf, int textu
 	VectorScale( textureSpaceBasis[1], decalWorldScale[1], textureSpaceBasis[1] );
 }
 
+// Remember the decal texture space for the overlap test and put the decal into the spatial index.
+static void R_DecalLinkNode( decal_t *pdecal, msurface_t *surf )
+{
+	decalnode_t	*node = &g_decalnodes[pdecal - gDecalPool];
+	vec3_t		textureSpaceBasis[3];
+	float		decalWorldScale[2];
+	int		width, height;
+
+	R_DecalUnlinkNode( pdecal );
+
+	R_SetupDecalTextureSpaceBasis( pdecal, surf, pdecal->texture, textureSpaceBasis, decalWorldScale );
+	VectorCopy( textureSpaceBasis[0], node->basis[0] );
+	VectorCopy( textureSpaceBasis[1], node->basis[1] );
+
+	R_GetDecalDimensions( pdecal->texture, &width, &height );
+	node->radius = Q_max( width, height ) * 0.5f / pdecal->scale;
+	g_decalmaxradius = Q_max( g_decalmaxradius, node->radius );
+	node->sequence = ++g_decalsequence;
+
+	node->hashcell = R_DecalHashKey( R_DecalHashCoord( pdecal->position[0] ),
+		R_DecalHashCoord( pdecal->position[1] ), R_DecalHashCoord( pdecal->position[2] )) + 1;
+	node->hashnext = g_decalhash[node->hashcell - 1];
+	g_decalhash[node->hashcell - 1] = pdecal - gDecalPool + 1;
+}
+
 // Build the initial list of vertices from the surface verts into the global array, 'verts'.
 void R_SetupDecalVertsForMSurface( decal_t *pDecal, msurface_t *surf,	vec3_t textureSpaceBasis[3], float *verts )
 {
@@ -363,10 +455,11 @@ float *R_DoDecalSHClip( float *pInVerts, decal_t *pDecal, int nStartVerts, int *
 	int	outCount;
 
 	// clip the polygon to the decal texture space
+	// and stop as soon as nothing is left
 	outCount = SHClip( pInVerts, nStartVerts, g_DecalClipVerts2[0], LEFT_EDGE );
-	outCount = SHClip( g_DecalClipVerts2[0], outCount, g_DecalClipVerts[0], RIGHT_EDGE );
-	outCount = SHClip( g_DecalClipVerts[0], outCount, g_DecalClipVerts2[0], TOP_EDGE );
-	outCount = SHClip( g_DecalClipVerts2[0], outCount, pOutVerts, BOTTOM_EDGE );
+	if( outCount ) outCount = SHClip( g_DecalClipVerts2[0], outCount, g_DecalClipVerts[0], RIGHT_EDGE );
+	if( outCount ) outCount = SHClip( g_DecalClipVerts[0], outCount, g_DecalClipVerts2[0], TOP_EDGE );
+	if( outCount ) outCount = SHClip( g_DecalClipVerts2[0], outCount, pOutVerts, BOTTOM_EDGE );
 
 	if( pVertCount )
 		*pVertCount = outCount;
@@ -423,6 +516,65 @@ static void R_DecalVertsLight( float *v, msurface_t *surf, int vertCount )
 	}
 }
 
+// Compute how much of pDecal is covered by the decal in decalinfo, zero if they don't touch
+static float R_DecalOverlapArea( decalinfo_t *decalinfo, decal_t *pDecal, vec3_t decalExtents[2] )
+{
+	decalnode_t	*node = &g_decalnodes[pDecal - gDecalPool];
+	vec3_t		testPosition[2];
+	vec2_t		vDecalMin, vDecalMax;
+	vec2_t		vUnionMin, vUnionMax;
+
+	VectorSubtract( decalinfo->m_Position, decalExtents[0], testPosition[0] );
+	VectorSubtract( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+
+	// Here, we project the min and max extents of the decal that got passed in into
+	// this decal's (pDecal's) [0,0,1,1] clip space, just like we would if we were
+	// clipping a triangle into pDecal's clip space.
+	Vector2Set( vDecalMin,
+		DotProduct( testPosition[0], node->basis[0] ) - pDecal->dx + 0.5f,
+		DotProduct( testPosition[1], node->basis[1] ) - pDecal->dy + 0.5f );
+
+	VectorAdd( decalinfo->m_Position, decalExtents[0], testPosition[0] );
+	VectorAdd( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+
+	Vector2Set( vDecalMax,
+		DotProduct( testPosition[0], node->basis[0] ) - pDecal->dx + 0.5f,
+		DotProduct( testPosition[1], node->basis[1] ) - pDecal->dy + 0.5f );
+
+	// Now figure out the part of the projection that intersects pDecal's
+	// clip box [0,0,1,1].
+	Vector2Set( vUnionMin, max( vDecalMin[0], 0 ), max( vDecalMin[1], 0 ));
+	Vector2Set( vUnionMax, min( vDecalMax[0], 1 ), min( vDecalMax[1], 1 ));
+
+	if( vUnionMin[0] < 1 && vUnionMin[1] < 1 && vUnionMax[0] > 0 && vUnionMax[1] > 0 )
+	{
+		// Figure out how much of this intersects the (0,0) - (1,1) bbox.
+		return (vUnionMax[0] - vUnionMin[1]) * (vUnionMax[1] - vUnionMin[1]);
+	}
+
+	return 0.0f;
+}
+
+// Distance from the decal center that covers every decal it can overlap.
+// Returns zero if the surface basis is too skewed to bound it.
+static float R_DecalQueryRadius( decalinfo_t *decalinfo, vec3_t decalExtents[2] )
+{
+	vec3_t	cross;
+	float	det;
+
+	// the decals on a surface overlap only if the distance between
+	// their centers along both basis vectors is below the sum of the
+	// half sizes, and the centers are never more than DECAL_DISTANCE
+	// away from the surface plane
+	CrossProduct( decalinfo->m_Basis[1], decalinfo->m_Basis[2], cross );
+	det = fabs( DotProduct( decalinfo->m_Basis[0], cross ));
+
+	if( det < 0.25f )
+		return 0.0f;
+
+	return ( VectorLength( decalExtents[0] ) + VectorLength( decalExtents[1] ) + g_decalmaxradius * 2.0f + DECAL_DISTANCE * 2.0f + 1.0f ) / det;
+}
+
 // Check for intersecting decals on this surface
 static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int *pcount )
 {
@@ -430,7 +582,11 @@ static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int
 	decal_t		*plast, *pDecal;
 	vec3_t		decalExtents[2];
 	float		lastArea = 2;
+	uint		lastSequence = 0;
+	int		mins[3], maxs[3];
 	int		mapSize[2];
+	int		i, x, y, z;
+	float		radius;
 
 	plast = NULL;
 	*pcount = 0;
@@ -443,65 +599,85 @@ static decal_t *R_DecalIntersect( decalinfo_t *decalinfo, msurface_t *surf, int
 	VectorScale( decalinfo->m_Basis[0], ((mapSize[0] / decalinfo->m_scale) * 0.5f), decalExtents[0] );
 	VectorScale( decalinfo->m_Basis[1], ((mapSize[1] / decalinfo->m_scale) * 0.5f), decalExtents[1] );
 
-	pDecal = surf->pdecals;
+	radius = R_DecalQueryRadius( decalinfo, decalExtents );
 
-	while( pDecal )
+	for( i = 0; i < 3 && radius > 0.0f; i++ )
 	{
-		texture = pDecal->texture;
+		mins[i] = R_DecalHashCoord( decalinfo->m_Position[i] - radius );
+		maxs[i] = R_DecalHashCoord( decalinfo->m_Position[i] + radius );
+	}
 
-		// Don't steal bigger decals and replace them with smaller decals
-		// Don't steal permanent decals
-		if( !FBitSet( pDecal->flags, FDECAL_PERMANENT ))
+	if( radius <= 0.0f || ( maxs[0] - mins[0] + 1 ) * ( maxs[1] - mins[1] + 1 ) * ( maxs[2] - mins[2] + 1 ) > DECAL_HASH_MAXCELLS )
+	{
+		// walk the whole surface list
+		for( pDecal = surf->pdecals; pDecal; pDecal = pDecal->pnext )
 		{
-			vec3_t	testBasis[3];
-			vec3_t	testPosition[2];
-			float	testWorldScale[2];
-			vec2_t	vDecalMin, vDecalMax;
-			vec2_t	vUnionMin, vUnionMax;
+			float	flArea;
 
-			R_SetupDecalTextureSpaceBasis( pDecal, surf, texture, testBasis, testWorldScale );
+			// Don't steal bigger decals and replace them with smaller decals
+			// Don't steal permanent decals
+			if( FBitSet( pDecal->flags, FDECAL_PERMANENT ))
+				continue;
 
-			VectorSubtract( decalinfo->m_Position, decalExtents[0], testPosition[0] );
-			VectorSubtract( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+			flArea = R_DecalOverlapArea( decalinfo, pDecal, decalExtents );
 
-			// Here, we project the min and max extents of the decal that got passed in into
-			// this decal's (pDecal's) [0,0,1,1] clip space, just like we would if we were
-			// clipping a triangle into pDecal's clip space.
-			Vector2Set( vDecalMin,
-				DotProduct( testPosition[0], testBasis[0] ) - pDecal->dx + 0.5f,
-				DotProduct( testPosition[1], testBasis[1] ) - pDecal->dy + 0.5f );
+			if( flArea > 0.6f )
+			{
+				*pcount += 1;
 
-			VectorAdd( decalinfo->m_Position, decalExtents[0], testPosition[0] );
-			VectorAdd( decalinfo->m_Position, decalExtents[1], testPosition[1] );
+				if( !plast || flArea <= lastArea )
+				{
+					plast = pDecal;
+					lastArea =  flArea;
+				}
+			}
+		}
 
-			Vector2Set( vDecalMax,
-				DotProduct( testPosition[0], testBasis[0] ) - pDecal->dx + 0.5f,
-				DotProduct( testPosition[1], testBasis[1] ) - pDecal->dy + 0.5f );
+		return plast;
+	}
 
-			// Now figure out the part of the projection that intersects pDecal's
-			// clip box [0,0,1,1].
-			Vector2Set( vUnionMin, max( vDecalMin[0], 0 ), max( vDecalMin[1], 0 ));
-			Vector2Set( vUnionMax, min( vDecalMax[0], 1 ), min( vDecalMax[1], 1 ));
+	g_decalvisitframe++;
 
-			if( vUnionMin[0] < 1 && vUnionMin[1] < 1 && vUnionMax[0] > 0 && vUnionMax[1] > 0 )
+	for( x = mins[0]; x <= maxs[0]; x++ )
+	{
+		for( y = mins[1]; y <= maxs[1]; y++ )
+		{
+			for( z = mins[2]; z <= maxs[2]; z++ )
 			{
-				// Figure out how much of this intersects the (0,0) - (1,1) bbox.
-				float	flArea = (vUnionMax[0] - vUnionMin[1]) * (vUnionMax[1] - vUnionMin[1]);
-
-				if( flArea > 0.6f )
+				for( i = g_decalhash[R_DecalHashKey( x, y, z )]; i; i = g_decalnodes[i - 1].hashnext )
 				{
-					*pcount += 1;
+					decalnode_t	*node = &g_decalnodes[i - 1];
+					float		flArea;
+
+					if( node->visitframe == g_decalvisitframe )
+						continue;
+					node->visitframe = g_decalvisitframe;
+
+					pDecal = &gDecalPool[i - 1];
+
+					if( pDecal->psurface != surf || FBitSet( pDecal->flags, FDECAL_PERMANENT ))
+						continue;
+
+					flArea = R_DecalOverlapArea( decalinfo, pDecal, decalExtents );
 
-					if( !plast || flArea <= lastArea )
+					if( flArea > 0.6f )
 					{
-						plast = pDecal;
-						lastArea =  flArea;
+						*pcount += 1;
+
+						// same pick as the surface list walk: the smallest
+						// area and the last linked decal among the equal ones
+						if( !plast || flArea < lastArea || ( flArea == lastArea && node->sequence > lastSequence ))
+						{
+							plast = pDecal;
+							lastArea = flArea;
+							lastSequence = node->sequence;
+						}
 					}
 				}
 			}
 		}
-		pDecal = pDecal->pnext;
 	}
+
 	return plast;
 }
 
@@ -575,6 +751,8 @@ static void R_AddDecalToSurface( decal_t *pdecal, msurface_t *surf, decalinfo_t
 	// and will be culled, drawing and sorting
 	// together with surface
 
+	R_DecalLinkNode( pdecal, surf );
+
 	// alloc clipped poly for decal
 	R_DecalCreatePoly( decalinfo, pdecal, surf );
 	//R_AddDecalVBO( pdecal, surf );
@@ -1177,23 +1355,45 @@ int GAME_EXPORT R_CreateDecalList( decallist_t *pList )
 
 	if( WORLDMODEL )
 	{
+		decal_t	*pdecals;
+
+		// compute depths with a single walk over every surface list
+		for( i = 0; i < MAX_RENDER_DECALS; i++ )
+			g_decalnodes[i].depth = -1;
+
+		for( i = 0; i < MAX_RENDER_DECALS; i++ )
+		{
+			decal_t	*decal = &gDecalPool[i];
+
+			if( decal->psurface == NULL || decal->psurface->pdecals != decal )
+				continue;
+
+			for( pdecals = decal, depth = 0; pdecals; pdecals = pdecals->pnext, depth++ )
+				g_decalnodes[pdecals - gDecalPool].depth = depth;
+		}
+
 		for( i = 0; i < MAX_RENDER_DECALS; i++ )
 		{
 			decal_t	*decal = &gDecalPool[i];
-			decal_t	*pdecals;
 
 			// decal is in use and is not a custom decal
 			if( decal->psurface == NULL || FBitSet( decal->flags, FDECAL_DONTSAVE ))
 				 continue;
 
 			// compute depth
-			depth = 0;
-			pdecals = decal->psurface->pdecals;
+			depth = g_decalnodes[i].depth;
 
-			while( pdecals && pdecals != decal )
+			if( depth == -1 )
 			{
-				depth++;
-				pdecals = pdecals->pnext;
+				// not in the surface list
+				depth = 0;
+				pdecals = decal->psurface->pdecals;
+
+				while( pdecals && pdecals != decal )
+				{
+					depth++;
+					pdecals = pdecals->pnext;
+				}
 			}
 
 			pList[total].depth = depth;
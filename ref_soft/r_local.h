@@ -25,6 +25,7 @@ GNU General Public License for more details.
 #include "protocol.h"
 #include "dlight.h"
 #include "ref_api.h"
+#include "r_worldcull.h"
 #include "xash3d_mathlib.h"
 #include "ref_params.h"
 #include "enginefeatures.h"
@@ -301,6 +302,7 @@ typedef struct
 
 	// cull info
 	vec3_t		modelorg;		// relative to viewpoint
+	worldcull_t	worldcull;	// packed bounds and cached leaf lists of the world
 
 	qboolean fCustomSkybox;
 	int sample_size;
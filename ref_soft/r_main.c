@@ -1541,9 +1541,7 @@ R_MarkLeaves
 */
 void R_MarkLeaves (void)
 {
-	byte	*vis;
-	mnode_t	*node;
-	int		i;
+	int		leaf1;
 
 	if (r_oldviewcluster == r_viewcluster && !r_novis->value && r_viewcluster != -1)
 		return;
@@ -1551,23 +1549,17 @@ void R_MarkLeaves (void)
 	tr.visframecount++;
 	r_oldviewcluster = r_viewcluster;
 
-	gEngfuncs.R_FatPVS( RI.pvsorigin, REFPVS_RADIUS, RI.visbytes, FBitSet( RI.params, RP_OLDVIEWLEAF ), false );
-	vis = RI.visbytes;
+	// the pvs of a leaf doesn't change, so keep the last few of them.
+	// merging into the previous pvs depends on it and can't be cached
+	leaf1 = ( RI.viewleaf && !FBitSet( RI.params, RP_OLDVIEWLEAF )) ? RI.viewleaf - WORLDMODEL->leafs : -1;
 
-	for (i = 0; i < WORLDMODEL->numleafs; i++)
+	if( !R_WorldCullFindPVS( &tr.worldcull, leaf1, -1, false, RI.visbytes ))
 	{
-		if (vis[i>>3] & (1<<(i&7)))
-		{
-			node = (mnode_t *) &WORLDMODEL->leafs[i+1];
-			do
-			{
-				if (node->visframe == tr.visframecount)
-					break;
-				node->visframe = tr.visframecount;
-				node = node->parent;
-			} while (node);
-		}
+		gEngfuncs.R_FatPVS( RI.pvsorigin, REFPVS_RADIUS, RI.visbytes, FBitSet( RI.params, RP_OLDVIEWLEAF ), false );
+		R_WorldCullStorePVS( &tr.worldcull, leaf1, -1, false, RI.visbytes );
 	}
+
+	R_WorldCullMarkNodes( &tr.worldcull, tr.visframecount );
 }
 
 
@@ -1830,6 +1822,7 @@ void GAME_EXPORT R_NewMap (void)
 	model_t *world = WORLDMODEL;
 
 	r_viewcluster = -1;
+	R_WorldCullInit( &tr.worldcull, world, r_temppool );
 
 	tr.draw_list->num_solid_entities = 0;
 	tr.draw_list->num_trans_entities = 0;
@@ -2008,6 +2001,7 @@ qboolean GAME_EXPORT R_Init( void )
 
 void GAME_EXPORT R_Shutdown( void )
 {
+	R_WorldCullFree( &tr.worldcull );
 	R_ShutdownImages();
 	gEngfuncs.R_Free_Video();
 }